@@ -0,0 +1,73 @@
+// Copyright (c) 2020 Chaintope Inc.
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <coloridentifier.h>
+#include <primitives/transaction.h>
+
+#include <vector>
+
+static void AddBalance(TxColoredCoinBalancesMap& balances, const ColorIdentifier& colorId, CAmount nValue)
+{
+    auto iter = balances.find(colorId);
+    if (iter == balances.end())
+        balances.emplace(colorId, nValue);
+    else
+        iter->second += nValue;
+}
+
+static void AddBalance(TxColoredCoinBalances& balances, const ColorIdentifier& colorId, CAmount nValue)
+{
+    balances.Add(colorId, nValue);
+}
+
+// Mirrors the token balance check of mempool acceptance: tally the inputs and
+// outputs per color and match every output color against the inputs.
+template <typename Balances>
+static bool CheckBalances(const std::vector<ColorIdentifier>& inColors, const std::vector<ColorIdentifier>& outColors)
+{
+    Balances inBalances, outBalances;
+    for (const ColorIdentifier& colorId : inColors)
+        AddBalance(inBalances, colorId, 10);
+    for (const ColorIdentifier& colorId : outColors)
+        AddBalance(outBalances, colorId, 10);
+
+    for (const auto& out : outBalances) {
+        auto iter = inBalances.find(out.first);
+        if (iter == inBalances.end() || out.second > iter->second)
+            return false;
+        iter->second -= out.second;
+    }
+    return true;
+}
+
+// A transaction moving two colors, paying the fee in TPC.
+template <typename Balances>
+static void ColoredCoinBalances(benchmark::State& state)
+{
+    uint256 hash;
+    hash.SetHex("485273f6703f038a234400edadb543eb44b4af5372e8b207990beebc386e7954");
+    const ColorIdentifier color1(COutPoint(hash, 0), TokenTypes::REISSUABLE);
+    const ColorIdentifier color2(COutPoint(hash, 1), TokenTypes::NON_REISSUABLE);
+    const std::vector<ColorIdentifier> inColors{ColorIdentifier(), color1, color1, color2};
+    const std::vector<ColorIdentifier> outColors{ColorIdentifier(), color1, color2, color1};
+
+    while (state.KeepRunning()) {
+        bool ok = CheckBalances<Balances>(inColors, outColors);
+        assert(ok);
+    }
+}
+
+static void ColoredCoinBalancesMap(benchmark::State& state)
+{
+    ColoredCoinBalances<TxColoredCoinBalancesMap>(state);
+}
+
+static void ColoredCoinBalancesFlat(benchmark::State& state)
+{
+    ColoredCoinBalances<TxColoredCoinBalances>(state);
+}
+
+BENCHMARK(ColoredCoinBalancesMap, 1000 * 1000);
+BENCHMARK(ColoredCoinBalancesFlat, 1000 * 1000);
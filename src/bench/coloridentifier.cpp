@@ -0,0 +1,52 @@
+// Copyright (c) 2020 Chaintope Inc.
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <coloridentifier.h>
+#include <primitives/transaction.h>
+#include <streams.h>
+
+#include <vector>
+
+static const uint256 BENCH_TXID = uint256S("485273f6703f038a234400edadb543eb44b4af5372e8b207990beebc386e7954");
+
+static void ColorIdentifierParseStream(benchmark::State& state)
+{
+    const std::vector<unsigned char> vch = ColorIdentifier(COutPoint(BENCH_TXID, 0), TokenTypes::NFT).toVector();
+    while (state.KeepRunning()) {
+        ColorIdentifier colorId;
+        CDataStream ss(vch, SER_NETWORK, INIT_PROTO_VERSION);
+        ss >> colorId;
+    }
+}
+
+static void ColorIdentifierParse(benchmark::State& state)
+{
+    const std::vector<unsigned char> vch = ColorIdentifier(COutPoint(BENCH_TXID, 0), TokenTypes::NFT).toVector();
+    while (state.KeepRunning()) {
+        ColorIdentifier colorId(vch);
+    }
+}
+
+static void ColorIdentifierFromScript(benchmark::State& state)
+{
+    const ColorIdentifier colorId(COutPoint(BENCH_TXID, 0), TokenTypes::REISSUABLE);
+    const CScript script = CScript() << colorId.toVector() << OP_COLOR << OP_DUP << OP_HASH160 << std::vector<unsigned char>(20, 0x01) << OP_EQUALVERIFY << OP_CHECKSIG;
+    while (state.KeepRunning()) {
+        GetColorIdFromScript(script);
+    }
+}
+
+static void ColorIdentifierFromOutPoint(benchmark::State& state)
+{
+    uint32_t n = 0;
+    while (state.KeepRunning()) {
+        ColorIdentifier colorId(COutPoint(BENCH_TXID, n++), TokenTypes::NFT);
+    }
+}
+
+BENCHMARK(ColorIdentifierParseStream, 2000 * 1000);
+BENCHMARK(ColorIdentifierParse, 2000 * 1000);
+BENCHMARK(ColorIdentifierFromScript, 1000 * 1000);
+BENCHMARK(ColorIdentifierFromOutPoint, 1000 * 1000);
@@ -0,0 +1,80 @@
+// Copyright (c) 2020 Chaintope Inc.
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <dbwrapper.h>
+#include <random.h>
+
+#include <utility>
+#include <vector>
+
+// The databases live in LevelDB's memory environment, so these measure the
+// CPU cost of each tuning profile (compression, bloom filter) rather than the disk.
+
+enum class DBProfile { DEFAULT, COMPRESSED, NO_BLOOM };
+
+static const uint32_t NUM_READ_KEYS = 20000;
+
+static DBTuning GetBenchTuning(DBProfile profile)
+{
+    DBTuning tuning(8 << 20);
+    tuning.compression = profile == DBProfile::COMPRESSED;
+    if (profile == DBProfile::NO_BLOOM)
+        tuning.bloom_bits = 0;
+    return tuning;
+}
+
+// A 200 byte record that is mostly repetitive, like the serialized
+// transactions and scripts an index stores.
+static std::vector<unsigned char> MakeValue(uint32_t n)
+{
+    std::vector<unsigned char> value(200);
+    for (size_t i = 0; i < value.size(); i++)
+        value[i] = i % 25 == 0 ? (unsigned char)(n >> (i % 4 * 8)) : (unsigned char)(i % 25);
+    return value;
+}
+
+static void DBWrapperWrite(benchmark::State& state, DBProfile profile)
+{
+    CDBWrapper db(fs::path("bench_dbwrapper"), GetBenchTuning(profile), true, true);
+    uint32_t n = 0;
+    while (state.KeepRunning()) {
+        CDBBatch batch(db);
+        for (int i = 0; i < 100; i++, n++)
+            batch.Write(std::make_pair('k', n), MakeValue(n));
+        db.WriteBatch(batch);
+    }
+}
+
+static void DBWrapperRead(benchmark::State& state, DBProfile profile)
+{
+    CDBWrapper db(fs::path("bench_dbwrapper"), GetBenchTuning(profile), true, true);
+    CDBBatch batch(db);
+    for (uint32_t n = 0; n < NUM_READ_KEYS; n++)
+        batch.Write(std::make_pair('k', n), MakeValue(n));
+    db.WriteBatch(batch);
+    // Move everything out of the memtable into table files.
+    db.CompactRange('k', 'l');
+
+    FastRandomContext rng(true);
+    std::vector<unsigned char> value;
+    while (state.KeepRunning()) {
+        // Half of the lookups are for keys that do not exist.
+        db.Read(std::make_pair('k', (uint32_t)rng.randrange(2 * NUM_READ_KEYS)), value);
+    }
+}
+
+static void DBWrapperWriteDefault(benchmark::State& state) { DBWrapperWrite(state, DBProfile::DEFAULT); }
+static void DBWrapperWriteCompressed(benchmark::State& state) { DBWrapperWrite(state, DBProfile::COMPRESSED); }
+static void DBWrapperWriteNoBloom(benchmark::State& state) { DBWrapperWrite(state, DBProfile::NO_BLOOM); }
+static void DBWrapperReadDefault(benchmark::State& state) { DBWrapperRead(state, DBProfile::DEFAULT); }
+static void DBWrapperReadCompressed(benchmark::State& state) { DBWrapperRead(state, DBProfile::COMPRESSED); }
+static void DBWrapperReadNoBloom(benchmark::State& state) { DBWrapperRead(state, DBProfile::NO_BLOOM); }
+
+BENCHMARK(DBWrapperWriteDefault, 500);
+BENCHMARK(DBWrapperWriteCompressed, 500);
+BENCHMARK(DBWrapperWriteNoBloom, 500);
+BENCHMARK(DBWrapperReadDefault, 200 * 1000);
+BENCHMARK(DBWrapperReadCompressed, 200 * 1000);
+BENCHMARK(DBWrapperReadNoBloom, 200 * 1000);
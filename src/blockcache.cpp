@@ -0,0 +1,86 @@
+// Copyright (c) 2020 Chaintope Inc.
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <blockcache.h>
+
+#include <core_memusage.h>
+#include <memusage.h>
+
+#include <assert.h>
+
+CBlockCache::CBlockCache(size_t max_usage) : m_max_usage(max_usage) {}
+
+size_t CBlockCache::EntryUsage(const CBlock& block)
+{
+    // The block with its shared_ptr control block, the LRU list node and the index node.
+    return memusage::MallocUsage(sizeof(CBlock)) + memusage::MallocUsage(sizeof(memusage::stl_shared_counter)) +
+           RecursiveDynamicUsage(block) +
+           memusage::MallocUsage(sizeof(Entry) + 2 * sizeof(void*)) +
+           memusage::MallocUsage(sizeof(memusage::unordered_node<std::pair<const uint256, std::list<Entry>::iterator>>));
+}
+
+std::shared_ptr<const CBlock> CBlockCache::Get(const uint256& hash)
+{
+    LOCK(cs);
+    auto it = m_index.find(hash);
+    if (it == m_index.end()) {
+        m_misses++;
+        return nullptr;
+    }
+    m_hits++;
+    m_lru.splice(m_lru.begin(), m_lru, it->second);
+    return it->second->block;
+}
+
+void CBlockCache::Insert(const uint256& hash, const std::shared_ptr<const CBlock>& block)
+{
+    assert(block);
+    const size_t usage = EntryUsage(*block);
+    LOCK(cs);
+    auto it = m_index.find(hash);
+    if (it != m_index.end()) {
+        m_lru.splice(m_lru.begin(), m_lru, it->second);
+        return;
+    }
+    // Never let a single block flush the whole cache.
+    if (usage > m_max_usage / 2) {
+        return;
+    }
+    m_lru.push_front(Entry{hash, block, usage});
+    m_index.emplace(hash, m_lru.begin());
+    m_usage += usage;
+    Trim();
+}
+
+void CBlockCache::SetMaxUsage(size_t max_usage)
+{
+    LOCK(cs);
+    m_max_usage = max_usage;
+    Trim();
+}
+
+void CBlockCache::Clear()
+{
+    LOCK(cs);
+    m_index.clear();
+    m_lru.clear();
+    m_usage = 0;
+}
+
+CBlockCache::Stats CBlockCache::GetStats()
+{
+    LOCK(cs);
+    return Stats{m_usage, m_max_usage, m_lru.size(), m_hits, m_misses};
+}
+
+void CBlockCache::Trim()
+{
+    AssertLockHeld(cs);
+    while (m_usage > m_max_usage) {
+        const Entry& oldest = m_lru.back();
+        m_usage -= oldest.usage;
+        m_index.erase(oldest.hash);
+        m_lru.pop_back();
+    }
+}
@@ -0,0 +1,75 @@
+// Copyright (c) 2020 Chaintope Inc.
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_BLOCKCACHE_H
+#define BITCOIN_BLOCKCACHE_H
+
+#include <primitives/block.h>
+#include <sync.h>
+#include <uint256.h>
+
+#include <list>
+#include <memory>
+#include <stdint.h>
+#include <unordered_map>
+
+/**
+ * Recently used deserialized blocks, keyed by block hash.
+ *
+ * Blocks are shared, immutable and identified by their hash, so an entry never
+ * goes stale; the cache only has to stay within its memory budget. When it
+ * would exceed it, the least recently used blocks are dropped.
+ */
+class CBlockCache
+{
+public:
+    struct Stats {
+        size_t usage;
+        size_t max_usage;
+        size_t entries;
+        uint64_t hits;
+        uint64_t misses;
+    };
+
+    explicit CBlockCache(size_t max_usage);
+
+    /** Return the block with the given hash, or nullptr if it is not cached. */
+    std::shared_ptr<const CBlock> Get(const uint256& hash);
+
+    /** Add a block, making it the most recently used. */
+    void Insert(const uint256& hash, const std::shared_ptr<const CBlock>& block);
+
+    /** Change the memory budget, evicting blocks if needed. 0 disables the cache. */
+    void SetMaxUsage(size_t max_usage);
+
+    void Clear();
+    Stats GetStats();
+
+    /** Memory accounted for a cached block, including the cache's own overhead. */
+    static size_t EntryUsage(const CBlock& block);
+
+private:
+    struct Entry {
+        uint256 hash;
+        std::shared_ptr<const CBlock> block;
+        size_t usage;
+    };
+
+    struct Hasher {
+        size_t operator()(const uint256& hash) const { return hash.GetCheapHash(); }
+    };
+
+    CCriticalSection cs;
+    size_t m_max_usage;
+    size_t m_usage = 0;
+    uint64_t m_hits = 0;
+    uint64_t m_misses = 0;
+    //! Most recently used first.
+    std::list<Entry> m_lru;
+    std::unordered_map<uint256, std::list<Entry>::iterator, Hasher> m_index;
+
+    void Trim();
+};
+
+#endif // BITCOIN_BLOCKCACHE_H
@@ -191,6 +191,7 @@ ReadStatus PartiallyDownloadedBlock::FillBlock(CBlock& block, const std::vector<
     assert(!header.IsNull());
     uint256 hash = header.GetHash();
     block = header;
+    block.MemoizeHashes();
     block.vtx.resize(txn_available.size());
 
     size_t tx_missing_offset = 0;
@@ -0,0 +1,109 @@
+// Copyright (c) 2020 Chaintope Inc.
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <blockfilemap.h>
+
+#include <logging.h>
+
+#ifndef WIN32
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+bool CMappedFile::IsSupported()
+{
+#ifndef WIN32
+    // Block files are up to 128MiB each, which would exhaust the address
+    // space of a 32 bit process quickly.
+    return sizeof(void*) >= 8;
+#else
+    return false;
+#endif
+}
+
+std::shared_ptr<const CMappedFile> CMappedFile::Open(const fs::path& path)
+{
+#ifndef WIN32
+    if (!IsSupported()) {
+        return nullptr;
+    }
+    int fd = ::open(path.string().c_str(), O_RDONLY);
+    if (fd == -1) {
+        return nullptr;
+    }
+    struct stat st;
+    if (::fstat(fd, &st) != 0 || st.st_size <= 0) {
+        ::close(fd);
+        return nullptr;
+    }
+    const size_t size = st.st_size;
+    void* data = ::mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    if (data == MAP_FAILED) {
+        LogPrint(BCLog::DB, "%s: mmap of %s failed: %s\n", __func__, path.string(), strerror(errno));
+        ::close(fd);
+        return nullptr;
+    }
+    // The mapping holds its own reference to the file.
+    ::close(fd);
+    return std::shared_ptr<const CMappedFile>(new CMappedFile(static_cast<const unsigned char*>(data), size));
+#else
+    return nullptr;
+#endif
+}
+
+CMappedFile::~CMappedFile()
+{
+#ifndef WIN32
+    ::munmap(const_cast<unsigned char*>(m_data), m_size);
+#endif
+}
+
+std::shared_ptr<const CMappedFile> CBlockFileMapCache::Get(const fs::path& path, size_t min_size)
+{
+    const std::string key = path.string();
+    LOCK(cs);
+    for (auto it = m_files.begin(); it != m_files.end(); ++it) {
+        if (it->first != key) continue;
+        if (it->second->size() >= min_size) {
+            m_files.splice(m_files.begin(), m_files, it);
+            return it->second;
+        }
+        // The file has grown since it was mapped.
+        m_files.erase(it);
+        break;
+    }
+
+    std::shared_ptr<const CMappedFile> file = CMappedFile::Open(path);
+    if (!file || file->size() < min_size) {
+        return nullptr;
+    }
+    m_files.emplace_front(key, file);
+    if (m_files.size() > m_max_files) {
+        m_files.pop_back();
+    }
+    return file;
+}
+
+void CBlockFileMapCache::Erase(const fs::path& path)
+{
+    const std::string key = path.string();
+    LOCK(cs);
+    m_files.remove_if([&key](const std::pair<std::string, std::shared_ptr<const CMappedFile>>& entry) { return entry.first == key; });
+}
+
+void CBlockFileMapCache::Clear()
+{
+    LOCK(cs);
+    m_files.clear();
+}
+
+size_t CBlockFileMapCache::Size()
+{
+    LOCK(cs);
+    return m_files.size();
+}
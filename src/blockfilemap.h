@@ -0,0 +1,78 @@
+// Copyright (c) 2020 Chaintope Inc.
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_BLOCKFILEMAP_H
+#define BITCOIN_BLOCKFILEMAP_H
+
+#include <fs.h>
+#include <span.h>
+#include <sync.h>
+
+#include <list>
+#include <memory>
+#include <string>
+#include <utility>
+
+/**
+ * A read-only memory mapping of a whole file.
+ *
+ * The mapping stays valid for as long as the object is alive, even if the
+ * file is deleted in the meantime, so hand out a shared_ptr to it together
+ * with any Span pointing into it.
+ */
+class CMappedFile
+{
+    const unsigned char* m_data;
+    size_t m_size;
+
+    CMappedFile(const unsigned char* data, size_t size) : m_data(data), m_size(size) {}
+
+public:
+    /** Map the file at path. Returns nullptr if it is empty or cannot be mapped. */
+    static std::shared_ptr<const CMappedFile> Open(const fs::path& path);
+
+    /** Whether memory mapping is supported on this platform. */
+    static bool IsSupported();
+
+    ~CMappedFile();
+    CMappedFile(const CMappedFile&) = delete;
+    CMappedFile& operator=(const CMappedFile&) = delete;
+
+    const unsigned char* data() const { return m_data; }
+    size_t size() const { return m_size; }
+
+    /** Whether [pos, pos + len) lies inside the mapping. */
+    bool Contains(size_t pos, size_t len) const { return pos <= m_size && len <= m_size - pos; }
+    Span<const unsigned char> GetSpan(size_t pos, size_t len) const { return Span<const unsigned char>(m_data + pos, len); }
+};
+
+/**
+ * Keeps the most recently used files mapped, so that reading many blocks from
+ * the same blk?????.dat does not open and copy the file every time.
+ */
+class CBlockFileMapCache
+{
+    CCriticalSection cs;
+    size_t m_max_files;
+    //! Most recently used first.
+    std::list<std::pair<std::string, std::shared_ptr<const CMappedFile>>> m_files;
+
+public:
+    explicit CBlockFileMapCache(size_t max_files) : m_max_files(max_files) {}
+
+    /**
+     * Return a mapping of path that covers at least its first min_size bytes.
+     * A cached mapping that is too short (the file has grown since) is
+     * replaced by a new one. Returns nullptr if the file cannot be mapped or
+     * is shorter than min_size.
+     */
+    std::shared_ptr<const CMappedFile> Get(const fs::path& path, size_t min_size);
+
+    /** Drop the mapping of path, e.g. because the file is truncated or deleted. */
+    void Erase(const fs::path& path);
+    void Clear();
+    size_t Size();
+};
+
+#endif // BITCOIN_BLOCKFILEMAP_H
@@ -6,6 +6,44 @@
 
 #include <chain.h>
 
+#include <memusage.h>
+
+size_t CBlockIndex::DynamicMemoryUsage() const
+{
+    size_t usage = memusage::DynamicUsage(proof);
+    if (pxfield)
+        usage += memusage::DynamicUsage(pxfield) + memusage::DynamicUsage(*pxfield);
+    return usage;
+}
+
+CBlockIndex* CBlockIndexArena::Allocate(size_t count)
+{
+    if (count == 0) {
+        return nullptr;
+    }
+    Array array{std::unique_ptr<CBlockIndex[]>(new CBlockIndex[count]), count};
+    CBlockIndex* data = array.data.get();
+    m_arrays.emplace(data, std::move(array));
+    m_size += count;
+    return data;
+}
+
+bool CBlockIndexArena::Owns(const CBlockIndex* pindex) const
+{
+    auto it = m_arrays.upper_bound(pindex);
+    if (it == m_arrays.begin()) {
+        return false;
+    }
+    --it;
+    return std::less<const CBlockIndex*>()(pindex, it->first + it->second.size);
+}
+
+void CBlockIndexArena::Clear()
+{
+    m_arrays.clear();
+    m_size = 0;
+}
+
 /**
  * CChain implementation
  */
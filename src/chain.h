@@ -9,11 +9,18 @@
 
 #include <arith_uint256.h>
 #include <consensus/params.h>
+#include <hash.h>
+#include <prevector.h>
 #include <primitives/block.h>
+#include <pubkey.h>
 #include <tinyformat.h>
 #include <uint256.h>
 #include <utilstrencodings.h>
+#include <version.h>
 
+#include <functional>
+#include <map>
+#include <memory>
 #include <vector>
 
 /**
@@ -211,8 +218,10 @@ public:
     uint256 hashImMerkleRoot;
     uint32_t nTime;
     uint8_t xfieldType;
-    std::vector<unsigned char> xfield;
-    std::vector<unsigned char> proof;
+    //! xfield, kept out of line as few blocks carry one. Null when empty.
+    std::shared_ptr<const std::vector<unsigned char>> pxfield;
+    //! Block proof, stored inline as long as it fits a Schnorr signature.
+    prevector<CPubKey::SCHNORR_SIGNATURE_SIZE, unsigned char> proof;
 
     //! (memory only) Sequential id assigned to distinguish order in which blocks are received.
     int32_t nSequenceId;
@@ -239,7 +248,7 @@ public:
         hashMerkleRoot = uint256();
         nTime          = 0;
         xfieldType          = 0;
-        xfield.clear();
+        pxfield.reset();
         proof.clear();
     }
 
@@ -257,8 +266,22 @@ public:
         hashImMerkleRoot = block.hashImMerkleRoot;
         nTime          = block.nTime;
         xfieldType          = block.xfieldType;
-        xfield         = block.xfield;
-        proof          = block.proof;
+        SetXField(block.xfield);
+        proof.assign(block.proof.begin(), block.proof.end());
+    }
+
+    const std::vector<unsigned char>& GetXField() const
+    {
+        static const std::vector<unsigned char> empty;
+        return pxfield ? *pxfield : empty;
+    }
+
+    void SetXField(std::vector<unsigned char> xfield)
+    {
+        if (xfield.empty())
+            pxfield.reset();
+        else
+            pxfield = std::make_shared<const std::vector<unsigned char>>(std::move(xfield));
     }
 
     CDiskBlockPos GetBlockPos() const {
@@ -289,8 +312,8 @@ public:
         block.hashImMerkleRoot = hashImMerkleRoot;
         block.nTime          = nTime;
         block.xfieldType          = xfieldType;
-        block.xfield         = xfield;
-        block.proof          = proof;
+        block.xfield         = GetXField();
+        block.proof.assign(proof.begin(), proof.end());
         return block;
     }
 
@@ -333,7 +356,7 @@ public:
             hashImMerkleRoot.ToString(),
             nTime,
             xfieldType,
-            HexStr(xfield),
+            HexStr(GetXField()),
             HexStr(proof),
             GetBlockHash().ToString());
     }
@@ -361,6 +384,9 @@ public:
         return false;
     }
 
+    //! Heap memory used by this entry, not counting the entry itself.
+    size_t DynamicMemoryUsage() const;
+
     //! Build the skiplist pointer for this entry.
     void BuildSkip();
 
@@ -412,23 +438,27 @@ public:
         READWRITE(hashImMerkleRoot);
         READWRITE(nTime);
         READWRITE(xfieldType);
-        if((TAPYRUS_XFIELDTYPES)xfieldType != TAPYRUS_XFIELDTYPES::NONE)
+        if((TAPYRUS_XFIELDTYPES)xfieldType != TAPYRUS_XFIELDTYPES::NONE) {
+            std::vector<unsigned char> xfield;
+            if (!ser_action.ForRead())
+                xfield = GetXField();
             READWRITE(xfield);
+            if (ser_action.ForRead())
+                SetXField(std::move(xfield));
+        }
         READWRITE(proof);
     }
 
     uint256 GetBlockHash() const
     {
-        CBlockHeader block;
-        block.nFeatures       = nFeatures;
-        block.hashPrevBlock   = hashPrev;
-        block.hashMerkleRoot  = hashMerkleRoot;
-        block.hashImMerkleRoot  = hashImMerkleRoot;
-        block.nTime           = nTime;
-        block.xfieldType          = xfieldType;
-        block.xfield         = xfield;
-        block.proof           = proof;
-        return block.GetHash();
+        // Hash the fields as CBlockHeader serializes them, without copying them
+        // into a header first.
+        CHashWriter ss(SER_GETHASH, PROTOCOL_VERSION);
+        ss << nFeatures << hashPrev << hashMerkleRoot << hashImMerkleRoot << nTime << xfieldType;
+        if((TAPYRUS_XFIELDTYPES)xfieldType != TAPYRUS_XFIELDTYPES::NONE)
+            ss << GetXField();
+        ss << proof;
+        return ss.GetHash();
     }
 
 
@@ -443,6 +473,32 @@ public:
     }
 };
 
+/**
+ * Owns CBlockIndex objects allocated in bulk, such as the entries loaded from
+ * the block index database at startup, rather than one by one with new.
+ * Objects from the arena are freed together by Clear() and must not be
+ * deleted individually; use Owns() to tell them apart.
+ */
+class CBlockIndexArena
+{
+    struct Array {
+        std::unique_ptr<CBlockIndex[]> data;
+        size_t size;
+    };
+    //! Keyed by the first element of each array.
+    std::map<const CBlockIndex*, Array, std::less<const CBlockIndex*>> m_arrays;
+    size_t m_size = 0;
+
+public:
+    /** Allocate an array of count default constructed entries. */
+    CBlockIndex* Allocate(size_t count);
+    /** Whether pindex was allocated by this arena. */
+    bool Owns(const CBlockIndex* pindex) const;
+    void Clear();
+    /** Number of entries allocated. */
+    size_t Size() const { return m_size; }
+};
+
 /** An in-memory indexed chain of blocks. */
 class CChain {
 private:
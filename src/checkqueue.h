@@ -16,6 +16,21 @@
 template <typename T>
 class CCheckQueueControl;
 
+/**
+ * Execute a slice of checks taken off the queue, stopping at the first
+ * failure. Check types that can share work between the checks of a slice
+ * (e.g. batch signature verification) provide an overload for their own type.
+ */
+template <typename T>
+bool RunCheckBatch(std::vector<T>& vChecks)
+{
+    for (T& check : vChecks) {
+        if (!check())
+            return false;
+    }
+    return true;
+}
+
 /**
  * Queue for verifications that have to be performed.
   * The verifications are represented by a type T, which must provide an
@@ -116,9 +131,8 @@ private:
                 fOk = fAllOk;
             }
             // execute work
-            for (T& check : vChecks)
-                if (fOk)
-                    fOk = check();
+            if (fOk)
+                fOk = RunCheckBatch(vChecks);
             vChecks.clear();
         } while (true);
     }
@@ -14,6 +14,16 @@ std::vector<uint256> CCoinsView::GetHeadBlocks() const { return std::vector<uint
 bool CCoinsView::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) { return false; }
 CCoinsViewCursor *CCoinsView::Cursor() const { return nullptr; }
 
+std::vector<std::unique_ptr<CCoinsViewCursor>> CCoinsView::RangeCursors(int nRanges) const
+{
+    // A single cursor over the whole state is a valid split.
+    std::vector<std::unique_ptr<CCoinsViewCursor>> cursors;
+    std::unique_ptr<CCoinsViewCursor> pcursor(Cursor());
+    if (pcursor)
+        cursors.push_back(std::move(pcursor));
+    return cursors;
+}
+
 bool CCoinsView::HaveCoin(const COutPoint &outpoint) const
 {
     Coin coin;
@@ -28,6 +38,7 @@ std::vector<uint256> CCoinsViewBacked::GetHeadBlocks() const { return base->GetH
 void CCoinsViewBacked::SetBackend(CCoinsView &viewIn) { base = &viewIn; }
 bool CCoinsViewBacked::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) { return base->BatchWrite(mapCoins, hashBlock); }
 CCoinsViewCursor *CCoinsViewBacked::Cursor() const { return base->Cursor(); }
+std::vector<std::unique_ptr<CCoinsViewCursor>> CCoinsViewBacked::RangeCursors(int nRanges) const { return base->RangeCursors(nRanges); }
 size_t CCoinsViewBacked::EstimateSize() const { return base->EstimateSize(); }
 
 SaltedOutpointHasher::SaltedOutpointHasher() : k0(GetRand(std::numeric_limits<uint64_t>::max())), k1(GetRand(std::numeric_limits<uint64_t>::max())) {}
@@ -55,6 +66,16 @@ CCoinsMap::iterator CCoinsViewCache::FetchCoin(const COutPoint &outpoint) const
     return ret;
 }
 
+void CCoinsViewCache::EmplaceFetchedCoin(const COutPoint &outpoint, Coin&& coin) {
+    std::pair<CCoinsMap::iterator, bool> inserted = cacheCoins.emplace(std::piecewise_construct, std::forward_as_tuple(outpoint), std::forward_as_tuple(std::move(coin)));
+    if (!inserted.second)
+        return;
+    if (inserted.first->second.coin.IsSpent()) {
+        inserted.first->second.flags = CCoinsCacheEntry::FRESH;
+    }
+    cachedCoinsUsage += inserted.first->second.coin.DynamicMemoryUsage();
+}
+
 bool CCoinsViewCache::GetCoin(const COutPoint &outpoint, Coin &coin) const {
     CCoinsMap::const_iterator it = FetchCoin(outpoint);
     if (it != cacheCoins.end()) {
@@ -89,11 +110,10 @@ void AddCoins(CCoinsViewCache& cache, const CTransaction &tx, int nHeight, bool
     bool fCoinbase = tx.IsCoinBase();
     const uint256& txid = tx.GetHashMalFix();
     for (size_t i = 0; i < tx.vout.size(); ++i) {
-        ColorIdentifier colorId(GetColorIdFromScript(tx.vout[i].scriptPubKey));
         bool overwrite = check ? cache.HaveCoin(COutPoint(txid, i)) : fCoinbase;
         // Always set the possible_overwrite flag to AddCoin for coinbase txn, in order to correctly
         // deal with the pre-BIP30 occurrences of duplicate coinbase transactions.
-        cache.AddCoin(COutPoint(txid, i), Coin(tx.vout[i], nHeight, fCoinbase, colorId.type), overwrite);
+        cache.AddCoin(COutPoint(txid, i), Coin(tx.vout[i], nHeight, fCoinbase, tx.GetColorId(i).type), overwrite);
     }
 }
 
@@ -204,7 +224,10 @@ bool CCoinsViewCache::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlockIn
 
 bool CCoinsViewCache::Flush() {
     bool fOk = base->BatchWrite(cacheCoins, hashBlock);
-    cacheCoins.clear();
+    // Start over with a new map and pool. This releases the memory of the old
+    // one, and the base may have taken the old pool along with the coins. The
+    // pool allocator propagates on move assignment, so the new pool comes along.
+    cacheCoins = CCoinsMap();
     cachedCoinsUsage = 0;
     return fOk;
 }
@@ -15,11 +15,15 @@
 #include <serialize.h>
 #include <uint256.h>
 #include <coloridentifier.h>
+#include <support/allocators/pool.h>
 
 #include <assert.h>
 #include <stdint.h>
 
+#include <functional>
+#include <memory>
 #include <unordered_map>
+#include <vector>
 
 /**
  * A UTXO entry.
@@ -100,7 +104,7 @@ class SaltedOutpointHasher
 {
 private:
     /** Salt */
-    const uint64_t k0, k1;
+    uint64_t k0, k1;
 
 public:
     SaltedOutpointHasher();
@@ -134,7 +138,13 @@ struct CCoinsCacheEntry
     explicit CCoinsCacheEntry(Coin&& coin_) : coin(std::move(coin_)), flags(0) {}
 };
 
-typedef std::unordered_map<COutPoint, CCoinsCacheEntry, SaltedOutpointHasher> CCoinsMap;
+/**
+ * Map of cached coins. Its nodes are taken from a pool owned by the map, which
+ * drops the per node malloc overhead and keeps the coins of a cache close
+ * together in memory. memusage::DynamicUsage() accounts for the whole pool.
+ */
+typedef std::unordered_map<COutPoint, CCoinsCacheEntry, SaltedOutpointHasher, std::equal_to<COutPoint>,
+    PoolAllocator<std::pair<const COutPoint, CCoinsCacheEntry>, sizeof(std::pair<const COutPoint, CCoinsCacheEntry>) + sizeof(void*) * 4>> CCoinsMap;
 
 /** Cursor for iterating over CoinsView state */
 class CCoinsViewCursor
@@ -185,6 +195,11 @@ public:
     //! Get a cursor to iterate over the whole state
     virtual CCoinsViewCursor *Cursor() const;
 
+    //! Get up to nRanges cursors that iterate over consecutive parts of the
+    //! same state, in order, and over the whole of it together. Each may be
+    //! used on a different thread. Empty if iteration is not supported.
+    virtual std::vector<std::unique_ptr<CCoinsViewCursor>> RangeCursors(int nRanges) const;
+
     //! As we use CCoinsViews polymorphically, have a virtual destructor
     virtual ~CCoinsView() {}
 
@@ -208,6 +223,7 @@ public:
     void SetBackend(CCoinsView &viewIn);
     bool BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) override;
     CCoinsViewCursor *Cursor() const override;
+    std::vector<std::unique_ptr<CCoinsViewCursor>> RangeCursors(int nRanges) const override;
     size_t EstimateSize() const override;
 };
 
@@ -243,6 +259,9 @@ public:
     CCoinsViewCursor* Cursor() const override {
         throw std::logic_error("CCoinsViewCache cursor iteration not supported.");
     }
+    std::vector<std::unique_ptr<CCoinsViewCursor>> RangeCursors(int nRanges) const override {
+        throw std::logic_error("CCoinsViewCache cursor iteration not supported.");
+    }
 
     /**
      * Check if we have the given utxo already loaded in this cache.
@@ -269,6 +288,14 @@ public:
      */
     void AddCoin(const COutPoint& outpoint, Coin&& coin, bool potential_overwrite);
 
+    /**
+     * Insert a coin that the caller read from the backing view itself, exactly
+     * as if it had been fetched on a cache miss. Entries already in the cache
+     * are left untouched. This lets several coins be read from a thread-safe
+     * base in parallel and then loaded into the cache from one thread.
+     */
+    void EmplaceFetchedCoin(const COutPoint& outpoint, Coin&& coin);
+
     /**
      * Spend a coin. Pass moveto in order to get the deleted data.
      * If no unspent output exists for the passed outpoint, this call
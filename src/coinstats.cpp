@@ -0,0 +1,185 @@
+// Copyright (c) 2009-2010 Satoshi Nakamoto
+// Copyright (c) 2009-2018 The Bitcoin Core developers
+// Copyright (c) 2020 Chaintope Inc.
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <coinstats.h>
+
+#include <coins.h>
+#include <hash.h>
+#include <shutdown.h>
+#include <streams.h>
+#include <sync.h>
+#include <util.h>
+#include <validation.h>
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+namespace {
+
+/** The statistics of one key range and the data it adds to the serialized hash. */
+struct RangeStats
+{
+    CCoinsStats stats;
+    std::vector<unsigned char> data;
+    bool fDone = false;
+    bool fOk = false;
+};
+
+} // namespace
+
+template <typename Stream>
+static void ApplyStats(CCoinsStats &stats, Stream& ss, const uint256& hash, const std::map<uint32_t, Coin>& outputs)
+{
+    assert(!outputs.empty());
+    ss << hash;
+    ss << VARINT(outputs.begin()->second.nHeight * 2 + outputs.begin()->second.fCoinBase ? 1u : 0u);
+    stats.nTransactions++;
+    for (const auto& output : outputs) {
+        ss << VARINT(output.first + 1);
+        ss << output.second.out.scriptPubKey;
+        ss << VARINT(output.second.out.nValue, VarIntMode::NONNEGATIVE_SIGNED);
+        stats.nTransactionOutputs++;
+        stats.nTotalAmount += output.second.out.nValue;
+        stats.nBogoSize += 32 /* txid */ + 4 /* vout index */ + 4 /* height + coinbase */ + 8 /* amount */ +
+                           2 /* scriptPubKey len */ + output.second.out.scriptPubKey.size() /* scriptPubKey */;
+        const ColorIdentifier colorId = GetColorIdFromScript(output.second.out.scriptPubKey);
+        if (colorId.type != TokenTypes::NONE) {
+            CColorCoinsStats& color_stats = stats.mapColorStats[colorId];
+            color_stats.nAmount += output.second.out.nValue;
+            color_stats.nTransactionOutputs++;
+        }
+    }
+    ss << VARINT(0u);
+}
+
+//! Scan the coins of one cursor into stats, serializing what they add to the hash into data.
+static bool ScanRange(CCoinsViewCursor& cursor, CCoinsStats& stats, std::vector<unsigned char>& data)
+{
+    CVectorWriter ss(SER_GETHASH, PROTOCOL_VERSION, data, 0);
+    uint256 prevkey;
+    std::map<uint32_t, Coin> outputs;
+    while (cursor.Valid()) {
+        if (ShutdownRequested())
+            return false;
+        COutPoint key;
+        Coin coin;
+        if (cursor.GetKey(key) && cursor.GetValue(coin)) {
+            if (!outputs.empty() && key.hashMalFix != prevkey) {
+                ApplyStats(stats, ss, prevkey, outputs);
+                outputs.clear();
+            }
+            prevkey = key.hashMalFix;
+            outputs[key.n] = std::move(coin);
+        } else {
+            return error("%s: unable to read value", __func__);
+        }
+        cursor.Next();
+    }
+    if (!outputs.empty()) {
+        ApplyStats(stats, ss, prevkey, outputs);
+    }
+    return true;
+}
+
+static void MergeStats(CCoinsStats& stats, const CCoinsStats& range)
+{
+    stats.nTransactions += range.nTransactions;
+    stats.nTransactionOutputs += range.nTransactionOutputs;
+    stats.nBogoSize += range.nBogoSize;
+    stats.nTotalAmount += range.nTotalAmount;
+    for (const auto& entry : range.mapColorStats) {
+        CColorCoinsStats& color_stats = stats.mapColorStats[entry.first];
+        color_stats.nAmount += entry.second.nAmount;
+        color_stats.nTransactionOutputs += entry.second.nTransactionOutputs;
+    }
+}
+
+bool GetUTXOStats(CCoinsView *view, CCoinsStats &stats, int nThreads)
+{
+    std::vector<std::unique_ptr<CCoinsViewCursor>> cursors = view->RangeCursors(COINS_STATS_RANGES);
+    assert(!cursors.empty());
+
+    CHashWriter ss(SER_GETHASH, PROTOCOL_VERSION);
+    stats.hashBlock = cursors[0]->GetBestBlock();
+    {
+        LOCK(cs_main);
+        stats.nHeight = LookupBlockIndex(stats.hashBlock)->nHeight;
+    }
+    ss << stats.hashBlock;
+
+    // Workers take the ranges in order and the calling thread merges them in
+    // the same order. Workers stay at most nMaxPending ranges ahead of the
+    // merge, which bounds the memory held by scanned but unmerged data.
+    nThreads = std::max(nThreads, 1);
+    const size_t nMaxPending = 2 * nThreads;
+    std::vector<RangeStats> ranges(cursors.size());
+    CWaitableCriticalSection cs;
+    CConditionVariable cv;
+    size_t nNext = 0;
+    size_t nMerged = 0;
+    bool fAbort = false;
+
+    auto worker = [&]() {
+        while (true) {
+            size_t i;
+            {
+                WaitableLock lock(cs);
+                cv.wait(lock, [&] { return fAbort || nNext == ranges.size() || nNext < nMerged + nMaxPending; });
+                if (fAbort || nNext == ranges.size())
+                    return;
+                i = nNext++;
+            }
+            const bool fOk = ScanRange(*cursors[i], ranges[i].stats, ranges[i].data);
+            cursors[i].reset();
+            {
+                WaitableLock lock(cs);
+                ranges[i].fOk = fOk;
+                ranges[i].fDone = true;
+            }
+            cv.notify_all();
+        }
+    };
+    std::vector<std::thread> threads;
+    threads.reserve(nThreads);
+    for (int i = 0; i < nThreads; i++) {
+        threads.emplace_back(worker);
+    }
+
+    bool fOk = true;
+    for (size_t i = 0; i < ranges.size(); i++) {
+        {
+            WaitableLock lock(cs);
+            cv.wait(lock, [&] { return ranges[i].fDone; });
+            fOk = ranges[i].fOk;
+        }
+        if (!fOk)
+            break;
+        MergeStats(stats, ranges[i].stats);
+        ss.write((const char*)ranges[i].data.data(), ranges[i].data.size());
+        std::vector<unsigned char>().swap(ranges[i].data);
+        {
+            WaitableLock lock(cs);
+            nMerged = i + 1;
+        }
+        cv.notify_all();
+    }
+
+    {
+        WaitableLock lock(cs);
+        fAbort = true;
+    }
+    cv.notify_all();
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    if (!fOk)
+        return false;
+
+    stats.hashSerialized = ss.GetHash();
+    stats.nDiskSize = view->EstimateSize();
+    return true;
+}
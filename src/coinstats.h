@@ -0,0 +1,68 @@
+// Copyright (c) 2009-2010 Satoshi Nakamoto
+// Copyright (c) 2009-2018 The Bitcoin Core developers
+// Copyright (c) 2020 Chaintope Inc.
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_COINSTATS_H
+#define BITCOIN_COINSTATS_H
+
+#include <amount.h>
+#include <coloridentifier.h>
+#include <serialize.h>
+#include <uint256.h>
+
+#include <map>
+#include <stdint.h>
+
+class CCoinsView;
+
+/** Amount and number of the unspent outputs of one color. */
+struct CColorCoinsStats
+{
+    CAmount nAmount;
+    uint64_t nTransactionOutputs;
+
+    CColorCoinsStats() : nAmount(0), nTransactionOutputs(0) {}
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(nAmount);
+        READWRITE(VARINT(nTransactionOutputs));
+    }
+};
+
+typedef std::map<ColorIdentifier, CColorCoinsStats, ColorIdentifierCompare> CColorCoinsStatsMap;
+
+/** Statistics about the unspent transaction output set, as reported by gettxoutsetinfo. */
+struct CCoinsStats
+{
+    int nHeight;
+    uint256 hashBlock;
+    uint64_t nTransactions;
+    uint64_t nTransactionOutputs;
+    uint64_t nBogoSize;
+    uint256 hashSerialized;
+    uint64_t nDiskSize;
+    CAmount nTotalAmount;
+    //! The colored outputs by color. Their amounts are included in nTotalAmount.
+    CColorCoinsStatsMap mapColorStats;
+
+    CCoinsStats() : nHeight(0), nTransactions(0), nTransactionOutputs(0), nBogoSize(0), nDiskSize(0), nTotalAmount(0) {}
+};
+
+/** Number of key ranges GetUTXOStats splits the UTXO set into, whatever the number of threads. */
+static const int COINS_STATS_RANGES = 256;
+
+/**
+ * Calculate statistics about the unspent transaction output set.
+ *
+ * The set is split into COINS_STATS_RANGES key ranges that nThreads threads
+ * scan in parallel. The ranges are combined in key order, so the result,
+ * hashSerialized included, does not depend on the number of threads.
+ */
+bool GetUTXOStats(CCoinsView* view, CCoinsStats& stats, int nThreads);
+
+#endif // BITCOIN_COINSTATS_H
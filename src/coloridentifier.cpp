@@ -6,21 +6,24 @@
 #include <script/script.h>
 #include <script/standard.h>
 
+ColorIdentifier::ColorIdentifier(const COutPoint &utxoIn, TokenTypes typeIn):type(typeIn), payload{}
+{
+    // hash the serialized outpoint: the txid followed by the little endian index
+    unsigned char n[4];
+    WriteLE32(n, utxoIn.n);
+    CSHA256().Write(utxoIn.hashMalFix.begin(), utxoIn.hashMalFix.size()).Write(n, sizeof(n)).Finalize(payload);
+}
+
 ColorIdentifier GetColorIdFromScript(const CScript& script)
 {
     if(!script.IsColoredScript())
         return ColorIdentifier();
 
-    std::vector<unsigned char> pubkeyhash, colorId;
-    if( MatchColoredPayToPubkeyHash(script, pubkeyhash, colorId))
-        return ColorIdentifier(colorId);
-
-    if(script.IsColoredPayToScriptHash())
-    {
-        colorId.assign(script.begin()+1, script.begin()+34);
-        return ColorIdentifier(colorId);
-    }
+    // the color identifier of the standard colored scripts is the first push
+    if(script.IsColoredPayToPubkeyHash() || script.IsColoredPayToScriptHash())
+        return ColorIdentifier(script.data() + 1, script.data() + 1 + COLOR_IDENTIFIER_SIZE);
 
+    std::vector<unsigned char> colorId;
     if(MatchCustomColoredScript(script, colorId))
         return ColorIdentifier(colorId);
 
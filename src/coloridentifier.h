@@ -4,11 +4,21 @@
 #ifndef TAPYRUS_COLORIDENTIFIER_H
 #define TAPYRUS_COLORIDENTIFIER_H
 
+#include <crypto/common.h>
 #include <crypto/sha256.h>
+#include <script/script.h>
+#include <span.h>
 #include <streams.h>
 #include <version.h>
 #include <amount.h>
 
+#include <functional>
+#include <ios>
+#include <map>
+#include <vector>
+
+class COutPoint;
+
 // Size of color identifier data in bytes
 static const unsigned int COLOR_IDENTIFIER_SIZE = 33;
 
@@ -52,28 +62,27 @@ struct ColorIdentifier
 
     ColorIdentifier():type(TokenTypes::NONE), payload{} { }
 
-    ColorIdentifier(COutPoint &utxoIn, TokenTypes typeIn):type(typeIn), payload{} {
-        CDataStream s(SER_NETWORK, INIT_PROTO_VERSION);
-        s << utxoIn;
-        CSHA256().Write((unsigned char *)s.data(), s.size()).Finalize(payload);
-    }
+    ColorIdentifier(const COutPoint &utxoIn, TokenTypes typeIn);
 
     ColorIdentifier(const CScript& input):type(TokenTypes::REISSUABLE), payload{} {
-        std::vector<unsigned char> scriptVector(input.begin(), input.end());
-        CSHA256().Write(scriptVector.data(), scriptVector.size()).Finalize(payload);
+        CSHA256().Write(input.data(), input.size()).Finalize(payload);
     }
 
-    ColorIdentifier(const unsigned char* pbegin, const unsigned char* pend):type(UintToToken(*pbegin)) {
-        CSerActionUnserialize ser_action;
-        CDataStream s((const char*)pbegin, (const char*)pend, SER_NETWORK, INIT_PROTO_VERSION);
-        SerializationOp(s, ser_action);
+    /** Parse a serialized color identifier directly from memory, without a stream. */
+    explicit ColorIdentifier(Span<const unsigned char> in):type(TokenTypes::NONE), payload{} {
+        if (in.size() < 1)
+            throw std::ios_base::failure("ColorIdentifier: end of data");
+        type = UintToToken(in[0]);
+        if (type == TokenTypes::NONE)
+            return;
+        if (in.size() < COLOR_IDENTIFIER_SIZE)
+            throw std::ios_base::failure("ColorIdentifier: end of data");
+        memcpy(payload, in.data() + 1, sizeof(payload));
     }
 
-    ColorIdentifier(const std::vector<unsigned char>& in) {
-        CSerActionUnserialize ser_action;
-        CDataStream s(in, SER_NETWORK, INIT_PROTO_VERSION);
-        SerializationOp(s, ser_action);
-    }
+    ColorIdentifier(const unsigned char* pbegin, const unsigned char* pend):ColorIdentifier(Span<const unsigned char>(pbegin, pend)) { }
+
+    ColorIdentifier(const std::vector<unsigned char>& in):ColorIdentifier(MakeSpan(in)) { }
 
     bool operator==(const ColorIdentifier& colorId) const {
         return this->type == colorId.type && (memcmp(&this->payload[0], &colorId.payload[0], COLOR_IDENTIFIER_SIZE - 1) == 0);
@@ -104,13 +113,28 @@ struct ColorIdentifier
     }
 
     inline std::vector<unsigned char> toVector() const {
-        CDataStream stream(SER_NETWORK, INIT_PROTO_VERSION);
-        this->Serialize(stream);
-        return std::vector<unsigned char>(stream.begin(), stream.end());
+        std::vector<unsigned char> vch(1, TokenToUint(type));
+        if(type >= TokenTypes::REISSUABLE && type <= TokenTypes::TOKENTYPE_MAX)
+            vch.insert(vch.end(), payload, payload + sizeof(payload));
+        return vch;
     }
 
 };
 
+namespace std {
+/**
+ * The payload is a SHA256 output, so its first 8 bytes are already uniformly
+ * distributed. The type is mixed in to tell apart colors sharing a payload.
+ */
+template <>
+struct hash<ColorIdentifier>
+{
+    size_t operator()(const ColorIdentifier& colorId) const {
+        return colorId.type == TokenTypes::NONE ? 0 : ReadLE64(colorId.payload) ^ TokenToUint(colorId.type);
+    }
+};
+}
+
 ColorIdentifier GetColorIdFromScript(const CScript& script);
 
 //this is needed to verify token balances as using a custom class as map key 
@@ -126,5 +150,93 @@ struct ColorIdentifierCompare
 
 typedef std::map<ColorIdentifier, CAmount, ColorIdentifierCompare> TxColoredCoinBalancesMap;
 
+/**
+ * Per-color token balances of the inputs or outputs of a single transaction.
+ *
+ * Transactions rarely carry more than a few colors, so the balances are kept
+ * in a flat array searched linearly on a precomputed hash of the color instead
+ * of in a TxColoredCoinBalancesMap. Up to INLINE_COLORS entries are stored
+ * inline, more colors move the entries to the heap. Entries are iterated in
+ * insertion order.
+ */
+class TxColoredCoinBalances
+{
+public:
+    struct Entry
+    {
+        ColorIdentifier first;
+        CAmount second;
+        uint64_t hash;
+    };
+
+    typedef Entry* iterator;
+    typedef const Entry* const_iterator;
+
+    static const size_t INLINE_COLORS = 4;
+
+    TxColoredCoinBalances() : m_size(0) {}
+
+    static uint64_t Hash(const ColorIdentifier& colorId) {
+        return std::hash<ColorIdentifier>()(colorId);
+    }
+
+    const_iterator find(const ColorIdentifier& colorId) const {
+        const uint64_t hash = Hash(colorId);
+        for (const_iterator it = begin(); it != end(); ++it) {
+            if (it->hash == hash && it->first == colorId)
+                return it;
+        }
+        return end();
+    }
+
+    iterator find(const ColorIdentifier& colorId) {
+        const uint64_t hash = Hash(colorId);
+        for (iterator it = begin(); it != end(); ++it) {
+            if (it->hash == hash && it->first == colorId)
+                return it;
+        }
+        return end();
+    }
+
+    /** Add nValue to the balance of colorId, inserting the color if needed. */
+    void Add(const ColorIdentifier& colorId, CAmount nValue) {
+        iterator it = find(colorId);
+        if (it != end()) {
+            it->second += nValue;
+            return;
+        }
+        const Entry entry{colorId, nValue, Hash(colorId)};
+        if (m_size < INLINE_COLORS) {
+            m_inline[m_size] = entry;
+        } else {
+            if (m_heap.empty()) {
+                m_heap.reserve(2 * INLINE_COLORS);
+                m_heap.assign(m_inline, m_inline + m_size);
+            }
+            m_heap.push_back(entry);
+        }
+        m_size++;
+    }
+
+    iterator begin() { return m_heap.empty() ? m_inline : m_heap.data(); }
+    iterator end() { return begin() + m_size; }
+    const_iterator begin() const { return m_heap.empty() ? m_inline : m_heap.data(); }
+    const_iterator end() const { return begin() + m_size; }
+
+    size_t size() const { return m_size; }
+    bool empty() const { return m_size == 0; }
+
+    void clear() {
+        m_size = 0;
+        m_heap.clear();
+    }
+
+private:
+    size_t m_size;
+    Entry m_inline[INLINE_COLORS];
+    //! All entries once there are more than INLINE_COLORS of them
+    std::vector<Entry> m_heap;
+};
+
 
 #endif //TAPYRUS_COLORIDENTIFIER_H
\ No newline at end of file
@@ -13,6 +13,7 @@
 #include <memenv.h>
 #include <stdint.h>
 #include <algorithm>
+#include <limits>
 
 class CBitcoinLevelDBLogger : public leveldb::Logger {
 public:
@@ -97,13 +98,13 @@ static void SetMaxOpenFiles(leveldb::Options *options) {
              options->max_open_files, default_open_files);
 }
 
-static leveldb::Options GetOptions(size_t nCacheSize)
+static leveldb::Options GetOptions(const DBTuning& tuning)
 {
     leveldb::Options options;
-    options.block_cache = leveldb::NewLRUCache(nCacheSize / 2);
-    options.write_buffer_size = nCacheSize / 4; // up to two write buffers may be held in memory simultaneously
-    options.filter_policy = leveldb::NewBloomFilterPolicy(10);
-    options.compression = leveldb::kNoCompression;
+    options.block_cache = leveldb::NewLRUCache(tuning.block_cache_size);
+    options.write_buffer_size = tuning.write_buffer_size;
+    options.filter_policy = tuning.bloom_bits > 0 ? leveldb::NewBloomFilterPolicy(tuning.bloom_bits) : nullptr;
+    options.compression = tuning.compression ? leveldb::kSnappyCompression : leveldb::kNoCompression;
     options.info_log = new CBitcoinLevelDBLogger();
     if (leveldb::kMajorVersion > 1 || (leveldb::kMajorVersion == 1 && leveldb::kMinorVersion >= 16)) {
         // LevelDB versions before 1.16 consider short writes to be corruption. Only trigger error
@@ -114,7 +115,75 @@ static leveldb::Options GetOptions(size_t nCacheSize)
     return options;
 }
 
+DBTuning::DBTuning(size_t nCacheSize, bool compressionIn) :
+    block_cache_size(nCacheSize / 2),
+    write_buffer_size(nCacheSize / 4), // up to two write buffers may be held in memory simultaneously
+    bloom_bits(10),
+    compression(compressionIn)
+{
+}
+
+//! Databases that can be named in -dbtuning
+static const char* const DB_TUNING_NAMES[] = {"chainstate", "blockindex", "txindex", "colorindex", "coinstatsindex"};
+
+bool ApplyDBTuningArgs(const std::vector<std::string>& args, const std::string& db_name, DBTuning& tuning, std::string& error)
+{
+    for (const std::string& arg : args) {
+        const size_t colon = arg.find(':');
+        const size_t equals = arg.find('=', colon == std::string::npos ? 0 : colon);
+        if (colon == std::string::npos || equals == std::string::npos) {
+            error = strprintf("Invalid -dbtuning option '%s', expected <db>:<setting>=<value>", arg);
+            return false;
+        }
+        const std::string name = arg.substr(0, colon);
+        const std::string setting = arg.substr(colon + 1, equals - colon - 1);
+        const std::string str_value = arg.substr(equals + 1);
+        if (std::find(std::begin(DB_TUNING_NAMES), std::end(DB_TUNING_NAMES), name) == std::end(DB_TUNING_NAMES)) {
+            error = strprintf("Unknown database '%s' in -dbtuning option '%s'", name, arg);
+            return false;
+        }
+        int64_t value;
+        if (!ParseInt64(str_value, &value) || value < 0) {
+            error = strprintf("Invalid value in -dbtuning option '%s'", arg);
+            return false;
+        }
+        DBTuning result = tuning;
+        // Sizes in MiB, clamped so that they fit a 32-bit size_t once shifted.
+        const size_t size = (size_t)std::min<uint64_t>(value, std::numeric_limits<size_t>::max() >> 20) << 20;
+        if (setting == "blockcache" && value >= 1 && value <= 16384) {
+            result.block_cache_size = size;
+        } else if (setting == "writebuffer" && value >= 1 && value <= 16384) {
+            result.write_buffer_size = size;
+        } else if (setting == "bloombits" && value <= 64) {
+            result.bloom_bits = value;
+        } else if (setting == "compression" && value <= 1) {
+            result.compression = value == 1;
+        } else {
+            error = strprintf("Invalid setting or value in -dbtuning option '%s'", arg);
+            return false;
+        }
+        if (name == db_name) {
+            tuning = result;
+        }
+    }
+    return true;
+}
+
+DBTuning GetDBTuning(const std::string& db_name, size_t nCacheSize, bool compression)
+{
+    DBTuning tuning(nCacheSize, compression);
+    std::string error;
+    // The options were checked at startup.
+    ApplyDBTuningArgs(gArgs.GetArgs("-dbtuning"), db_name, tuning, error);
+    return tuning;
+}
+
 CDBWrapper::CDBWrapper(const fs::path& path, size_t nCacheSize, bool fMemory, bool fWipe, bool obfuscate)
+    : CDBWrapper(path, DBTuning(nCacheSize), fMemory, fWipe, obfuscate)
+{
+}
+
+CDBWrapper::CDBWrapper(const fs::path& path, const DBTuning& tuning, bool fMemory, bool fWipe, bool obfuscate)
     : m_name(fs::basename(path))
 {
     penv = nullptr;
@@ -122,7 +191,10 @@ CDBWrapper::CDBWrapper(const fs::path& path, size_t nCacheSize, bool fMemory, bo
     iteroptions.verify_checksums = true;
     iteroptions.fill_cache = false;
     syncoptions.sync = true;
-    options = GetOptions(nCacheSize);
+    options = GetOptions(tuning);
+    LogPrint(BCLog::LEVELDB, "LevelDB %s using block cache %.1fMiB, write buffer %.1fMiB, bloom filter %d bits/key, compression %s\n",
+             m_name, tuning.block_cache_size * (1.0 / 1024 / 1024), tuning.write_buffer_size * (1.0 / 1024 / 1024), tuning.bloom_bits,
+             tuning.compression ? "snappy" : "none");
     options.create_if_missing = true;
     if (fMemory) {
         penv = leveldb::NewMemEnv(leveldb::Env::Default());
@@ -167,12 +167,56 @@ public:
         return true;
     }
 
+    /**
+     * Copy the value, deobfuscated but not deserialized, into value. Lets
+     * callers deserialize many values later, e.g. on several threads.
+     */
+    void GetValueBytes(std::vector<unsigned char>& value) {
+        leveldb::Slice slValue = piter->value();
+        value.assign(slValue.data(), slValue.data() + slValue.size());
+        const std::vector<unsigned char>& key = dbwrapper_private::GetObfuscateKey(parent);
+        if (key.empty()) {
+            return;
+        }
+        for (size_t i = 0, j = 0; i != value.size(); i++) {
+            value[i] ^= key[j++];
+            if (j == key.size())
+                j = 0;
+        }
+    }
+
     unsigned int GetValueSize() {
         return piter->value().size();
     }
 
 };
 
+/** LevelDB settings of one database. */
+struct DBTuning
+{
+    //! Size of the LevelDB block cache in bytes
+    size_t block_cache_size;
+    //! Size of one write buffer in bytes (up to two may be held in memory)
+    size_t write_buffer_size;
+    //! Bloom filter bits per key, 0 for no bloom filter
+    int bloom_bits;
+    //! Compress table blocks with Snappy. Has no effect if LevelDB was built without it.
+    bool compression;
+
+    //! Split nCacheSize into half block cache and a quarter per write buffer.
+    explicit DBTuning(size_t nCacheSize, bool compressionIn = false);
+};
+
+/**
+ * Apply the -dbtuning=<db>:<setting>=<value> options in args that are meant
+ * for db_name to tuning. Every option is checked, whichever database it is
+ * for; returns false and sets error on the first invalid one.
+ */
+bool ApplyDBTuningArgs(const std::vector<std::string>& args, const std::string& db_name, DBTuning& tuning, std::string& error);
+
+/** Default tuning of database db_name for nCacheSize, with its -dbtuning options applied. */
+DBTuning GetDBTuning(const std::string& db_name, size_t nCacheSize, bool compression = false);
+
 class CDBWrapper
 {
     friend const std::vector<unsigned char>& dbwrapper_private::GetObfuscateKey(const CDBWrapper &w);
@@ -222,6 +266,8 @@ public:
      *                        with a zero'd byte array.
      */
     CDBWrapper(const fs::path& path, size_t nCacheSize, bool fMemory = false, bool fWipe = false, bool obfuscate = false);
+    //! Same as above, with the LevelDB cache, bloom filter and compression settings given by tuning.
+    CDBWrapper(const fs::path& path, const DBTuning& tuning, bool fMemory = false, bool fWipe = false, bool obfuscate = false);
     ~CDBWrapper();
 
     CDBWrapper(const CDBWrapper&) = delete;
@@ -310,6 +356,28 @@ public:
         return new CDBIterator(*this, pdb->NewIterator(iteroptions));
     }
 
+    /**
+     * Take a snapshot of the current state of the database. Iterators created
+     * from the same snapshot all see that state, whatever is written later.
+     * Release it with ReleaseSnapshot once those iterators are destroyed.
+     */
+    const leveldb::Snapshot* GetSnapshot()
+    {
+        return pdb->GetSnapshot();
+    }
+
+    void ReleaseSnapshot(const leveldb::Snapshot* snapshot)
+    {
+        pdb->ReleaseSnapshot(snapshot);
+    }
+
+    CDBIterator *NewIterator(const leveldb::Snapshot* snapshot)
+    {
+        leveldb::ReadOptions options = iteroptions;
+        options.snapshot = snapshot;
+        return new CDBIterator(*this, pdb->NewIterator(options));
+    }
+
     /**
      * Return true if the database managed by this class contains no entries.
      */
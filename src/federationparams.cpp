@@ -16,6 +16,7 @@
 #include <chainparamsseeds.h>
 #include <validation.h>
 
+#include <algorithm>
 #include <assert.h>
 
 void SetupFederationParamsOptions()
@@ -159,7 +160,17 @@ CPubKey CFederationParams::ReadAggregatePubkey(const std::vector<unsigned char>&
             throw std::runtime_error(strprintf("Aggregate Public Key for Signed Block is invalid: %s", HexStr(pubkey)));
         }
 
-        aggregatePubkeyHeight.push_back(p);
+        p.aggpubkeyParsed = CParsedPubKey(p.aggpubkey);
+
+        LOCK(cs_aggregatePubkey);
+        // keep the list sorted by height; keys sharing a height stay in the order they were read
+        auto it = std::upper_bound(aggregatePubkeyHeight.begin(), aggregatePubkeyHeight.end(), height,
+            [](uint64_t h, const aggPubkeyAndHeight& entry) { return h < entry.height; });
+        aggregatePubkeyHeight.insert(it, p);
+
+        auto inserted = aggregatePubkeyHeightIndex.emplace(p.aggpubkey, height);
+        if(!inserted.second && (int)height < inserted.first->second)
+            inserted.first->second = height;
 
         return p.aggpubkey;
 
@@ -211,7 +222,7 @@ bool CFederationParams::ReadGenesisBlock(std::string genesisHex)
 
     //verify proof
     const uint256 blockHash = genesis.GetHashForSign();
-    if(!aggregatePubkeyHeight.back().aggpubkey.Verify_Schnorr(blockHash, genesis.proof))
+    if(!GetLatestAggregatePubkey().Verify_Schnorr(blockHash, genesis.proof))
         throw std::runtime_error("ReadGenesisBlock: Proof verification failed");
 
     return true;
@@ -219,23 +230,39 @@ bool CFederationParams::ReadGenesisBlock(std::string genesisHex)
 
 int CFederationParams::GetHeightFromAggregatePubkey(const CPubKey &aggpubkey) const
 {
-    for (auto& c : aggregatePubkeyHeight) {
-        if (c.aggpubkey == aggpubkey)
-            return c.height;
-    }
-    return -1;
+    LOCK(cs_aggregatePubkey);
+    auto it = aggregatePubkeyHeightIndex.find(aggpubkey);
+    if (it == aggregatePubkeyHeightIndex.end())
+        return -1;
+    return it->second;
 }
 
-CPubKey& CFederationParams::GetAggPubkeyFromHeight(int height) const
+const aggPubkeyAndHeight& CFederationParams::LookupAggPubkeyFromHeight(int height) const
 {
-    if(height == 0 || aggregatePubkeyHeight.size() == 1)
-        return aggregatePubkeyHeight.at(0).aggpubkey; 
+    if(height == 0 || aggregatePubkeyHeight.size() <= 1)
+        return aggregatePubkeyHeight.at(0);
+
+    if(height < 0)
+        return aggregatePubkeyHeight.back();
+
+    // first key activated at or above height
+    auto it = std::lower_bound(aggregatePubkeyHeight.begin(), aggregatePubkeyHeight.end(), (uint64_t)height,
+        [](const aggPubkeyAndHeight& entry, uint64_t h) { return entry.height < h; });
+    if(it != aggregatePubkeyHeight.end() && it->height == (uint64_t)height)
+        return *it;
+    if(it == aggregatePubkeyHeight.begin())
+        return *it;
+    return *std::prev(it);
+}
 
-    if(height < 0 || height > aggregatePubkeyHeight.back().height)
-        return aggregatePubkeyHeight.back().aggpubkey;
+CPubKey CFederationParams::GetAggPubkeyFromHeight(int height) const
+{
+    LOCK(cs_aggregatePubkey);
+    return LookupAggPubkeyFromHeight(height).aggpubkey;
+}
 
-    for(unsigned int i = 0; i < aggregatePubkeyHeight.size(); i++) {
-        if(height == aggregatePubkeyHeight.at(i).height || (aggregatePubkeyHeight.at(i).height < height && height < aggregatePubkeyHeight.at(i+1).height))
-            return aggregatePubkeyHeight.at(i).aggpubkey;
-    }
+aggPubkeyAndHeight CFederationParams::GetAggPubkeyAndHeightFromHeight(int height) const
+{
+    LOCK(cs_aggregatePubkey);
+    return LookupAggPubkeyFromHeight(height);
 }
@@ -10,10 +10,13 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <unordered_map>
+#include <crypto/common.h>
 #include <protocol.h>
 #include <streams.h>
 #include <pubkey.h>
 #include <primitives/block.h>
+#include <sync.h>
 #include <util.h>
 
 const std::string TAPYRUS_GENESIS_FILENAME = "genesis.dat";
@@ -26,6 +29,17 @@ struct SeedSpec6 {
 struct aggPubkeyAndHeight {
     CPubKey aggpubkey;
     uint64_t height;
+    //! aggpubkey parsed once, so that block proofs are verified without decoding it again
+    CParsedPubKey aggpubkeyParsed;
+};
+
+/**
+ * Aggregate public keys are fully validated compressed keys, so their x
+ * coordinate bytes are already uniformly distributed.
+ */
+struct AggPubkeyHasher
+{
+    size_t operator()(const CPubKey& pubkey) const { return ReadLE64(pubkey.begin() + 1); }
 };
 
 /**
@@ -41,8 +55,8 @@ public:
      * Parse aggPubkey in block header.
      */
     CPubKey ReadAggregatePubkey(const std::vector<unsigned char>& pubkey, uint64_t height) const;
-    const std::vector<aggPubkeyAndHeight>& GetAggregatePubkeyHeightList() const { return aggregatePubkeyHeight; }
-    const CPubKey& GetLatestAggregatePubkey() const { return aggregatePubkeyHeight.back().aggpubkey; }
+    std::vector<aggPubkeyAndHeight> GetAggregatePubkeyHeightList() const { LOCK(cs_aggregatePubkey); return aggregatePubkeyHeight; }
+    CPubKey GetLatestAggregatePubkey() const { LOCK(cs_aggregatePubkey); return aggregatePubkeyHeight.back().aggpubkey; }
     bool ReadGenesisBlock(std::string genesisHex);
     const CBlock& GenesisBlock() const { return genesis; }
     const std::string& getDataDir() const { return dataDir; }
@@ -50,7 +64,13 @@ public:
     /** Return the list of hostnames to look up for DNS seeds */
     const std::vector<std::string>& DNSSeeds() const { return vSeeds; }
     int GetHeightFromAggregatePubkey(const CPubKey &aggpubkey) const;
-    CPubKey& GetAggPubkeyFromHeight(int height) const;
+    CPubKey GetAggPubkeyFromHeight(int height) const;
+    /**
+     * The aggregate public key in effect at the given height, with the height it was activated at.
+     * Headers are checked without cs_main while connected blocks read new keys, so the entry is
+     * copied under cs_aggregatePubkey.
+     */
+    aggPubkeyAndHeight GetAggPubkeyAndHeightFromHeight(int height) const;
 
     CFederationParams();
     CFederationParams(const int networkId, const std::string dataDirName, const std::string genesisHex);
@@ -60,7 +80,14 @@ private:
     CMessageHeader::MessageStartChars pchMessageStart;
     std::string strNetworkID;
     std::string dataDir;
-    mutable std::vector<aggPubkeyAndHeight> aggregatePubkeyHeight;
+    //! Guards aggregatePubkeyHeight and aggregatePubkeyHeightIndex
+    mutable CCriticalSection cs_aggregatePubkey;
+    //! Aggregate public keys sorted by the height they became active at
+    mutable std::vector<aggPubkeyAndHeight> aggregatePubkeyHeight GUARDED_BY(cs_aggregatePubkey);
+    //! Reverse index of aggregatePubkeyHeight: the first height each key was active at
+    mutable std::unordered_map<CPubKey, int, AggPubkeyHasher> aggregatePubkeyHeightIndex GUARDED_BY(cs_aggregatePubkey);
+
+    const aggPubkeyAndHeight& LookupAggPubkeyFromHeight(int height) const EXCLUSIVE_LOCKS_REQUIRED(cs_aggregatePubkey);
     CBlock genesis;
     std::vector<std::string> vSeeds;
     std::vector<SeedSpec6> vFixedSeeds;
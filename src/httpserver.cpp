@@ -582,10 +582,33 @@ void HTTPRequest::WriteHeader(const std::string& hdr, const std::string& value)
 void HTTPRequest::WriteReply(int nStatus, const std::string& strReply)
 {
     assert(!replySent && req);
-    // Send event to main http thread to send reply message
     struct evbuffer* evb = evhttp_request_get_output_buffer(req);
     assert(evb);
     evbuffer_add(evb, strReply.data(), strReply.size());
+    SendReply(nStatus);
+}
+
+static void ReleaseReplyReference(const void* data, size_t datalen, void* extra)
+{
+    delete static_cast<std::shared_ptr<const void>*>(extra);
+}
+
+void HTTPRequest::WriteReply(int nStatus, Span<const unsigned char> reply, std::shared_ptr<const void> keep_alive)
+{
+    assert(!replySent && req);
+    struct evbuffer* evb = evhttp_request_get_output_buffer(req);
+    assert(evb);
+    std::shared_ptr<const void>* ref = new std::shared_ptr<const void>(std::move(keep_alive));
+    if (evbuffer_add_reference(evb, reply.data(), reply.size(), ReleaseReplyReference, ref) != 0) {
+        delete ref;
+        evbuffer_add(evb, reply.data(), reply.size());
+    }
+    SendReply(nStatus);
+}
+
+void HTTPRequest::SendReply(int nStatus)
+{
+    // Send event to main http thread to send reply message
     auto req_copy = req;
     HTTPEvent* ev = new HTTPEvent(eventBase, true, [req_copy, nStatus]{
         evhttp_send_reply(req_copy, nStatus, nullptr, nullptr);
@@ -5,9 +5,12 @@
 #ifndef BITCOIN_HTTPSERVER_H
 #define BITCOIN_HTTPSERVER_H
 
+#include <span.h>
+
 #include <string>
 #include <stdint.h>
 #include <functional>
+#include <memory>
 
 static const int DEFAULT_HTTP_THREADS=4;
 static const int DEFAULT_HTTP_WORKQUEUE=16;
@@ -114,6 +117,19 @@ public:
      * main thread, do not call any other HTTPRequest methods after calling this.
      */
     void WriteReply(int nStatus, const std::string& strReply = "");
+
+    /**
+     * Write HTTP reply without copying the body.
+     * reply must stay valid for as long as keep_alive is held; the reference
+     * is dropped once the body has been sent.
+     *
+     * @note Same restrictions as the other WriteReply.
+     */
+    void WriteReply(int nStatus, Span<const unsigned char> reply, std::shared_ptr<const void> keep_alive);
+
+private:
+    /** Hand the request with its completed output buffer back to the main thread. */
+    void SendReply(int nStatus);
 };
 
 /** Event handler closure.
@@ -28,8 +28,8 @@ static void FatalError(const char* fmt, const Args&... args)
     StartShutdown();
 }
 
-BaseIndex::DB::DB(const fs::path& path, size_t n_cache_size, bool f_memory, bool f_wipe, bool f_obfuscate) :
-    CDBWrapper(path, n_cache_size, f_memory, f_wipe, f_obfuscate)
+BaseIndex::DB::DB(const fs::path& path, const DBTuning& tuning, bool f_memory, bool f_wipe, bool f_obfuscate) :
+    CDBWrapper(path, tuning, f_memory, f_wipe, f_obfuscate)
 {}
 
 bool BaseIndex::DB::ReadBestBlock(CBlockLocator& locator) const
@@ -103,6 +103,11 @@ void BaseIndex::ThreadSync()
                     m_synced = true;
                     break;
                 }
+                if (pindex_next->pprev != pindex && !Rewind(pindex, pindex_next->pprev)) {
+                    FatalError("%s: Failed to rewind index %s to a previous chain tip",
+                               __func__, GetName());
+                    return;
+                }
                 pindex = pindex_next;
             }
 
@@ -118,13 +123,15 @@ void BaseIndex::ThreadSync()
                 last_locator_write_time = current_time;
             }
 
-            CBlock block;
-            if (!ReadBlockFromDisk(block, pindex)) {
+            // Catching up walks through old blocks, so do not let them
+            // evict the recent ones from the block cache.
+            std::shared_ptr<const CBlock> block = ReadBlockFromDiskCached(pindex, false);
+            if (!block) {
                 FatalError("%s: Failed to read block %s from disk",
                            __func__, pindex->GetBlockHash().ToString());
                 return;
             }
-            if (!WriteBlock(block, pindex)) {
+            if (!WriteBlock(*block, pindex)) {
                 FatalError("%s: Failed to write block %s to index database",
                            __func__, pindex->GetBlockHash().ToString());
                 return;
@@ -148,6 +155,15 @@ bool BaseIndex::WriteBestBlock(const CBlockIndex* block_index)
     return true;
 }
 
+bool BaseIndex::Rewind(const CBlockIndex* current_tip, const CBlockIndex* new_tip)
+{
+    assert(current_tip->GetAncestor(new_tip->nHeight) == new_tip);
+
+    // In the case of a reorg, ensure persisted block locator is not stale.
+    m_best_block_index = new_tip;
+    return WriteBestBlock(new_tip);
+}
+
 void BaseIndex::BlockConnected(const std::shared_ptr<const CBlock>& block, const CBlockIndex* pindex,
                                const std::vector<CTransactionRef>& txn_conflicted)
 {
@@ -175,6 +191,11 @@ void BaseIndex::BlockConnected(const std::shared_ptr<const CBlock>& block, const
                       best_block_index->GetBlockHash().ToString());
             return;
         }
+        if (best_block_index != pindex->pprev && !Rewind(best_block_index, pindex->pprev)) {
+            FatalError("%s: Failed to rewind index %s to a previous chain tip",
+                       __func__, GetName());
+            return;
+        }
     }
 
     if (WriteBlock(*block, pindex)) {
@@ -186,6 +207,27 @@ void BaseIndex::BlockConnected(const std::shared_ptr<const CBlock>& block, const
     }
 }
 
+void BaseIndex::BlockDisconnected(const std::shared_ptr<const CBlock>& block)
+{
+    if (!m_synced) {
+        return;
+    }
+
+    // Blocks disconnected before the index caught up are never written to it,
+    // so only the current best block can be rewound here. Any other case is
+    // handled by BlockConnected once the new chain gets connected.
+    const CBlockIndex* best_block_index = m_best_block_index.load();
+    if (!best_block_index || !best_block_index->pprev ||
+        best_block_index->GetBlockHash() != block->GetHash()) {
+        return;
+    }
+
+    if (!Rewind(best_block_index, best_block_index->pprev)) {
+        FatalError("%s: Failed to rewind index %s to a previous chain tip",
+                   __func__, GetName());
+    }
+}
+
 void BaseIndex::ChainStateFlushed(const CBlockLocator& locator)
 {
     if (!m_synced) {
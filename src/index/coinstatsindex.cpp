@@ -0,0 +1,230 @@
+// Copyright (c) 2020 Chaintope Inc.
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <index/coinstatsindex.h>
+#include <coins.h>
+#include <federationparams.h>
+#include <undo.h>
+#include <util.h>
+#include <validation.h>
+
+constexpr char DB_COLOR_STATS = 'c';
+constexpr char DB_STATS = 's';
+
+std::unique_ptr<CoinStatsIndex> g_coinstatsindex;
+
+namespace {
+
+/**
+ * Statistics of the whole UTXO set and the block they are at. A new index is
+ * at the genesis block, whose outputs are not in the UTXO set.
+ */
+struct DBStats
+{
+    uint256 hashBlock;
+    int nHeight;
+    uint64_t nTransactionOutputs;
+    uint64_t nBogoSize;
+    CAmount nTotalAmount;
+
+    DBStats() : hashBlock(FederationParams().GenesisBlock().GetHash()), nHeight(0), nTransactionOutputs(0), nBogoSize(0), nTotalAmount(0) {}
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(hashBlock);
+        READWRITE(VARINT(nHeight, VarIntMode::NONNEGATIVE_SIGNED));
+        READWRITE(VARINT(nTransactionOutputs));
+        READWRITE(VARINT(nBogoSize));
+        READWRITE(nTotalAmount);
+    }
+};
+
+} // namespace
+
+/**
+ * Access to the coinstatsindex database (indexes/coinstatsindex/)
+ *
+ * The database stores the statistics of the whole UTXO set under DB_STATS
+ * and the amount and output count of every color under DB_COLOR_STATS.
+ */
+class CoinStatsIndex::DB : public BaseIndex::DB
+{
+public:
+    explicit DB(size_t n_cache_size, bool f_memory = false, bool f_wipe = false);
+
+    bool ReadStats(DBStats& stats) const;
+
+    /// Read the statistics and every color from one consistent state of the database.
+    bool ReadAllStats(DBStats& stats, CColorCoinsStatsMap& colors);
+
+    /// Get the stats of a color in the map, reading them from the database the first time.
+    CColorCoinsStats& GetColorStats(CColorCoinsStatsMap& colors, const ColorIdentifier& colorId) const;
+
+    /// Write the updated stats to the batch, erasing colors without outputs.
+    void WriteStats(CDBBatch& batch, const DBStats& stats, const CColorCoinsStatsMap& colors) const;
+};
+
+CoinStatsIndex::DB::DB(size_t n_cache_size, bool f_memory, bool f_wipe) :
+    BaseIndex::DB(GetDataDir() / "indexes" / "coinstatsindex", GetDBTuning("coinstatsindex", n_cache_size), f_memory, f_wipe)
+{}
+
+bool CoinStatsIndex::DB::ReadStats(DBStats& stats) const
+{
+    return Read(DB_STATS, stats);
+}
+
+bool CoinStatsIndex::DB::ReadAllStats(DBStats& stats, CColorCoinsStatsMap& colors)
+{
+    std::unique_ptr<CDBIterator> cursor(NewIterator());
+    std::pair<char, ColorIdentifier> key;
+    for (cursor->Seek(std::make_pair(DB_COLOR_STATS, ColorIdentifier())); cursor->Valid(); cursor->Next()) {
+        if (!cursor->GetKey(key) || key.first != DB_COLOR_STATS) {
+            break;
+        }
+        if (!cursor->GetValue(colors[key.second])) {
+            return error("%s: cannot parse coinstatsindex record", __func__);
+        }
+    }
+    char stats_key;
+    cursor->Seek(DB_STATS);
+    if (cursor->Valid() && cursor->GetKey(stats_key) && stats_key == DB_STATS && !cursor->GetValue(stats)) {
+        return error("%s: cannot parse coinstatsindex record", __func__);
+    }
+    return true;
+}
+
+CColorCoinsStats& CoinStatsIndex::DB::GetColorStats(CColorCoinsStatsMap& colors, const ColorIdentifier& colorId) const
+{
+    auto it = colors.find(colorId);
+    if (it == colors.end()) {
+        it = colors.emplace(colorId, CColorCoinsStats()).first;
+        Read(std::make_pair(DB_COLOR_STATS, colorId), it->second);
+    }
+    return it->second;
+}
+
+void CoinStatsIndex::DB::WriteStats(CDBBatch& batch, const DBStats& stats, const CColorCoinsStatsMap& colors) const
+{
+    for (const auto& entry : colors) {
+        if (entry.second.nTransactionOutputs == 0) {
+            batch.Erase(std::make_pair(DB_COLOR_STATS, entry.first));
+        } else {
+            batch.Write(std::make_pair(DB_COLOR_STATS, entry.first), entry.second);
+        }
+    }
+    batch.Write(DB_STATS, stats);
+}
+
+CoinStatsIndex::CoinStatsIndex(size_t n_cache_size, bool f_memory, bool f_wipe)
+    : m_db(MakeUnique<CoinStatsIndex::DB>(n_cache_size, f_memory, f_wipe))
+{}
+
+CoinStatsIndex::~CoinStatsIndex() {}
+
+bool CoinStatsIndex::ApplyBlock(const CBlock& block, const CBlockIndex* pindex, bool fConnect)
+{
+    DBStats stats;
+    m_db->ReadStats(stats);
+    CColorCoinsStatsMap colors;
+
+    const CBlockIndex* pindexBefore = fConnect ? pindex->pprev : pindex;
+    const CBlockIndex* pindexAfter = fConnect ? pindex : pindex->pprev;
+    const uint256 hashBefore = pindexBefore ? pindexBefore->GetBlockHash() : uint256();
+    const uint256 hashAfter = pindexAfter ? pindexAfter->GetBlockHash() : uint256();
+    if (stats.hashBlock == hashAfter) {
+        // Already applied: the stats are written with every block, the
+        // locator only now and then, so it may lag behind after a crash.
+        return true;
+    }
+    if (stats.hashBlock != hashBefore) {
+        return error("%s: index is at block %s, not %s", __func__, stats.hashBlock.ToString(), hashBefore.ToString());
+    }
+
+    // The genesis block's transactions are not added to the UTXO set.
+    if (pindex->pprev) {
+        CBlockUndo blockundo;
+        if (!UndoReadFromDisk(blockundo, pindex)) {
+            return error("%s: no undo data for block %s at height %d", __func__,
+                         pindex->GetBlockHash().ToString(), pindex->nHeight);
+        }
+        if (blockundo.vtxundo.size() + 1 != block.vtx.size()) {
+            return error("%s: block %s and undo data inconsistent", __func__, pindex->GetBlockHash().ToString());
+        }
+
+        // Outputs spent within the block are both added and removed here.
+        auto apply = [&](const CTxOut& txout, bool fAdd) {
+            const int64_t sign = fAdd == fConnect ? 1 : -1;
+            stats.nTransactionOutputs += sign;
+            stats.nTotalAmount += sign * txout.nValue;
+            stats.nBogoSize += sign * (32 /* txid */ + 4 /* vout index */ + 4 /* height + coinbase */ + 8 /* amount */ +
+                                       2 /* scriptPubKey len */ + txout.scriptPubKey.size() /* scriptPubKey */);
+            const ColorIdentifier colorId = GetColorIdFromScript(txout.scriptPubKey);
+            if (colorId.type != TokenTypes::NONE) {
+                CColorCoinsStats& color_stats = m_db->GetColorStats(colors, colorId);
+                color_stats.nAmount += sign * txout.nValue;
+                color_stats.nTransactionOutputs += sign;
+            }
+        };
+        for (size_t i = 0; i < block.vtx.size(); i++) {
+            for (const CTxOut& txout : block.vtx[i]->vout) {
+                if (!txout.scriptPubKey.IsUnspendable()) {
+                    apply(txout, true);
+                }
+            }
+            if (i > 0) {
+                for (const Coin& coin : blockundo.vtxundo[i - 1].vprevout) {
+                    apply(coin.out, false);
+                }
+            }
+        }
+    }
+
+    stats.hashBlock = hashAfter;
+    stats.nHeight = pindexAfter ? pindexAfter->nHeight : 0;
+
+    CDBBatch batch(*m_db);
+    m_db->WriteStats(batch, stats, colors);
+    return m_db->WriteBatch(batch);
+}
+
+bool CoinStatsIndex::WriteBlock(const CBlock& block, const CBlockIndex* pindex)
+{
+    return ApplyBlock(block, pindex, true);
+}
+
+bool CoinStatsIndex::Rewind(const CBlockIndex* current_tip, const CBlockIndex* new_tip)
+{
+    assert(current_tip->GetAncestor(new_tip->nHeight) == new_tip);
+
+    for (const CBlockIndex* pindex = current_tip; pindex != new_tip; pindex = pindex->pprev) {
+        CBlock block;
+        if (!ReadBlockFromDisk(block, pindex)) {
+            return error("%s: failed to read block %s from disk", __func__, pindex->GetBlockHash().ToString());
+        }
+        if (!ApplyBlock(block, pindex, false)) {
+            return error("%s: failed to rewind block %s", __func__, pindex->GetBlockHash().ToString());
+        }
+    }
+
+    return BaseIndex::Rewind(current_tip, new_tip);
+}
+
+BaseIndex::DB& CoinStatsIndex::GetDB() const { return *m_db; }
+
+bool CoinStatsIndex::LookupStats(CCoinsStats& stats) const
+{
+    DBStats db_stats;
+    stats.mapColorStats.clear();
+    if (!m_db->ReadAllStats(db_stats, stats.mapColorStats)) {
+        return false;
+    }
+    stats.hashBlock = db_stats.hashBlock;
+    stats.nHeight = db_stats.nHeight;
+    stats.nTransactionOutputs = db_stats.nTransactionOutputs;
+    stats.nBogoSize = db_stats.nBogoSize;
+    stats.nTotalAmount = db_stats.nTotalAmount;
+    return true;
+}
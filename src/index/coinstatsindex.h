@@ -0,0 +1,57 @@
+// Copyright (c) 2020 Chaintope Inc.
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef TAPYRUS_INDEX_COINSTATSINDEX_H
+#define TAPYRUS_INDEX_COINSTATSINDEX_H
+
+#include <chain.h>
+#include <coinstats.h>
+#include <index/base.h>
+
+/**
+ * CoinStatsIndex keeps the statistics of the UTXO set reported by
+ * gettxoutsetinfo up to date as blocks are connected and disconnected, using
+ * the coins each block spent from its undo data, so that they can be looked
+ * up without scanning the chainstate. The number of transactions and the
+ * serialized hash depend on the whole set and are not maintained.
+ */
+class CoinStatsIndex final : public BaseIndex
+{
+protected:
+    class DB;
+
+private:
+    const std::unique_ptr<DB> m_db;
+
+    /// Add the changes a block made to the UTXO set to the index, or remove them.
+    bool ApplyBlock(const CBlock& block, const CBlockIndex* pindex, bool fConnect);
+
+protected:
+    bool WriteBlock(const CBlock& block, const CBlockIndex* pindex) override;
+
+    bool Rewind(const CBlockIndex* current_tip, const CBlockIndex* new_tip) override;
+
+    BaseIndex::DB& GetDB() const override;
+
+    const char* GetName() const override { return "coinstatsindex"; }
+
+public:
+    /// Constructs the index, which becomes available to be queried.
+    explicit CoinStatsIndex(size_t n_cache_size, bool f_memory = false, bool f_wipe = false);
+
+    // Destructor is declared because this class contains a unique_ptr to an incomplete type.
+    virtual ~CoinStatsIndex() override;
+
+    /// Look up the statistics of the UTXO set at the block the index is synced to.
+    ///
+    /// @param[out]  stats  nHeight, hashBlock, nTransactionOutputs, nBogoSize,
+    ///                     nTotalAmount and mapColorStats are set.
+    /// @return  false on a database error, true otherwise
+    bool LookupStats(CCoinsStats& stats) const;
+};
+
+/// The global UTXO set statistics index. May be null.
+extern std::unique_ptr<CoinStatsIndex> g_coinstatsindex;
+
+#endif // TAPYRUS_INDEX_COINSTATSINDEX_H
@@ -0,0 +1,270 @@
+// Copyright (c) 2020 Chaintope Inc.
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <index/colorindex.h>
+#include <util.h>
+#include <validation.h>
+
+constexpr char DB_COLOR_STATS = 's';
+constexpr char DB_COLOR_UTXO = 'c';
+constexpr char DB_UTXO = 'u';
+constexpr char DB_BLOCK_UNDO = 'U';
+constexpr char DB_APPLIED_BLOCK = 'h';
+
+std::unique_ptr<ColorIndex> g_colorindex;
+
+typedef std::map<ColorIdentifier, ColorStats, ColorIdentifierCompare> ColorStatsMap;
+
+/**
+ * Changes made to the index by one block, used to rewind the index during a
+ * reorg. Undo records are only kept for the last MIN_BLOCKS_TO_KEEP blocks.
+ */
+struct ColorBlockUndo
+{
+    std::vector<std::pair<COutPoint, ColorUtxo>> vCreated;
+    std::vector<std::pair<COutPoint, ColorUtxo>> vSpent;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(vCreated);
+        READWRITE(vSpent);
+    }
+};
+
+/**
+ * Access to the colorindex database (indexes/colorindex/)
+ *
+ * The database stores, per color, the supply and unspent output count under
+ * DB_COLOR_STATS and the unspent outputs under DB_COLOR_UTXO, keyed by color
+ * and outpoint so that the outputs of one color can be iterated. DB_UTXO maps
+ * an outpoint back to its color for spends. DB_APPLIED_BLOCK is the hash of
+ * the last block applied to the index, written in the same batch as its changes.
+ */
+class ColorIndex::DB : public BaseIndex::DB
+{
+public:
+    explicit DB(size_t n_cache_size, bool f_memory = false, bool f_wipe = false);
+
+    bool ReadColorStats(const ColorIdentifier& colorId, ColorStats& stats) const;
+
+    bool ReadUtxo(const COutPoint& outpoint, ColorUtxo& utxo) const;
+
+    bool ReadColorUtxos(const ColorIdentifier& colorId, std::vector<std::pair<COutPoint, ColorUtxo>>& utxos, size_t max_count);
+
+    bool ReadBlockUndo(const uint256& block_hash, ColorBlockUndo& undo) const;
+
+    bool ReadAppliedBlock(uint256& block_hash) const;
+
+    /// Add the given outputs to the batch and update their colors' stats.
+    void WriteUtxos(CDBBatch& batch, const std::vector<std::pair<COutPoint, ColorUtxo>>& utxos, ColorStatsMap& stats) const;
+
+    /// Remove the given outputs in the batch and update their colors' stats.
+    void EraseUtxos(CDBBatch& batch, const std::vector<std::pair<COutPoint, ColorUtxo>>& utxos, ColorStatsMap& stats) const;
+
+    /// Write the updated stats to the batch, erasing colors without outputs.
+    void WriteColorStats(CDBBatch& batch, const ColorStatsMap& stats) const;
+
+private:
+    /// Get the stats of a color in the map, reading them from the database the first time.
+    ColorStats& GetColorStats(ColorStatsMap& stats, const ColorIdentifier& colorId) const;
+};
+
+ColorIndex::DB::DB(size_t n_cache_size, bool f_memory, bool f_wipe) :
+    BaseIndex::DB(GetDataDir() / "indexes" / "colorindex", GetDBTuning("colorindex", n_cache_size, true), f_memory, f_wipe)
+{}
+
+bool ColorIndex::DB::ReadColorStats(const ColorIdentifier& colorId, ColorStats& stats) const
+{
+    return Read(std::make_pair(DB_COLOR_STATS, colorId), stats);
+}
+
+bool ColorIndex::DB::ReadUtxo(const COutPoint& outpoint, ColorUtxo& utxo) const
+{
+    return Read(std::make_pair(DB_UTXO, outpoint), utxo);
+}
+
+bool ColorIndex::DB::ReadColorUtxos(const ColorIdentifier& colorId, std::vector<std::pair<COutPoint, ColorUtxo>>& utxos, size_t max_count)
+{
+    std::unique_ptr<CDBIterator> cursor(NewIterator());
+    std::pair<char, std::pair<ColorIdentifier, COutPoint>> key;
+    for (cursor->Seek(std::make_pair(DB_COLOR_UTXO, std::make_pair(colorId, COutPoint(uint256(), 0)))); cursor->Valid(); cursor->Next()) {
+        if (!cursor->GetKey(key) || key.first != DB_COLOR_UTXO || !(key.second.first == colorId)) {
+            break;
+        }
+        ColorUtxo utxo;
+        if (!cursor->GetValue(utxo)) {
+            return error("%s: cannot parse colorindex record", __func__);
+        }
+        utxos.emplace_back(key.second.second, utxo);
+        if (max_count && utxos.size() >= max_count) {
+            break;
+        }
+    }
+    return true;
+}
+
+bool ColorIndex::DB::ReadBlockUndo(const uint256& block_hash, ColorBlockUndo& undo) const
+{
+    return Read(std::make_pair(DB_BLOCK_UNDO, block_hash), undo);
+}
+
+bool ColorIndex::DB::ReadAppliedBlock(uint256& block_hash) const
+{
+    return Read(DB_APPLIED_BLOCK, block_hash);
+}
+
+ColorStats& ColorIndex::DB::GetColorStats(ColorStatsMap& stats, const ColorIdentifier& colorId) const
+{
+    auto it = stats.find(colorId);
+    if (it == stats.end()) {
+        it = stats.emplace(colorId, ColorStats()).first;
+        ReadColorStats(colorId, it->second);
+    }
+    return it->second;
+}
+
+void ColorIndex::DB::WriteUtxos(CDBBatch& batch, const std::vector<std::pair<COutPoint, ColorUtxo>>& utxos, ColorStatsMap& stats) const
+{
+    for (const auto& entry : utxos) {
+        const ColorUtxo& utxo = entry.second;
+        batch.Write(std::make_pair(DB_UTXO, entry.first), utxo);
+        batch.Write(std::make_pair(DB_COLOR_UTXO, std::make_pair(utxo.colorId, entry.first)), utxo);
+        ColorStats& color_stats = GetColorStats(stats, utxo.colorId);
+        color_stats.nSupply += utxo.nValue;
+        color_stats.nUtxos++;
+    }
+}
+
+void ColorIndex::DB::EraseUtxos(CDBBatch& batch, const std::vector<std::pair<COutPoint, ColorUtxo>>& utxos, ColorStatsMap& stats) const
+{
+    for (const auto& entry : utxos) {
+        const ColorUtxo& utxo = entry.second;
+        batch.Erase(std::make_pair(DB_UTXO, entry.first));
+        batch.Erase(std::make_pair(DB_COLOR_UTXO, std::make_pair(utxo.colorId, entry.first)));
+        ColorStats& color_stats = GetColorStats(stats, utxo.colorId);
+        color_stats.nSupply -= utxo.nValue;
+        color_stats.nUtxos--;
+    }
+}
+
+void ColorIndex::DB::WriteColorStats(CDBBatch& batch, const ColorStatsMap& stats) const
+{
+    for (const auto& entry : stats) {
+        if (entry.second.nUtxos == 0) {
+            batch.Erase(std::make_pair(DB_COLOR_STATS, entry.first));
+        } else {
+            batch.Write(std::make_pair(DB_COLOR_STATS, entry.first), entry.second);
+        }
+    }
+}
+
+ColorIndex::ColorIndex(size_t n_cache_size, bool f_memory, bool f_wipe)
+    : m_db(MakeUnique<ColorIndex::DB>(n_cache_size, f_memory, f_wipe))
+{}
+
+ColorIndex::~ColorIndex() {}
+
+bool ColorIndex::WriteBlock(const CBlock& block, const CBlockIndex* pindex)
+{
+    // The locator is written now and then, the changes with every block, so
+    // after a crash blocks already in the index may be written again.
+    uint256 hashApplied;
+    if (m_db->ReadAppliedBlock(hashApplied)) {
+        LOCK(cs_main);
+        const CBlockIndex* pindexApplied = LookupBlockIndex(hashApplied);
+        if (pindexApplied && pindexApplied->GetAncestor(pindex->nHeight) == pindex) {
+            return true;
+        }
+        if (pindexApplied != pindex->pprev) {
+            return error("%s: index is at block %s, not %s", __func__, hashApplied.ToString(),
+                         pindex->pprev ? pindex->pprev->GetBlockHash().ToString() : uint256().ToString());
+        }
+    }
+
+    // Outputs created by this block that are not spent within the block.
+    std::map<COutPoint, ColorUtxo> created;
+    ColorBlockUndo undo;
+
+    for (const auto& tx : block.vtx) {
+        if (!tx->IsCoinBase()) {
+            for (const CTxIn& txin : tx->vin) {
+                auto it = created.find(txin.prevout);
+                if (it != created.end()) {
+                    created.erase(it);
+                    continue;
+                }
+                ColorUtxo utxo;
+                if (m_db->ReadUtxo(txin.prevout, utxo)) {
+                    undo.vSpent.emplace_back(txin.prevout, utxo);
+                }
+            }
+        }
+        for (uint32_t i = 0; i < tx->vout.size(); i++) {
+            const CTxOut& txout = tx->vout[i];
+            if (txout.scriptPubKey.IsUnspendable()) {
+                continue;
+            }
+            const ColorIdentifier& colorId = tx->GetColorId(i);
+            if (colorId.type == TokenTypes::NONE) {
+                continue;
+            }
+            created.emplace(COutPoint(tx->GetHashMalFix(), i), ColorUtxo(colorId, txout.nValue, pindex->nHeight));
+        }
+    }
+    undo.vCreated.assign(created.begin(), created.end());
+
+    CDBBatch batch(*m_db);
+    ColorStatsMap stats;
+    m_db->EraseUtxos(batch, undo.vSpent, stats);
+    m_db->WriteUtxos(batch, undo.vCreated, stats);
+    m_db->WriteColorStats(batch, stats);
+
+    batch.Write(std::make_pair(DB_BLOCK_UNDO, pindex->GetBlockHash()), undo);
+    batch.Write(DB_APPLIED_BLOCK, pindex->GetBlockHash());
+    const CBlockIndex* pindex_expired = pindex->GetAncestor(pindex->nHeight - MIN_BLOCKS_TO_KEEP);
+    if (pindex_expired) {
+        batch.Erase(std::make_pair(DB_BLOCK_UNDO, pindex_expired->GetBlockHash()));
+    }
+    return m_db->WriteBatch(batch);
+}
+
+bool ColorIndex::Rewind(const CBlockIndex* current_tip, const CBlockIndex* new_tip)
+{
+    assert(current_tip->GetAncestor(new_tip->nHeight) == new_tip);
+
+    CDBBatch batch(*m_db);
+    ColorStatsMap stats;
+    for (const CBlockIndex* pindex = current_tip; pindex != new_tip; pindex = pindex->pprev) {
+        ColorBlockUndo undo;
+        if (!m_db->ReadBlockUndo(pindex->GetBlockHash(), undo)) {
+            return error("%s: no undo data for block %s at height %d", __func__,
+                         pindex->GetBlockHash().ToString(), pindex->nHeight);
+        }
+        m_db->EraseUtxos(batch, undo.vCreated, stats);
+        m_db->WriteUtxos(batch, undo.vSpent, stats);
+        batch.Erase(std::make_pair(DB_BLOCK_UNDO, pindex->GetBlockHash()));
+    }
+    m_db->WriteColorStats(batch, stats);
+    batch.Write(DB_APPLIED_BLOCK, new_tip->GetBlockHash());
+    if (!m_db->WriteBatch(batch)) {
+        return error("%s: failed to write rewound index", __func__);
+    }
+
+    return BaseIndex::Rewind(current_tip, new_tip);
+}
+
+BaseIndex::DB& ColorIndex::GetDB() const { return *m_db; }
+
+bool ColorIndex::GetColorStats(const ColorIdentifier& colorId, ColorStats& stats) const
+{
+    return m_db->ReadColorStats(colorId, stats);
+}
+
+bool ColorIndex::GetColorUtxos(const ColorIdentifier& colorId, std::vector<std::pair<COutPoint, ColorUtxo>>& utxos, size_t max_count) const
+{
+    utxos.clear();
+    return m_db->ReadColorUtxos(colorId, utxos, max_count);
+}
@@ -0,0 +1,105 @@
+// Copyright (c) 2020 Chaintope Inc.
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef TAPYRUS_INDEX_COLORINDEX_H
+#define TAPYRUS_INDEX_COLORINDEX_H
+
+#include <amount.h>
+#include <chain.h>
+#include <coloridentifier.h>
+#include <index/base.h>
+#include <serialize.h>
+
+/** Aggregate state of one color in the UTXO set. */
+struct ColorStats
+{
+    //! Sum of the token amounts of all unspent outputs of the color
+    CAmount nSupply;
+    //! Number of unspent outputs of the color
+    uint64_t nUtxos;
+
+    ColorStats() : nSupply(0), nUtxos(0) {}
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(nSupply);
+        READWRITE(VARINT(nUtxos));
+    }
+};
+
+/** An unspent colored output as recorded in the color index. */
+struct ColorUtxo
+{
+    ColorIdentifier colorId;
+    CAmount nValue;
+    //! Height of the block that created the output
+    uint32_t nHeight;
+
+    ColorUtxo() : nValue(0), nHeight(0) {}
+    ColorUtxo(const ColorIdentifier& colorIdIn, CAmount nValueIn, uint32_t nHeightIn) :
+        colorId(colorIdIn), nValue(nValueIn), nHeight(nHeightIn) {}
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action) {
+        READWRITE(colorId);
+        READWRITE(nValue);
+        READWRITE(VARINT(nHeight));
+    }
+};
+
+/**
+ * ColorIndex keeps track of the colored outputs in the UTXO set. For every
+ * color it maintains the total supply, the number of unspent outputs and the
+ * list of those outputs, so that token queries do not need to scan the
+ * chainstate. The index is written to a LevelDB database and is updated
+ * incrementally as blocks are connected and disconnected.
+ */
+class ColorIndex final : public BaseIndex
+{
+protected:
+    class DB;
+
+private:
+    const std::unique_ptr<DB> m_db;
+
+protected:
+    bool WriteBlock(const CBlock& block, const CBlockIndex* pindex) override;
+
+    bool Rewind(const CBlockIndex* current_tip, const CBlockIndex* new_tip) override;
+
+    BaseIndex::DB& GetDB() const override;
+
+    const char* GetName() const override { return "colorindex"; }
+
+public:
+    /// Constructs the index, which becomes available to be queried.
+    explicit ColorIndex(size_t n_cache_size, bool f_memory = false, bool f_wipe = false);
+
+    // Destructor is declared because this class contains a unique_ptr to an incomplete type.
+    virtual ~ColorIndex() override;
+
+    /// Look up the supply and unspent output count of a color.
+    ///
+    /// @param[in]   colorId  The color to look up.
+    /// @param[out]  stats  The state of the color in the UTXO set.
+    /// @return  true if the color has unspent outputs, false otherwise
+    bool GetColorStats(const ColorIdentifier& colorId, ColorStats& stats) const;
+
+    /// List the unspent outputs of a color.
+    ///
+    /// @param[in]   colorId  The color to look up.
+    /// @param[out]  utxos  The unspent outputs of the color, ordered by outpoint.
+    /// @param[in]   max_count  The maximum number of outputs returned, 0 for no limit.
+    /// @return  false on a database error, true otherwise
+    bool GetColorUtxos(const ColorIdentifier& colorId, std::vector<std::pair<COutPoint, ColorUtxo>>& utxos, size_t max_count = 0) const;
+};
+
+/// The global color index. May be null.
+extern std::unique_ptr<ColorIndex> g_colorindex;
+
+#endif // TAPYRUS_INDEX_COLORINDEX_H
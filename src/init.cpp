@@ -12,6 +12,7 @@
 
 #include <addrman.h>
 #include <amount.h>
+#include <blockcache.h>
 #include <chain.h>
 #include <chainparams.h>
 #include <checkpoints.h>
@@ -20,6 +21,8 @@
 #include <fs.h>
 #include <httpserver.h>
 #include <httprpc.h>
+#include <index/coinstatsindex.h>
+#include <index/colorindex.h>
 #include <index/txindex.h>
 #include <key.h>
 #include <validation.h>
@@ -182,6 +185,12 @@ void Interrupt()
     if (g_txindex) {
         g_txindex->Interrupt();
     }
+    if (g_colorindex) {
+        g_colorindex->Interrupt();
+    }
+    if (g_coinstatsindex) {
+        g_coinstatsindex->Interrupt();
+    }
 }
 
 void Shutdown()
@@ -211,6 +220,8 @@ void Shutdown()
     if (peerLogic) UnregisterValidationInterface(peerLogic.get());
     if (g_connman) g_connman->Stop();
     if (g_txindex) g_txindex->Stop();
+    if (g_colorindex) g_colorindex->Stop();
+    if (g_coinstatsindex) g_coinstatsindex->Stop();
 
     StopTorControl();
 
@@ -224,6 +235,8 @@ void Shutdown()
     peerLogic.reset();
     g_connman.reset();
     g_txindex.reset();
+    g_colorindex.reset();
+    g_coinstatsindex.reset();
 
     if (g_is_mempool_loaded && gArgs.GetArg("-persistmempool", DEFAULT_PERSIST_MEMPOOL)) {
         DumpMempool();
@@ -361,15 +374,22 @@ void SetupServerArgs()
     gArgs.AddArg("-blocksdir=<dir>", "Specify blocks directory (default: <datadir>/blocks)", false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-blocknotify=<cmd>", "Execute command when the best block changes (%s in cmd is replaced by block hash)", false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-blockreconstructionextratxn=<n>", strprintf("Extra transactions to keep in memory for compact block reconstructions (default: %u)", DEFAULT_BLOCK_RECONSTRUCTION_EXTRA_TXN), false, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-blockmmap", strprintf("Read blocks from memory mapped block files where supported. This avoids copying blocks from disk, but a disk error while reading a mapped block file terminates the node instead of failing the read (default: %u)", DEFAULT_BLOCK_MMAP), true, OptionsCategory::OPTIONS);
     gArgs.AddArg("-blocksonly", strprintf("Whether to operate in a blocks only mode (default: %u)", DEFAULT_BLOCKSONLY), true, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-coinstatsindex", strprintf("Maintain the statistics of the UTXO set as blocks are connected, used by the gettxoutsetinfo rpc call (default: %u)", DEFAULT_COINSTATSINDEX), false, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-colorindex", strprintf("Maintain an index of the colored coins in the UTXO set, used by the getcolorinfo and listcolorutxos rpc calls (default: %u)", DEFAULT_COLORINDEX), false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-conf=<file>", strprintf("Specify configuration file. Relative paths will be prefixed by datadir location. (default: %s)", BITCOIN_CONF_FILENAME), false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-datadir=<dir>", "Specify data directory", false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-dbbatchsize", strprintf("Maximum database write batch size in bytes (default: %u)", nDefaultDbBatchSize), true, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-dbasyncflush", strprintf("Write the coin database cache to disk on a background thread (default: %u)", DEFAULT_DB_ASYNC_FLUSH), true, OptionsCategory::OPTIONS);
     gArgs.AddArg("-dbcache=<n>", strprintf("Set database cache size in megabytes (%d to %d, default: %d)", nMinDbCache, nMaxDbCache, nDefaultDbCache), false, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-dbtuning=<db>:<setting>=<value>", "Tune the LevelDB database <db> (chainstate, blockindex, txindex, colorindex or coinstatsindex). <setting> is one of blockcache=<MiB>, writebuffer=<MiB>, bloombits=<n> or compression=<0|1>. "
+        "Cache sizes set here replace that database's share of -dbcache, and the difference is taken from the in-memory UTXO set. Compression needs LevelDB to be built with Snappy and is on by default for txindex and colorindex. Can be specified multiple times", false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-debuglogfile=<file>", strprintf("Specify location of debug log file. Relative paths will be prefixed by a net-specific datadir location. (-nodebuglogfile to disable; default: %s)", DEFAULT_DEBUGLOGFILE), false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-feefilter", strprintf("Tell other nodes to filter invs to us by our mempool min fee (default: %u)", DEFAULT_FEEFILTER), true, OptionsCategory::OPTIONS);
     gArgs.AddArg("-includeconf=<file>", "Specify additional configuration file, relative to the -datadir path (only useable from configuration file, not command line)", false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-loadblock=<file>", "Imports blocks from external blk000??.dat file on startup", false, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-maxblockcachesize=<n>", strprintf("Keep up to <n> MiB of recently used blocks in memory for serving peers, RPC and REST, 0 to disable (default: %u)", DEFAULT_MAX_BLOCK_CACHE_SIZE), false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-maxmempool=<n>", strprintf("Keep the transaction memory pool below <n> megabytes (default: %u)", DEFAULT_MAX_MEMPOOL_SIZE), false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-maxorphantx=<n>", strprintf("Keep at most <n> unconnectable transactions in memory (default: %u)", DEFAULT_MAX_ORPHAN_TRANSACTIONS), false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-mempoolexpiry=<n>", strprintf("Do not keep transactions in the mempool longer than <n> hours (default: %u)", DEFAULT_MEMPOOL_EXPIRY), false, OptionsCategory::OPTIONS);
@@ -381,7 +401,7 @@ void SetupServerArgs()
 #else
     hidden_args.emplace_back("-pid");
 #endif
-    gArgs.AddArg("-prune=<n>", strprintf("Reduce storage requirements by enabling pruning (deleting) of old blocks. This allows the pruneblockchain RPC to be called to delete specific blocks, and enables automatic pruning of old blocks if a target size in MiB is provided. This mode is incompatible with -txindex and -rescan. "
+    gArgs.AddArg("-prune=<n>", strprintf("Reduce storage requirements by enabling pruning (deleting) of old blocks. This allows the pruneblockchain RPC to be called to delete specific blocks, and enables automatic pruning of old blocks if a target size in MiB is provided. This mode is incompatible with -txindex, -colorindex, -coinstatsindex and -rescan. "
             "Warning: Reverting this setting requires re-downloading the entire blockchain. "
             "(default: 0 = disable pruning blocks, 1 = allow manual pruning via RPC, >=%u = automatically prune block files to stay under the specified target size in MiB)", MIN_DISK_SPACE_FOR_BLOCK_FILES / 1024 / 1024), false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-reindex", "Rebuild chain state and block index from the blk*.dat files on disk", false, OptionsCategory::OPTIONS);
@@ -933,10 +953,14 @@ bool AppInitParameterInteraction()
         return InitError(strprintf(_("Specified blocks directory \"%s\" does not exist."), gArgs.GetArg("-blocksdir", "").c_str()));
     }
 
-    // if using block pruning, then disallow txindex
+    // if using block pruning, then disallow txindex, colorindex and coinstatsindex
     if (gArgs.GetArg("-prune", 0)) {
         if (gArgs.GetBoolArg("-txindex", DEFAULT_TXINDEX))
             return InitError(_("Prune mode is incompatible with -txindex."));
+        if (gArgs.GetBoolArg("-colorindex", DEFAULT_COLORINDEX))
+            return InitError(_("Prune mode is incompatible with -colorindex."));
+        if (gArgs.GetBoolArg("-coinstatsindex", DEFAULT_COINSTATSINDEX))
+            return InitError(_("Prune mode is incompatible with -coinstatsindex."));
     }
 
     // -bind and -whitebind can't be set when not listening
@@ -1002,6 +1026,13 @@ bool AppInitParameterInteraction()
     if (gArgs.IsArgSet("-blockminsize"))
         InitWarning("Unsupported argument -blockminsize ignored.");
 
+    {
+        DBTuning tuning(0);
+        std::string error;
+        if (!ApplyDBTuningArgs(gArgs.GetArgs("-dbtuning"), "", tuning, error))
+            return InitError(error);
+    }
+
     // Checkmempool and checkblockindex default to true in dev mode
     int ratio = std::min<int>(std::max<int>(gArgs.GetArg("-checkmempool", chainparams.DefaultConsistencyChecks() ? 1 : 0), 0), 1000000);
     if (ratio != 0) {
@@ -1009,6 +1040,7 @@ bool AppInitParameterInteraction()
     }
     fCheckBlockIndex = gArgs.GetBoolArg("-checkblockindex", chainparams.DefaultConsistencyChecks());
     fCheckpointsEnabled = gArgs.GetBoolArg("-checkpoints", DEFAULT_CHECKPOINTS_ENABLED);
+    fBlockFileMmap = gArgs.GetBoolArg("-blockmmap", DEFAULT_BLOCK_MMAP);
 
     hashAssumeValid = uint256S(gArgs.GetArg("-assumevalid", ""));
     if (!hashAssumeValid.IsNull())
@@ -1137,6 +1169,13 @@ bool AppInitParameterInteraction()
     return true;
 }
 
+//! Memory taken by database db_name given nCacheSize, once its -dbtuning options are applied.
+static int64_t TunedDBCacheUsage(const std::string& db_name, int64_t nCacheSize)
+{
+    const DBTuning tuning = GetDBTuning(db_name, nCacheSize);
+    return tuning.block_cache_size + 2 * tuning.write_buffer_size;
+}
+
 static bool LockDataDirectory(bool probeOnly)
 {
     // Make sure only a single Bitcoin process is using the data directory.
@@ -1228,11 +1267,16 @@ bool AppInitMain()
 
     InitSignatureCache();
     InitScriptExecutionCache();
+    InitBlockProofCache();
 
-    LogPrintf("Using %u threads for script verification\n", nScriptCheckThreads);
+    LogPrintf("Using %u threads for block and mempool script and header proof verification and coin prefetching\n", nScriptCheckThreads);
     if (nScriptCheckThreads) {
-        for (int i=0; i<nScriptCheckThreads-1; i++)
+        for (int i=0; i<nScriptCheckThreads-1; i++) {
             threadGroup.create_thread(&ThreadScriptCheck);
+            threadGroup.create_thread(&ThreadMempoolScriptCheck);
+            threadGroup.create_thread(&ThreadHeaderProofCheck);
+            threadGroup.create_thread(&ThreadCoinPrefetch);
+        }
     }
 
     // Start the lightweight task scheduler thread
@@ -1397,18 +1441,47 @@ bool AppInitMain()
     nTotalCache -= nBlockTreeDBCache;
     int64_t nTxIndexCache = std::min(nTotalCache / 8, gArgs.GetBoolArg("-txindex", DEFAULT_TXINDEX) ? nMaxTxIndexCache << 20 : 0);
     nTotalCache -= nTxIndexCache;
+    int64_t nColorIndexCache = std::min(nTotalCache / 8, gArgs.GetBoolArg("-colorindex", DEFAULT_COLORINDEX) ? nMaxColorIndexCache << 20 : 0);
+    nTotalCache -= nColorIndexCache;
+    int64_t nCoinStatsIndexCache = std::min(nTotalCache / 8, gArgs.GetBoolArg("-coinstatsindex", DEFAULT_COINSTATSINDEX) ? nMaxCoinStatsIndexCache << 20 : 0);
+    nTotalCache -= nCoinStatsIndexCache;
     int64_t nCoinDBCache = std::min(nTotalCache / 2, (nTotalCache / 4) + (1 << 23)); // use 25%-50% of the remainder for disk cache
     nCoinDBCache = std::min(nCoinDBCache, nMaxCoinsDBCache << 20); // cap total coins db cache
     nTotalCache -= nCoinDBCache;
+    const int64_t nUntunedCoinCache = nTotalCache;
+    // Cache sizes set with -dbtuning replace a database's share, so take the
+    // difference from (or give it back to) the in-memory cache.
+    const int64_t nBlockTreeDBUsage = TunedDBCacheUsage("blockindex", nBlockTreeDBCache);
+    const int64_t nTxIndexUsage = nTxIndexCache > 0 ? TunedDBCacheUsage("txindex", nTxIndexCache) : 0;
+    const int64_t nColorIndexUsage = nColorIndexCache > 0 ? TunedDBCacheUsage("colorindex", nColorIndexCache) : 0;
+    const int64_t nCoinStatsIndexUsage = nCoinStatsIndexCache > 0 ? TunedDBCacheUsage("coinstatsindex", nCoinStatsIndexCache) : 0;
+    const int64_t nCoinDBUsage = TunedDBCacheUsage("chainstate", nCoinDBCache);
+    nTotalCache -= (nBlockTreeDBUsage - nBlockTreeDBCache) + (nTxIndexUsage - nTxIndexCache) + (nColorIndexUsage - nColorIndexCache) +
+                   (nCoinStatsIndexUsage - nCoinStatsIndexCache) + (nCoinDBUsage - nCoinDBCache);
+    // Tuned caches may not shrink the in-memory cache below nMinDbCache, or below its untuned size if that is smaller.
+    const int64_t nMinCoinCache = std::min(nUntunedCoinCache, nMinDbCache << 20);
+    if (nTotalCache < nMinCoinCache) {
+        return InitError(strprintf(_("The -dbtuning cache sizes leave %.1fMiB of -dbcache for the in-memory UTXO set, which needs at least %.1fMiB. Raise -dbcache or lower the tuned cache sizes."),
+            std::max<int64_t>(nTotalCache, 0) * (1.0 / 1024 / 1024), nMinCoinCache * (1.0 / 1024 / 1024)));
+    }
     nCoinCacheUsage = nTotalCache; // the rest goes to in-memory cache
     int64_t nMempoolSizeMax = gArgs.GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000;
     LogPrintf("Cache configuration:\n");
-    LogPrintf("* Using %.1fMiB for block index database\n", nBlockTreeDBCache * (1.0 / 1024 / 1024));
+    LogPrintf("* Using %.1fMiB for block index database\n", nBlockTreeDBUsage * (1.0 / 1024 / 1024));
     if (gArgs.GetBoolArg("-txindex", DEFAULT_TXINDEX)) {
-        LogPrintf("* Using %.1fMiB for transaction index database\n", nTxIndexCache * (1.0 / 1024 / 1024));
+        LogPrintf("* Using %.1fMiB for transaction index database\n", nTxIndexUsage * (1.0 / 1024 / 1024));
+    }
+    if (gArgs.GetBoolArg("-colorindex", DEFAULT_COLORINDEX)) {
+        LogPrintf("* Using %.1fMiB for color index database\n", nColorIndexUsage * (1.0 / 1024 / 1024));
     }
-    LogPrintf("* Using %.1fMiB for chain state database\n", nCoinDBCache * (1.0 / 1024 / 1024));
+    if (gArgs.GetBoolArg("-coinstatsindex", DEFAULT_COINSTATSINDEX)) {
+        LogPrintf("* Using %.1fMiB for coin stats index database\n", nCoinStatsIndexUsage * (1.0 / 1024 / 1024));
+    }
+    LogPrintf("* Using %.1fMiB for chain state database\n", nCoinDBUsage * (1.0 / 1024 / 1024));
     LogPrintf("* Using %.1fMiB for in-memory UTXO set (plus up to %.1fMiB of unused mempool space)\n", nCoinCacheUsage * (1.0 / 1024 / 1024), nMempoolSizeMax * (1.0 / 1024 / 1024));
+    const int64_t nBlockCacheSize = std::max<int64_t>(gArgs.GetArg("-maxblockcachesize", DEFAULT_MAX_BLOCK_CACHE_SIZE), 0) << 20;
+    g_block_cache.SetMaxUsage(nBlockCacheSize);
+    LogPrintf("* Using %.1fMiB for recently used blocks\n", nBlockCacheSize * (1.0 / 1024 / 1024));
 
     bool fLoaded = false;
     while (!fLoaded && !ShutdownRequested()) {
@@ -1491,6 +1564,8 @@ bool AppInitMain()
                 }
 
                 // The on-disk coinsdb is now in a good state, create the cache
+                if (gArgs.GetBoolArg("-dbasyncflush", DEFAULT_DB_ASYNC_FLUSH))
+                    pcoinsdbview->StartBackgroundFlush();
                 pcoinsTip.reset(new CCoinsViewCache(pcoinscatcher.get()));
 
                 bool is_coinsview_empty = fReset || fReindexChainState || pcoinsTip->GetBestBlock().IsNull();
@@ -1586,6 +1661,14 @@ bool AppInitMain()
         g_txindex = MakeUnique<TxIndex>(nTxIndexCache, false, fReindex);
         g_txindex->Start();
     }
+    if (gArgs.GetBoolArg("-colorindex", DEFAULT_COLORINDEX)) {
+        g_colorindex = MakeUnique<ColorIndex>(nColorIndexCache, false, fReindex);
+        g_colorindex->Start();
+    }
+    if (gArgs.GetBoolArg("-coinstatsindex", DEFAULT_COINSTATSINDEX)) {
+        g_coinstatsindex = MakeUnique<CoinStatsIndex>(nCoinStatsIndexCache, false, fReindex);
+        g_coinstatsindex->Start();
+    }
 
     // ********************************************************* Step 9: load wallet
     if (!g_wallet_init_interface.Open()) return false;
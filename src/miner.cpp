@@ -78,6 +78,101 @@ static BlockAssembler::Options DefaultOptions()
 
 BlockAssembler::BlockAssembler(const CChainParams& params) : BlockAssembler(params, DefaultOptions()) {}
 
+/**
+ * The transactions selected for a block, kept for the next one together with
+ * the transactions added to the mempool since. Updated from the mempool's
+ * notifications, which are sent with mempool.cs held.
+ */
+struct BlockAssembler::KeptSelection
+{
+    //! Whether the selection can be updated, or must be made again
+    bool fValid = false;
+    //! The chain context the selection was made in
+    const CBlockIndex* pindexPrev = nullptr;
+    int nHeight = 0;
+    int64_t nLockTimeCutoff = 0;
+    //! The selected transactions, in block order
+    std::vector<CTxMemPool::txiter> vEntries;
+    CTxMemPool::setEntries setEntries;
+    //! The transactions added to the mempool since, and their total weight
+    std::vector<CTransactionRef> vAdded;
+    int64_t nAddedWeight = 0;
+    //! The mempool's update count when the selection was made, and the
+    //! number of notified updates since. Any other update, like a fee
+    //! delta, makes the sum differ from the mempool's count. The
+    //! notifications are sent before the count is updated.
+    unsigned int nTransactionsUpdated = 0;
+    unsigned int nUpdates = 0;
+
+    boost::signals2::scoped_connection connAdded;
+    boost::signals2::scoped_connection connRemoved;
+
+    void Clear()
+    {
+        fValid = false;
+        vEntries.clear();
+        setEntries.clear();
+        vAdded.clear();
+        nAddedWeight = 0;
+    }
+
+    //! Clear the selection if the mempool changed without a notification,
+    //! as when it was cleared, which leaves the selected entries dangling.
+    void CheckUpdates()
+    {
+        if (fValid && mempool.GetTransactionsUpdated() != nTransactionsUpdated + nUpdates)
+            Clear();
+        ++nUpdates;
+    }
+
+    void TransactionAdded(const CTransactionRef& tx, unsigned int nBlockMaxWeight)
+    {
+        CheckUpdates();
+        if (!fValid)
+            return;
+        // More than a block's worth of new transactions calls for a new selection anyway.
+        nAddedWeight += GetTransactionWeight(*tx);
+        if (nAddedWeight > nBlockMaxWeight) {
+            Clear();
+            return;
+        }
+        vAdded.push_back(tx);
+    }
+
+    void TransactionRemoved(const CTransactionRef& tx)
+    {
+        CheckUpdates();
+        if (!fValid)
+            return;
+        // The entry is still in the mempool while the removal is notified.
+        CTxMemPool::txiter it = mempool.mapTx.find(tx->GetHashMalFix());
+        if (it != mempool.mapTx.end() && setEntries.count(it))
+            Clear();
+    }
+};
+
+void BlockAssembler::TrackMempool()
+{
+    LOCK(mempool.cs);
+    pkept = std::make_shared<KeptSelection>();
+    // The connections are owned by the selection, which the handlers only
+    // use while it exists.
+    std::weak_ptr<KeptSelection> weak = pkept;
+    const unsigned int nMaxWeight = nBlockMaxWeight;
+    pkept->connAdded = mempool.NotifyEntryAdded.connect([weak, nMaxWeight](CTransactionRef tx) {
+        if (std::shared_ptr<KeptSelection> kept = weak.lock()) {
+            LOCK(mempool.cs);
+            kept->TransactionAdded(tx, nMaxWeight);
+        }
+    });
+    pkept->connRemoved = mempool.NotifyEntryRemoved.connect([weak](CTransactionRef tx, MemPoolRemovalReason) {
+        if (std::shared_ptr<KeptSelection> kept = weak.lock()) {
+            LOCK(mempool.cs);
+            kept->TransactionRemoved(tx);
+        }
+    });
+}
+
 void BlockAssembler::resetBlock()
 {
     inBlock.clear();
@@ -126,7 +221,9 @@ std::unique_ptr<CBlockTemplate> BlockAssembler::CreateNewBlock(const CScript& sc
 
     int nPackagesSelected = 0;
     int nDescendantsUpdated = 0;
-    addPackageTxs(nPackagesSelected, nDescendantsUpdated, required_age_in_secs);
+    const bool fKeptSelection = UpdateKeptSelection(pindexPrev, required_age_in_secs);
+    if (!fKeptSelection)
+        addPackageTxs(nPackagesSelected, nDescendantsUpdated, required_age_in_secs);
 
     int64_t nTime1 = GetTimeMicros();
 
@@ -161,13 +258,87 @@ std::unique_ptr<CBlockTemplate> BlockAssembler::CreateNewBlock(const CScript& sc
     if (!TestBlockValidity(state, *pblock, pindexPrev, false, false)) {
         throw std::runtime_error(strprintf("%s: TestBlockValidity failed: %s", __func__, FormatStateMessage(state)));
     }
+    KeepSelection(pindexPrev, required_age_in_secs);
     int64_t nTime2 = GetTimeMicros();
 
-    LogPrint(BCLog::BENCH, "CreateNewBlock() packages: %.2fms (%d packages, %d updated descendants), validity: %.2fms (total %.2fms)\n", 0.001 * (nTime1 - nTimeStart), nPackagesSelected, nDescendantsUpdated, 0.001 * (nTime2 - nTime1), 0.001 * (nTime2 - nTimeStart));
+    LogPrint(BCLog::BENCH, "CreateNewBlock() packages: %.2fms (%s, %d packages, %d updated descendants), validity: %.2fms (total %.2fms)\n", 0.001 * (nTime1 - nTimeStart), fKeptSelection ? "kept" : "selected", nPackagesSelected, nDescendantsUpdated, 0.001 * (nTime2 - nTime1), 0.001 * (nTime2 - nTimeStart));
 
     return std::move(pblocktemplate);
 }
 
+bool BlockAssembler::UpdateKeptSelection(const CBlockIndex* pindexPrev, int required_age_in_secs)
+{
+    if (!pkept)
+        return false;
+
+    // The selection is only kept again once this block passed validation.
+    KeptSelection& kept = *pkept;
+    const bool fUsable = kept.fValid && !required_age_in_secs && kept.pindexPrev == pindexPrev &&
+        kept.nHeight == nHeight && kept.nLockTimeCutoff == nLockTimeCutoff &&
+        mempool.GetTransactionsUpdated() == kept.nTransactionsUpdated + kept.nUpdates;
+    std::vector<CTxMemPool::txiter> vEntries;
+    std::vector<CTransactionRef> vAdded;
+    vEntries.swap(kept.vEntries);
+    vAdded.swap(kept.vAdded);
+    kept.Clear();
+    if (!fUsable)
+        return false;
+
+    for (CTxMemPool::txiter it : vEntries)
+        AddToBlock(it);
+
+    for (const CTransactionRef& tx : vAdded) {
+        CTxMemPool::txiter it = mempool.mapTx.find(tx->GetHashMalFix());
+        if (it == mempool.mapTx.end() || inBlock.count(it))
+            continue;
+
+        // Appending the transaction gives the block addPackageTxs would
+        // select only when its parents are in the block already, so that its
+        // package is itself, and when it fits without displacing anything.
+        bool fParentsInBlock = true;
+        for (CTxMemPool::txiter parent : mempool.GetMemPoolParents(it)) {
+            if (!inBlock.count(parent)) {
+                fParentsInBlock = false;
+                break;
+            }
+        }
+        if (!fParentsInBlock || !TestPackage(it->GetTxSize(), it->GetSigOpCost())) {
+            resetBlock();
+            pblock->vtx.resize(1);
+            pblocktemplate->vTxFees.resize(1);
+            pblocktemplate->vTxSigOpsCost.resize(1);
+            return false;
+        }
+
+        if (it->GetModifiedFee() < blockMinFeeRate.GetFee(it->GetTxSize()) ||
+                !TestPackageTransactions(CTxMemPool::setEntries{it})) {
+            continue;
+        }
+        AddToBlock(it);
+    }
+    return true;
+}
+
+void BlockAssembler::KeepSelection(const CBlockIndex* pindexPrev, int required_age_in_secs)
+{
+    // A selection of old enough transactions only is of no use to the next block.
+    if (!pkept || required_age_in_secs)
+        return;
+
+    KeptSelection& kept = *pkept;
+    kept.Clear();
+    kept.vEntries.reserve(pblock->vtx.size() - 1);
+    for (size_t i = 1; i < pblock->vtx.size(); i++)
+        kept.vEntries.push_back(mempool.mapTx.find(pblock->vtx[i]->GetHashMalFix()));
+    kept.setEntries = inBlock;
+    kept.pindexPrev = pindexPrev;
+    kept.nHeight = nHeight;
+    kept.nLockTimeCutoff = nLockTimeCutoff;
+    kept.nTransactionsUpdated = mempool.GetTransactionsUpdated();
+    kept.nUpdates = 0;
+    kept.fValid = true;
+}
+
 void BlockAssembler::onlyUnconfirmed(CTxMemPool::setEntries& testSet)
 {
     for (CTxMemPool::setEntries::iterator iit = testSet.begin(); iit != testSet.end(); ) {
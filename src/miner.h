@@ -159,12 +159,31 @@ public:
     /** Construct a new block template with coinbase to scriptPubKeyIn */
     std::unique_ptr<CBlockTemplate> CreateNewBlock(const CScript& scriptPubKeyIn, bool fMineWitnessTx=true, int required_age_in_secs=0);
 
+    /**
+     * Keep the transactions CreateNewBlock selects for the next call and
+     * update them with the transactions entering and leaving the mempool in
+     * between, instead of selecting them all again. They are selected again
+     * when the tip changes, a selected transaction leaves the mempool, a fee
+     * delta is applied, or a new transaction does not fit on top of its
+     * selected parents. For an assembler kept to create many blocks.
+     */
+    void TrackMempool();
+
 private:
+    struct KeptSelection;
+    // The selection kept for the next block, once TrackMempool was called
+    std::shared_ptr<KeptSelection> pkept;
+
     // utility functions
     /** Clear the block's state and prepare for assembling a new block */
     void resetBlock();
     /** Add a tx to the block */
     void AddToBlock(CTxMemPool::txiter iter);
+    /** Fill the block with the kept selection updated with the mempool
+      * changes since. Returns false if the transactions must be selected again. */
+    bool UpdateKeptSelection(const CBlockIndex* pindexPrev, int required_age_in_secs) EXCLUSIVE_LOCKS_REQUIRED(mempool.cs);
+    /** Keep the transactions of the block for the next one */
+    void KeepSelection(const CBlockIndex* pindexPrev, int required_age_in_secs) EXCLUSIVE_LOCKS_REQUIRED(mempool.cs);
 
     // Methods for how to add transactions to a block.
     /** Add transactions based on feerate including unconfirmed ancestors
@@ -2060,6 +2060,8 @@ void CConnman::ThreadMessageHandler()
                 return;
         }
 
+        m_msgproc->FinishMessageRound();
+
         {
             LOCK(cs_vNodes);
             for (CNode* pnode : vNodesCopy)
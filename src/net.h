@@ -480,6 +480,8 @@ public:
     virtual bool SendMessages(CNode* pnode) = 0;
     virtual void InitializeNode(CNode* pnode) = 0;
     virtual void FinalizeNode(NodeId id, bool& update_connection_time) = 0;
+    /** Called after every node has had a turn at processing its messages, to finish work left for the whole round */
+    virtual void FinishMessageRound() = 0;
 
 protected:
     /**
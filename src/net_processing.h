@@ -60,6 +60,8 @@ public:
     * @return                      True if there is more work to be done
     */
     bool SendMessages(CNode* pto) override EXCLUSIVE_LOCKS_REQUIRED(pto->cs_sendProcessing);
+    /** Process the transactions received in the round as one batch */
+    void FinishMessageRound() override;
 
     /** Consider evicting an outbound peer based on the amount of time they've been behind our tip */
     void ConsiderEviction(CNode *pto, int64_t time_in_seconds);
@@ -14,9 +14,26 @@
 
 uint256 CBlockHeader::GetHash() const
 {
+    if (m_hashes_memoized)
+        return m_hash;
     return SerializeHash(*this);
 }
 
+uint256 CBlockHeader::GetHashForSign() const
+{
+    if (m_hashes_memoized)
+        return m_hash_for_sign;
+    return CBlockHeaderWithoutProof::GetHashForSign();
+}
+
+void CBlockHeader::MemoizeHashes()
+{
+    m_hashes_memoized = false;
+    m_hash = SerializeHash(*this);
+    m_hash_for_sign = CBlockHeaderWithoutProof::GetHashForSign();
+    m_hashes_memoized = true;
+}
+
 std::string CBlockHeader::ToString() const
 {
     std::stringstream s;
@@ -72,6 +89,7 @@ bool CBlockHeader::AbsorbBlockProof(const std::vector<unsigned char>& blockproof
 
     //clear old proof
     proof.clear();
+    m_hashes_memoized = false;
 
     //add signatures to block
     proof = std::move(blockproof);
@@ -12,6 +12,8 @@
 #include <uint256.h>
 #include <key.h>
 
+#include <memory>
+
 enum class TAPYRUS_XFIELDTYPES
 {
     NONE = 0, //no xfield
@@ -82,21 +84,71 @@ public:
 
 class CBlockHeader : public CBlockHeaderWithoutProof
 {
+private:
+    //! GetHash() and GetHashForSign() as kept by MemoizeHashes()
+    uint256 m_hash;
+    uint256 m_hash_for_sign;
+    bool m_hashes_memoized = false;
+
 public:
     static constexpr int32_t TAPYRUS_BLOCK_FEATURES = 1;
     std::vector<unsigned char> proof{CPubKey::SCHNORR_SIGNATURE_SIZE};
 
     CBlockHeader():CBlockHeaderWithoutProof(),proof() {}
 
+    // Copies may be changed, so they do not keep the memoized hashes.
+    CBlockHeader(const CBlockHeader& other) : CBlockHeaderWithoutProof(other), proof(other.proof) {}
+
+    CBlockHeader(CBlockHeader&& other) noexcept : CBlockHeaderWithoutProof(std::move(other)), proof(std::move(other.proof))
+    {
+        other.m_hashes_memoized = false;
+    }
+
+    CBlockHeader& operator=(const CBlockHeader& other)
+    {
+        CBlockHeaderWithoutProof::operator=(other);
+        proof = other.proof;
+        m_hashes_memoized = false;
+        return *this;
+    }
+
+    CBlockHeader& operator=(CBlockHeader&& other) noexcept
+    {
+        CBlockHeaderWithoutProof::operator=(std::move(other));
+        proof = std::move(other.proof);
+        m_hashes_memoized = false;
+        other.m_hashes_memoized = false;
+        return *this;
+    }
+
     ADD_SERIALIZE_METHODS;
 
     template <typename Stream, typename Operation>
     inline void SerializationOp(Stream& s, Operation ser_action) {
+        if (ser_action.ForRead())
+            m_hashes_memoized = false;
         CBlockHeaderWithoutProof::SerializationOp(s, ser_action);
         READWRITE(proof);
     }
 
+    void SetNull()
+    {
+        CBlockHeaderWithoutProof::SetNull();
+        m_hashes_memoized = false;
+    }
+
     uint256 GetHash() const;
+    // Return BlockHash for proof of Signed Blocks
+    uint256 GetHashForSign() const;
+
+    /**
+     * Compute GetHash() and GetHashForSign() once and return them from then on.
+     * Only for headers that are not changed afterwards, such as blocks and
+     * headers received from peers or read from disk before they are shared.
+     * Deserializing, SetNull() and AbsorbBlockProof() drop the memoized hashes.
+     */
+    void MemoizeHashes();
+
     std::string ToString() const;
     bool AbsorbBlockProof(const std::vector<unsigned char>& blockproof, const CPubKey& aggregatePubkey);
 };
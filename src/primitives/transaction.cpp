@@ -87,6 +87,27 @@ uint256 CTransaction::ComputeHashMalFix() const
     return SerializeHash(*this, SER_GETHASH, SERIALIZE_TRANSACTION_MALFIX | SERIALIZE_TRANSACTION_NO_WITNESS);
 }
 
+std::vector<ColorIdentifier> CTransaction::ComputeColorIds() const
+{
+    std::vector<ColorIdentifier> colorIds;
+    for (const auto& tx_out : vout) {
+        if (tx_out.scriptPubKey.IsColoredScript()) {
+            colorIds.reserve(vout.size());
+            for (const auto& out : vout) {
+                colorIds.push_back(GetColorIdFromScript(out.scriptPubKey));
+            }
+            break;
+        }
+    }
+    return colorIds;
+}
+
+const ColorIdentifier& CTransaction::GetColorId(size_t n) const
+{
+    static const ColorIdentifier colorIdTPC;
+    return m_color_ids.empty() ? colorIdTPC : m_color_ids[n];
+}
+
 /* For backward compatibility, the hash is initialized to 0. TODO: remove the need for this default constructor entirely. */
 CTransaction::CTransaction() :
             vin(),
@@ -95,7 +116,8 @@ CTransaction::CTransaction() :
             nLockTime(0),
             hash{},
             m_witness_hash{},
-            hashMalFix{}
+            hashMalFix{},
+            m_color_ids{}
     {}
 
 CTransaction::CTransaction(const CMutableTransaction& tx) :
@@ -105,7 +127,8 @@ CTransaction::CTransaction(const CMutableTransaction& tx) :
             nLockTime(tx.nLockTime),
             hash{ComputeHash()},
             m_witness_hash{ComputeWitnessHash()},
-            hashMalFix{ComputeHashMalFix()}
+            hashMalFix{ComputeHashMalFix()},
+            m_color_ids{ComputeColorIds()}
     {}
 CTransaction::CTransaction(CMutableTransaction&& tx) :
             vin(std::move(tx.vin)),
@@ -114,16 +137,16 @@ CTransaction::CTransaction(CMutableTransaction&& tx) :
             nLockTime(tx.nLockTime),
             hash{ComputeHash()},
             m_witness_hash{ComputeWitnessHash()},
-            hashMalFix{ComputeHashMalFix()}
+            hashMalFix{ComputeHashMalFix()},
+            m_color_ids{ComputeColorIds()}
     {}
 
 CAmount CTransaction::GetValueOut() const
 {
     CAmount nValueOut = 0;
-    for (const auto& tx_out : vout) {
-        ColorIdentifier outColorId(GetColorIdFromScript(tx_out.scriptPubKey));
-
-        if(outColorId.type == TokenTypes::NONE)
+    for (size_t i = 0; i < vout.size(); i++) {
+        const CTxOut& tx_out = vout[i];
+        if(GetColorId(i).type == TokenTypes::NONE)
             nValueOut += tx_out.nValue;
 
         if (!MoneyRange(tx_out.nValue) || !MoneyRange(nValueOut))
@@ -9,6 +9,7 @@
 
 #include <stdint.h>
 #include <amount.h>
+#include <coloridentifier.h>
 #include <script/script.h>
 #include <serialize.h>
 #include <uint256.h>
@@ -243,10 +244,14 @@ private:
     /*Fix transaction malleability hash - created without scriptSig
      used in previous output in spending transaction */
     const uint256 hashMalFix;
+    /* Colors of the outputs, parsed once from their scriptPubKeys.
+     Empty when none of the outputs is colored. */
+    const std::vector<ColorIdentifier> m_color_ids;
 
     uint256 ComputeHash() const;
     uint256 ComputeWitnessHash() const;
     uint256 ComputeHashMalFix() const;
+    std::vector<ColorIdentifier> ComputeColorIds() const;
 
 public:
     /** Construct a CTransaction that qualifies as IsNull() */
@@ -274,6 +279,10 @@ public:
     const uint256& GetWitnessHash() const { return m_witness_hash; };
     const uint256& GetHashMalFix() const { return hashMalFix; }
 
+    // Return the color of output n, TPC for uncolored outputs.
+    const ColorIdentifier& GetColorId(size_t n) const;
+    const std::vector<ColorIdentifier>& GetColorIds() const { return m_color_ids; }
+
     // Return sum of txouts.
     CAmount GetValueOut() const;
     // GetValueIn() is a method on CCoinsViewCache, because
@@ -200,6 +200,67 @@ bool CPubKey::Verify_Schnorr(const uint256 &hash, const std::vector<unsigned cha
     return secp256k1_schnorr_verify(secp256k1_context_verify, &vchSig[0], hash.begin(), &pubkey);
 }
 
+static_assert(sizeof(secp256k1_pubkey) == 64, "CParsedPubKey must be able to hold a secp256k1_pubkey");
+
+CParsedPubKey::CParsedPubKey(const CPubKey& pubkey) : fValid(false) {
+    memset(data, 0, sizeof(data));
+    if (!pubkey.IsValid())
+        return;
+
+    secp256k1_pubkey parsed;
+    if (!secp256k1_ec_pubkey_parse(secp256k1_context_verify, &parsed, pubkey.data(), pubkey.size()))
+        return;
+    memcpy(data, &parsed, sizeof(parsed));
+    fValid = true;
+}
+
+bool CParsedPubKey::Verify_Schnorr(const uint256& hash, const std::vector<unsigned char>& vchSig) const {
+    if (!fValid)
+        return false;
+
+    if (vchSig.size() != CPubKey::SCHNORR_SIGNATURE_SIZE)
+        return false;
+
+    secp256k1_pubkey pubkey;
+    memcpy(&pubkey, data, sizeof(pubkey));
+    return secp256k1_schnorr_verify(secp256k1_context_verify, &vchSig[0], hash.begin(), &pubkey);
+}
+
+bool CSchnorrBatch::Add(const CPubKey& pubkey, const uint256& hash, const std::vector<unsigned char>& vchSig) {
+    if (!pubkey.IsValid())
+        return false;
+
+    if (vchSig.size() != CPubKey::SCHNORR_SIGNATURE_SIZE)
+        return false;
+
+    entries.emplace_back();
+    Entry& entry = entries.back();
+    entry.pubkey = pubkey;
+    entry.hash = hash;
+    memcpy(entry.sig, vchSig.data(), CPubKey::SCHNORR_SIGNATURE_SIZE);
+    return true;
+}
+
+bool CSchnorrBatch::Verify() const {
+    if (entries.empty())
+        return true;
+
+    std::vector<secp256k1_pubkey> pubkeys(entries.size());
+    std::vector<const secp256k1_pubkey*> pubkeyptrs(entries.size());
+    std::vector<const unsigned char*> sigptrs(entries.size());
+    std::vector<const unsigned char*> msgptrs(entries.size());
+    for (size_t i = 0; i < entries.size(); i++) {
+        const Entry& entry = entries[i];
+        if (!secp256k1_ec_pubkey_parse(secp256k1_context_verify, &pubkeys[i], entry.pubkey.data(), entry.pubkey.size()))
+            return false;
+        pubkeyptrs[i] = &pubkeys[i];
+        sigptrs[i] = entry.sig;
+        msgptrs[i] = entry.hash.begin();
+    }
+
+    return secp256k1_schnorr_verify_batch(secp256k1_context_verify, sigptrs.data(), msgptrs.data(), pubkeyptrs.data(), entries.size());
+}
+
 bool CPubKey::RecoverCompact(const uint256 &hash, const std::vector<unsigned char>& vchSig) {
     if (vchSig.size() != COMPACT_SIGNATURE_SIZE)
         return false;
@@ -263,6 +263,60 @@ struct CExtPubKey {
     }
 };
 
+/**
+ * A public key held in libsecp256k1's parsed form. Used for keys that verify
+ * many signatures, such as the federation's aggregate public keys, so that the
+ * serialized key is not decoded again for every verification.
+ */
+class CParsedPubKey
+{
+private:
+    //! Opaque secp256k1_pubkey
+    unsigned char data[64];
+    bool fValid;
+
+public:
+    CParsedPubKey() : fValid(false) {}
+    explicit CParsedPubKey(const CPubKey& pubkey);
+
+    //! Whether the key could be parsed, same as CPubKey::IsFullyValid().
+    bool IsValid() const { return fValid; }
+
+    //! Same as CPubKey::Verify_Schnorr.
+    bool Verify_Schnorr(const uint256& hash, const std::vector<unsigned char>& vchSig) const;
+};
+
+/**
+ * Collects Schnorr signature checks so that they can be verified together with
+ * a single multi-scalar multiplication instead of one at a time.
+ * A failed Verify() does not tell which signature is bad; callers that need
+ * to know have to fall back to CPubKey::Verify_Schnorr.
+ */
+class CSchnorrBatch
+{
+private:
+    struct Entry {
+        CPubKey pubkey;
+        uint256 hash;
+        unsigned char sig[CPubKey::SCHNORR_SIGNATURE_SIZE];
+    };
+    std::vector<Entry> entries;
+
+public:
+    /**
+     * Queue a signature for verification. Returns false if the signature can
+     * be rejected right away, the same way CPubKey::Verify_Schnorr would.
+     */
+    bool Add(const CPubKey& pubkey, const uint256& hash, const std::vector<unsigned char>& vchSig);
+
+    //! Verify all queued signatures. An empty batch is valid.
+    bool Verify() const;
+
+    size_t size() const { return entries.size(); }
+    bool empty() const { return entries.empty(); }
+    void clear() { entries.clear(); }
+};
+
 /** Users of this module must hold an ECCVerifyHandle. The constructor and
  *  destructor of these are not allowed to run in parallel, though. */
 class ECCVerifyHandle
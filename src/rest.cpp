@@ -6,6 +6,8 @@
 #include <chain.h>
 #include <chainparams.h>
 #include <core_io.h>
+#include <federationparams.h>
+#include <index/colorindex.h>
 #include <index/txindex.h>
 #include <primitives/block.h>
 #include <primitives/transaction.h>
@@ -24,6 +26,7 @@
 #include <univalue.h>
 
 static const size_t MAX_GETUTXOS_OUTPOINTS = 15; //allow a max of 15 outpoints to be queried at once
+static const size_t MAX_REST_COLOR_UNSPENTS = 1000; //the unspent outputs of a color listed at most
 
 enum class RetFormat {
     UNDEF,
@@ -208,7 +211,8 @@ static bool rest_block(HTTPRequest* req,
     if (!ParseHashStr(hashStr, hash))
         return RESTERR(req, HTTP_BAD_REQUEST, "Invalid hash: " + hashStr);
 
-    CBlock block;
+    std::shared_ptr<const CBlock> block;
+    CRawBlockData block_data;
     CBlockIndex* pblockindex = nullptr;
     {
         LOCK(cs_main);
@@ -220,23 +224,27 @@ static bool rest_block(HTTPRequest* req,
         if (IsBlockPruned(pblockindex))
             return RESTERR(req, HTTP_NOT_FOUND, hashStr + " not available (pruned data)");
 
-        if (!ReadBlockFromDisk(block, pblockindex))
-            return RESTERR(req, HTTP_NOT_FOUND, hashStr + " not found");
+        // The binary and hex formats are the block as stored on disk, so
+        // there is no need to deserialize it.
+        if (rf == RetFormat::BINARY || rf == RetFormat::HEX) {
+            if (!ReadRawBlockFromDisk(block_data, pblockindex, FederationParams().MessageStart()))
+                return RESTERR(req, HTTP_NOT_FOUND, hashStr + " not found");
+        } else {
+            block = ReadBlockFromDiskCached(pblockindex);
+            if (!block)
+                return RESTERR(req, HTTP_NOT_FOUND, hashStr + " not found");
+        }
     }
 
-    CDataStream ssBlock(SER_NETWORK, PROTOCOL_VERSION | RPCSerializationFlags());
-    ssBlock << block;
-
     switch (rf) {
     case RetFormat::BINARY: {
-        std::string binaryBlock = ssBlock.str();
         req->WriteHeader("Content-Type", "application/octet-stream");
-        req->WriteReply(HTTP_OK, binaryBlock);
+        req->WriteReply(HTTP_OK, block_data.data, std::move(block_data.keep_alive));
         return true;
     }
 
     case RetFormat::HEX: {
-        std::string strHex = HexStr(ssBlock.begin(), ssBlock.end()) + "\n";
+        std::string strHex = HexStr(block_data.data.begin(), block_data.data.end()) + "\n";
         req->WriteHeader("Content-Type", "text/plain");
         req->WriteReply(HTTP_OK, strHex);
         return true;
@@ -246,7 +254,7 @@ static bool rest_block(HTTPRequest* req,
         UniValue objBlock;
         {
             LOCK(cs_main);
-            objBlock = blockToJSON(block, pblockindex, showTxDetails);
+            objBlock = blockToJSON(*block, pblockindex, showTxDetails);
         }
         std::string strJSON = objBlock.write() + "\n";
         req->WriteHeader("Content-Type", "application/json");
@@ -325,9 +333,20 @@ static bool rest_mempool_contents(HTTPRequest* req, const std::string& strURIPar
     std::string param;
     const RetFormat rf = ParseDataFormat(param, strURIPart);
 
+    // /rest/mempool/contents/<COLOR>.json only returns the transactions of a color
+    ColorIdentifier colorId;
+    if (!param.empty()) {
+        const std::string strColor = param.substr(1);
+        if (param[0] != '/' || !IsHex(strColor) || strColor.size() != 2 * COLOR_IDENTIFIER_SIZE)
+            return RESTERR(req, HTTP_BAD_REQUEST, "Invalid color identifier: " + param);
+        colorId = ColorIdentifier(ParseHex(strColor));
+        if (colorId.type == TokenTypes::NONE)
+            return RESTERR(req, HTTP_BAD_REQUEST, "Invalid color identifier: " + param);
+    }
+
     switch (rf) {
     case RetFormat::JSON: {
-        UniValue mempoolObject = mempoolToJSON(true);
+        UniValue mempoolObject = mempoolToJSON(true, colorId);
 
         std::string strJSON = mempoolObject.write() + "\n";
         req->WriteHeader("Content-Type", "application/json");
@@ -393,6 +412,39 @@ static bool rest_tx(HTTPRequest* req, const std::string& strURIPart)
     }
 }
 
+static bool rest_color(HTTPRequest* req, const std::string& strURIPart)
+{
+    if (!CheckWarmup(req))
+        return false;
+    std::string colorStr;
+    const RetFormat rf = ParseDataFormat(colorStr, strURIPart);
+
+    if (!IsHex(colorStr) || colorStr.size() != 2 * COLOR_IDENTIFIER_SIZE)
+        return RESTERR(req, HTTP_BAD_REQUEST, "Invalid color identifier: " + colorStr);
+    const ColorIdentifier colorId(ParseHex(colorStr));
+    if (colorId.type == TokenTypes::NONE)
+        return RESTERR(req, HTTP_BAD_REQUEST, "Invalid color identifier: " + colorStr);
+
+    if (!g_colorindex)
+        return RESTERR(req, HTTP_NOT_FOUND, "Color index is not enabled (use -colorindex)");
+    if (!g_colorindex->BlockUntilSyncedToCurrentChain())
+        return RESTERR(req, HTTP_SERVICE_UNAVAILABLE, "Color index is still syncing");
+
+    switch (rf) {
+    case RetFormat::JSON: {
+        UniValue colorObject = colorInfoToJSON(colorId, true, MAX_REST_COLOR_UNSPENTS);
+
+        std::string strJSON = colorObject.write() + "\n";
+        req->WriteHeader("Content-Type", "application/json");
+        req->WriteReply(HTTP_OK, strJSON);
+        return true;
+    }
+    default: {
+        return RESTERR(req, HTTP_NOT_FOUND, "output format not found (available: json)");
+    }
+    }
+}
+
 static bool rest_getutxos(HTTPRequest* req, const std::string& strURIPart)
 {
     if (!CheckWarmup(req))
@@ -589,6 +641,7 @@ static const struct {
       {"/rest/mempool/contents", rest_mempool_contents},
       {"/rest/headers/", rest_headers},
       {"/rest/getutxos", rest_getutxos},
+      {"/rest/color/", rest_color},
 };
 
 bool StartREST()
@@ -12,9 +12,13 @@
 #include <chainparams.h>
 #include <checkpoints.h>
 #include <coins.h>
+#include <coinstats.h>
 #include <consensus/validation.h>
 #include <validation.h>
 #include <core_io.h>
+#include <federationparams.h>
+#include <index/coinstatsindex.h>
+#include <index/colorindex.h>
 #include <index/txindex.h>
 #include <key_io.h>
 #include <policy/feerate.h>
@@ -22,6 +26,7 @@
 #include <primitives/transaction.h>
 #include <rpc/server.h>
 #include <script/descriptor.h>
+#include <shutdown.h>
 #include <streams.h>
 #include <sync.h>
 #include <txdb.h>
@@ -38,11 +43,13 @@
 #include <univalue.h>
 
 #include <boost/algorithm/string.hpp>
-#include <boost/thread/thread.hpp> // boost::thread::interrupt
 
+#include <algorithm>
+#include <iterator>
 #include <memory>
 #include <mutex>
 #include <condition_variable>
+#include <thread>
 
 struct CUpdatedBlock
 {
@@ -73,8 +80,8 @@ UniValue blockheaderToJSON(const CBlockIndex* blockindex)
     result.pushKV("mediantime", (int64_t)blockindex->GetMedianTimePast());
     result.pushKV("nTx", (uint64_t)blockindex->nTx);
     result.pushKV("xfieldType", (uint8_t)blockindex->xfieldType);
-    if(blockindex->xfield.size())
-        result.pushKV("xfield", HexStr(blockindex->xfield));
+    if(blockindex->GetXField().size())
+        result.pushKV("xfield", HexStr(blockindex->GetXField()));
     result.pushKV("proof", HexStr(blockindex->proof));
 
     if (blockindex->pprev)
@@ -119,8 +126,8 @@ UniValue blockToJSON(const CBlock& block, const CBlockIndex* blockindex, bool tx
     result.pushKV("time", block.GetBlockTime());
     result.pushKV("mediantime", (int64_t)blockindex->GetMedianTimePast());
     result.pushKV("xfieldType", (uint64_t)blockindex->xfieldType);
-    if(blockindex->xfield.size())
-        result.pushKV("xfield", HexStr(blockindex->xfield));
+    if(blockindex->GetXField().size())
+        result.pushKV("xfield", HexStr(blockindex->GetXField()));
     result.pushKV("proof", HexStr(block.GetBlockHeader().proof));
     result.pushKV("nTx", (uint64_t)blockindex->nTx);
 
@@ -390,25 +397,48 @@ static void entryToJSON(UniValue &info, const CTxMemPoolEntry &e) EXCLUSIVE_LOCK
     info.pushKV("spentby", spent);
 }
 
-UniValue mempoolToJSON(bool fVerbose)
+static ColorIdentifier ParseColorIdentifier(const UniValue& param)
+{
+    const std::string& strColor = param.get_str();
+    if (!IsHex(strColor) || strColor.size() != 2 * COLOR_IDENTIFIER_SIZE)
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid color identifier: " + strColor);
+    ColorIdentifier colorId(ParseHex(strColor));
+    if (colorId.type == TokenTypes::NONE)
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid color identifier: " + strColor);
+    return colorId;
+}
+
+UniValue mempoolToJSON(bool fVerbose, const ColorIdentifier& colorId)
 {
     if (fVerbose)
     {
         LOCK(mempool.cs);
         UniValue o(UniValue::VOBJ);
-        for (const CTxMemPoolEntry& e : mempool.mapTx)
-        {
+        auto push = [&](const CTxMemPoolEntry& e) {
             const uint256& hash = e.GetTx().GetHashMalFix();
             UniValue info(UniValue::VOBJ);
             entryToJSON(info, e);
             o.pushKV(hash.ToString(), info);
+        };
+        if (colorId.type == TokenTypes::NONE) {
+            for (const CTxMemPoolEntry& e : mempool.mapTx)
+                push(e);
+        } else {
+            for (CTxMemPool::txiter it : mempool.GetColorEntries(colorId))
+                push(*it);
         }
         return o;
     }
     else
     {
         std::vector<uint256> vtxid;
-        mempool.queryHashes(vtxid);
+        if (colorId.type == TokenTypes::NONE) {
+            mempool.queryHashes(vtxid);
+        } else {
+            LOCK(mempool.cs);
+            for (CTxMemPool::txiter it : mempool.GetColorEntries(colorId))
+                vtxid.push_back(it->GetTx().GetHashMalFix());
+        }
 
         UniValue a(UniValue::VARR);
         for (const uint256& hash : vtxid)
@@ -420,13 +450,14 @@ UniValue mempoolToJSON(bool fVerbose)
 
 static UniValue getrawmempool(const JSONRPCRequest& request)
 {
-    if (request.fHelp || request.params.size() > 1)
+    if (request.fHelp || request.params.size() > 2)
         throw std::runtime_error(
-            "getrawmempool ( verbose )\n"
+            "getrawmempool ( verbose \"color\" )\n"
             "\nReturns all transaction ids in memory pool as a json array of string transaction ids.\n"
             "\nHint: use getmempoolentry to fetch a specific transaction from the mempool.\n"
             "\nArguments:\n"
             "1. verbose (boolean, optional, default=false) True for a json object, false for array of transaction ids\n"
+            "2. color   (string, optional) Only return the transactions that create or spend outputs of this color\n"
             "\nResult: (for verbose = false):\n"
             "[                     (json array of string)\n"
             "  \"transactionid\"     (string) The transaction id\n"
@@ -440,6 +471,7 @@ static UniValue getrawmempool(const JSONRPCRequest& request)
             "}\n"
             "\nExamples:\n"
             + HelpExampleCli("getrawmempool", "true")
+            + HelpExampleCli("getrawmempool", "false \"c1ec2fd806701a3f55808cbec3922c38dafaa3070c48c803e9043ee3642c660b46\"")
             + HelpExampleRpc("getrawmempool", "true")
         );
 
@@ -447,7 +479,11 @@ static UniValue getrawmempool(const JSONRPCRequest& request)
     if (!request.params[0].isNull())
         fVerbose = request.params[0].get_bool();
 
-    return mempoolToJSON(fVerbose);
+    ColorIdentifier colorId;
+    if (!request.params[1].isNull())
+        colorId = ParseColorIdentifier(request.params[1]);
+
+    return mempoolToJSON(fVerbose, colorId);
 }
 
 static UniValue getmempoolancestors(const JSONRPCRequest& request)
@@ -695,14 +731,14 @@ static UniValue getblockheader(const JSONRPCRequest& request)
     return blockheaderToJSON(pblockindex);
 }
 
-static CBlock GetBlockChecked(const CBlockIndex* pblockindex)
+static std::shared_ptr<const CBlock> GetBlockChecked(const CBlockIndex* pblockindex)
 {
-    CBlock block;
     if (IsBlockPruned(pblockindex)) {
         throw JSONRPCError(RPC_MISC_ERROR, "Block not available (pruned data)");
     }
 
-    if (!ReadBlockFromDisk(block, pblockindex)) {
+    std::shared_ptr<const CBlock> block = ReadBlockFromDiskCached(pblockindex);
+    if (!block) {
         // Block not found on disk. This could be because we have the block
         // header in our index but don't have the block (for example if a
         // non-whitelisted node sends us an unrequested long chain of valid
@@ -714,6 +750,21 @@ static CBlock GetBlockChecked(const CBlockIndex* pblockindex)
     return block;
 }
 
+/** Like GetBlockChecked, but returns the block as stored on disk without deserializing it. */
+static CRawBlockData GetRawBlockChecked(const CBlockIndex* pblockindex)
+{
+    CRawBlockData block;
+    if (IsBlockPruned(pblockindex)) {
+        throw JSONRPCError(RPC_MISC_ERROR, "Block not available (pruned data)");
+    }
+
+    if (!ReadRawBlockFromDisk(block, pblockindex, FederationParams().MessageStart())) {
+        throw JSONRPCError(RPC_MISC_ERROR, "Block not found on disk");
+    }
+
+    return block;
+}
+
 // TODO: add proof in result
 static UniValue getblock(const JSONRPCRequest& request)
 {
@@ -783,88 +834,16 @@ static UniValue getblock(const JSONRPCRequest& request)
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
     }
 
-    const CBlock block = GetBlockChecked(pblockindex);
-
     if (verbosity <= 0)
     {
-        CDataStream ssBlock(SER_NETWORK, PROTOCOL_VERSION | RPCSerializationFlags());
-        ssBlock << block;
-        std::string strHex = HexStr(ssBlock.begin(), ssBlock.end());
-        return strHex;
+        // The network serialization of a block is the one on disk.
+        const CRawBlockData block = GetRawBlockChecked(pblockindex);
+        return HexStr(block.data.begin(), block.data.end());
     }
 
-    return blockToJSON(block, pblockindex, verbosity >= 2);
-}
-
-struct CCoinsStats
-{
-    int nHeight;
-    uint256 hashBlock;
-    uint64_t nTransactions;
-    uint64_t nTransactionOutputs;
-    uint64_t nBogoSize;
-    uint256 hashSerialized;
-    uint64_t nDiskSize;
-    CAmount nTotalAmount;
-
-    CCoinsStats() : nHeight(0), nTransactions(0), nTransactionOutputs(0), nBogoSize(0), nDiskSize(0), nTotalAmount(0) {}
-};
-
-static void ApplyStats(CCoinsStats &stats, CHashWriter& ss, const uint256& hash, const std::map<uint32_t, Coin>& outputs)
-{
-    assert(!outputs.empty());
-    ss << hash;
-    ss << VARINT(outputs.begin()->second.nHeight * 2 + outputs.begin()->second.fCoinBase ? 1u : 0u);
-    stats.nTransactions++;
-    for (const auto& output : outputs) {
-        ss << VARINT(output.first + 1);
-        ss << output.second.out.scriptPubKey;
-        ss << VARINT(output.second.out.nValue, VarIntMode::NONNEGATIVE_SIGNED);
-        stats.nTransactionOutputs++;
-        stats.nTotalAmount += output.second.out.nValue;
-        stats.nBogoSize += 32 /* txid */ + 4 /* vout index */ + 4 /* height + coinbase */ + 8 /* amount */ +
-                           2 /* scriptPubKey len */ + output.second.out.scriptPubKey.size() /* scriptPubKey */;
-    }
-    ss << VARINT(0u);
-}
-
-//! Calculate statistics about the unspent transaction output set
-static bool GetUTXOStats(CCoinsView *view, CCoinsStats &stats)
-{
-    std::unique_ptr<CCoinsViewCursor> pcursor(view->Cursor());
-    assert(pcursor);
+    const std::shared_ptr<const CBlock> block = GetBlockChecked(pblockindex);
 
-    CHashWriter ss(SER_GETHASH, PROTOCOL_VERSION);
-    stats.hashBlock = pcursor->GetBestBlock();
-    {
-        LOCK(cs_main);
-        stats.nHeight = LookupBlockIndex(stats.hashBlock)->nHeight;
-    }
-    ss << stats.hashBlock;
-    uint256 prevkey;
-    std::map<uint32_t, Coin> outputs;
-    while (pcursor->Valid()) {
-        boost::this_thread::interruption_point();
-        COutPoint key;
-        Coin coin;
-        if (pcursor->GetKey(key) && pcursor->GetValue(coin)) {
-            if (!outputs.empty() && key.hashMalFix != prevkey) {
-                ApplyStats(stats, ss, prevkey, outputs);
-                outputs.clear();
-            }
-            prevkey = key.hashMalFix;
-            outputs[key.n] = std::move(coin);
-        } else {
-            return error("%s: unable to read value", __func__);
-        }
-        pcursor->Next();
-    }
-    if (!outputs.empty()) {
-        ApplyStats(stats, ss, prevkey, outputs);
-    }
-    stats.hashSerialized = ss.GetHash();
-    stats.nDiskSize = view->EstimateSize();
-    return true;
+    return blockToJSON(*block, pblockindex, verbosity >= 2);
 }
 
 static UniValue pruneblockchain(const JSONRPCRequest& request)
@@ -918,11 +897,15 @@ static UniValue pruneblockchain(const JSONRPCRequest& request)
 
 static UniValue gettxoutsetinfo(const JSONRPCRequest& request)
 {
-    if (request.fHelp || request.params.size() != 0)
+    if (request.fHelp || request.params.size() > 1)
         throw std::runtime_error(
-            "gettxoutsetinfo\n"
+            "gettxoutsetinfo ( use_index )\n"
             "\nReturns statistics about the unspent transaction output set.\n"
-            "Note this call may take some time.\n"
+            "Note this call may take some time, unless -coinstatsindex is enabled.\n"
+            "\nArguments:\n"
+            "1. use_index      (boolean, optional, default=true) Use -coinstatsindex if it is enabled. The index\n"
+            "                  does not maintain \"transactions\" and \"hash_serialized_2\", which are only returned\n"
+            "                  when the UTXO set is scanned.\n"
             "\nResult:\n"
             "{\n"
             "  \"height\":n,     (numeric) The current block height (index)\n"
@@ -932,29 +915,59 @@ static UniValue gettxoutsetinfo(const JSONRPCRequest& request)
             "  \"bogosize\": n,          (numeric) A meaningless metric for UTXO set size\n"
             "  \"hash_serialized_2\": \"hash\", (string) The serialized hash\n"
             "  \"disk_size\": n,         (numeric) The estimated size of the chainstate on disk\n"
-            "  \"total_amount\": x.xxx          (numeric) The total amount\n"
+            "  \"total_amount\": x.xxx,         (numeric) The total amount\n"
+            "  \"colors\": [           (array) The colored outputs, by color\n"
+            "    {\n"
+            "      \"color\" : \"hex\",  (string) The color identifier\n"
+            "      \"amount\" : n,     (numeric) The amount of tokens of the color\n"
+            "      \"txouts\" : n      (numeric) The number of unspent outputs of the color\n"
+            "    }\n"
+            "    ,...\n"
+            "  ]\n"
             "}\n"
             "\nExamples:\n"
             + HelpExampleCli("gettxoutsetinfo", "")
             + HelpExampleRpc("gettxoutsetinfo", "")
         );
 
+    const bool fFromIndex = g_coinstatsindex && (request.params[0].isNull() || request.params[0].get_bool());
+
     UniValue ret(UniValue::VOBJ);
 
     CCoinsStats stats;
-    FlushStateToDisk();
-    if (GetUTXOStats(pcoinsdbview.get(), stats)) {
-        ret.pushKV("height", (int64_t)stats.nHeight);
-        ret.pushKV("bestblock", stats.hashBlock.GetHex());
-        ret.pushKV("transactions", (int64_t)stats.nTransactions);
-        ret.pushKV("txouts", (int64_t)stats.nTransactionOutputs);
-        ret.pushKV("bogosize", (int64_t)stats.nBogoSize);
-        ret.pushKV("hash_serialized_2", stats.hashSerialized.GetHex());
-        ret.pushKV("disk_size", stats.nDiskSize);
-        ret.pushKV("total_amount", ValueFromAmount(stats.nTotalAmount));
+    if (fFromIndex) {
+        if (!g_coinstatsindex->BlockUntilSyncedToCurrentChain())
+            throw JSONRPCError(RPC_MISC_ERROR, "Coin stats index is still syncing. Try again later or set use_index to false");
+        if (!g_coinstatsindex->LookupStats(stats))
+            throw JSONRPCError(RPC_DATABASE_ERROR, "Unable to read coin stats index");
+        stats.nDiskSize = pcoinsdbview->EstimateSize();
     } else {
-        throw JSONRPCError(RPC_INTERNAL_ERROR, "Unable to read UTXO set");
+        FlushStateToDisk();
+        // Scan with as many threads as script verification uses.
+        if (!GetUTXOStats(pcoinsdbview.get(), stats, nScriptCheckThreads + 1))
+            throw JSONRPCError(RPC_INTERNAL_ERROR, "Unable to read UTXO set");
     }
+
+    ret.pushKV("height", (int64_t)stats.nHeight);
+    ret.pushKV("bestblock", stats.hashBlock.GetHex());
+    if (!fFromIndex)
+        ret.pushKV("transactions", (int64_t)stats.nTransactions);
+    ret.pushKV("txouts", (int64_t)stats.nTransactionOutputs);
+    ret.pushKV("bogosize", (int64_t)stats.nBogoSize);
+    if (!fFromIndex)
+        ret.pushKV("hash_serialized_2", stats.hashSerialized.GetHex());
+    ret.pushKV("disk_size", stats.nDiskSize);
+    ret.pushKV("total_amount", ValueFromAmount(stats.nTotalAmount));
+    UniValue colors(UniValue::VARR);
+    for (const auto& entry : stats.mapColorStats) {
+        UniValue color(UniValue::VOBJ);
+        const std::vector<unsigned char> vchColorId = entry.first.toVector();
+        color.pushKV("color", HexStr(vchColorId.begin(), vchColorId.end()));
+        color.pushKV("amount", entry.second.nAmount);
+        color.pushKV("txouts", entry.second.nTransactionOutputs);
+        colors.push_back(color);
+    }
+    ret.pushKV("colors", colors);
     return ret;
 }
 
@@ -1037,6 +1050,108 @@ UniValue gettxout(const JSONRPCRequest& request)
     return ret;
 }
 
+UniValue colorInfoToJSON(const ColorIdentifier& colorId, bool fIncludeUtxos, size_t max_count)
+{
+    ColorStats stats;
+    g_colorindex->GetColorStats(colorId, stats);
+
+    UniValue ret(UniValue::VOBJ);
+    const std::vector<unsigned char> vchColorId = colorId.toVector();
+    ret.pushKV("color", HexStr(vchColorId.begin(), vchColorId.end()));
+    ret.pushKV("supply", stats.nSupply);
+    ret.pushKV("utxos", stats.nUtxos);
+    if (fIncludeUtxos) {
+        std::vector<std::pair<COutPoint, ColorUtxo>> utxos;
+        if (!g_colorindex->GetColorUtxos(colorId, utxos, max_count))
+            throw JSONRPCError(RPC_DATABASE_ERROR, "Unable to read color index");
+        UniValue outputs(UniValue::VARR);
+        for (const auto& entry : utxos) {
+            UniValue output(UniValue::VOBJ);
+            output.pushKV("txid", entry.first.hashMalFix.GetHex());
+            output.pushKV("vout", (int64_t)entry.first.n);
+            output.pushKV("amount", entry.second.nValue);
+            output.pushKV("height", (int64_t)entry.second.nHeight);
+            outputs.push_back(output);
+        }
+        ret.pushKV("unspents", outputs);
+    }
+    return ret;
+}
+
+static void EnsureColorIndex()
+{
+    if (!g_colorindex)
+        throw JSONRPCError(RPC_MISC_ERROR, "Color index is not enabled. Use -colorindex to enable it");
+    if (!g_colorindex->BlockUntilSyncedToCurrentChain())
+        throw JSONRPCError(RPC_MISC_ERROR, "Color index is still syncing. Try again later");
+}
+
+static UniValue getcolorinfo(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() != 1)
+        throw std::runtime_error(
+            "getcolorinfo \"color\"\n"
+            "\nReturns the supply and the number of unspent outputs of a token color.\n"
+            "Requires -colorindex.\n"
+            "\nArguments:\n"
+            "1. \"color\"       (string, required) The color identifier in hex\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"color\" : \"hex\",     (string) The color identifier\n"
+            "  \"supply\" : n,        (numeric) The total amount of tokens of the color in the UTXO set\n"
+            "  \"utxos\" : n          (numeric) The number of unspent outputs of the color\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getcolorinfo", "\"c1ec2fd806701a3f55808cbec3922c38dafaa3070c48c803e9043ee3642c660b46\"")
+            + HelpExampleRpc("getcolorinfo", "\"c1ec2fd806701a3f55808cbec3922c38dafaa3070c48c803e9043ee3642c660b46\"")
+        );
+
+    const ColorIdentifier colorId = ParseColorIdentifier(request.params[0]);
+    EnsureColorIndex();
+    return colorInfoToJSON(colorId);
+}
+
+static UniValue listcolorutxos(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() < 1 || request.params.size() > 2)
+        throw std::runtime_error(
+            "listcolorutxos \"color\" ( count )\n"
+            "\nReturns the supply and the unspent outputs of a token color, ordered by outpoint.\n"
+            "Requires -colorindex.\n"
+            "\nArguments:\n"
+            "1. \"color\"       (string, required) The color identifier in hex\n"
+            "2. count         (numeric, optional, default=0) The maximum number of outputs to return, 0 for all\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"color\" : \"hex\",     (string) The color identifier\n"
+            "  \"supply\" : n,        (numeric) The total amount of tokens of the color in the UTXO set\n"
+            "  \"utxos\" : n,         (numeric) The number of unspent outputs of the color\n"
+            "  \"unspents\" : [\n"
+            "    {\n"
+            "      \"txid\" : \"hash\",  (string) The transaction id\n"
+            "      \"vout\" : n,       (numeric) The output index\n"
+            "      \"amount\" : n,     (numeric) The amount of tokens\n"
+            "      \"height\" : n      (numeric) The height of the block containing the transaction\n"
+            "    }\n"
+            "    ,...\n"
+            "  ]\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("listcolorutxos", "\"c1ec2fd806701a3f55808cbec3922c38dafaa3070c48c803e9043ee3642c660b46\" 100")
+            + HelpExampleRpc("listcolorutxos", "\"c1ec2fd806701a3f55808cbec3922c38dafaa3070c48c803e9043ee3642c660b46\", 100")
+        );
+
+    const ColorIdentifier colorId = ParseColorIdentifier(request.params[0]);
+    int count = 0;
+    if (!request.params[1].isNull()) {
+        count = request.params[1].get_int();
+        if (count < 0)
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "Negative count");
+    }
+    EnsureColorIndex();
+    return colorInfoToJSON(colorId, true, count);
+}
+
 static UniValue verifychain(const JSONRPCRequest& request)
 {
     int nCheckLevel = gArgs.GetArg("-checklevel", DEFAULT_CHECKLEVEL);
@@ -1128,7 +1243,7 @@ UniValue getblockchaininfo(const JSONRPCRequest& request)
     }
     //aggregate pubkey list with block height
     UniValue aggPubkeyList(UniValue::VARR);
-    const std::vector<aggPubkeyAndHeight>& aggregatePubkeyHeightList = FederationParams().GetAggregatePubkeyHeightList();
+    const std::vector<aggPubkeyAndHeight> aggregatePubkeyHeightList = FederationParams().GetAggregatePubkeyHeightList();
     for (auto& aggpubkeyPair : aggregatePubkeyHeightList)
     {
         UniValue aggPubkeyObj(UniValue::VOBJ);
@@ -1358,7 +1473,7 @@ static UniValue invalidateblock(const JSONRPCRequest& request)
             throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
         }
 
-        if((pblockindex->xfieldType == 1 && pblockindex->xfield.size()  == CPubKey::COMPRESSED_PUBLIC_KEY_SIZE) || pblockindex->nHeight <= FederationParams().GetHeightFromAggregatePubkey(FederationParams().GetLatestAggregatePubkey()))
+        if((pblockindex->xfieldType == 1 && pblockindex->GetXField().size()  == CPubKey::COMPRESSED_PUBLIC_KEY_SIZE) || pblockindex->nHeight <= FederationParams().GetHeightFromAggregatePubkey(FederationParams().GetLatestAggregatePubkey()))
             throw JSONRPCError(RPC_INVALID_PARAMETER, "Federation block found");
 
         InvalidateBlock(state, pblockindex);
@@ -1400,7 +1515,7 @@ static UniValue reconsiderblock(const JSONRPCRequest& request)
             throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
         }
 
-        if((pblockindex->xfieldType == 1 && pblockindex->xfield.size()  == CPubKey::COMPRESSED_PUBLIC_KEY_SIZE) || pblockindex->nHeight <= FederationParams().GetHeightFromAggregatePubkey(FederationParams().GetLatestAggregatePubkey()))
+        if((pblockindex->xfieldType == 1 && pblockindex->GetXField().size()  == CPubKey::COMPRESSED_PUBLIC_KEY_SIZE) || pblockindex->nHeight <= FederationParams().GetHeightFromAggregatePubkey(FederationParams().GetLatestAggregatePubkey()))
             throw JSONRPCError(RPC_INVALID_PARAMETER, "Federation block found");
 
         ResetBlockFailureFlags(pblockindex);
@@ -1643,7 +1758,8 @@ static UniValue getblockstats(const JSONRPCRequest& request)
         }
     }
 
-    const CBlock block = GetBlockChecked(pindex);
+    const std::shared_ptr<const CBlock> pblock = GetBlockChecked(pindex);
+    const CBlock& block = *pblock;
 
     const bool do_all = stats.size() == 0; // Calculate everything if nothing selected (default)
     const bool do_mediantxsize = do_all || stats.count("mediantxsize") != 0;
@@ -1834,73 +1950,153 @@ static UniValue savemempool(const JSONRPCRequest& request)
     return NullUniValue;
 }
 
-//! Search for a given set of pubkey scripts
-bool FindScriptPubKey(std::atomic<int>& scan_progress, const std::atomic<bool>& should_abort, int64_t& count, CCoinsViewCursor* cursor, const std::set<CScript>& needles, std::map<COutPoint, Coin>& out_results) {
-    scan_progress = 0;
+/** The outputs a scantxoutset scan looks for. */
+struct ScanNeedles
+{
+    //! Outputs with one of these scriptPubKeys match.
+    std::set<CScript> scripts;
+    //! Every output of one of these colors matches.
+    std::set<ColorIdentifier, ColorIdentifierCompare> colors;
+
+    bool Match(const CScript& scriptPubKey) const
+    {
+        if (scripts.count(scriptPubKey))
+            return true;
+        return !colors.empty() && scriptPubKey.IsColoredScript() && colors.count(GetColorIdFromScript(scriptPubKey));
+    }
+};
+
+/** A scantxoutset scan in progress, which the "status" and "abort" actions refer to by its id. */
+struct CoinsViewScan
+{
+    const std::string id;
+    std::atomic<int> progress{0};
+    std::atomic<bool> should_abort{false};
+    //! Number of matching outputs found so far.
+    std::atomic<int64_t> found{0};
+
+    explicit CoinsViewScan(const std::string& idIn) : id(idIn) {}
+};
+
+//! Search the given key ranges of the UTXO set for the needles, scanning up to nThreads ranges at a time
+bool FindScriptPubKey(CoinsViewScan& scan, int64_t& count, std::vector<std::unique_ptr<CCoinsViewCursor>>& cursors, const ScanNeedles& needles, int nThreads, std::vector<std::pair<COutPoint, Coin>>& out_results) {
+    scan.progress = 0;
     count = 0;
-    while (cursor->Valid()) {
-        COutPoint key;
-        Coin coin;
-        if (!cursor->GetKey(key) || !cursor->GetValue(coin)) return false;
-        if (++count % 8192 == 0) {
-            boost::this_thread::interruption_point();
-            if (should_abort) {
-                // allow to abort the scan via the abort reference
-                return false;
+    // Each range collects its own matches, so that concatenating them keeps the key order.
+    std::vector<std::vector<std::pair<COutPoint, Coin>>> results(cursors.size());
+    std::atomic<size_t> next{0};
+    std::atomic<size_t> done{0};
+    std::atomic<int64_t> searched{0};
+    std::atomic<bool> failed{false};
+
+    auto worker = [&]() {
+        size_t i;
+        while (!failed && (i = next++) < cursors.size()) {
+            CCoinsViewCursor& cursor = *cursors[i];
+            int64_t n = 0;
+            for (; cursor.Valid() && !failed; cursor.Next()) {
+                COutPoint key;
+                Coin coin;
+                if (!cursor.GetKey(key) || !cursor.GetValue(coin)) {
+                    failed = true;
+                    break;
+                }
+                if (++n % 8192 == 0 && (scan.should_abort || ShutdownRequested())) {
+                    // allow to abort the scan via the abort flag
+                    failed = true;
+                    break;
+                }
+                if (needles.Match(coin.out.scriptPubKey)) {
+                    results[i].emplace_back(key, std::move(coin));
+                    scan.found++;
+                }
             }
+            searched += n;
+            cursors[i].reset();
+            scan.progress = (int)(++done * 100 / cursors.size());
         }
-        if (count % 256 == 0) {
-            // update progress reference every 256 item
-            uint32_t high = 0x100 * *key.hashMalFix.begin() + *(key.hashMalFix.begin() + 1);
-            scan_progress = (int)(high * 100.0 / 65536.0 + 0.5);
-        }
-        if (needles.count(coin.out.scriptPubKey)) {
-            out_results.emplace(key, coin);
-        }
-        cursor->Next();
+    };
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < std::min<size_t>(std::max(nThreads, 1), cursors.size()); i++) {
+        threads.emplace_back(worker);
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+
+    count = searched;
+    if (failed) return false;
+    for (auto& range : results) {
+        std::move(range.begin(), range.end(), std::back_inserter(out_results));
     }
-    scan_progress = 100;
+    scan.progress = 100;
     return true;
 }
 
-/** RAII object to prevent concurrency issue when scanning the txout set */
+/** Number of key ranges a scantxoutset scan splits the UTXO set into */
+static const int SCANTXOUTSET_RANGES = 256;
+/** Maximum number of scantxoutset scans running at the same time */
+static const size_t MAX_CONCURRENT_SCANS = 4;
+
+/** RAII object to register a scan while it runs */
 static std::mutex g_utxosetscan;
-static std::atomic<int> g_scan_progress;
-static std::atomic<bool> g_scan_in_progress;
-static std::atomic<bool> g_should_abort_scan;
+static std::vector<std::shared_ptr<CoinsViewScan>> g_scans; // in start order, guarded by g_utxosetscan
+static uint64_t g_scan_sequence = 0; // guarded by g_utxosetscan
 class CoinsViewScanReserver
 {
 private:
-    bool m_could_reserve;
+    std::shared_ptr<CoinsViewScan> m_scan;
 public:
-    explicit CoinsViewScanReserver() : m_could_reserve(false) {}
+    explicit CoinsViewScanReserver() {}
 
-    bool reserve() {
-        assert (!m_could_reserve);
+    /** Register a scan with the given id, or a new one if it is empty. */
+    CoinsViewScan& reserve(std::string id) {
+        assert (!m_scan);
         std::lock_guard<std::mutex> lock(g_utxosetscan);
-        if (g_scan_in_progress) {
-            return false;
+        if (g_scans.size() >= MAX_CONCURRENT_SCANS) {
+            throw JSONRPCError(RPC_MISC_ERROR, strprintf("Too many scans in progress (at most %u), use action \"abort\" or \"status\"", MAX_CONCURRENT_SCANS));
         }
-        g_scan_in_progress = true;
-        m_could_reserve = true;
-        return true;
+        auto in_use = [&](const std::string& id) {
+            return std::any_of(g_scans.begin(), g_scans.end(), [&](const std::shared_ptr<CoinsViewScan>& scan) { return scan->id == id; });
+        };
+        if (id.empty()) {
+            do {
+                id = strprintf("%u", ++g_scan_sequence);
+            } while (in_use(id));
+        } else if (in_use(id)) {
+            throw JSONRPCError(RPC_INVALID_PARAMETER, strprintf("Scan %s already in progress, use action \"abort\" or \"status\"", id));
+        }
+        m_scan = std::make_shared<CoinsViewScan>(id);
+        g_scans.push_back(m_scan);
+        return *m_scan;
     }
 
     ~CoinsViewScanReserver() {
-        if (m_could_reserve) {
+        if (m_scan) {
             std::lock_guard<std::mutex> lock(g_utxosetscan);
-            g_scan_in_progress = false;
+            g_scans.erase(std::find(g_scans.begin(), g_scans.end(), m_scan));
         }
     }
 };
 
+//! The scans in progress with the given id, or all of them if it is empty
+static std::vector<std::shared_ptr<CoinsViewScan>> GetScans(const std::string& id)
+{
+    std::lock_guard<std::mutex> lock(g_utxosetscan);
+    std::vector<std::shared_ptr<CoinsViewScan>> scans;
+    for (const auto& scan : g_scans) {
+        if (id.empty() || scan->id == id) scans.push_back(scan);
+    }
+    return scans;
+}
+
 UniValue scantxoutset(const JSONRPCRequest& request)
 {
-    if (request.fHelp || request.params.size() < 1 || request.params.size() > 2)
+    if (request.fHelp || request.params.size() < 1 || request.params.size() > 3)
         throw std::runtime_error(
-            "scantxoutset <action> ( <scanobjects> )\n"
+            "scantxoutset <action> ( <scanobjects> \"scanid\" )\n"
             "\nEXPERIMENTAL warning: this call may be removed or changed in future releases.\n"
-            "\nScans the unspent transaction output set for entries that match certain output descriptors.\n"
+            "\nScans the unspent transaction output set for entries that match certain output descriptors or colors.\n"
             "Examples of output descriptors are:\n"
             "    addr(<address>)                      Outputs whose scriptPubKey corresponds to the specified address (does not include P2PK)\n"
             "    raw(<hex script>)                    Outputs whose scriptPubKey equals the specified hex scripts\n"
@@ -1912,20 +2108,24 @@ UniValue scantxoutset(const JSONRPCRequest& request)
             "unhardened or hardened child keys.\n"
             "In the latter case, a range needs to be specified by below if different from 1000.\n"
             "For more information on output descriptors, see the documentation in the doc/descriptors.md file.\n"
+            "\nThe set is scanned on several threads, and up to " + std::to_string(MAX_CONCURRENT_SCANS) + " scans may run at the same time.\n"
             "\nArguments:\n"
             "1. \"action\"                       (string, required) The action to execute\n"
             "                                      \"start\" for starting a scan\n"
-            "                                      \"abort\" for aborting the current scan (returns true when abort was successful)\n"
-            "                                      \"status\" for progress report (in %) of the current scan\n"
-            "2. \"scanobjects\"                  (array, required) Array of scan objects\n"
+            "                                      \"abort\" for aborting the scan with the given id, or all scans (returns true when abort was successful)\n"
+            "                                      \"status\" for progress report (in %) of the scan with the given id, or all scans\n"
+            "2. \"scanobjects\"                  (array, required for \"start\") Array of scan objects\n"
             "    [                             Every scan object is either a string descriptor or an object:\n"
             "        \"descriptor\",             (string, optional) An output descriptor\n"
             "        {                         (object, optional) An object with output descriptor and metadata\n"
-            "          \"desc\": \"descriptor\",   (string, required) An output descriptor\n"
+            "          \"desc\": \"descriptor\",   (string, optional) An output descriptor. Required unless a color is given\n"
             "          \"range\": n,             (numeric, optional) Up to what child index HD chains should be explored (default: 1000)\n"
+            "          \"color\": \"color\",       (string, optional) A color identifier. Only outputs of this color match the descriptor,\n"
+            "                                  or every output of this color if no descriptor is given\n"
             "        },\n"
             "        ...\n"
             "    ]\n"
+            "3. \"scanid\"                       (string, optional) The id of the scan to start, query or abort\n"
             "\nResult:\n"
             "{\n"
             "  \"unspents\": [\n"
@@ -1933,51 +2133,72 @@ UniValue scantxoutset(const JSONRPCRequest& request)
             "    \"txid\" : \"transactionid\",     (string) The transaction id\n"
             "    \"vout\": n,                    (numeric) the vout value\n"
             "    \"scriptPubKey\" : \"script\",    (string) the script key\n"
-            "    \"amount\" : x.xxx,             (numeric) The total amount in " + CURRENCY_UNIT + " of the unspent output\n"
+            "    \"color\" : \"color\",            (string) The color identifier of a colored output\n"
+            "    \"amount\" : x.xxx,             (numeric) The total amount in " + CURRENCY_UNIT + " or tokens of the unspent output\n"
             "    \"height\" : n,                 (numeric) Height of the unspent transaction output\n"
             "   }\n"
             "   ,...], \n"
-            " \"total_amount\" : x.xxx,          (numeric) The total amount of all found unspent outputs in " + CURRENCY_UNIT + "\n"
+            " \"total_amount\" : x.xxx,          (numeric) The total amount of all found uncolored unspent outputs in " + CURRENCY_UNIT + "\n"
             "]\n"
         );
 
-    RPCTypeCheck(request.params, {UniValue::VSTR, UniValue::VARR});
+    RPCTypeCheck(request.params, {UniValue::VSTR, UniValue::VARR, UniValue::VSTR}, true);
 
+    const std::string scanid = request.params[2].isNull() ? std::string() : request.params[2].get_str();
     UniValue result(UniValue::VOBJ);
     if (request.params[0].get_str() == "status") {
-        CoinsViewScanReserver reserver;
-        if (reserver.reserve()) {
+        const std::vector<std::shared_ptr<CoinsViewScan>> scans = GetScans(scanid);
+        if (scans.empty()) {
             // no scan in progress
             return NullUniValue;
         }
-        result.pushKV("progress", g_scan_progress);
+        result.pushKV("progress", scans[0]->progress.load());
+        result.pushKV("found", scans[0]->found.load());
+        if (scanid.empty()) {
+            UniValue scans_uni(UniValue::VARR);
+            for (const auto& scan : scans) {
+                UniValue scan_uni(UniValue::VOBJ);
+                scan_uni.pushKV("scanid", scan->id);
+                scan_uni.pushKV("progress", scan->progress.load());
+                scan_uni.pushKV("found", scan->found.load());
+                scans_uni.push_back(scan_uni);
+            }
+            result.pushKV("scans", scans_uni);
+        }
         return result;
     } else if (request.params[0].get_str() == "abort") {
-        CoinsViewScanReserver reserver;
-        if (reserver.reserve()) {
-            // reserve was possible which means no scan was running
+        const std::vector<std::shared_ptr<CoinsViewScan>> scans = GetScans(scanid);
+        if (scans.empty()) {
+            // no scan was running
             return false;
         }
-        // set the abort flag
-        g_should_abort_scan = true;
+        // set the abort flags
+        for (const auto& scan : scans) {
+            scan->should_abort = true;
+        }
         return true;
     } else if (request.params[0].get_str() == "start") {
         CoinsViewScanReserver reserver;
-        if (!reserver.reserve()) {
-            throw JSONRPCError(RPC_INVALID_PARAMETER, "Scan already in progress, use action \"abort\" or \"status\"");
-        }
-        std::set<CScript> needles;
+        CoinsViewScan& scan = reserver.reserve(scanid);
+        ScanNeedles needles;
         CAmount total_in = 0;
 
         // loop through the scan objects
         for (const UniValue& scanobject : request.params[1].get_array().getValues()) {
             std::string desc_str;
             int range = 1000;
+            ColorIdentifier colorId;
             if (scanobject.isStr()) {
                 desc_str = scanobject.get_str();
             } else if (scanobject.isObject()) {
+                UniValue color_uni = find_value(scanobject, "color");
+                if (!color_uni.isNull()) colorId = ParseColorIdentifier(color_uni);
                 UniValue desc_uni = find_value(scanobject, "desc");
-                if (desc_uni.isNull()) throw JSONRPCError(RPC_INVALID_PARAMETER, "Descriptor needs to be provided in scan object");
+                if (desc_uni.isNull()) {
+                    if (color_uni.isNull()) throw JSONRPCError(RPC_INVALID_PARAMETER, "Descriptor or color needs to be provided in scan object");
+                    needles.colors.insert(colorId);
+                    continue;
+                }
                 desc_str = desc_uni.get_str();
                 UniValue range_uni = find_value(scanobject, "range");
                 if (!range_uni.isNull()) {
@@ -1994,30 +2215,29 @@ UniValue scantxoutset(const JSONRPCRequest& request)
                 throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, strprintf("Invalid descriptor '%s'", desc_str));
             }
             if (!desc->IsRange()) range = 0;
+            const CScript colorPrefix = colorId.type == TokenTypes::NONE ? CScript() : CScript() << colorId.toVector() << OP_COLOR;
             for (int i = 0; i <= range; ++i) {
                 std::vector<CScript> scripts;
                 if (!desc->Expand(i, provider, scripts, provider)) {
                     throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, strprintf("Cannot derive script without private keys: '%s'", desc_str));
                 }
-                needles.insert(scripts.begin(), scripts.end());
+                for (const CScript& script : scripts) {
+                    needles.scripts.insert(colorPrefix + script);
+                }
             }
         }
 
         // Scan the unspent transaction output set for inputs
         UniValue unspents(UniValue::VARR);
-        std::vector<CTxOut> input_txos;
-        std::map<COutPoint, Coin> coins;
-        g_should_abort_scan = false;
-        g_scan_progress = 0;
+        std::vector<std::pair<COutPoint, Coin>> coins;
         int64_t count = 0;
-        std::unique_ptr<CCoinsViewCursor> pcursor;
+        std::vector<std::unique_ptr<CCoinsViewCursor>> cursors;
         {
             LOCK(cs_main);
             FlushStateToDisk();
-            pcursor = std::unique_ptr<CCoinsViewCursor>(pcoinsdbview->Cursor());
-            assert(pcursor);
+            cursors = pcoinsdbview->RangeCursors(SCANTXOUTSET_RANGES);
         }
-        bool res = FindScriptPubKey(g_scan_progress, g_should_abort_scan, count, pcursor.get(), needles, coins);
+        bool res = FindScriptPubKey(scan, count, cursors, needles, nScriptCheckThreads + 1, coins);
         result.pushKV("success", res);
         result.pushKV("searched_items", count);
 
@@ -2025,14 +2245,20 @@ UniValue scantxoutset(const JSONRPCRequest& request)
             const COutPoint& outpoint = it.first;
             const Coin& coin = it.second;
             const CTxOut& txo = coin.out;
-            input_txos.push_back(txo);
-            total_in += txo.nValue;
+            const ColorIdentifier colorId = GetColorIdFromScript(txo.scriptPubKey);
 
             UniValue unspent(UniValue::VOBJ);
             unspent.pushKV("txid", outpoint.hashMalFix.GetHex());
             unspent.pushKV("vout", (int32_t)outpoint.n);
             unspent.pushKV("scriptPubKey", HexStr(txo.scriptPubKey.begin(), txo.scriptPubKey.end()));
-            unspent.pushKV("amount", ValueFromAmount(txo.nValue));
+            if (colorId.type != TokenTypes::NONE) {
+                const std::vector<unsigned char> vchColorId = colorId.toVector();
+                unspent.pushKV("color", HexStr(vchColorId.begin(), vchColorId.end()));
+                unspent.pushKV("amount", txo.nValue);
+            } else {
+                total_in += txo.nValue;
+                unspent.pushKV("amount", ValueFromAmount(txo.nValue));
+            }
             unspent.pushKV("height", (int32_t)coin.nHeight);
 
             unspents.push_back(unspent);
@@ -2061,15 +2287,17 @@ static const CRPCCommand commands[] =
     { "blockchain",         "getmempooldescendants",  &getmempooldescendants,  {"txid","verbose"} },
     { "blockchain",         "getmempoolentry",        &getmempoolentry,        {"txid"} },
     { "blockchain",         "getmempoolinfo",         &getmempoolinfo,         {} },
-    { "blockchain",         "getrawmempool",          &getrawmempool,          {"verbose"} },
+    { "blockchain",         "getrawmempool",          &getrawmempool,          {"verbose", "color"} },
     { "blockchain",         "gettxout",               &gettxout,               {"txid","n","include_mempool"} },
-    { "blockchain",         "gettxoutsetinfo",        &gettxoutsetinfo,        {} },
+    { "blockchain",         "gettxoutsetinfo",        &gettxoutsetinfo,        {"use_index"} },
+    { "blockchain",         "getcolorinfo",           &getcolorinfo,           {"color"} },
+    { "blockchain",         "listcolorutxos",         &listcolorutxos,         {"color","count"} },
     { "blockchain",         "pruneblockchain",        &pruneblockchain,        {"height"} },
     { "blockchain",         "savemempool",            &savemempool,            {} },
     { "blockchain",         "verifychain",            &verifychain,            {"checklevel","nblocks"} },
 
     { "blockchain",         "preciousblock",          &preciousblock,          {"blockhash"} },
-    { "blockchain",         "scantxoutset",           &scantxoutset,           {"action", "scanobjects"} },
+    { "blockchain",         "scantxoutset",           &scantxoutset,           {"action", "scanobjects", "scanid"} },
 
     /* Not shown in help */
     { "hidden",             "invalidateblock",        &invalidateblock,        {"blockhash"} },
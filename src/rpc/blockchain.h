@@ -7,8 +7,10 @@
 #define BITCOIN_RPC_BLOCKCHAIN_H
 
 #include <vector>
+#include <stddef.h>
 #include <stdint.h>
 #include <amount.h>
+#include <coloridentifier.h>
 
 class CBlock;
 class CBlockIndex;
@@ -26,11 +28,14 @@ UniValue blockToJSON(const CBlock& block, const CBlockIndex* blockindex, bool tx
 UniValue mempoolInfoToJSON();
 
 /** Mempool to JSON */
-UniValue mempoolToJSON(bool fVerbose = false);
+UniValue mempoolToJSON(bool fVerbose = false, const ColorIdentifier& colorId = ColorIdentifier());
 
 /** Block header to JSON */
 UniValue blockheaderToJSON(const CBlockIndex* blockindex);
 
+/** Color index entry of a color to JSON, optionally with its unspent outputs. Requires -colorindex. */
+UniValue colorInfoToJSON(const ColorIdentifier& colorId, bool fIncludeUtxos = false, size_t max_count = 0);
+
 /** Used by getblockstats to get feerates at different percentiles by weight  */
 void CalculatePercentilesByWeight(CAmount result[NUM_GETBLOCKSTATS_PERCENTILES], std::vector<std::pair<CAmount, int64_t>>& scores, int64_t total_weight);
 
@@ -124,6 +124,8 @@ static const CRPCConvertParam vRPCConvertParams[] =
     { "converttopsbt", 2, "iswitness"},
     { "gettxout", 1, "n" },
     { "gettxout", 2, "include_mempool" },
+    { "listcolorutxos", 1, "count" },
+    { "gettxoutsetinfo", 0, "use_index" },
     { "gettxoutproof", 0, "txids" },
     { "lockunspent", 0, "unlock" },
     { "lockunspent", 1, "transactions" },
@@ -170,6 +172,7 @@ static const CRPCConvertParam vRPCConvertParams[] =
     { "rescanblockchain", 1, "stop_height"},
     { "createwallet", 1, "disable_private_keys"},
     { "testproposedblock", 1, "nonstandard"},
+    { "createblockproposal", 1, "required_age"},
 };
 
 class CRPCConvertTable
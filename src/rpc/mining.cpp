@@ -40,6 +40,24 @@ unsigned int ParseConfirmTarget(const UniValue& value)
     return (unsigned int)target;
 }
 
+/**
+ * Create a block template for the RPCs proposing blocks. They share an
+ * assembler that keeps its selection of transactions up to date with the
+ * mempool between calls, so that most templates do not select them again.
+ */
+static std::unique_ptr<CBlockTemplate> CreateProposalTemplate(const CScript& scriptPubKey)
+{
+    static CCriticalSection cs_assembler;
+    static std::unique_ptr<BlockAssembler> assembler;
+    // cs_main first, as getblocktemplate holds it already.
+    LOCK2(cs_main, cs_assembler);
+    if (!assembler) {
+        assembler = MakeUnique<BlockAssembler>(Params());
+        assembler->TrackMempool();
+    }
+    return assembler->CreateNewBlock(scriptPubKey);
+}
+
 UniValue generateBlocks(std::shared_ptr<CReserveScript> coinbaseScript, int nGenerate, bool keepScript, const CKey& privKey)
 {
     int nHeightEnd = 0;
@@ -125,35 +143,23 @@ static UniValue generatetoaddress(const JSONRPCRequest& request)
     return generateBlocks(coinbaseScript, nGenerate, false, cPrivKey);
 }
 
-UniValue getnewblock(const JSONRPCRequest& request)
+/** Create a new block for the federation to sign, paying to the given address. */
+static std::shared_ptr<CBlock> CreateBlockProposal(const UniValue& address, const UniValue& required_age)
 {
-    if (request.fHelp || request.params.size() > 2)
-        throw std::runtime_error(
-                "getnewblock\n"
-                "\nGets hex representation of a proposed, unmined new block\n"
-                "\nArguments:\n"
-                "1. address         (string, required) The address to send fees and the newly generated coin.\n"
-                "2. required_age    (numeric, optional, default=0) How many seconds a transaction must have been in the mempool to be inluded in the block proposal. This may help with faster block convergence among functionaries using compact blocks.\n"
-                "\nResult\n"
-                "blockhex      (hex) The block hex\n"
-                "\nExamples:\n"
-                + HelpExampleCli("getnewblock", "")
-        );
-
     ColorIdentifier colorId;
-    CTxDestination destination = DecodeDestination(request.params[0].get_str(), colorId);
+    CTxDestination destination = DecodeDestination(address.get_str(), colorId);
     if (!IsValidDestination(destination)) {
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Error: Invalid address");
     }
 
-    int required_wait = !request.params[1].isNull() ? request.params[1].get_int() : 0;
+    int required_wait = !required_age.isNull() ? required_age.get_int() : 0;
     if (required_wait < 0) {
         throw JSONRPCError(RPC_INVALID_PARAMS, "required_wait must be non-negative.");
     }
 
     CScript coinbaseScript {GetScriptForDestination(destination, colorId)};
 
-    std::unique_ptr<CBlockTemplate> pblocktemplate(BlockAssembler(Params()).CreateNewBlock(coinbaseScript, true));
+    std::unique_ptr<CBlockTemplate> pblocktemplate(CreateProposalTemplate(coinbaseScript));
     if (!pblocktemplate.get())
         throw JSONRPCError(RPC_INTERNAL_ERROR, "Wallet keypool empty");
     {
@@ -163,8 +169,28 @@ UniValue getnewblock(const JSONRPCRequest& request)
         IncrementExtraNonce(&pblocktemplate->block, chainActive.Tip(), nExtraNonce);
     }
 
+    return std::make_shared<CBlock>(std::move(pblocktemplate->block));
+}
+
+UniValue getnewblock(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() > 2)
+        throw std::runtime_error(
+                "getnewblock\n"
+                "\nGets hex representation of a proposed, unmined new block\n"
+                "\nArguments:\n"
+                "1. address         (string, required) The address to send fees and the newly generated coin.\n"
+                "2. required_age    (numeric, optional, default=0) How many seconds a transaction must have been in the mempool to be inluded in the block proposal. This may help with faster block convergence among functionaries using compact blocks.\n"
+                "\nResult\n"
+                "blockhex      (hex) The block hex\n"
+                "\nExamples:\n"
+                + HelpExampleCli("getnewblock", "")
+        );
+
+    std::shared_ptr<CBlock> pblock = CreateBlockProposal(request.params[0], request.params[1]);
+
     CDataStream ssBlock(SER_NETWORK, PROTOCOL_VERSION);
-    ssBlock << pblocktemplate->block;
+    ssBlock << *pblock;
     return HexStr(ssBlock.begin(), ssBlock.end());
 }
 
@@ -486,7 +512,7 @@ static UniValue getblocktemplate(const JSONRPCRequest& request)
 
         // Create new block
         CScript scriptDummy = CScript() << OP_TRUE;
-        pblocktemplate = BlockAssembler(Params()).CreateNewBlock(scriptDummy, fSupportsSegwit);
+        pblocktemplate = CreateProposalTemplate(scriptDummy);
         if (!pblocktemplate)
             throw JSONRPCError(RPC_OUT_OF_MEMORY, "Out of memory");
 
@@ -598,35 +624,10 @@ protected:
     }
 };
 
-static UniValue submitblock(const JSONRPCRequest& request)
+/** Process a block submitted over RPC and return the result as defined in BIP22. */
+static UniValue ProcessSubmittedBlock(const std::shared_ptr<CBlock>& blockptr)
 {
-    // We allow 2 arguments for compliance with BIP22. Argument 2 is ignored.
-    if (request.fHelp || request.params.size() < 1 || request.params.size() > 2) {
-        throw std::runtime_error(
-            "submitblock \"hexdata\"  ( \"dummy\" )\n"
-            "\nAttempts to submit new block to network.\n"
-            "See https://en.bitcoin.it/wiki/BIP_0022 for full specification.\n"
-
-            "\nArguments\n"
-            "1. \"hexdata\"        (string, required) the hex-encoded block data to submit\n"
-            "2. \"dummy\"          (optional) dummy value, for compatibility with BIP22. This value is ignored.\n"
-            "\nResult:\n"
-            "\nExamples:\n"
-            + HelpExampleCli("submitblock", "\"mydata\"")
-            + HelpExampleRpc("submitblock", "\"mydata\"")
-        );
-    }
-
-    std::shared_ptr<CBlock> blockptr = std::make_shared<CBlock>();
     CBlock& block = *blockptr;
-    if (!DecodeHexBlk(block, request.params[0].get_str())) {
-        throw JSONRPCError(RPC_DESERIALIZATION_ERROR, "Block decode failed");
-    }
-
-    if (block.vtx.empty() || !block.vtx[0]->IsCoinBase()) {
-        throw JSONRPCError(RPC_DESERIALIZATION_ERROR, "Block does not start with a coinbase");
-    }
-
     uint256 hash = block.GetHash();
     {
         LOCK(cs_main);
@@ -667,6 +668,38 @@ static UniValue submitblock(const JSONRPCRequest& request)
     return BIP22ValidationResult(sc.state);
 }
 
+static UniValue submitblock(const JSONRPCRequest& request)
+{
+    // We allow 2 arguments for compliance with BIP22. Argument 2 is ignored.
+    if (request.fHelp || request.params.size() < 1 || request.params.size() > 2) {
+        throw std::runtime_error(
+            "submitblock \"hexdata\"  ( \"dummy\" )\n"
+            "\nAttempts to submit new block to network.\n"
+            "See https://en.bitcoin.it/wiki/BIP_0022 for full specification.\n"
+
+            "\nArguments\n"
+            "1. \"hexdata\"        (string, required) the hex-encoded block data to submit\n"
+            "2. \"dummy\"          (optional) dummy value, for compatibility with BIP22. This value is ignored.\n"
+            "\nResult:\n"
+            "\nExamples:\n"
+            + HelpExampleCli("submitblock", "\"mydata\"")
+            + HelpExampleRpc("submitblock", "\"mydata\"")
+        );
+    }
+
+    std::shared_ptr<CBlock> blockptr = std::make_shared<CBlock>();
+    CBlock& block = *blockptr;
+    if (!DecodeHexBlk(block, request.params[0].get_str())) {
+        throw JSONRPCError(RPC_DESERIALIZATION_ERROR, "Block decode failed");
+    }
+
+    if (block.vtx.empty() || !block.vtx[0]->IsCoinBase()) {
+        throw JSONRPCError(RPC_DESERIALIZATION_ERROR, "Block does not start with a coinbase");
+    }
+
+    return ProcessSubmittedBlock(blockptr);
+}
+
 static UniValue estimatefee(const JSONRPCRequest& request)
 {
     throw JSONRPCError(RPC_METHOD_DEPRECATED, "estimatefee was removed in v0.17.\n"
@@ -836,6 +869,24 @@ static UniValue estimaterawfee(const JSONRPCRequest& request)
     return result;
 }
 
+/** Parse a hex-encoded block proof, throwing on a malformed signature. */
+static std::vector<unsigned char> ParseBlockProof(const UniValue& param)
+{
+    const std::string signature(param.get_str());
+    if(!signature.size())
+        throw JSONRPCError(RPC_INVALID_PARAMS, "Signature was empty");
+
+    if (!IsHex(signature))
+        throw JSONRPCError(RPC_INVALID_PARAMS, "Invalid signature");
+
+    std::vector<unsigned char> blockProof(ParseHex(signature));
+
+    if(blockProof.size() != CPubKey::SCHNORR_SIGNATURE_SIZE || !CheckSchnorrSignatureEncoding(blockProof, nullptr, true) )
+        throw JSONRPCError(RPC_INVALID_PARAMS, "Invalid signature encoding");
+
+    return blockProof;
+}
+
 UniValue combineblocksigs(const JSONRPCRequest& request)
 {
     if (request.fHelp || request.params.size() != 2)
@@ -859,19 +910,11 @@ UniValue combineblocksigs(const JSONRPCRequest& request)
     if (!DecodeHexBlk(block, request.params[0].get_str()))
         throw JSONRPCError(RPC_DESERIALIZATION_ERROR, "Block decode failed");
 
-    const std::string signature(request.params[1].get_str());
-    if(!signature.size())
-        throw JSONRPCError(RPC_INVALID_PARAMS, "Signature was empty");
-
-    if (!IsHex(signature))
-        throw JSONRPCError(RPC_INVALID_PARAMS, "Invalid signature");
-
-    const std::vector<unsigned char> blockProof(ParseHex(signature));
-
-    if(blockProof.size() != CPubKey::SCHNORR_SIGNATURE_SIZE || !CheckSchnorrSignatureEncoding(blockProof, nullptr, true) )
-        throw JSONRPCError(RPC_INVALID_PARAMS, "Invalid signature encoding");
+    const std::vector<unsigned char> blockProof(ParseBlockProof(request.params[1]));
 
-    bool status = block.AbsorbBlockProof(blockProof, FederationParams().GetLatestAggregatePubkey());
+    bool status = CheckBlockProof(block.GetHashForSign(), blockProof, FederationParams().GetLatestAggregatePubkey());
+    if (status)
+        block.proof = blockProof;
 
     UniValue result(UniValue::VOBJ);
     CDataStream ssBlock(SER_NETWORK, PROTOCOL_VERSION);
@@ -883,24 +926,9 @@ UniValue combineblocksigs(const JSONRPCRequest& request)
     return result;
 }
 
-UniValue testproposedblock(const JSONRPCRequest& request)
+/** Validate a block proposal on top of the current tip, throwing if it is not acceptable. */
+static void TestProposedBlock(const CBlock& block)
 {
-    if (request.fHelp || request.params.size() != 1 )
-        throw std::runtime_error(
-            "testproposedblock \"blockhex\"\n"
-            "\nValidate proposed block before signing\n"
-            "\nArguments:\n"
-            "1. \"blockhex\"       (string, required) The hex-encoded block from getnewblockhex\n"
-            "\nResult\n"
-            "\"valid\"              (bool) true when the block is valid, JSON exception on failure\n"
-            "\nExamples:\n"
-            + HelpExampleCli("testproposedblock", "\"blockhex\"")
-        );
-
-    CBlock block;
-    if (!DecodeHexBlk(block, request.params[0].get_str()))
-        throw JSONRPCError(RPC_DESERIALIZATION_ERROR, "Block decode failed");
-
     LOCK(cs_main);
 
     //test block validity
@@ -938,8 +966,197 @@ UniValue testproposedblock(const JSONRPCRequest& request)
             throw JSONRPCError(RPC_VERIFY_ERROR, "Block proposal included a non-standard transaction: " + reason);
         }
     }
-    return valid ? true : false;
 }
+
+UniValue testproposedblock(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() != 1 )
+        throw std::runtime_error(
+            "testproposedblock \"blockhex\"\n"
+            "\nValidate proposed block before signing\n"
+            "\nArguments:\n"
+            "1. \"blockhex\"       (string, required) The hex-encoded block from getnewblockhex\n"
+            "\nResult\n"
+            "\"valid\"              (bool) true when the block is valid, JSON exception on failure\n"
+            "\nExamples:\n"
+            + HelpExampleCli("testproposedblock", "\"blockhex\"")
+        );
+
+    CBlock block;
+    if (!DecodeHexBlk(block, request.params[0].get_str()))
+        throw JSONRPCError(RPC_DESERIALIZATION_ERROR, "Block decode failed");
+
+    TestProposedBlock(block);
+    return true;
+}
+
+/**
+ * Block proposals held for the federation signers, keyed by the hash they sign
+ * (CBlockHeader::GetHashForSign). A proposal is decoded and validated once when
+ * it is created or loaded; the signature is then absorbed into the stored block
+ * and the block is submitted without going through its hex encoding again.
+ */
+static CCriticalSection cs_blockproposals;
+static std::map<uint256, std::shared_ptr<CBlock>> mapBlockProposals GUARDED_BY(cs_blockproposals);
+
+//! Maximum number of block proposals kept at a time
+static const size_t MAX_BLOCK_PROPOSALS = 16;
+
+/** Store a validated proposal, dropping the ones not built on the current tip. */
+static uint256 AddBlockProposal(const std::shared_ptr<CBlock>& pblock)
+{
+    uint256 hashTip;
+    {
+        LOCK(cs_main);
+        hashTip = chainActive.Tip()->GetBlockHash();
+    }
+
+    const uint256 hash = pblock->GetHashForSign();
+    LOCK(cs_blockproposals);
+    for (auto it = mapBlockProposals.begin(); it != mapBlockProposals.end(); ) {
+        if (it->second->hashPrevBlock != hashTip)
+            it = mapBlockProposals.erase(it);
+        else
+            ++it;
+    }
+    if (mapBlockProposals.size() >= MAX_BLOCK_PROPOSALS && !mapBlockProposals.count(hash))
+        throw JSONRPCError(RPC_MISC_ERROR, strprintf("Too many block proposals, at most %u are kept", MAX_BLOCK_PROPOSALS));
+    mapBlockProposals[hash] = pblock;
+    return hash;
+}
+
+static UniValue BlockProposalToJSON(const uint256& hash, const CBlock& block)
+{
+    CDataStream ssBlock(SER_NETWORK, PROTOCOL_VERSION);
+    ssBlock << block;
+
+    UniValue result(UniValue::VOBJ);
+    result.pushKV("hash", hash.GetHex());
+    result.pushKV("hex", HexStr(ssBlock.begin(), ssBlock.end()));
+    return result;
+}
+
+static UniValue createblockproposal(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() < 1 || request.params.size() > 2)
+        throw std::runtime_error(
+            "createblockproposal \"address\" ( required_age )\n"
+            "\nCreates a new block and keeps it as a proposal to be signed by the federation.\n"
+            "The proposal can then be signed with signblockproposal and submitted with submitblockproposal.\n"
+            "\nArguments:\n"
+            "1. \"address\"       (string, required) The address to send fees and the newly generated coin.\n"
+            "2. required_age    (numeric, optional, default=0) How many seconds a transaction must have been in the mempool to be inluded in the block proposal.\n"
+            "\nResult\n"
+            "{\n"
+            "  \"hash\": \"value\",       (string) The hash of the block to be signed, identifying the proposal\n"
+            "  \"hex\": \"value\"         (string) The hex-encoded block, to be sent to the other signers\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("createblockproposal", "\"address\"")
+            + HelpExampleRpc("createblockproposal", "\"address\"")
+        );
+
+    std::shared_ptr<CBlock> pblock = CreateBlockProposal(request.params[0], request.params[1]);
+    return BlockProposalToJSON(AddBlockProposal(pblock), *pblock);
+}
+
+static UniValue loadblockproposal(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() != 1)
+        throw std::runtime_error(
+            "loadblockproposal \"blockhex\"\n"
+            "\nValidates a block proposed by another signer, like testproposedblock, and keeps it\n"
+            "to be signed with signblockproposal and submitted with submitblockproposal.\n"
+            "\nArguments:\n"
+            "1. \"blockhex\"      (string, required) The hex-encoded block proposal\n"
+            "\nResult\n"
+            "\"hash\"             (string) The hash of the block to be signed, identifying the proposal\n"
+            "\nExamples:\n"
+            + HelpExampleCli("loadblockproposal", "\"blockhex\"")
+            + HelpExampleRpc("loadblockproposal", "\"blockhex\"")
+        );
+
+    std::shared_ptr<CBlock> pblock = std::make_shared<CBlock>();
+    if (!DecodeHexBlk(*pblock, request.params[0].get_str()))
+        throw JSONRPCError(RPC_DESERIALIZATION_ERROR, "Block decode failed");
+
+    if (pblock->vtx.empty() || !pblock->vtx[0]->IsCoinBase())
+        throw JSONRPCError(RPC_DESERIALIZATION_ERROR, "Block does not start with a coinbase");
+
+    TestProposedBlock(*pblock);
+    return AddBlockProposal(pblock).GetHex();
+}
+
+static UniValue signblockproposal(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() != 2)
+        throw std::runtime_error(
+            "signblockproposal \"hash\" \"signature\"\n"
+            "\nAdds the federation signature to a block proposal\n"
+            "\nArguments:\n"
+            "1. \"hash\"          (string, required) The hash of the proposal from createblockproposal or loadblockproposal\n"
+            "2. \"signature\"     (string, required) A block signature from aggregate pubkey (in the form of a hex-encoded scriptSig)\n"
+            "\nResult\n"
+            "{\n"
+            "  \"complete\": n           (boolean) if the block signature is valid and the proposal can be submitted\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("signblockproposal", "\"hash\" \"signature\"")
+            + HelpExampleRpc("signblockproposal", "\"hash\", \"signature\"")
+        );
+
+    const uint256 hash = ParseHashV(request.params[0], "hash");
+    const std::vector<unsigned char> blockProof(ParseBlockProof(request.params[1]));
+    const CPubKey aggregatePubkey = FederationParams().GetLatestAggregatePubkey();
+
+    bool status;
+    {
+        LOCK(cs_blockproposals);
+        auto it = mapBlockProposals.find(hash);
+        if (it == mapBlockProposals.end())
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "Block proposal not found");
+        status = CheckBlockProof(it->second->GetHashForSign(), blockProof, aggregatePubkey);
+        if (status)
+            it->second->proof = blockProof;
+    }
+
+    UniValue result(UniValue::VOBJ);
+    result.pushKV("complete", status);
+    return result;
+}
+
+static UniValue submitblockproposal(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() != 1)
+        throw std::runtime_error(
+            "submitblockproposal \"hash\"\n"
+            "\nSubmits a signed block proposal to the network and forgets it.\n"
+            "\nArguments:\n"
+            "1. \"hash\"          (string, required) The hash of the proposal from createblockproposal or loadblockproposal\n"
+            "\nResult:\n"
+            "null or a string describing why the block was rejected, as submitblock\n"
+            "\nExamples:\n"
+            + HelpExampleCli("submitblockproposal", "\"hash\"")
+            + HelpExampleRpc("submitblockproposal", "\"hash\"")
+        );
+
+    const uint256 hash = ParseHashV(request.params[0], "hash");
+
+    std::shared_ptr<CBlock> pblock;
+    {
+        LOCK(cs_blockproposals);
+        auto it = mapBlockProposals.find(hash);
+        if (it == mapBlockProposals.end())
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "Block proposal not found");
+        if (it->second->proof.empty())
+            throw JSONRPCError(RPC_VERIFY_ERROR, "Block proposal is not signed");
+        pblock = it->second;
+        mapBlockProposals.erase(it);
+    }
+
+    return ProcessSubmittedBlock(pblock);
+}
+
 static const CRPCCommand commands[] =
 { //  category              name                      actor (function)         argNames
   //  --------------------- ------------------------  -----------------------  ----------
@@ -958,6 +1175,10 @@ static const CRPCCommand commands[] =
     { "hidden",             "estimaterawfee",         &estimaterawfee,         {"conf_target", "threshold"} },
     { "mining",             "combineblocksigs",       &combineblocksigs,       {"block_hex", "signature_list"} },
     { "mining",             "testproposedblock",      &testproposedblock,       {"block_hex", "nonstandard"} },
+    { "mining",             "createblockproposal",    &createblockproposal,    {"address", "required_age"} },
+    { "mining",             "loadblockproposal",      &loadblockproposal,      {"block_hex"} },
+    { "mining",             "signblockproposal",      &signblockproposal,      {"hash", "signature"} },
+    { "mining",             "submitblockproposal",    &submitblockproposal,    {"hash"} },
 };
 
 void RegisterMiningRPCCommands(CRPCTable &t)
@@ -3,6 +3,7 @@
 // Distributed under the MIT software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#include <blockcache.h>
 #include <chain.h>
 #include <clientversion.h>
 #include <core_io.h>
@@ -294,6 +295,27 @@ static UniValue RPCLockedMemoryInfo()
     return obj;
 }
 
+static UniValue RPCBlockCacheInfo()
+{
+    CBlockCache::Stats stats = g_block_cache.GetStats();
+    UniValue obj(UniValue::VOBJ);
+    obj.pushKV("usage", uint64_t(stats.usage));
+    obj.pushKV("max", uint64_t(stats.max_usage));
+    obj.pushKV("blocks", uint64_t(stats.entries));
+    obj.pushKV("hits", stats.hits);
+    obj.pushKV("misses", stats.misses);
+    return obj;
+}
+
+static UniValue RPCBlockIndexInfo()
+{
+    LOCK(cs_main);
+    UniValue obj(UniValue::VOBJ);
+    obj.pushKV("usage", uint64_t(BlockIndexDynamicMemoryUsage()));
+    obj.pushKV("entries", uint64_t(mapBlockIndex.size()));
+    return obj;
+}
+
 #ifdef HAVE_MALLOC_INFO
 static std::string RPCMallocInfo()
 {
@@ -335,6 +357,17 @@ static UniValue getmemoryinfo(const JSONRPCRequest& request)
             "    \"locked\": xxxxxx,       (numeric) Amount of bytes that succeeded locking. If this number is smaller than total, locking pages failed at some point and key data could be swapped to disk.\n"
             "    \"chunks_used\": xxxxx,   (numeric) Number allocated chunks\n"
             "    \"chunks_free\": xxxxx,   (numeric) Number unused chunks\n"
+            "  },\n"
+            "  \"blockcache\": {           (json object) Information about the cache of recently used blocks\n"
+            "    \"usage\": xxxxx,         (numeric) Number of bytes used\n"
+            "    \"max\": xxxxx,           (numeric) Maximum number of bytes used (-maxblockcachesize)\n"
+            "    \"blocks\": xxxxx,        (numeric) Number of cached blocks\n"
+            "    \"hits\": xxxxx,          (numeric) Number of lookups that found the block in the cache\n"
+            "    \"misses\": xxxxx,        (numeric) Number of lookups that had to read the block from disk\n"
+            "  },\n"
+            "  \"blockindex\": {           (json object) Information about the in-memory block index\n"
+            "    \"usage\": xxxxx,         (numeric) Number of bytes used\n"
+            "    \"entries\": xxxxx,       (numeric) Number of block index entries\n"
             "  }\n"
             "}\n"
             "\nResult (mode \"mallocinfo\"):\n"
@@ -348,6 +381,8 @@ static UniValue getmemoryinfo(const JSONRPCRequest& request)
     if (mode == "stats") {
         UniValue obj(UniValue::VOBJ);
         obj.pushKV("locked", RPCLockedMemoryInfo());
+        obj.pushKV("blockcache", RPCBlockCacheInfo());
+        obj.pushKV("blockindex", RPCBlockIndexInfo());
         return obj;
     } else if (mode == "mallocinfo") {
 #ifdef HAVE_MALLOC_INFO
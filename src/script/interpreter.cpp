@@ -1164,9 +1164,7 @@ bool EvalScript(std::vector<std::vector<unsigned char> >& stack, const CScript&
                     if (stack.size() < 1)
                         return set_error(serror, SCRIPT_ERR_INVALID_STACK_OPERATION);
 
-                    valtype& vchColorid(stacktop(-1));
-                    CDataStream ss(vchColorid, SER_NETWORK, PROTOCOL_VERSION);
-                    ss >> *colorId;
+                    *colorId = ColorIdentifier(stacktop(-1));
 
 
                     //COLOR identifier consists of one byte of TYPE and 32 of PAYLOAD.
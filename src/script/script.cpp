@@ -242,6 +242,24 @@ bool CScript::IsColoredPayToScriptHash() const
     return false;
 }
 
+bool CScript::IsColoredPayToPubkeyHash() const
+{
+    //<COLOR identifier> OP_COLOR OP_DUP OP_HASH160 <H(pubkey)> OP_EQUALVERIFY OP_CHECKSIG
+    if(this->size() == 60) // <COLOR identifier> : TYPE = 1 byte and 32 byte PAYLOAD
+        return ((*this)[0] == 0x21 &&
+                (*this)[34] == OP_COLOR &&
+                (*this)[35] == OP_DUP &&
+                (*this)[36] == OP_HASH160 &&
+                (*this)[37] == 0x14 &&
+                (*this)[58] == OP_EQUALVERIFY &&
+                (*this)[59] == OP_CHECKSIG &&
+
+                ((*this)[1] == TokenToUint(TokenTypes::REISSUABLE) ||
+                 (*this)[1] == TokenToUint(TokenTypes::NON_REISSUABLE) ||
+                 (*this)[1] == TokenToUint(TokenTypes::NFT)));
+    return false;
+}
+
 bool CScript::IsPayToWitnessScriptHash() const
 {
     // Extra-fast test for pay-to-witness-script-hash CScripts:
@@ -370,20 +388,7 @@ bool GetScriptOp(CScriptBase::const_iterator& pc, CScriptBase::const_iterator en
 
 bool MatchColoredPayToPubkeyHash(const CScript& script, std::vector<unsigned char>& pubkeyhash, std::vector<unsigned char>& colorid)
 {
-    //<COLOR identifier> OP_COLOR OP_DUP OP_HASH160 <H(pubkey)> OP_EQUALVERIFY OP_CHECKSIG
-    // <COLOR identifier> : TYPE = 1 byte and 32 byte PAYLOAD
-    if (script.size() == 60 &&
-         script[0] == 0x21 &&
-         script[34] == OP_COLOR &&
-         script[35] == OP_DUP &&
-         script[36] == OP_HASH160 &&
-         script[37] == 20 &&
-         script[58] == OP_EQUALVERIFY &&
-         script[59] == OP_CHECKSIG &&
-
-         (script[1] == TokenToUint(TokenTypes::REISSUABLE) ||
-          script[1] == TokenToUint(TokenTypes::NON_REISSUABLE) ||
-          script[1] == TokenToUint(TokenTypes::NFT)))
+    if (script.IsColoredPayToPubkeyHash())
     {
         pubkeyhash = std::vector<unsigned char>(script.begin() + 38, script.begin() + 58);
         colorid = std::vector<unsigned char>(script.begin() + 1, script.begin() + 34);
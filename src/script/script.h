@@ -542,6 +542,7 @@ public:
 
     bool IsColoredScript() const;
     bool IsColoredPayToScriptHash() const;
+    bool IsColoredPayToPubkeyHash() const;
 
     /** Called by IsStandardTx and P2SH/BIP62 VerifyScript (which makes it consensus-critical). */
     bool IsPushOnly(const_iterator pc) const;
@@ -86,6 +86,8 @@ bool CachingTransactionSignatureChecker::VerifySignature(const std::vector<unsig
     signatureCache.ComputeEntry(entry, sighash, vchSig, pubkey);
     if (signatureCache.Get(entry, !store))
         return true;
+    if (batch && !store && vchSig.size() == CPubKey::SCHNORR_SIGNATURE_SIZE)
+        return batch->Add(pubkey, sighash, vchSig);
     if (!TransactionSignatureChecker::VerifySignature(vchSig, pubkey, sighash))
         return false;
     if (store)
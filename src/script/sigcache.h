@@ -18,6 +18,7 @@ static const unsigned int DEFAULT_MAX_SIG_CACHE_SIZE = 32;
 static const int64_t MAX_MAX_SIG_CACHE_SIZE = 16384;
 
 class CPubKey;
+class CSchnorrBatch;
 
 /**
  * We're hashing a nonce into the entries themselves, so we don't need extra
@@ -40,13 +41,22 @@ public:
     }
 };
 
+/**
+ * Signature checker backed by the signature cache.
+ *
+ * If a CSchnorrBatch is given, Schnorr signatures that miss the cache are not
+ * verified but queued in the batch and assumed valid. The caller must then
+ * check the batch, and re-run the script without a batch if it fails. Batching
+ * is not used when storing, as only verified signatures may enter the cache.
+ */
 class CachingTransactionSignatureChecker : public TransactionSignatureChecker
 {
 private:
     bool store;
+    CSchnorrBatch* batch;
 
 public:
-    CachingTransactionSignatureChecker(const CTransaction* txToIn, unsigned int nInIn, const CAmount& amountIn, bool storeIn, PrecomputedTransactionData& txdataIn) : TransactionSignatureChecker(txToIn, nInIn, amountIn, txdataIn), store(storeIn) {}
+    CachingTransactionSignatureChecker(const CTransaction* txToIn, unsigned int nInIn, const CAmount& amountIn, bool storeIn, PrecomputedTransactionData& txdataIn, CSchnorrBatch* batchIn = nullptr) : TransactionSignatureChecker(txToIn, nInIn, amountIn, txdataIn), store(storeIn), batch(batchIn) {}
 
     bool VerifySignature(const std::vector<unsigned char>& vchSig, const CPubKey& vchPubKey, const uint256& sighash) const override;
 };
@@ -28,4 +28,8 @@ static int secp256k1_ecmult_context_is_built(const secp256k1_ecmult_context *ctx
 /** Double multiply: R = na*A + ng*G */
 static void secp256k1_ecmult(const secp256k1_ecmult_context *ctx, secp256k1_gej *r, const secp256k1_gej *a, const secp256k1_scalar *na, const secp256k1_scalar *ng);
 
+/** Multi multiply: R = sum(na[i]*A[i]) + ng*G, for n non-infinity points A[i].
+ *  All terms share a single chain of doublings. Not constant time. */
+static void secp256k1_ecmult_multi_var(const secp256k1_ecmult_context *ctx, const secp256k1_callback *cb, secp256k1_gej *r, const secp256k1_ge *a, const secp256k1_scalar *na, size_t n, const secp256k1_scalar *ng);
+
 #endif /* SECP256K1_ECMULT_H */
@@ -403,4 +403,100 @@ static void secp256k1_ecmult(const secp256k1_ecmult_context *ctx, secp256k1_gej
     }
 }
 
+/** Strauss' method: every point gets its own table of odd multiples and its
+ *  own wnaf, and all of them are accumulated into r while sharing one chain of
+ *  doublings. Compared with n calls to secp256k1_ecmult this saves (n-1)*256
+ *  doublings, and the generator term is added only once.
+ *  The tables are converted to affine coordinates (one inversion per point) so
+ *  that points with different Z denominators can be mixed in the same sum.
+ */
+static void secp256k1_ecmult_multi_var(const secp256k1_ecmult_context *ctx, const secp256k1_callback *cb, secp256k1_gej *r, const secp256k1_ge *a, const secp256k1_scalar *na, size_t n, const secp256k1_scalar *ng) {
+    secp256k1_gej prej[ECMULT_TABLE_SIZE(WINDOW_A)];
+    secp256k1_fe zr[ECMULT_TABLE_SIZE(WINDOW_A)];
+    secp256k1_ge *pre_a;
+    int *wnaf_na;
+    int *bits_na;
+    secp256k1_ge tmpa;
+    secp256k1_gej aj;
+#ifdef USE_ENDOMORPHISM
+    /* Splitted G factors. */
+    secp256k1_scalar ng_1, ng_128;
+    int wnaf_ng_1[129];
+    int bits_ng_1;
+    int wnaf_ng_128[129];
+    int bits_ng_128;
+#else
+    int wnaf_ng[256];
+    int bits_ng;
+#endif
+    size_t i;
+    int bits = 0;
+    int bit;
+
+    pre_a = (secp256k1_ge*)checked_malloc(cb, sizeof(secp256k1_ge) * ECMULT_TABLE_SIZE(WINDOW_A) * (n + 1));
+    wnaf_na = (int*)checked_malloc(cb, sizeof(int) * 256 * (n + 1));
+    bits_na = (int*)checked_malloc(cb, sizeof(int) * (n + 1));
+
+    for (i = 0; i < n; i++) {
+        VERIFY_CHECK(!secp256k1_ge_is_infinity(&a[i]));
+        bits_na[i] = secp256k1_ecmult_wnaf(&wnaf_na[i * 256], 256, &na[i], WINDOW_A);
+        if (bits_na[i] > bits) {
+            bits = bits_na[i];
+        }
+        secp256k1_gej_set_ge(&aj, &a[i]);
+        secp256k1_ecmult_odd_multiples_table(ECMULT_TABLE_SIZE(WINDOW_A), prej, zr, &aj);
+        secp256k1_ge_set_table_gej_var(&pre_a[i * ECMULT_TABLE_SIZE(WINDOW_A)], prej, zr, ECMULT_TABLE_SIZE(WINDOW_A));
+    }
+
+#ifdef USE_ENDOMORPHISM
+    /* split ng into ng_1 and ng_128 (where gn = gn_1 + gn_128*2^128, and gn_1 and gn_128 are ~128 bit) */
+    secp256k1_scalar_split_128(&ng_1, &ng_128, ng);
+    bits_ng_1   = secp256k1_ecmult_wnaf(wnaf_ng_1,   129, &ng_1,   WINDOW_G);
+    bits_ng_128 = secp256k1_ecmult_wnaf(wnaf_ng_128, 129, &ng_128, WINDOW_G);
+    if (bits_ng_1 > bits) {
+        bits = bits_ng_1;
+    }
+    if (bits_ng_128 > bits) {
+        bits = bits_ng_128;
+    }
+#else
+    bits_ng     = secp256k1_ecmult_wnaf(wnaf_ng,     256, ng,      WINDOW_G);
+    if (bits_ng > bits) {
+        bits = bits_ng;
+    }
+#endif
+
+    secp256k1_gej_set_infinity(r);
+
+    for (bit = bits - 1; bit >= 0; bit--) {
+        int m;
+        secp256k1_gej_double_var(r, r, NULL);
+        for (i = 0; i < n; i++) {
+            if (bit < bits_na[i] && (m = wnaf_na[i * 256 + bit])) {
+                ECMULT_TABLE_GET_GE(&tmpa, &pre_a[i * ECMULT_TABLE_SIZE(WINDOW_A)], m, WINDOW_A);
+                secp256k1_gej_add_ge_var(r, r, &tmpa, NULL);
+            }
+        }
+#ifdef USE_ENDOMORPHISM
+        if (bit < bits_ng_1 && (m = wnaf_ng_1[bit])) {
+            ECMULT_TABLE_GET_GE_STORAGE(&tmpa, *ctx->pre_g, m, WINDOW_G);
+            secp256k1_gej_add_ge_var(r, r, &tmpa, NULL);
+        }
+        if (bit < bits_ng_128 && (m = wnaf_ng_128[bit])) {
+            ECMULT_TABLE_GET_GE_STORAGE(&tmpa, *ctx->pre_g_128, m, WINDOW_G);
+            secp256k1_gej_add_ge_var(r, r, &tmpa, NULL);
+        }
+#else
+        if (bit < bits_ng && (m = wnaf_ng[bit])) {
+            ECMULT_TABLE_GET_GE_STORAGE(&tmpa, *ctx->pre_g, m, WINDOW_G);
+            secp256k1_gej_add_ge_var(r, r, &tmpa, NULL);
+        }
+#endif
+    }
+
+    free(pre_a);
+    free(wnaf_na);
+    free(bits_na);
+}
+
 #endif /* SECP256K1_ECMULT_IMPL_H */
@@ -164,6 +164,114 @@ int secp256k1_schnorr_verify(
     return 1;
 }
 
+ /* Batch verification:
+ *   Inputs:
+ *     n signatures (r_i, s_i) over messages m_i with public keys P_i.
+ *
+ *   Parse every signature and lift r_i to the point R_i as in option 2 above,
+ *   and compute e_i as for a single verification.
+ *   Derive coefficients a_0 = 1, a_i = Hash(seed || i) where seed commits to
+ *   every e_i and s_i, so that they cannot be anticipated by the signers.
+ *   All signatures are valid (except with negligible probability) if
+ *     sum(a_i * R_i) + sum(a_i * e_i * P_i) - (sum(a_i * s_i)) * G == 0.
+ */
+int secp256k1_schnorr_verify_batch(
+    const secp256k1_context* ctx,
+    const unsigned char * const *sig64,
+    const unsigned char * const *msg32,
+    const secp256k1_pubkey * const *pubkeys,
+    size_t n_sigs
+) {
+    secp256k1_sha256_t sha;
+    unsigned char seed[32];
+    unsigned char buf[36];
+    secp256k1_ge *points;
+    secp256k1_scalar *scalars;
+    secp256k1_scalar a, s, sg;
+    secp256k1_fe Rx;
+    secp256k1_gej Rj;
+    size_t i;
+    int overflow;
+    int ret = 0;
+
+    VERIFY_CHECK(ctx != NULL);
+    ARG_CHECK(secp256k1_ecmult_context_is_built(&ctx->ecmult_ctx));
+    if (n_sigs == 0) {
+        return 1;
+    }
+    ARG_CHECK(sig64 != NULL);
+    ARG_CHECK(msg32 != NULL);
+    ARG_CHECK(pubkeys != NULL);
+    for (i = 0; i < n_sigs; i++) {
+        ARG_CHECK(sig64[i] != NULL && msg32[i] != NULL && pubkeys[i] != NULL);
+    }
+
+    /* points[2i] = R_i, points[2i+1] = P_i, with matching scalars a_i and a_i*e_i. */
+    points = (secp256k1_ge*)checked_malloc(&ctx->error_callback, sizeof(secp256k1_ge) * 2 * n_sigs);
+    scalars = (secp256k1_scalar*)checked_malloc(&ctx->error_callback, sizeof(secp256k1_scalar) * 2 * n_sigs);
+
+    secp256k1_sha256_initialize(&sha);
+    for (i = 0; i < n_sigs; i++) {
+        if (!secp256k1_pubkey_load(ctx, &points[2 * i + 1], pubkeys[i]) ||
+            secp256k1_ge_is_infinity(&points[2 * i + 1])) {
+            goto done;
+        }
+
+        /* Extract s */
+        overflow = 0;
+        secp256k1_scalar_set_b32(&s, sig64[i] + 32, &overflow);
+        if (overflow) {
+            goto done;
+        }
+
+        /* Extract R.x and lift it to R with a quadratic residue y */
+        if (!secp256k1_fe_set_b32(&Rx, sig64[i])) {
+            goto done;
+        }
+        if (!secp256k1_ge_set_xquad(&points[2 * i], &Rx)) {
+            goto done;
+        }
+
+        /* Compute e, which commits to R.x, P and the message */
+        secp256k1_schnorr_compute_e(&scalars[2 * i + 1], sig64[i], &points[2 * i + 1], msg32[i]);
+        secp256k1_scalar_get_b32(buf, &scalars[2 * i + 1]);
+        secp256k1_sha256_write(&sha, buf, 32);
+        secp256k1_sha256_write(&sha, sig64[i] + 32, 32);
+    }
+    secp256k1_sha256_finalize(&sha, seed);
+
+    secp256k1_scalar_clear(&sg);
+    for (i = 0; i < n_sigs; i++) {
+        if (i == 0) {
+            secp256k1_scalar_set_int(&a, 1);
+        } else {
+            memcpy(buf, seed, 32);
+            buf[32] = i & 0xff;
+            buf[33] = (i >> 8) & 0xff;
+            buf[34] = (i >> 16) & 0xff;
+            buf[35] = (i >> 24) & 0xff;
+            secp256k1_sha256_initialize(&sha);
+            secp256k1_sha256_write(&sha, buf, 36);
+            secp256k1_sha256_finalize(&sha, buf);
+            secp256k1_scalar_set_b32(&a, buf, NULL);
+        }
+        secp256k1_scalar_set_b32(&s, sig64[i] + 32, NULL);
+        secp256k1_scalar_mul(&s, &s, &a);
+        secp256k1_scalar_add(&sg, &sg, &s);
+        scalars[2 * i] = a;
+        secp256k1_scalar_mul(&scalars[2 * i + 1], &scalars[2 * i + 1], &a);
+    }
+    secp256k1_scalar_negate(&sg, &sg);
+
+    secp256k1_ecmult_multi_var(&ctx->ecmult_ctx, &ctx->error_callback, &Rj, points, scalars, 2 * n_sigs, &sg);
+    ret = secp256k1_gej_is_infinity(&Rj);
+
+done:
+    free(points);
+    free(scalars);
+    return ret;
+}
+
  /* Signing:
  *   Inputs:
  *     32-byte message m,
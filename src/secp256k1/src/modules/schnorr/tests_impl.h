@@ -106,6 +106,51 @@ void test_schnorr_end_to_end(void) {
     CHECK(secp256k1_schnorr_verify(ctx, schnorr_signature, message, &pubkey) == 0);
 }
 
+void test_schnorr_verify_batch(void) {
+    enum { N_SIGS = 16 };
+    unsigned char privkey[32];
+    unsigned char message[N_SIGS][32];
+    unsigned char signature[N_SIGS][64];
+    secp256k1_pubkey pubkey[N_SIGS];
+    const unsigned char *sigptr[N_SIGS];
+    const unsigned char *msgptr[N_SIGS];
+    const secp256k1_pubkey *pkptr[N_SIGS];
+    size_t i;
+    size_t bad;
+
+    for (i = 0; i < N_SIGS; i++) {
+        secp256k1_scalar key;
+        random_scalar_order_test(&key);
+        secp256k1_scalar_get_b32(privkey, &key);
+        secp256k1_rand256_test(message[i]);
+        CHECK(secp256k1_ec_pubkey_create(ctx, &pubkey[i], privkey) == 1);
+        CHECK(secp256k1_schnorr_sign(ctx, signature[i], message[i], privkey, NULL, NULL) == 1);
+        sigptr[i] = signature[i];
+        msgptr[i] = message[i];
+        pkptr[i] = &pubkey[i];
+    }
+
+    /* An empty batch is trivially valid. */
+    CHECK(secp256k1_schnorr_verify_batch(ctx, NULL, NULL, NULL, 0) == 1);
+    for (i = 1; i <= N_SIGS; i++) {
+        CHECK(secp256k1_schnorr_verify_batch(ctx, sigptr, msgptr, pkptr, i) == 1);
+    }
+
+    /* Swapping messages between two signatures breaks the batch. */
+    msgptr[0] = message[1];
+    msgptr[1] = message[0];
+    CHECK(secp256k1_schnorr_verify_batch(ctx, sigptr, msgptr, pkptr, N_SIGS) == 0);
+    msgptr[0] = message[0];
+    msgptr[1] = message[1];
+
+    /* A single corrupted signature anywhere breaks the batch. */
+    bad = secp256k1_rand_int(N_SIGS);
+    signature[bad][secp256k1_rand_bits(6)] += 1 + secp256k1_rand_int(255);
+    CHECK(secp256k1_schnorr_verify(ctx, signature[bad], message[bad], &pubkey[bad]) == 0);
+    CHECK(secp256k1_schnorr_verify_batch(ctx, sigptr, msgptr, pkptr, N_SIGS) == 0);
+    CHECK(secp256k1_schnorr_verify_batch(ctx, sigptr + bad, msgptr + bad, pkptr + bad, 1) == 0);
+}
+
 void run_schnorr_compact_test(void) {
     {
         /* Test vector 1 */
@@ -672,6 +717,10 @@ void run_schnorr_tests(void) {
         test_schnorr_end_to_end();
     }
 
+    for (i = 0; i < count; i++) {
+        test_schnorr_verify_batch();
+    }
+
     test_schnorr_api();
     run_schnorr_compact_test();
     test_ecdsa_schnorr_nonce();
@@ -8,6 +8,7 @@
 
 #include <support/allocators/zeroafterfree.h>
 #include <serialize.h>
+#include <span.h>
 
 #include <algorithm>
 #include <assert.h>
@@ -139,6 +140,69 @@ private:
     size_t nPos;
 };
 
+/* Minimal stream for reading from an existing byte span, e.g. a memory mapped
+ * file, without copying it first.
+ *
+ * The referenced bytes must outlive the reader.
+ */
+class CSpanReader
+{
+ public:
+
+/*
+ * @param[in]  nTypeIn Serialization Type
+ * @param[in]  nVersionIn Serialization Version (including any flags)
+ * @param[in]  data Referenced bytes to read from
+*/
+    CSpanReader(int nTypeIn, int nVersionIn, Span<const unsigned char> data) : nType(nTypeIn), nVersion(nVersionIn), m_data(data) {}
+
+    template<typename T>
+    CSpanReader& operator>>(T& obj)
+    {
+        // Unserialize from this stream
+        ::Unserialize(*this, obj);
+        return (*this);
+    }
+    int GetVersion() const
+    {
+        return nVersion;
+    }
+    int GetType() const
+    {
+        return nType;
+    }
+    size_t size() const
+    {
+        return m_data.size();
+    }
+    bool empty() const
+    {
+        return m_data.size() == 0;
+    }
+    void read(char* dst, size_t n)
+    {
+        if (n == 0) {
+            return;
+        }
+        if (n > (size_t)m_data.size()) {
+            throw std::ios_base::failure("CSpanReader::read(): end of data");
+        }
+        memcpy(dst, m_data.data(), n);
+        m_data = m_data.subspan(n);
+    }
+    void ignore(size_t n)
+    {
+        if (n > (size_t)m_data.size()) {
+            throw std::ios_base::failure("CSpanReader::ignore(): end of data");
+        }
+        m_data = m_data.subspan(n);
+    }
+private:
+    const int nType;
+    const int nVersion;
+    Span<const unsigned char> m_data;
+};
+
 /** Double ended buffer combining vector and stream-like interfaces.
  *
  * >> and << read and write unformatted data using the above serialization templates.
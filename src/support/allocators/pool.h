@@ -0,0 +1,203 @@
+// Copyright (c) 2020 Chaintope Inc.
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_SUPPORT_ALLOCATORS_POOL_H
+#define BITCOIN_SUPPORT_ALLOCATORS_POOL_H
+
+#include <cassert>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+/**
+ * A memory resource for many small allocations of a few sizes, such as the
+ * nodes of a node based container.
+ *
+ * Memory is carved out of large chunks with a bump pointer, so there is no
+ * per allocation malloc overhead and nodes of one container end up next to
+ * each other. Freed blocks are kept in one free list per size and reused; the
+ * chunks themselves are only released when the resource is destroyed.
+ *
+ * Allocations larger than MAX_BLOCK_SIZE_BYTES, or with a stricter alignment
+ * than ALIGN_BYTES, are passed on to ::operator new.
+ *
+ * Not thread safe.
+ */
+template <std::size_t MAX_BLOCK_SIZE_BYTES, std::size_t ALIGN_BYTES>
+class PoolResource
+{
+    static_assert(ALIGN_BYTES > 0 && (ALIGN_BYTES & (ALIGN_BYTES - 1)) == 0, "ALIGN_BYTES must be a power of two");
+
+    //! Free blocks store a pointer to the next free block of the same size.
+    struct ListNode {
+        ListNode* m_next;
+    };
+
+    //! Granularity of all block sizes.
+    static const std::size_t ELEM_ALIGN_BYTES = ALIGN_BYTES > alignof(ListNode) ? ALIGN_BYTES : alignof(ListNode);
+    static_assert(ELEM_ALIGN_BYTES >= sizeof(ListNode), "block must be able to hold a free list pointer");
+
+    const std::size_t m_chunk_size_bytes;
+    std::vector<char*> m_allocated_chunks;
+    //! m_free_lists[n] holds free blocks of n * ELEM_ALIGN_BYTES bytes.
+    std::vector<ListNode*> m_free_lists;
+    char* m_available_memory_it = nullptr;
+    char* m_available_memory_end = nullptr;
+
+    static std::size_t NumElemAlignBytes(std::size_t bytes)
+    {
+        return (bytes + ELEM_ALIGN_BYTES - 1) / ELEM_ALIGN_BYTES + (bytes == 0);
+    }
+
+    static bool IsFreeListUsable(std::size_t bytes, std::size_t alignment)
+    {
+        return alignment <= ELEM_ALIGN_BYTES && bytes <= MAX_BLOCK_SIZE_BYTES;
+    }
+
+    void PushFree(char* p, std::size_t num_alignments)
+    {
+        ListNode* node = new (p) ListNode{m_free_lists[num_alignments]};
+        m_free_lists[num_alignments] = node;
+    }
+
+    void AllocateChunk()
+    {
+        // Hand the rest of the current chunk to the free list of its size so it is not lost.
+        const std::size_t remaining = m_available_memory_end - m_available_memory_it;
+        if (remaining > 0) {
+            PushFree(m_available_memory_it, remaining / ELEM_ALIGN_BYTES);
+        }
+        char* chunk = static_cast<char*>(::operator new(m_chunk_size_bytes));
+        m_allocated_chunks.push_back(chunk);
+        m_available_memory_it = chunk;
+        m_available_memory_end = chunk + m_chunk_size_bytes;
+    }
+
+public:
+    static const std::size_t DEFAULT_CHUNK_SIZE_BYTES = 256 * 1024;
+
+    explicit PoolResource(std::size_t chunk_size_bytes = DEFAULT_CHUNK_SIZE_BYTES)
+        : m_chunk_size_bytes(chunk_size_bytes / ELEM_ALIGN_BYTES * ELEM_ALIGN_BYTES),
+          m_free_lists(MAX_BLOCK_SIZE_BYTES / ELEM_ALIGN_BYTES + 1, nullptr)
+    {
+        assert(m_chunk_size_bytes >= MAX_BLOCK_SIZE_BYTES);
+    }
+
+    PoolResource(const PoolResource&) = delete;
+    PoolResource& operator=(const PoolResource&) = delete;
+
+    ~PoolResource()
+    {
+        for (char* chunk : m_allocated_chunks) {
+            ::operator delete(chunk);
+        }
+    }
+
+    void* Allocate(std::size_t bytes, std::size_t alignment)
+    {
+        if (!IsFreeListUsable(bytes, alignment)) {
+            return ::operator new(bytes);
+        }
+        const std::size_t num_alignments = NumElemAlignBytes(bytes);
+        ListNode* node = m_free_lists[num_alignments];
+        if (node != nullptr) {
+            m_free_lists[num_alignments] = node->m_next;
+            return node;
+        }
+        const std::size_t round_bytes = num_alignments * ELEM_ALIGN_BYTES;
+        if (static_cast<std::size_t>(m_available_memory_end - m_available_memory_it) < round_bytes) {
+            AllocateChunk();
+        }
+        char* p = m_available_memory_it;
+        m_available_memory_it += round_bytes;
+        return p;
+    }
+
+    void Deallocate(void* p, std::size_t bytes, std::size_t alignment) noexcept
+    {
+        if (!IsFreeListUsable(bytes, alignment)) {
+            ::operator delete(p);
+            return;
+        }
+        PushFree(static_cast<char*>(p), NumElemAlignBytes(bytes));
+    }
+
+    std::size_t NumAllocatedChunks() const { return m_allocated_chunks.size(); }
+    std::size_t ChunkSizeBytes() const { return m_chunk_size_bytes; }
+};
+
+/**
+ * Allocator that takes memory from a PoolResource, for use with node based
+ * containers like std::unordered_map.
+ *
+ * The resource is shared by all copies of the allocator and lives as long as
+ * the last of them. A container therefore owns the memory of its nodes:
+ * moving or swapping containers moves the resource along, and destroying the
+ * container releases every chunk at once. A copy constructed container gets a
+ * fresh resource. A moved-from container keeps sharing the resource with the
+ * container it was moved into, so it should be reset before it is used from
+ * another thread (the resource is not thread safe).
+ */
+template <class T, std::size_t MAX_BLOCK_SIZE_BYTES, std::size_t ALIGN_BYTES = alignof(T)>
+class PoolAllocator
+{
+public:
+    typedef PoolResource<MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES> ResourceType;
+
+private:
+    std::shared_ptr<ResourceType> m_resource;
+
+    template <class U, std::size_t M, std::size_t A>
+    friend class PoolAllocator;
+
+public:
+    typedef T value_type;
+    typedef std::false_type propagate_on_container_copy_assignment;
+    typedef std::true_type propagate_on_container_move_assignment;
+    typedef std::true_type propagate_on_container_swap;
+
+    template <class U>
+    struct rebind {
+        typedef PoolAllocator<U, MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES> other;
+    };
+
+    PoolAllocator() : m_resource(std::make_shared<ResourceType>()) {}
+    explicit PoolAllocator(std::shared_ptr<ResourceType> resource) : m_resource(std::move(resource)) {}
+    // Copies only: a moved-from allocator must still be usable.
+    PoolAllocator(const PoolAllocator& other) noexcept = default;
+    PoolAllocator& operator=(const PoolAllocator& other) noexcept = default;
+
+    template <class U>
+    PoolAllocator(const PoolAllocator<U, MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES>& other) noexcept : m_resource(other.m_resource) {}
+
+    PoolAllocator select_on_container_copy_construction() const { return PoolAllocator(); }
+
+    T* allocate(std::size_t n)
+    {
+        return static_cast<T*>(m_resource->Allocate(n * sizeof(T), alignof(T)));
+    }
+
+    void deallocate(T* p, std::size_t n) noexcept
+    {
+        m_resource->Deallocate(p, n * sizeof(T), alignof(T));
+    }
+
+    ResourceType* resource() const noexcept { return m_resource.get(); }
+
+    template <class U>
+    bool operator==(const PoolAllocator<U, MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES>& other) const noexcept
+    {
+        return m_resource == other.m_resource;
+    }
+
+    template <class U>
+    bool operator!=(const PoolAllocator<U, MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES>& other) const noexcept
+    {
+        return !(*this == other);
+    }
+};
+
+#endif // BITCOIN_SUPPORT_ALLOCATORS_POOL_H
@@ -5,10 +5,12 @@
 
 #include <util.h>
 
+#include <support/allocators/pool.h>
 #include <support/allocators/secure.h>
 #include <test/test_tapyrus.h>
 
 #include <memory>
+#include <unordered_map>
 
 #include <boost/test/unit_test.hpp>
 
@@ -234,4 +236,69 @@ BOOST_AUTO_TEST_CASE(lockedpool_tests_live)
     BOOST_CHECK(pool.stats().used == initial.used);
 }
 
+
+BOOST_AUTO_TEST_CASE(pool_resource_tests)
+{
+    PoolResource<64, 8> resource(1024);
+    BOOST_CHECK_EQUAL(resource.NumAllocatedChunks(), 0U);
+
+    // Blocks are carved out of one chunk, rounded up to the alignment.
+    char* a = static_cast<char*>(resource.Allocate(8, 8));
+    char* b = static_cast<char*>(resource.Allocate(20, 8));
+    char* c = static_cast<char*>(resource.Allocate(8, 8));
+    BOOST_CHECK_EQUAL(resource.NumAllocatedChunks(), 1U);
+    BOOST_CHECK(b == a + 8);
+    BOOST_CHECK(c == b + 24);
+
+    // Freed blocks are reused for allocations of the same size only.
+    resource.Deallocate(b, 20, 8);
+    BOOST_CHECK(resource.Allocate(8, 8) == c + 8);
+    BOOST_CHECK(resource.Allocate(24, 8) == b);
+
+    // Large or overaligned allocations do not come from the pool.
+    void* large = resource.Allocate(65, 8);
+    void* aligned = resource.Allocate(8, 16);
+    BOOST_CHECK_EQUAL(resource.NumAllocatedChunks(), 1U);
+    resource.Deallocate(large, 65, 8);
+    resource.Deallocate(aligned, 8, 16);
+
+    // A new chunk is started when the current one runs out.
+    for (int i = 0; i < 1024 / 64; i++)
+        resource.Allocate(64, 8);
+    BOOST_CHECK_EQUAL(resource.NumAllocatedChunks(), 2U);
+}
+
+BOOST_AUTO_TEST_CASE(pool_allocator_tests)
+{
+    typedef std::pair<const int, int> value_type;
+    typedef std::unordered_map<int, int, std::hash<int>, std::equal_to<int>, PoolAllocator<value_type, 64>> PoolMap;
+
+    PoolMap map;
+    for (int i = 0; i < 1000; i++)
+        map[i] = i;
+    PoolMap::allocator_type::ResourceType* resource = map.get_allocator().resource();
+    const size_t chunks = resource->NumAllocatedChunks();
+    BOOST_CHECK(chunks > 0);
+
+    // Erased nodes are reused.
+    for (int i = 0; i < 1000; i++)
+        map.erase(i);
+    for (int i = 1000; i < 2000; i++)
+        map[i] = i;
+    BOOST_CHECK_EQUAL(resource->NumAllocatedChunks(), chunks);
+
+    // Copies get their own pool, moves take it along.
+    PoolMap copy(map);
+    BOOST_CHECK(copy.get_allocator().resource() != resource);
+    BOOST_CHECK(copy == map);
+    PoolMap moved(std::move(map));
+    BOOST_CHECK(moved.get_allocator().resource() == resource);
+    BOOST_CHECK(moved == copy);
+
+    // The moved-from map can still be used.
+    map.clear();
+    map[1] = 1;
+    BOOST_CHECK_EQUAL(map.size(), 1U);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -2,6 +2,7 @@
 // Distributed under the MIT software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#include <chain.h>
 #include <primitives/block.h>
 #include <test/test_tapyrus.h>
 #include <test/test_keys_helper.h>
@@ -222,4 +223,71 @@ BOOST_AUTO_TEST_CASE(blockHeaderWithxfieldType2_xfield0)
     BOOST_CHECK_EQUAL(blockHeader.proof.size(), 65);
 }
 
+BOOST_AUTO_TEST_CASE(memoized_hashes)
+{
+    CBlockHeader header = getBlockHeader();
+    const uint256 hash = SerializeHash(header);
+    const uint256 hashForSign = SerializeHash(static_cast<const CBlockHeaderWithoutProof&>(header));
+    BOOST_CHECK(header.GetHash() == hash);
+    BOOST_CHECK(header.GetHashForSign() == hashForSign);
+
+    // Without memoized hashes, changes are reflected at once.
+    header.nTime++;
+    BOOST_CHECK(header.GetHash() == SerializeHash(header));
+    BOOST_CHECK(header.GetHashForSign() != hashForSign);
+    header.nTime--;
+
+    header.MemoizeHashes();
+    BOOST_CHECK(header.GetHash() == hash);
+    BOOST_CHECK(header.GetHashForSign() == hashForSign);
+
+    // Copies and moves may be changed, so they hash their own fields.
+    CBlockHeader copy(header);
+    copy.hashMerkleRoot = uint256();
+    BOOST_CHECK(copy.GetHash() == SerializeHash(copy));
+    copy = header;
+    BOOST_CHECK(copy.GetHash() == hash);
+    copy.nTime++;
+    BOOST_CHECK(copy.GetHash() == SerializeHash(copy));
+    copy.MemoizeHashes();
+    CBlockHeader moved(std::move(copy));
+    moved.proof.assign(64, 0x01);
+    BOOST_CHECK(moved.GetHash() == SerializeHash(moved));
+    BOOST_CHECK(copy.GetHash() == SerializeHash(copy));
+    copy = std::move(moved);
+    BOOST_CHECK(copy.GetHash() == SerializeHash(copy));
+
+    // Deserializing and SetNull drop the memoized hashes.
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << copy;
+    header.MemoizeHashes();
+    ss >> header;
+    BOOST_CHECK(header.GetHash() == copy.GetHash());
+    header.MemoizeHashes();
+    header.SetNull();
+    BOOST_CHECK(header.GetHash() == SerializeHash(header));
+
+    // So do blocks.
+    CBlock block(getBlockHeader());
+    block.MemoizeHashes();
+    block.SetNull();
+    BOOST_CHECK(block.GetHash() == SerializeHash(static_cast<const CBlockHeader&>(block)));
+}
+
+BOOST_AUTO_TEST_CASE(disk_block_index_hash)
+{
+    CBlockHeader header = getBlockHeader();
+    CBlockIndex index(header);
+    CDiskBlockIndex diskindex(&index);
+    diskindex.hashPrev = header.hashPrevBlock;
+    BOOST_CHECK(diskindex.GetBlockHash() == header.GetHash());
+
+    header.xfieldType = 0;
+    header.xfield.clear();
+    CBlockIndex index2(header);
+    CDiskBlockIndex diskindex2(&index2);
+    diskindex2.hashPrev = header.hashPrevBlock;
+    BOOST_CHECK(diskindex2.GetBlockHash() == header.GetHash());
+}
+
 BOOST_AUTO_TEST_SUITE_END()
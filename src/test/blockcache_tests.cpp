@@ -0,0 +1,110 @@
+// Copyright (c) 2020 Chaintope Inc.
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <blockcache.h>
+#include <validation.h>
+
+#include <test/test_tapyrus.h>
+
+#include <boost/test/unit_test.hpp>
+
+static std::shared_ptr<const CBlock> MakeBlock(uint32_t nonce, size_t script_size)
+{
+    CMutableTransaction tx;
+    tx.vin.resize(1);
+    tx.vin[0].prevout.n = nonce;
+    tx.vout.resize(1);
+    tx.vout[0].scriptPubKey = CScript(std::vector<unsigned char>(script_size, 0x51));
+    std::shared_ptr<CBlock> block = std::make_shared<CBlock>();
+    block->nTime = nonce;
+    block->vtx.push_back(MakeTransactionRef(tx));
+    return block;
+}
+
+BOOST_FIXTURE_TEST_SUITE(blockcache_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(block_cache_lru)
+{
+    std::vector<std::shared_ptr<const CBlock>> blocks;
+    for (uint32_t i = 0; i < 4; i++) {
+        blocks.push_back(MakeBlock(i, 1000));
+    }
+    const size_t entry_usage = CBlockCache::EntryUsage(*blocks[0]);
+    BOOST_CHECK(entry_usage > 1000);
+
+    // Room for three blocks.
+    CBlockCache cache(entry_usage * 3);
+    BOOST_CHECK(!cache.Get(blocks[0]->GetHash()));
+    for (int i = 0; i < 3; i++) {
+        cache.Insert(blocks[i]->GetHash(), blocks[i]);
+    }
+    CBlockCache::Stats stats = cache.GetStats();
+    BOOST_CHECK_EQUAL(stats.entries, 3);
+    BOOST_CHECK_EQUAL(stats.usage, entry_usage * 3);
+    BOOST_CHECK_EQUAL(stats.max_usage, entry_usage * 3);
+
+    // Using block 0 makes block 1 the least recently used one.
+    BOOST_CHECK_EQUAL(cache.Get(blocks[0]->GetHash()), blocks[0]);
+    cache.Insert(blocks[3]->GetHash(), blocks[3]);
+    BOOST_CHECK(!cache.Get(blocks[1]->GetHash()));
+    BOOST_CHECK_EQUAL(cache.Get(blocks[0]->GetHash()), blocks[0]);
+    BOOST_CHECK_EQUAL(cache.Get(blocks[2]->GetHash()), blocks[2]);
+    BOOST_CHECK_EQUAL(cache.Get(blocks[3]->GetHash()), blocks[3]);
+
+    stats = cache.GetStats();
+    BOOST_CHECK_EQUAL(stats.entries, 3);
+    BOOST_CHECK_EQUAL(stats.hits, 4);
+    BOOST_CHECK_EQUAL(stats.misses, 2);
+
+    // Inserting a cached block again only refreshes it.
+    cache.Insert(blocks[0]->GetHash(), blocks[0]);
+    BOOST_CHECK_EQUAL(cache.GetStats().usage, entry_usage * 3);
+
+    // Shrinking the budget evicts the least recently used blocks.
+    cache.SetMaxUsage(entry_usage);
+    stats = cache.GetStats();
+    BOOST_CHECK_EQUAL(stats.entries, 1);
+    BOOST_CHECK_EQUAL(cache.Get(blocks[0]->GetHash()), blocks[0]);
+
+    // A block larger than half the budget is never cached.
+    cache.SetMaxUsage(entry_usage * 3);
+    std::shared_ptr<const CBlock> big = MakeBlock(4, 100000);
+    cache.Insert(big->GetHash(), big);
+    BOOST_CHECK(!cache.Get(big->GetHash()));
+    BOOST_CHECK_EQUAL(cache.GetStats().entries, 1);
+
+    cache.Clear();
+    stats = cache.GetStats();
+    BOOST_CHECK_EQUAL(stats.entries, 0);
+    BOOST_CHECK_EQUAL(stats.usage, 0);
+
+    // A budget of 0 disables the cache.
+    cache.SetMaxUsage(0);
+    cache.Insert(blocks[0]->GetHash(), blocks[0]);
+    BOOST_CHECK(!cache.Get(blocks[0]->GetHash()));
+}
+
+BOOST_FIXTURE_TEST_CASE(block_cache_connect_and_read, TestChainSetup)
+{
+    // Connected blocks are cached.
+    const CBlockIndex* tip = chainActive.Tip();
+    std::shared_ptr<const CBlock> cached = g_block_cache.Get(tip->GetBlockHash());
+    BOOST_REQUIRE(cached);
+    BOOST_CHECK_EQUAL(cached->GetHash(), tip->GetBlockHash());
+    BOOST_CHECK_EQUAL(ReadBlockFromDiskCached(tip), cached);
+
+    // Reads from disk fill the cache unless asked not to.
+    g_block_cache.Clear();
+    std::shared_ptr<const CBlock> read = ReadBlockFromDiskCached(tip, false);
+    BOOST_REQUIRE(read);
+    BOOST_CHECK_EQUAL(read->GetHash(), tip->GetBlockHash());
+    BOOST_CHECK(!g_block_cache.Get(tip->GetBlockHash()));
+
+    read = ReadBlockFromDiskCached(tip);
+    BOOST_REQUIRE(read);
+    BOOST_CHECK_EQUAL(g_block_cache.Get(tip->GetBlockHash()), read);
+    BOOST_CHECK_EQUAL(ReadBlockFromDiskCached(tip), read);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,129 @@
+// Copyright (c) 2020 Chaintope Inc.
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <blockfilemap.h>
+#include <federationparams.h>
+#include <streams.h>
+#include <validation.h>
+
+#include <test/test_tapyrus.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include <stdio.h>
+
+static void AppendToFile(const fs::path& path, const std::vector<unsigned char>& data)
+{
+    FILE* file = fsbridge::fopen(path, "ab");
+    BOOST_REQUIRE(file);
+    BOOST_REQUIRE_EQUAL(fwrite(data.data(), 1, data.size(), file), data.size());
+    fclose(file);
+}
+
+BOOST_AUTO_TEST_SUITE(blockfilemap_tests)
+
+BOOST_FIXTURE_TEST_CASE(block_file_map_cache, BasicTestingSetup)
+{
+    if (!CMappedFile::IsSupported()) {
+        BOOST_CHECK(!CMappedFile::Open(GetDataDir() / "missing"));
+        return;
+    }
+
+    const fs::path path = GetDataDir() / "mapped";
+    const std::vector<unsigned char> first = {1, 2, 3, 4};
+    const std::vector<unsigned char> second = {5, 6, 7, 8};
+    AppendToFile(path, first);
+
+    CBlockFileMapCache cache(2);
+    BOOST_CHECK(!cache.Get(GetDataDir() / "missing", 0));
+
+    std::shared_ptr<const CMappedFile> file = cache.Get(path, 4);
+    BOOST_REQUIRE(file);
+    BOOST_CHECK_EQUAL(file->size(), 4);
+    BOOST_CHECK(file->GetSpan(0, 4) == MakeSpan(first));
+    BOOST_CHECK(file->Contains(1, 3));
+    BOOST_CHECK(!file->Contains(1, 4));
+    BOOST_CHECK(!file->Contains(5, 0));
+    BOOST_CHECK_EQUAL(cache.Get(path, 2), file);
+
+    // The file is shorter than requested.
+    BOOST_CHECK(!cache.Get(path, 8));
+
+    // Once the file grows, a longer mapping replaces the old one, which stays
+    // valid for as long as it is referenced.
+    AppendToFile(path, second);
+    std::shared_ptr<const CMappedFile> grown = cache.Get(path, 8);
+    BOOST_REQUIRE(grown);
+    BOOST_CHECK(grown != file);
+    BOOST_CHECK(grown->GetSpan(4, 4) == MakeSpan(second));
+    BOOST_CHECK(file->GetSpan(0, 4) == MakeSpan(first));
+    BOOST_CHECK_EQUAL(cache.Get(path, 0), grown);
+    BOOST_CHECK_EQUAL(cache.Size(), 1);
+
+    // Least recently used files are unmapped first.
+    const fs::path path2 = GetDataDir() / "mapped2";
+    const fs::path path3 = GetDataDir() / "mapped3";
+    AppendToFile(path2, first);
+    AppendToFile(path3, second);
+    BOOST_CHECK(cache.Get(path2, 0));
+    BOOST_CHECK_EQUAL(cache.Get(path, 0), grown);
+    BOOST_CHECK(cache.Get(path3, 0));
+    BOOST_CHECK_EQUAL(cache.Size(), 2);
+    BOOST_CHECK_EQUAL(cache.Get(path, 0), grown);
+
+    cache.Erase(path);
+    BOOST_CHECK_EQUAL(cache.Size(), 1);
+    BOOST_CHECK(cache.Get(path, 0) != grown);
+    cache.Clear();
+    BOOST_CHECK_EQUAL(cache.Size(), 0);
+
+    // A mapping outlives the file it maps.
+    fs::remove(path2);
+    BOOST_CHECK(file->GetSpan(0, 4) == MakeSpan(first));
+}
+
+BOOST_FIXTURE_TEST_CASE(read_block_from_mapped_file, TestChainSetup)
+{
+    const bool mmap_before = fBlockFileMmap;
+    const CMessageHeader::MessageStartChars& message_start = FederationParams().MessageStart();
+
+    for (const CBlockIndex* pindex = chainActive.Tip(); pindex; pindex = pindex->pprev) {
+        CBlock block_mapped;
+        CBlock block_read;
+        CRawBlockData raw_mapped;
+        CRawBlockData raw_read;
+
+        fBlockFileMmap = true;
+        BOOST_CHECK(ReadBlockFromDisk(block_mapped, pindex));
+        BOOST_CHECK(ReadRawBlockFromDisk(raw_mapped, pindex, message_start));
+        fBlockFileMmap = false;
+        BOOST_CHECK(ReadBlockFromDisk(block_read, pindex));
+        BOOST_CHECK(ReadRawBlockFromDisk(raw_read, pindex, message_start));
+
+        BOOST_CHECK_EQUAL(block_mapped.GetHash(), pindex->GetBlockHash());
+        BOOST_CHECK_EQUAL(block_read.GetHash(), pindex->GetBlockHash());
+
+        CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+        ss << block_read;
+        const std::vector<unsigned char> serialized(ss.begin(), ss.end());
+        BOOST_CHECK(raw_mapped.data == MakeSpan(serialized));
+        BOOST_CHECK(raw_read.data == MakeSpan(serialized));
+        BOOST_CHECK(raw_mapped.keep_alive);
+        BOOST_CHECK(raw_read.keep_alive);
+    }
+
+    // A wrong network magic is detected on both paths.
+    CMessageHeader::MessageStartChars wrong_start;
+    memcpy(wrong_start, message_start, sizeof(wrong_start));
+    wrong_start[0] ^= 0xff;
+    CRawBlockData raw;
+    fBlockFileMmap = true;
+    BOOST_CHECK(!ReadRawBlockFromDisk(raw, chainActive.Tip(), wrong_start));
+    fBlockFileMmap = false;
+    BOOST_CHECK(!ReadRawBlockFromDisk(raw, chainActive.Tip(), wrong_start));
+
+    fBlockFileMmap = mmap_before;
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -9,6 +9,7 @@
 #include <undo.h>
 #include <utilstrencodings.h>
 #include <test/test_tapyrus.h>
+#include <txdb.h>
 #include <validation.h>
 #include <consensus/validation.h>
 
@@ -870,4 +871,69 @@ BOOST_AUTO_TEST_CASE(ccoins_write)
                     CheckWriteCoins(parent_value, child_value, parent_value, parent_flags, child_flags, parent_flags);
 }
 
+
+BOOST_FIXTURE_TEST_CASE(ccoins_db_background_flush, TestingSetup)
+{
+    CCoinsViewDB db(1 << 20, true, true);
+    db.StartBackgroundFlush();
+
+    std::vector<COutPoint> outpoints;
+    for (uint32_t i = 0; i < 100; i++)
+        outpoints.emplace_back(InsecureRand256(), i);
+
+    // Whether or not the thread has written them yet, flushed coins are visible.
+    const uint256 block1 = InsecureRand256();
+    {
+        CCoinsViewCache cache(&db);
+        for (const COutPoint& outpoint : outpoints) {
+            Coin coin(CTxOut(outpoint.n + 1, CScript() << OP_TRUE), 1, false, TokenTypes::NONE);
+            cache.AddCoin(outpoint, std::move(coin), false);
+        }
+        cache.SetBestBlock(block1);
+        BOOST_CHECK(cache.Flush());
+    }
+    BOOST_CHECK(db.GetBestBlock() == block1);
+    for (const COutPoint& outpoint : outpoints) {
+        Coin coin;
+        BOOST_CHECK(db.HaveCoin(outpoint));
+        BOOST_CHECK(db.GetCoin(outpoint, coin));
+        BOOST_CHECK_EQUAL(coin.out.nValue, outpoint.n + 1);
+    }
+
+    // Spend half of them in a second flush, which waits for the first one.
+    const uint256 block2 = InsecureRand256();
+    {
+        CCoinsViewCache cache(&db);
+        for (size_t i = 0; i < outpoints.size(); i += 2)
+            BOOST_CHECK(cache.SpendCoin(outpoints[i]));
+        cache.SetBestBlock(block2);
+        BOOST_CHECK(cache.Flush());
+    }
+    BOOST_CHECK(db.GetBestBlock() == block2);
+    for (size_t i = 0; i < outpoints.size(); i++)
+        BOOST_CHECK_EQUAL(db.HaveCoin(outpoints[i]), i % 2 == 1);
+
+    // Callbacks run once the coins are in the database, before the sync returns.
+    bool written = false;
+    db.AfterPendingWrites([&db, &written] { written = db.GetHeadBlocks().empty(); });
+
+    // Once synced, the database itself holds the state.
+    BOOST_CHECK(db.SyncPendingWrites());
+    BOOST_CHECK(written);
+    bool called = false;
+    db.AfterPendingWrites([&called] { called = true; });
+    BOOST_CHECK(called);
+    BOOST_CHECK(db.GetHeadBlocks().empty());
+    std::unique_ptr<CCoinsViewCursor> cursor(db.Cursor());
+    BOOST_CHECK(cursor->GetBestBlock() == block2);
+    size_t count = 0;
+    for (; cursor->Valid(); cursor->Next()) {
+        COutPoint key;
+        BOOST_CHECK(cursor->GetKey(key));
+        BOOST_CHECK_EQUAL(key.n % 2, 1U);
+        count++;
+    }
+    BOOST_CHECK_EQUAL(count, outpoints.size() / 2);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,160 @@
+// Copyright (c) 2020 Chaintope Inc.
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <coinstats.h>
+#include <consensus/validation.h>
+#include <index/coinstatsindex.h>
+#include <script/standard.h>
+#include <test/test_tapyrus.h>
+#include <txdb.h>
+#include <util.h>
+#include <utiltime.h>
+#include <validation.h>
+#include <validationinterface.h>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_AUTO_TEST_SUITE(coinstatsindex_tests)
+
+static CCoinsStats ScanUTXOStats(int nThreads)
+{
+    FlushStateToDisk();
+    CCoinsStats stats;
+    BOOST_CHECK(GetUTXOStats(pcoinsdbview.get(), stats, nThreads));
+    return stats;
+}
+
+static void CheckIndexStats(const CoinStatsIndex& index, const CCoinsStats& expected)
+{
+    CCoinsStats stats;
+    BOOST_CHECK(index.LookupStats(stats));
+    BOOST_CHECK(stats.hashBlock == expected.hashBlock);
+    BOOST_CHECK_EQUAL(stats.nHeight, expected.nHeight);
+    BOOST_CHECK_EQUAL(stats.nTransactionOutputs, expected.nTransactionOutputs);
+    BOOST_CHECK_EQUAL(stats.nBogoSize, expected.nBogoSize);
+    BOOST_CHECK_EQUAL(stats.nTotalAmount, expected.nTotalAmount);
+    BOOST_CHECK_EQUAL(stats.mapColorStats.size(), expected.mapColorStats.size());
+    for (const auto& entry : expected.mapColorStats) {
+        auto it = stats.mapColorStats.find(entry.first);
+        BOOST_REQUIRE(it != stats.mapColorStats.end());
+        BOOST_CHECK_EQUAL(it->second.nAmount, entry.second.nAmount);
+        BOOST_CHECK_EQUAL(it->second.nTransactionOutputs, entry.second.nTransactionOutputs);
+    }
+}
+
+BOOST_FIXTURE_TEST_CASE(utxo_stats_thread_independent, TestChainSetup)
+{
+    const CCoinsStats stats = ScanUTXOStats(1);
+    BOOST_CHECK_EQUAL(stats.nHeight, chainActive.Height());
+    BOOST_CHECK(stats.hashBlock == chainActive.Tip()->GetBlockHash());
+    BOOST_CHECK(stats.nTransactionOutputs > 0);
+    BOOST_CHECK(stats.mapColorStats.empty());
+
+    for (int nThreads : {2, 3, 8}) {
+        const CCoinsStats parallel = ScanUTXOStats(nThreads);
+        BOOST_CHECK(parallel.hashSerialized == stats.hashSerialized);
+        BOOST_CHECK_EQUAL(parallel.nTransactions, stats.nTransactions);
+        BOOST_CHECK_EQUAL(parallel.nTransactionOutputs, stats.nTransactionOutputs);
+        BOOST_CHECK_EQUAL(parallel.nBogoSize, stats.nBogoSize);
+        BOOST_CHECK_EQUAL(parallel.nTotalAmount, stats.nTotalAmount);
+    }
+
+    // The range cursors together visit every coin exactly once, in txid order.
+    size_t nCoins = 0;
+    uint256 prev;
+    bool fFirst = true;
+    for (const auto& cursor : pcoinsdbview->RangeCursors(COINS_STATS_RANGES)) {
+        BOOST_CHECK(cursor->GetBestBlock() == stats.hashBlock);
+        for (; cursor->Valid(); cursor->Next()) {
+            COutPoint key;
+            BOOST_REQUIRE(cursor->GetKey(key));
+            BOOST_CHECK(fFirst || !(key.hashMalFix < prev));
+            prev = key.hashMalFix;
+            fFirst = false;
+            nCoins++;
+        }
+    }
+    BOOST_CHECK_EQUAL(nCoins, stats.nTransactionOutputs);
+}
+
+BOOST_FIXTURE_TEST_CASE(coinstatsindex_initial_sync_and_reorg, TestChainSetup)
+{
+    const CScript& coinbaseScript = m_coinbase_txns[0]->vout[0].scriptPubKey;
+    const ColorIdentifier colorId(coinbaseScript);
+    const CKeyID keyId = coinbaseKey.GetPubKey().GetID();
+    const CScript tpcScript = GetScriptForDestination(keyId);
+    const CScript colorScript = CScript() << colorId.toVector() << OP_COLOR << OP_DUP << OP_HASH160 << ToByteVector(keyId) << OP_EQUALVERIFY << OP_CHECKSIG;
+
+    // issue 100 tokens
+    CMutableTransaction issueTx;
+    issueTx.nFeatures = 1;
+    issueTx.vin.resize(1);
+    issueTx.vin[0].prevout = COutPoint(m_coinbase_txns[0]->GetHashMalFix(), 0);
+    issueTx.vout.resize(2);
+    issueTx.vout[0] = CTxOut(100, colorScript);
+    issueTx.vout[1] = CTxOut(m_coinbase_txns[0]->vout[0].nValue - 10 * CENT, tpcScript);
+    SignInput(issueTx, 0, coinbaseKey, coinbaseScript, false);
+    CreateAndProcessBlock({issueTx}, tpcScript);
+
+    CoinStatsIndex coinstatsindex(1 << 20, true);
+    coinstatsindex.Start();
+    // Stop the thread before the destructor runs, also when a requirement fails.
+    struct IndexStopper {
+        BaseIndex& index;
+        ~IndexStopper() { index.Stop(); }
+    } stopper{coinstatsindex};
+
+    // Allow the index to catch up with the block index.
+    constexpr int64_t timeout_ms = 10 * 1000;
+    int64_t time_start = GetTimeMillis();
+    while (!coinstatsindex.BlockUntilSyncedToCurrentChain()) {
+        BOOST_REQUIRE(time_start + timeout_ms > GetTimeMillis());
+        MilliSleep(100);
+    }
+
+    CCoinsStats stats = ScanUTXOStats(2);
+    BOOST_REQUIRE_EQUAL(stats.mapColorStats.size(), 1U);
+    BOOST_CHECK_EQUAL(stats.mapColorStats[colorId].nAmount, 100);
+    BOOST_CHECK_EQUAL(stats.mapColorStats[colorId].nTransactionOutputs, 1U);
+    CheckIndexStats(coinstatsindex, stats);
+
+    // Split the tokens in a block connected after the sync.
+    CMutableTransaction splitTx;
+    splitTx.nFeatures = 1;
+    splitTx.vin.resize(2);
+    splitTx.vin[0].prevout = COutPoint(issueTx.GetHashMalFix(), 0);
+    splitTx.vin[1].prevout = COutPoint(issueTx.GetHashMalFix(), 1);
+    splitTx.vout.resize(3);
+    splitTx.vout[0] = CTxOut(60, colorScript);
+    splitTx.vout[1] = CTxOut(40, colorScript);
+    splitTx.vout[2] = CTxOut(issueTx.vout[1].nValue - 10 * CENT, tpcScript);
+    SignInput(splitTx, 0, coinbaseKey, colorScript, true);
+    SignInput(splitTx, 1, coinbaseKey, tpcScript, true);
+
+    const CBlock block = CreateAndProcessBlock({splitTx}, tpcScript);
+    BOOST_CHECK(coinstatsindex.BlockUntilSyncedToCurrentChain());
+    const CCoinsStats statsSplit = ScanUTXOStats(2);
+    BOOST_CHECK_EQUAL(statsSplit.mapColorStats.at(colorId).nTransactionOutputs, 2U);
+    CheckIndexStats(coinstatsindex, statsSplit);
+
+    // Disconnecting the block rewinds the index.
+    CValidationState state;
+    {
+        LOCK(cs_main);
+        BOOST_CHECK(InvalidateBlock(state, LookupBlockIndex(block.GetHash())));
+    }
+    SyncWithValidationInterfaceQueue();
+    CheckIndexStats(coinstatsindex, ScanUTXOStats(2));
+
+    // Reconnecting it applies it again.
+    {
+        LOCK(cs_main);
+        ResetBlockFailureFlags(LookupBlockIndex(block.GetHash()));
+    }
+    BOOST_CHECK(ActivateBestChain(state));
+    BOOST_CHECK(coinstatsindex.BlockUntilSyncedToCurrentChain());
+    CheckIndexStats(coinstatsindex, statsSplit);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -248,4 +248,132 @@ BOOST_AUTO_TEST_CASE(coloridentifier_map_compare)
     BOOST_CHECK_EQUAL(c5 < c4, true);
 }
 
+BOOST_AUTO_TEST_CASE(coloridentifier_transaction_outputs)
+{
+    uint256 hashMalFix(ParseHex("485273f6703f038a234400edadb543eb44b4af5372e8b207990beebc386e7954"));
+    ColorIdentifier colorId(COutPoint(hashMalFix, 0), TokenTypes::NON_REISSUABLE);
+    CScript tpcScript = CScript() << OP_DUP << OP_HASH160 << std::vector<unsigned char>(20, 0x01) << OP_EQUALVERIFY << OP_CHECKSIG;
+    CScript coloredScript = CScript() << colorId.toVector() << OP_COLOR << OP_DUP << OP_HASH160 << std::vector<unsigned char>(20, 0x01) << OP_EQUALVERIFY << OP_CHECKSIG;
+
+    //no colored output - nothing is stored
+    CMutableTransaction mtx;
+    mtx.vout.resize(2);
+    mtx.vout[0].scriptPubKey = tpcScript;
+    mtx.vout[1].scriptPubKey = tpcScript;
+    CTransaction tx(mtx);
+    BOOST_CHECK(tx.GetColorIds().empty());
+    BOOST_CHECK(tx.GetColorId(0) == ColorIdentifier());
+    BOOST_CHECK(tx.GetColorId(1) == ColorIdentifier());
+
+    //colors match the ones parsed from the scripts
+    mtx.vout[1].scriptPubKey = coloredScript;
+    CTransaction tx2(mtx);
+    BOOST_CHECK_EQUAL(tx2.GetColorIds().size(), 2U);
+    BOOST_CHECK(tx2.GetColorId(0) == GetColorIdFromScript(tpcScript));
+    BOOST_CHECK(tx2.GetColorId(1) == GetColorIdFromScript(coloredScript));
+    BOOST_CHECK(tx2.GetColorId(1) == colorId);
+
+    //colors survive serialization
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << tx2;
+    CTransaction tx3(deserialize, ss);
+    BOOST_CHECK(tx3.GetColorId(1) == colorId);
+}
+
+BOOST_AUTO_TEST_CASE(coloridentifier_coloredcoin_balances)
+{
+    uint256 hashMalFix(ParseHex("485273f6703f038a234400edadb543eb44b4af5372e8b207990beebc386e7954"));
+    TxColoredCoinBalances balances;
+    BOOST_CHECK(balances.empty());
+    BOOST_CHECK(balances.find(ColorIdentifier()) == balances.end());
+
+    //amounts of the same color are accumulated
+    balances.Add(ColorIdentifier(), 10);
+    balances.Add(ColorIdentifier(COutPoint(hashMalFix, 0), TokenTypes::REISSUABLE), 5);
+    balances.Add(ColorIdentifier(), 20);
+    BOOST_CHECK_EQUAL(balances.size(), 2U);
+    BOOST_CHECK_EQUAL(balances.find(ColorIdentifier())->second, 30);
+    BOOST_CHECK_EQUAL(balances.find(ColorIdentifier(COutPoint(hashMalFix, 0), TokenTypes::REISSUABLE))->second, 5);
+
+    //same payload with a different type is a different color
+    BOOST_CHECK(balances.find(ColorIdentifier(COutPoint(hashMalFix, 0), TokenTypes::NON_REISSUABLE)) == balances.end());
+
+    //more colors than fit inline
+    std::map<ColorIdentifier, CAmount> expected;
+    expected[ColorIdentifier()] = 30;
+    expected[ColorIdentifier(COutPoint(hashMalFix, 0), TokenTypes::REISSUABLE)] = 5;
+    for (uint32_t i = 1; i <= 2 * TxColoredCoinBalances::INLINE_COLORS; i++) {
+        ColorIdentifier colorId(COutPoint(hashMalFix, i), TokenTypes::NFT);
+        balances.Add(colorId, i);
+        balances.Add(colorId, i);
+        expected[colorId] = 2 * i;
+    }
+    BOOST_CHECK_EQUAL(balances.size(), expected.size());
+    for (const auto& entry : expected)
+        BOOST_CHECK_EQUAL(balances.find(entry.first)->second, entry.second);
+
+    //iteration follows insertion order
+    BOOST_CHECK(balances.begin()->first == ColorIdentifier());
+    BOOST_CHECK((balances.end() - 1)->first == ColorIdentifier(COutPoint(hashMalFix, 2 * TxColoredCoinBalances::INLINE_COLORS), TokenTypes::NFT));
+
+    //copies are independent
+    TxColoredCoinBalances copy(balances);
+    copy.find(ColorIdentifier())->second = 0;
+    BOOST_CHECK_EQUAL(balances.find(ColorIdentifier())->second, 30);
+
+    balances.clear();
+    BOOST_CHECK(balances.empty());
+    BOOST_CHECK(balances.find(ColorIdentifier()) == balances.end());
+    balances.Add(ColorIdentifier(), 1);
+    BOOST_CHECK_EQUAL(balances.find(ColorIdentifier())->second, 1);
+}
+
+BOOST_AUTO_TEST_CASE(coloridentifier_parse_bytes)
+{
+    uint256 hashMalFix(ParseHex("485273f6703f038a234400edadb543eb44b4af5372e8b207990beebc386e7954"));
+    ColorIdentifier c1(COutPoint(hashMalFix, 1), TokenTypes::NFT);
+
+    //outpoint color is the hash of the serialized outpoint
+    CDataStream ssOut(SER_NETWORK, INIT_PROTO_VERSION);
+    ssOut << COutPoint(hashMalFix, 1);
+    uint256 expected;
+    CSHA256().Write((unsigned char*)ssOut.data(), ssOut.size()).Finalize(expected.begin());
+    BOOST_CHECK(memcmp(c1.payload, expected.begin(), 32) == 0);
+
+    //parsing from memory matches deserialization
+    std::vector<unsigned char> vch = c1.toVector();
+    BOOST_CHECK_EQUAL(vch.size(), 33U);
+    ColorIdentifier c2;
+    CDataStream ss(vch, SER_NETWORK, INIT_PROTO_VERSION);
+    ss >> c2;
+    BOOST_CHECK(c2 == c1);
+    BOOST_CHECK(ColorIdentifier(vch) == c1);
+    BOOST_CHECK(ColorIdentifier(vch.data(), vch.data() + vch.size()) == c1);
+
+    //serialization matches toVector
+    CDataStream ss2(SER_NETWORK, INIT_PROTO_VERSION);
+    ss2 << c1;
+    BOOST_CHECK(std::vector<unsigned char>(ss2.begin(), ss2.end()) == vch);
+    BOOST_CHECK(ColorIdentifier().toVector() == std::vector<unsigned char>(1, 0x00));
+
+    //trailing data is ignored
+    vch.push_back(0xff);
+    BOOST_CHECK(ColorIdentifier(vch) == c1);
+
+    //TPC has no payload
+    BOOST_CHECK(ColorIdentifier(std::vector<unsigned char>(1, 0x00)) == ColorIdentifier());
+
+    //short input is rejected
+    BOOST_CHECK_THROW(ColorIdentifier{std::vector<unsigned char>()}, std::ios_base::failure);
+    vch.resize(32);
+    BOOST_CHECK_THROW(ColorIdentifier{vch}, std::ios_base::failure);
+
+    //colors sharing a payload hash differently
+    ColorIdentifier c3(COutPoint(hashMalFix, 1), TokenTypes::NON_REISSUABLE);
+    std::hash<ColorIdentifier> hasher;
+    BOOST_CHECK_EQUAL(hasher(c1), hasher(ColorIdentifier(c1.toVector())));
+    BOOST_CHECK(hasher(c1) != hasher(c3));
+    BOOST_CHECK_EQUAL(hasher(ColorIdentifier()), 0U);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
\ No newline at end of file
@@ -0,0 +1,196 @@
+// Copyright (c) 2020 Chaintope Inc.
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <consensus/validation.h>
+#include <index/colorindex.h>
+#include <script/standard.h>
+#include <test/test_tapyrus.h>
+#include <util.h>
+#include <utiltime.h>
+#include <validation.h>
+#include <validationinterface.h>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_AUTO_TEST_SUITE(colorindex_tests)
+
+static CAmount SumColorUtxos(const std::vector<std::pair<COutPoint, ColorUtxo>>& utxos)
+{
+    CAmount total = 0;
+    for (const auto& entry : utxos)
+        total += entry.second.nValue;
+    return total;
+}
+
+BOOST_FIXTURE_TEST_CASE(colorindex_initial_sync_and_reorg, TestChainSetup)
+{
+    const CScript& coinbaseScript = m_coinbase_txns[0]->vout[0].scriptPubKey;
+    const ColorIdentifier colorId(coinbaseScript);
+    const CKeyID keyId = coinbaseKey.GetPubKey().GetID();
+    const CScript tpcScript = GetScriptForDestination(keyId);
+    const CScript colorScript = CScript() << colorId.toVector() << OP_COLOR << OP_DUP << OP_HASH160 << ToByteVector(keyId) << OP_EQUALVERIFY << OP_CHECKSIG;
+
+    // issue 100 tokens and split them within the same block
+    CMutableTransaction issueTx;
+    issueTx.nFeatures = 1;
+    issueTx.vin.resize(1);
+    issueTx.vin[0].prevout = COutPoint(m_coinbase_txns[0]->GetHashMalFix(), 0);
+    issueTx.vout.resize(2);
+    issueTx.vout[0] = CTxOut(100, colorScript);
+    issueTx.vout[1] = CTxOut(m_coinbase_txns[0]->vout[0].nValue - 10 * CENT, tpcScript);
+    SignInput(issueTx, 0, coinbaseKey, coinbaseScript, false);
+
+    CMutableTransaction splitTx;
+    splitTx.nFeatures = 1;
+    splitTx.vin.resize(2);
+    splitTx.vin[0].prevout = COutPoint(issueTx.GetHashMalFix(), 0);
+    splitTx.vin[1].prevout = COutPoint(issueTx.GetHashMalFix(), 1);
+    splitTx.vout.resize(3);
+    splitTx.vout[0] = CTxOut(60, colorScript);
+    splitTx.vout[1] = CTxOut(40, colorScript);
+    splitTx.vout[2] = CTxOut(issueTx.vout[1].nValue - 10 * CENT, tpcScript);
+    SignInput(splitTx, 0, coinbaseKey, colorScript, true);
+    SignInput(splitTx, 1, coinbaseKey, tpcScript, true);
+
+    CreateAndProcessBlock({issueTx, splitTx}, tpcScript);
+    {
+        LOCK(cs_main);
+        BOOST_CHECK(pcoinsTip->HaveCoin(COutPoint(splitTx.GetHashMalFix(), 1)));
+    }
+
+    ColorIndex colorindex(1 << 20, true);
+
+    ColorStats stats;
+    BOOST_CHECK(!colorindex.GetColorStats(colorId, stats));
+
+    colorindex.Start();
+
+    // Allow color index to catch up with the block index.
+    constexpr int64_t timeout_ms = 10 * 1000;
+    int64_t time_start = GetTimeMillis();
+    while (!colorindex.BlockUntilSyncedToCurrentChain()) {
+        BOOST_REQUIRE(time_start + timeout_ms > GetTimeMillis());
+        MilliSleep(100);
+    }
+
+    // The issued output was spent in the same block and is not indexed.
+    std::vector<std::pair<COutPoint, ColorUtxo>> utxos;
+    BOOST_CHECK(colorindex.GetColorStats(colorId, stats));
+    BOOST_CHECK_EQUAL(stats.nSupply, 100);
+    BOOST_CHECK_EQUAL(stats.nUtxos, 2U);
+    BOOST_CHECK(colorindex.GetColorUtxos(colorId, utxos));
+    BOOST_CHECK_EQUAL(utxos.size(), 2U);
+    BOOST_CHECK_EQUAL(SumColorUtxos(utxos), 100);
+    BOOST_CHECK(colorindex.GetColorUtxos(colorId, utxos, 1));
+    BOOST_CHECK_EQUAL(utxos.size(), 1U);
+
+    // Uncolored outputs are not indexed.
+    BOOST_CHECK(!colorindex.GetColorStats(ColorIdentifier(tpcScript), stats));
+
+    // Split the 40 token output again in a block connected after the sync.
+    CMutableTransaction splitTx2;
+    splitTx2.nFeatures = 1;
+    splitTx2.vin.resize(2);
+    splitTx2.vin[0].prevout = COutPoint(splitTx.GetHashMalFix(), 1);
+    splitTx2.vin[1].prevout = COutPoint(splitTx.GetHashMalFix(), 2);
+    splitTx2.vout.resize(3);
+    splitTx2.vout[0] = CTxOut(30, colorScript);
+    splitTx2.vout[1] = CTxOut(10, colorScript);
+    splitTx2.vout[2] = CTxOut(splitTx.vout[2].nValue - 10 * CENT, tpcScript);
+    SignInput(splitTx2, 0, coinbaseKey, colorScript, true);
+    SignInput(splitTx2, 1, coinbaseKey, tpcScript, true);
+
+    const CBlock block = CreateAndProcessBlock({splitTx2}, tpcScript);
+    BOOST_CHECK(colorindex.BlockUntilSyncedToCurrentChain());
+    BOOST_CHECK(colorindex.GetColorStats(colorId, stats));
+    BOOST_CHECK_EQUAL(stats.nSupply, 100);
+    BOOST_CHECK_EQUAL(stats.nUtxos, 3U);
+    BOOST_CHECK(colorindex.GetColorUtxos(colorId, utxos));
+    BOOST_CHECK_EQUAL(utxos.size(), 3U);
+    BOOST_CHECK_EQUAL(SumColorUtxos(utxos), 100);
+
+    // Disconnecting the block rewinds the index.
+    CValidationState state;
+    {
+        LOCK(cs_main);
+        BOOST_CHECK(InvalidateBlock(state, LookupBlockIndex(block.GetHash())));
+    }
+    SyncWithValidationInterfaceQueue();
+    BOOST_CHECK(colorindex.GetColorStats(colorId, stats));
+    BOOST_CHECK_EQUAL(stats.nUtxos, 2U);
+    BOOST_CHECK(colorindex.GetColorUtxos(colorId, utxos));
+    BOOST_CHECK_EQUAL(utxos.size(), 2U);
+    BOOST_CHECK_EQUAL(SumColorUtxos(utxos), 100);
+
+    // Reconnecting it applies it again.
+    {
+        LOCK(cs_main);
+        ResetBlockFailureFlags(LookupBlockIndex(block.GetHash()));
+    }
+    BOOST_CHECK(ActivateBestChain(state));
+    BOOST_CHECK(colorindex.BlockUntilSyncedToCurrentChain());
+    BOOST_CHECK(colorindex.GetColorStats(colorId, stats));
+    BOOST_CHECK_EQUAL(stats.nUtxos, 3U);
+    BOOST_CHECK(colorindex.GetColorUtxos(colorId, utxos));
+    BOOST_CHECK_EQUAL(SumColorUtxos(utxos), 100);
+
+    colorindex.Stop(); // Stop thread before calling destructor
+}
+
+BOOST_FIXTURE_TEST_CASE(colorindex_replayed_block, TestChainSetup)
+{
+    const CScript& coinbaseScript = m_coinbase_txns[0]->vout[0].scriptPubKey;
+    const ColorIdentifier colorId(coinbaseScript);
+    const CKeyID keyId = coinbaseKey.GetPubKey().GetID();
+    const CScript tpcScript = GetScriptForDestination(keyId);
+    const CScript colorScript = CScript() << colorId.toVector() << OP_COLOR << OP_DUP << OP_HASH160 << ToByteVector(keyId) << OP_EQUALVERIFY << OP_CHECKSIG;
+
+    constexpr int64_t timeout_ms = 10 * 1000;
+    {
+        // The index is kept on disk, so that it can be opened again.
+        ColorIndex colorindex(1 << 20);
+        colorindex.Start();
+        int64_t time_start = GetTimeMillis();
+        while (!colorindex.BlockUntilSyncedToCurrentChain()) {
+            BOOST_REQUIRE(time_start + timeout_ms > GetTimeMillis());
+            MilliSleep(100);
+        }
+
+        // The locator is written when the index gets in sync, but not for
+        // this block, as the chainstate is not flushed.
+        CMutableTransaction issueTx;
+        issueTx.nFeatures = 1;
+        issueTx.vin.resize(1);
+        issueTx.vin[0].prevout = COutPoint(m_coinbase_txns[0]->GetHashMalFix(), 0);
+        issueTx.vout.resize(2);
+        issueTx.vout[0] = CTxOut(100, colorScript);
+        issueTx.vout[1] = CTxOut(m_coinbase_txns[0]->vout[0].nValue - 10 * CENT, tpcScript);
+        SignInput(issueTx, 0, coinbaseKey, coinbaseScript, false);
+        CreateAndProcessBlock({issueTx}, tpcScript);
+        BOOST_CHECK(colorindex.BlockUntilSyncedToCurrentChain());
+
+        colorindex.Stop();
+    }
+
+    // Opened again, the index syncs from its locator and is handed the block a second time.
+    ColorIndex colorindex(1 << 20);
+    colorindex.Start();
+    int64_t time_start = GetTimeMillis();
+    while (!colorindex.BlockUntilSyncedToCurrentChain()) {
+        BOOST_REQUIRE(time_start + timeout_ms > GetTimeMillis());
+        MilliSleep(100);
+    }
+
+    ColorStats stats;
+    std::vector<std::pair<COutPoint, ColorUtxo>> utxos;
+    BOOST_CHECK(colorindex.GetColorStats(colorId, stats));
+    BOOST_CHECK_EQUAL(stats.nSupply, 100);
+    BOOST_CHECK_EQUAL(stats.nUtxos, 1U);
+    BOOST_CHECK(colorindex.GetColorUtxos(colorId, utxos));
+    BOOST_CHECK_EQUAL(utxos.size(), 1U);
+
+    colorindex.Stop(); // Stop thread before calling destructor
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -320,4 +320,51 @@ BOOST_AUTO_TEST_CASE(iterator_string_ordering)
 
 
 
+BOOST_AUTO_TEST_CASE(dbwrapper_tuning)
+{
+    const DBTuning defaults(8 << 20);
+    BOOST_CHECK_EQUAL(defaults.block_cache_size, 4U << 20);
+    BOOST_CHECK_EQUAL(defaults.write_buffer_size, 2U << 20);
+    BOOST_CHECK_EQUAL(defaults.bloom_bits, 10);
+    BOOST_CHECK(!defaults.compression);
+
+    // Only the options for the named database are applied.
+    const std::vector<std::string> args{"txindex:compression=0", "txindex:blockcache=16", "chainstate:bloombits=0", "txindex:writebuffer=4", "txindex:bloombits=12"};
+    DBTuning tuning(8 << 20, true);
+    std::string error;
+    BOOST_CHECK(ApplyDBTuningArgs(args, "txindex", tuning, error));
+    BOOST_CHECK_EQUAL(tuning.block_cache_size, 16U << 20);
+    BOOST_CHECK_EQUAL(tuning.write_buffer_size, 4U << 20);
+    BOOST_CHECK_EQUAL(tuning.bloom_bits, 12);
+    BOOST_CHECK(!tuning.compression);
+
+    tuning = DBTuning(8 << 20);
+    BOOST_CHECK(ApplyDBTuningArgs(args, "blockindex", tuning, error));
+    BOOST_CHECK_EQUAL(tuning.block_cache_size, defaults.block_cache_size);
+    BOOST_CHECK_EQUAL(tuning.bloom_bits, defaults.bloom_bits);
+
+    // The largest sizes are clamped rather than wrapped where size_t is 32 bits.
+    BOOST_CHECK(ApplyDBTuningArgs({"blockindex:blockcache=16384"}, "blockindex", tuning, error));
+    BOOST_CHECK_EQUAL(tuning.block_cache_size, std::min<uint64_t>(16384, std::numeric_limits<size_t>::max() >> 20) << 20);
+
+    // Invalid options are rejected whichever database they are for.
+    for (const char* arg : {"txindex", "txindex:bloombits", "wallet:bloombits=1", "txindex:level=1", "txindex:compression=2",
+                            "txindex:blockcache=0", "txindex:bloombits=-1", "txindex:bloombits=x"}) {
+        BOOST_CHECK(!ApplyDBTuningArgs({arg}, "chainstate", tuning, error));
+        BOOST_CHECK(!error.empty());
+        error.clear();
+    }
+
+    // A database opened with a tuning works like any other.
+    fs::path ph = SetDataDir(std::string("dbwrapper_tuning"));
+    tuning = DBTuning(1 << 20, true);
+    tuning.bloom_bits = 0;
+    CDBWrapper dbw(ph, tuning, true, false, true);
+    uint256 in = InsecureRand256();
+    uint256 res;
+    BOOST_CHECK(dbw.Write('k', in));
+    BOOST_CHECK(dbw.Read('k', res));
+    BOOST_CHECK_EQUAL(res.ToString(), in.ToString());
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -28,6 +28,7 @@ struct FederationParamsTestingSetup {
         SetupNetworking();
         InitSignatureCache();
         InitScriptExecutionCache();
+        InitBlockProofCache();
         fCheckBlockIndex = true;
         SetDataDir("tempdir");
         writeTestGenesisBlockToFile(GetDataDir());
@@ -148,4 +149,45 @@ BOOST_AUTO_TEST_CASE(create_genesis_block_one_publickey)
     BOOST_CHECK(aggPubkey.Verify_Schnorr(blockHash, baseChainParams->GenesisBlock().proof));
 }
 
+BOOST_AUTO_TEST_CASE(aggregate_pubkey_height_lookup)
+{
+    auto params = CreateFederationParams(TAPYRUS_OP_MODE::PROD, true);
+    const CPubKey genesisKey = params->GetLatestAggregatePubkey();
+    const std::vector<CPubKey> keys = validPubKeys(3);
+
+    // keys may be read out of order, e.g. while reindexing
+    params->ReadAggregatePubkey(std::vector<unsigned char>(keys[0].begin(), keys[0].end()), 100);
+    params->ReadAggregatePubkey(std::vector<unsigned char>(keys[2].begin(), keys[2].end()), 300);
+    params->ReadAggregatePubkey(std::vector<unsigned char>(keys[1].begin(), keys[1].end()), 200);
+
+    BOOST_CHECK_EQUAL(params->GetAggregatePubkeyHeightList().size(), 4);
+    BOOST_CHECK(params->GetLatestAggregatePubkey() == keys[2]);
+
+    BOOST_CHECK(params->GetAggPubkeyFromHeight(0) == genesisKey);
+    BOOST_CHECK(params->GetAggPubkeyFromHeight(99) == genesisKey);
+    BOOST_CHECK(params->GetAggPubkeyFromHeight(100) == keys[0]);
+    BOOST_CHECK(params->GetAggPubkeyFromHeight(199) == keys[0]);
+    BOOST_CHECK(params->GetAggPubkeyFromHeight(200) == keys[1]);
+    BOOST_CHECK(params->GetAggPubkeyFromHeight(299) == keys[1]);
+    BOOST_CHECK(params->GetAggPubkeyFromHeight(300) == keys[2]);
+    BOOST_CHECK(params->GetAggPubkeyFromHeight(100000) == keys[2]);
+    BOOST_CHECK(params->GetAggPubkeyFromHeight(-1) == keys[2]);
+
+    const aggPubkeyAndHeight entry = params->GetAggPubkeyAndHeightFromHeight(250);
+    BOOST_CHECK(entry.aggpubkey == keys[1]);
+    BOOST_CHECK_EQUAL(entry.height, 200);
+    BOOST_CHECK(entry.aggpubkeyParsed.IsValid());
+
+    BOOST_CHECK_EQUAL(params->GetHeightFromAggregatePubkey(genesisKey), 0);
+    BOOST_CHECK_EQUAL(params->GetHeightFromAggregatePubkey(keys[0]), 100);
+    BOOST_CHECK_EQUAL(params->GetHeightFromAggregatePubkey(keys[1]), 200);
+    BOOST_CHECK_EQUAL(params->GetHeightFromAggregatePubkey(keys[2]), 300);
+    BOOST_CHECK_EQUAL(params->GetHeightFromAggregatePubkey(validPubKeys(4)[3]), -1);
+
+    // a key that comes back later keeps the height it was first used at
+    params->ReadAggregatePubkey(std::vector<unsigned char>(keys[0].begin(), keys[0].end()), 400);
+    BOOST_CHECK(params->GetAggPubkeyFromHeight(400) == keys[0]);
+    BOOST_CHECK_EQUAL(params->GetHeightFromAggregatePubkey(keys[0]), 100);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
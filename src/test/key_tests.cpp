@@ -248,6 +248,45 @@ BOOST_AUTO_TEST_CASE(key_signature_tests)
     BOOST_CHECK(found_small);
 }
 
+BOOST_AUTO_TEST_CASE(schnorr_batch_tests)
+{
+    CSchnorrBatch batch;
+    BOOST_CHECK(batch.empty());
+    BOOST_CHECK(batch.Verify());
+
+    std::vector<CKey> keys(10);
+    std::vector<uint256> hashes(keys.size());
+    std::vector<std::vector<unsigned char>> sigs(keys.size());
+    for (size_t i = 0; i < keys.size(); i++) {
+        keys[i].MakeNewKey(i % 2 == 0);
+        std::string msg = "Batched message " + std::to_string(i);
+        hashes[i] = Hash(msg.begin(), msg.end());
+        BOOST_CHECK(keys[i].Sign_Schnorr(hashes[i], sigs[i]));
+        BOOST_CHECK(batch.Add(keys[i].GetPubKey(), hashes[i], sigs[i]));
+    }
+    BOOST_CHECK_EQUAL(batch.size(), keys.size());
+    BOOST_CHECK(batch.Verify());
+
+    // A signature checked against the wrong key makes the whole batch fail.
+    BOOST_CHECK(batch.Add(keys[1].GetPubKey(), hashes[0], sigs[0]));
+    BOOST_CHECK(!batch.Verify());
+    batch.clear();
+    BOOST_CHECK(batch.Verify());
+
+    // A signature over another message makes the whole batch fail.
+    BOOST_CHECK(batch.Add(keys[0].GetPubKey(), hashes[0], sigs[0]));
+    BOOST_CHECK(batch.Add(keys[2].GetPubKey(), hashes[3], sigs[2]));
+    BOOST_CHECK(!batch.Verify());
+    batch.clear();
+
+    // Malformed input is rejected up front.
+    BOOST_CHECK(!batch.Add(CPubKey(), hashes[0], sigs[0]));
+    std::vector<unsigned char> ecdsa_sig;
+    BOOST_CHECK(keys[0].Sign_ECDSA(hashes[0], ecdsa_sig));
+    BOOST_CHECK(!batch.Add(keys[0].GetPubKey(), hashes[0], ecdsa_sig));
+    BOOST_CHECK(batch.empty());
+}
+
 BOOST_AUTO_TEST_CASE(pubkey_combine_tests)
 {
     auto pubkeys = validPubKeys(15);
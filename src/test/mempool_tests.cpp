@@ -750,4 +750,62 @@ BOOST_AUTO_TEST_CASE(MempoolAncestryTests)
     BOOST_CHECK_EQUAL(descendants, 6ULL);
 }
 
+BOOST_AUTO_TEST_CASE(MempoolColorIndexTest)
+{
+    CTxMemPool pool;
+    LOCK(pool.cs);
+    TestMemPoolEntryHelper entry;
+
+    const ColorIdentifier colorA(CScript() << OP_1);
+    const ColorIdentifier colorB(CScript() << OP_2);
+    auto colorScript = [](const ColorIdentifier& colorId) {
+        return CScript() << colorId.toVector() << OP_COLOR << OP_DUP << OP_HASH160 << ToByteVector(uint160()) << OP_EQUALVERIFY << OP_CHECKSIG;
+    };
+
+    // [tx1] creates outputs of color A
+    CMutableTransaction tx1;
+    tx1.vin.resize(1);
+    tx1.vin[0].scriptSig = CScript() << OP_11;
+    tx1.vout.resize(2);
+    tx1.vout[0] = CTxOut(100, colorScript(colorA));
+    tx1.vout[1] = CTxOut(10 * COIN, CScript() << OP_11 << OP_EQUAL);
+    pool.addUnchecked(tx1.GetHashMalFix(), entry.FromTx(tx1));
+
+    // [tx1].0 <- [tx2] spends color A and creates color B
+    CMutableTransaction tx2;
+    tx2.vin.resize(1);
+    tx2.vin[0].prevout = COutPoint(tx1.GetHashMalFix(), 0);
+    tx2.vout.resize(1);
+    tx2.vout[0] = CTxOut(100, colorScript(colorB));
+    pool.addUnchecked(tx2.GetHashMalFix(), CTxMemPoolEntry(MakeTransactionRef(tx2), 0, 0, 1, false, 4, LockPoints(), {colorA}));
+
+    // [tx1].1 <- [tx3] is uncolored
+    CMutableTransaction tx3;
+    tx3.vin.resize(1);
+    tx3.vin[0].prevout = COutPoint(tx1.GetHashMalFix(), 1);
+    tx3.vout.resize(1);
+    tx3.vout[0] = CTxOut(9 * COIN, CScript() << OP_11 << OP_EQUAL);
+    pool.addUnchecked(tx3.GetHashMalFix(), entry.FromTx(tx3));
+
+    auto hashes = [&](const ColorIdentifier& colorId) {
+        std::set<uint256> result;
+        for (CTxMemPool::txiter it : pool.GetColorEntries(colorId))
+            result.insert(it->GetTx().GetHashMalFix());
+        return result;
+    };
+    BOOST_CHECK(hashes(colorA) == std::set<uint256>({tx1.GetHashMalFix(), tx2.GetHashMalFix()}));
+    BOOST_CHECK(hashes(colorB) == std::set<uint256>({tx2.GetHashMalFix()}));
+    BOOST_CHECK(hashes(ColorIdentifier(CScript() << OP_3)).empty());
+    BOOST_CHECK_EQUAL(pool.mapTx.find(tx2.GetHashMalFix())->GetColorIds().size(), 2U);
+    BOOST_CHECK(pool.mapTx.find(tx3.GetHashMalFix())->GetColorIds().empty());
+
+    // Removing a transaction removes it from the index of each of its colors.
+    pool.removeRecursive(tx2);
+    BOOST_CHECK(hashes(colorA) == std::set<uint256>({tx1.GetHashMalFix()}));
+    BOOST_CHECK(hashes(colorB).empty());
+    pool.removeRecursive(tx1);
+    BOOST_CHECK(hashes(colorA).empty());
+    BOOST_CHECK_EQUAL(pool.size(), 0U);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
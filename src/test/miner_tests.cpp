@@ -13,6 +13,7 @@
 #include <miner.h>
 #include <policy/policy.h>
 #include <pubkey.h>
+#include <script/sigcache.h>
 #include <script/standard.h>
 #include <txmempool.h>
 #include <uint256.h>
@@ -616,4 +617,159 @@ BOOST_AUTO_TEST_CASE(CreateNewBlock_required_age_in_secs)
     BOOST_CHECK(pblocktemplate->block.vtx[1]->GetHashMalFix() == hashPastTimeTx);
 }
 
+static std::vector<uint256> BlockTxids(const CBlock& block)
+{
+    std::vector<uint256> txids;
+    for (size_t i = 1; i < block.vtx.size(); i++)
+        txids.push_back(block.vtx[i]->GetHashMalFix());
+    return txids;
+}
+
+BOOST_AUTO_TEST_CASE(CreateNewBlock_kept_selection)
+{
+    CKey aggregateKey;
+    aggregateKey.Set(validAggPrivateKey, validAggPrivateKey + 32, true);
+    CPubKey aggPubkey;
+    aggPubkey.Set(validAggPubKey, validAggPubKey + 33);
+
+    auto chainParams = FederationParams();
+    chainParams.ReadGenesisBlock(getTestGenesisBlockHex(aggPubkey, aggregateKey));
+    std::unique_ptr<CBlockTemplate> pblocktemplate;
+    int baseheight = 0;
+    std::vector<CTransactionRef> txFirst;
+    CreateBlocks(Params(), pblocktemplate, baseheight, txFirst);
+
+    LOCK(cs_main);
+    LOCK(::mempool.cs);
+
+    BlockAssembler::Options options;
+    options.nBlockMaxWeight = MAX_BLOCK_WEIGHT;
+    options.blockMinFeeRate = blockMinFeeRate;
+    BlockAssembler assembler(Params(), options);
+    assembler.TrackMempool();
+    TestMemPoolEntryHelper entry;
+
+    CMutableTransaction tx;
+    tx.vin.resize(1);
+    tx.vin[0].scriptSig = CScript() << OP_1;
+    tx.vin[0].prevout.hashMalFix = txFirst[0]->GetHashMalFix();
+    tx.vin[0].prevout.n = 0;
+    tx.vout.resize(1);
+    tx.vout[0].nValue = 5000000000LL - 1000;
+    const CTransaction parentTx(tx);
+    mempool.addUnchecked(parentTx.GetHashMalFix(), entry.Fee(1000).Time(GetTime()).SpendsCoinbase(true).FromTx(tx));
+    BOOST_CHECK(pblocktemplate = assembler.CreateNewBlock(scriptPubKey));
+    BOOST_CHECK(BlockTxids(pblocktemplate->block) == std::vector<uint256>({parentTx.GetHashMalFix()}));
+
+    // New transactions are appended to the kept selection, even when a new
+    // selection would put them first.
+    tx.vin[0].prevout.hashMalFix = txFirst[1]->GetHashMalFix();
+    tx.vout[0].nValue = 5000000000LL - 10000;
+    const uint256 hashMediumFeeTx = tx.GetHashMalFix();
+    mempool.addUnchecked(hashMediumFeeTx, entry.Fee(10000).Time(GetTime()).SpendsCoinbase(true).FromTx(tx));
+
+    tx.vin[0].prevout.hashMalFix = parentTx.GetHashMalFix();
+    tx.vout[0].nValue = 5000000000LL - 1000 - 50000;
+    const uint256 hashChildTx = tx.GetHashMalFix();
+    mempool.addUnchecked(hashChildTx, entry.Fee(50000).Time(GetTime()).SpendsCoinbase(false).FromTx(tx));
+
+    // A transaction below the block min fee is left out, as a new selection would.
+    tx.vin[0].prevout.hashMalFix = txFirst[2]->GetHashMalFix();
+    tx.vout[0].nValue = 5000000000LL;
+    const uint256 hashFreeTx = tx.GetHashMalFix();
+    mempool.addUnchecked(hashFreeTx, entry.Fee(0).Time(GetTime()).SpendsCoinbase(true).FromTx(tx));
+
+    BOOST_CHECK(pblocktemplate = assembler.CreateNewBlock(scriptPubKey));
+    BOOST_CHECK(BlockTxids(pblocktemplate->block) == std::vector<uint256>({parentTx.GetHashMalFix(), hashMediumFeeTx, hashChildTx}));
+
+    // A fee delta calls for a new selection, in ancestor fee rate order.
+    mempool.PrioritiseTransaction(hashFreeTx, 100000);
+    BOOST_CHECK(pblocktemplate = assembler.CreateNewBlock(scriptPubKey));
+    std::unique_ptr<CBlockTemplate> fresh = AssemblerForTest(Params()).CreateNewBlock(scriptPubKey);
+    BOOST_CHECK(BlockTxids(pblocktemplate->block) == BlockTxids(fresh->block));
+    BOOST_CHECK_EQUAL(pblocktemplate->block.vtx.size(), 5U);
+    BOOST_CHECK(pblocktemplate->block.vtx[1]->GetHashMalFix() == hashFreeTx);
+
+    // So does the removal of a selected transaction.
+    mempool.removeRecursive(parentTx);
+    BOOST_CHECK(pblocktemplate = assembler.CreateNewBlock(scriptPubKey));
+    BOOST_CHECK(BlockTxids(pblocktemplate->block) == std::vector<uint256>({hashFreeTx, hashMediumFeeTx}));
+
+    // And clearing the mempool.
+    mempool.clear();
+    BOOST_CHECK(pblocktemplate = assembler.CreateNewBlock(scriptPubKey));
+    BOOST_CHECK_EQUAL(pblocktemplate->block.vtx.size(), 1U);
+    mempool.PrioritiseTransaction(hashFreeTx, -100000);
+}
+
+static void SetMerkleRoots(CBlock& block)
+{
+    block.hashMerkleRoot = BlockMerkleRoot(block);
+    block.hashImMerkleRoot = BlockMerkleRoot(block, nullptr, true);
+}
+
+BOOST_FIXTURE_TEST_CASE(TestBlockValidity_script_cache, TestChainSetup)
+{
+    const CScript tpcScript = GetScriptForDestination(coinbaseKey.GetPubKey().GetID());
+    CKey otherKey;
+    otherKey.MakeNewKey(true);
+    auto spend = [&](const CTransactionRef& prevTx, const CKey& key) {
+        CMutableTransaction tx;
+        tx.nFeatures = 1;
+        tx.vin.resize(1);
+        tx.vin[0].prevout = COutPoint(prevTx->GetHashMalFix(), 0);
+        tx.vout.resize(1);
+        tx.vout[0] = CTxOut(prevTx->vout[0].nValue - CENT, tpcScript);
+        SignInput(tx, 0, key, prevTx->vout[0].scriptPubKey, false);
+        return MakeTransactionRef(tx);
+    };
+    const CTransactionRef cachedTx = spend(m_coinbase_txns[0], coinbaseKey);
+    const CTransactionRef uncachedTx = spend(m_coinbase_txns[1], coinbaseKey);
+    const CTransactionRef badTx = spend(m_coinbase_txns[2], otherKey);
+
+    LOCK(cs_main);
+    CValidationState state;
+    BOOST_CHECK(AcceptToMemoryPool(mempool, state, cachedTx, nullptr /* pfMissingInputs */,
+                                   nullptr /* plTxnReplaced */, true /* bypass_limits */, 0 /* nAbsurdFee */));
+    BOOST_CHECK(SignatureCached(*cachedTx, m_coinbase_txns[0]->vout[0]));
+
+    // Start over with an empty signature cache, which a signature only gets
+    // back into when its script is run again.
+    InitSignatureCache();
+    BOOST_CHECK(!SignatureCached(*cachedTx, m_coinbase_txns[0]->vout[0]));
+
+    // CreateNewBlock checks the template with TestBlockValidity, which does not
+    // run the scripts of a transaction in the script execution cache again.
+    std::unique_ptr<CBlockTemplate> pblocktemplate;
+    BOOST_REQUIRE(pblocktemplate = AssemblerForTest(Params()).CreateNewBlock(tpcScript));
+    CBlock block = pblocktemplate->block;
+    BOOST_CHECK_EQUAL(block.vtx.size(), 2U);
+    BOOST_CHECK(!SignatureCached(*cachedTx, m_coinbase_txns[0]->vout[0]));
+
+    // The scripts of any other transaction are run.
+    block.vtx.push_back(uncachedTx);
+    SetMerkleRoots(block);
+    BOOST_CHECK(TestBlockValidity(state, block, chainActive.Tip(), false, true));
+    BOOST_CHECK(SignatureCached(*uncachedTx, m_coinbase_txns[1]->vout[0]));
+    BOOST_CHECK(!SignatureCached(*cachedTx, m_coinbase_txns[0]->vout[0]));
+
+    // So an invalid one is still rejected.
+    block.vtx.push_back(badTx);
+    SetMerkleRoots(block);
+    BOOST_CHECK(!TestBlockValidity(state, block, chainActive.Tip(), false, true));
+    BOOST_CHECK_EQUAL(state.GetRejectReason(), "block-validation-failed");
+
+    // And cached scripts do not exempt a block from the other checks.
+    block.vtx.pop_back();
+    CMutableTransaction coinbaseTx(*block.vtx[0]);
+    coinbaseTx.vout[0].nValue += 2 * CENT + 1;
+    block.vtx[0] = MakeTransactionRef(coinbaseTx);
+    SetMerkleRoots(block);
+    state = CValidationState();
+    BOOST_CHECK(!TestBlockValidity(state, block, chainActive.Tip(), false, true));
+    BOOST_CHECK_EQUAL(state.GetRejectReason(), "bad-cb-amount");
+
+    mempool.clear();
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -9,6 +9,7 @@
 #include <core_io.h>
 #include <key_io.h>
 #include <netbase.h>
+#include <validation.h>
 
 #include <test/test_tapyrus.h>
 
@@ -420,4 +421,44 @@ BOOST_AUTO_TEST_CASE(rpc_getblockstats_calculate_percentiles_by_weight)
     }
 }
 
+BOOST_FIXTURE_TEST_CASE(rpc_blockproposal, TestChainSetup)
+{
+    ColorIdentifier colorId;
+    const std::string address = EncodeDestination(coinbaseKey.GetPubKey().GetID(), colorId);
+    int nHeight;
+    {
+        LOCK(cs_main);
+        nHeight = chainActive.Height();
+    }
+
+    UniValue r = CallRPC("createblockproposal " + address);
+    const std::string hash = find_value(r.get_obj(), "hash").get_str();
+    CBlock block;
+    BOOST_CHECK(DecodeHexBlk(block, find_value(r.get_obj(), "hex").get_str()));
+    BOOST_CHECK_EQUAL(block.GetHashForSign().GetHex(), hash);
+
+    // the proposal must be signed before it is submitted
+    BOOST_CHECK_THROW(CallRPC("submitblockproposal " + hash), std::runtime_error);
+    BOOST_CHECK_THROW(CallRPC("signblockproposal " + uint256().GetHex() + " " + HexStr(std::vector<unsigned char>(64, 1))), std::runtime_error);
+
+    // loading the same block again refers to the same proposal
+    BOOST_CHECK_EQUAL(CallRPC("loadblockproposal " + find_value(r.get_obj(), "hex").get_str()).get_str(), hash);
+
+    std::vector<unsigned char> blockProof;
+    createSignedBlockProof(block, blockProof);
+    r = CallRPC("signblockproposal " + hash + " " + HexStr(blockProof));
+    BOOST_CHECK(find_value(r.get_obj(), "complete").get_bool());
+
+    BOOST_CHECK(CallRPC("submitblockproposal " + hash).isNull());
+    BOOST_CHECK(block.AbsorbBlockProof(blockProof, FederationParams().GetLatestAggregatePubkey()));
+    {
+        LOCK(cs_main);
+        BOOST_CHECK_EQUAL(chainActive.Height(), nHeight + 1);
+        BOOST_CHECK(chainActive.Tip()->GetBlockHash() == block.GetHash());
+    }
+
+    // submitted proposals are forgotten
+    BOOST_CHECK_THROW(CallRPC("submitblockproposal " + hash), std::runtime_error);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -4,6 +4,7 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include <chain.h>
+#include <streams.h>
 #include <util.h>
 #include <test/test_tapyrus.h>
 
@@ -178,4 +179,75 @@ BOOST_AUTO_TEST_CASE(findearliestatleast_edge_test)
     BOOST_CHECK(!chain.FindEarliestAtLeast(int64_t(std::numeric_limits<unsigned int>::max()) + 1));
 }
 
+BOOST_AUTO_TEST_CASE(blockindex_arena)
+{
+    CBlockIndexArena arena;
+    CBlockIndex* first = arena.Allocate(10);
+    CBlockIndex* second = arena.Allocate(5);
+    BOOST_CHECK_EQUAL(arena.Size(), 15U);
+    BOOST_CHECK_EQUAL(arena.Allocate(0), nullptr);
+
+    for (int i = 0; i < 10; i++) {
+        BOOST_CHECK(arena.Owns(first + i));
+        BOOST_CHECK_EQUAL(first[i].nHeight, 0);
+    }
+    for (int i = 0; i < 5; i++) {
+        BOOST_CHECK(arena.Owns(second + i));
+    }
+    BOOST_CHECK(!arena.Owns(nullptr));
+
+    // The end of an array is not owned, with no other array to run into.
+    CBlockIndexArena lone;
+    CBlockIndex* only = lone.Allocate(3);
+    BOOST_CHECK(lone.Owns(only + 2));
+    BOOST_CHECK(!lone.Owns(only + 3));
+    BOOST_CHECK(!lone.Owns(first));
+    BOOST_CHECK(!arena.Owns(only));
+
+    std::unique_ptr<CBlockIndex> single(new CBlockIndex());
+    BOOST_CHECK(!arena.Owns(single.get()));
+
+    arena.Clear();
+    BOOST_CHECK_EQUAL(arena.Size(), 0U);
+    BOOST_CHECK(!arena.Owns(single.get()));
+    BOOST_CHECK(!arena.Owns(first));
+}
+
+BOOST_AUTO_TEST_CASE(blockindex_compact_header)
+{
+    CBlockHeader header;
+    header.nTime = 1234;
+    header.proof = std::vector<unsigned char>(CPubKey::SCHNORR_SIGNATURE_SIZE, 0x42);
+
+    // A Schnorr proof is stored inline and no xfield is allocated.
+    CBlockIndex plain(header);
+    BOOST_CHECK(!plain.pxfield);
+    BOOST_CHECK(plain.GetXField().empty());
+    BOOST_CHECK_EQUAL(plain.DynamicMemoryUsage(), 0U);
+    BOOST_CHECK(plain.GetBlockHeader().proof == header.proof);
+
+    header.xfieldType = 1;
+    header.xfield = std::vector<unsigned char>(CPubKey::COMPRESSED_PUBLIC_KEY_SIZE, 0x02);
+    CBlockIndex withxfield(header);
+    BOOST_CHECK(withxfield.pxfield);
+    BOOST_CHECK(withxfield.GetXField() == header.xfield);
+    BOOST_CHECK(withxfield.DynamicMemoryUsage() > 0);
+
+    // The disk format and the block hash are unchanged.
+    uint256 hash = header.GetHash();
+    withxfield.phashBlock = &hash;
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss << CDiskBlockIndex(&withxfield);
+    CDiskBlockIndex diskindex;
+    ss >> diskindex;
+    BOOST_CHECK(diskindex.GetXField() == header.xfield);
+    BOOST_CHECK(diskindex.proof == withxfield.proof);
+    BOOST_CHECK_EQUAL(diskindex.GetBlockHash(), hash);
+
+    // A proof that does not fit the inline storage still round trips.
+    header.proof = std::vector<unsigned char>(CPubKey::SCHNORR_SIGNATURE_SIZE + 1, 0x43);
+    CBlockIndex large(header);
+    BOOST_CHECK(large.GetBlockHeader().proof == header.proof);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -13,6 +13,7 @@
 #include <validation.h>
 #include <miner.h>
 #include <net_processing.h>
+#include <policy/policy.h>
 #include <ui_interface.h>
 #include <streams.h>
 #include <rpc/server.h>
@@ -58,6 +59,7 @@ BasicTestingSetup::BasicTestingSetup(const std::string& chainName)
     SetupNetworking();
     InitSignatureCache();
     InitScriptExecutionCache();
+    InitBlockProofCache();
     fCheckBlockIndex = true;
     SelectParams(TAPYRUS_OP_MODE::PROD);
     SetDataDir("tempdir");
@@ -103,6 +105,7 @@ TestingSetup::TestingSetup(const std::string& chainName) : BasicTestingSetup(cha
         mempool.setSanityCheck(1.0);
         pblocktree.reset(new CBlockTreeDB(1 << 20, true));
         pcoinsdbview.reset(new CCoinsViewDB(1 << 23, true));
+        pcoinsdbview->StartBackgroundFlush();
         pcoinsTip.reset(new CCoinsViewCache(pcoinsdbview.get()));
         if (!LoadGenesisBlock()) {
             throw std::runtime_error("LoadGenesisBlock failed.");
@@ -114,8 +117,12 @@ TestingSetup::TestingSetup(const std::string& chainName) : BasicTestingSetup(cha
             }
         }
         nScriptCheckThreads = 3;
-        for (int i=0; i < nScriptCheckThreads-1; i++)
+        for (int i=0; i < nScriptCheckThreads-1; i++) {
             threadGroup.create_thread(&ThreadScriptCheck);
+            threadGroup.create_thread(&ThreadMempoolScriptCheck);
+            threadGroup.create_thread(&ThreadHeaderProofCheck);
+            threadGroup.create_thread(&ThreadCoinPrefetch);
+        }
         g_connman = std::unique_ptr<CConnman>(new CConnman(0x1337, 0x1337)); // Deterministic randomness for tests.
         connman = g_connman.get();
         peerLogic.reset(new PeerLogicValidation(connman, scheduler, /*enable_bip61=*/true));
@@ -147,6 +154,27 @@ void createSignedBlockProof(CBlock &block, std::vector<unsigned char>& blockProo
     return;
 }
 
+void SignInput(CMutableTransaction& tx, unsigned int nIn, const CKey& key, const CScript& prevScript, bool fPushPubkey)
+{
+    std::vector<unsigned char> vchSig;
+    uint256 hash = SignatureHash(prevScript, tx, nIn, SIGHASH_ALL, 0, SigVersion::BASE);
+    bool fSigned = key.Sign_Schnorr(hash, vchSig);
+    assert(fSigned);
+    vchSig.push_back((unsigned char)SIGHASH_ALL);
+    tx.vin[nIn].scriptSig = CScript() << vchSig;
+    if (fPushPubkey)
+        tx.vin[nIn].scriptSig << ToByteVector(key.GetPubKey());
+}
+
+bool SignatureCached(const CTransaction& tx, const CTxOut& prevout)
+{
+    PrecomputedTransactionData txdata(tx);
+    CSchnorrBatch batch;
+    CachingTransactionSignatureChecker checker(&tx, 0, prevout.nValue, false, txdata, &batch);
+    ColorIdentifier colorId;
+    return VerifyScript(tx.vin[0].scriptSig, prevout.scriptPubKey, nullptr, STANDARD_SCRIPT_VERIFY_FLAGS, checker, colorId) && batch.empty();
+}
+
 TestChainSetup::TestChainSetup() : TestingSetup(TAPYRUS_MODES::DEV)
 {
     // CreateAndProcessBlock() does not support building SegWit blocks, so don't activate in these tests.
@@ -48,6 +48,14 @@ std::string getTestGenesisBlockHex(const CPubKey& aggregatePubkey,
                                    const CKey& aggregatePrivkey);
 void writeTestGenesisBlockToFile(fs::path genesisPath, std::string genesisFileName="");
 void createSignedBlockProof(CBlock &block, std::vector<unsigned char>& blockProof);
+/** Sign input nIn of tx spending prevScript with a Schnorr signature of key, pushing the public key too if fPushPubkey */
+void SignInput(CMutableTransaction& tx, unsigned int nIn, const CKey& key, const CScript& prevScript, bool fPushPubkey);
+/**
+ * Whether the signature of the first input of tx, spending prevout, is in the
+ * signature cache. A miss is queued in a batch instead of being verified, so
+ * nothing is added; a hit only marks the entry as one that may be overwritten.
+ */
+bool SignatureCached(const CTransaction& tx, const CTxOut& prevout);
 // define an implicit conversion here so that uint256 may be used directly in BOOST_CHECK_*
 std::ostream& operator<<(std::ostream& os, const uint256& num);
 
@@ -20,7 +20,7 @@
 
 #include <boost/test/unit_test.hpp>
 
-bool CheckInputs(const CTransaction& tx, CValidationState &state, const CCoinsViewCache &inputs, bool fScriptChecks, unsigned int flags, bool cacheSigStore, bool cacheFullScriptStore, PrecomputedTransactionData& txdata, TxColoredCoinBalancesMap& inColoredCoinBalances, std::vector<CScriptCheck> *pvChecks);
+bool CheckInputs(const CTransaction& tx, CValidationState &state, const CCoinsViewCache &inputs, bool fScriptChecks, unsigned int flags, bool cacheSigStore, bool cacheFullScriptStore, PrecomputedTransactionData& txdata, TxColoredCoinBalances& inColoredCoinBalances, std::vector<CScriptCheck> *pvChecks);
 
 BOOST_AUTO_TEST_SUITE(tx_validationcache_tests)
 
@@ -108,6 +108,130 @@ BOOST_FIXTURE_TEST_CASE(tx_mempool_block_doublespend, TestChainSetup)
     }
 }
 
+BOOST_FIXTURE_TEST_CASE(tx_mempool_parallel_script_checks, TestChainSetup)
+{
+    // Transactions with MIN_PARALLEL_MEMPOOL_INPUTS inputs have their script
+    // checks run on the script check threads.
+    BOOST_REQUIRE(nScriptCheckThreads > 0);
+    BOOST_REQUIRE(m_coinbase_txns.size() >= MIN_PARALLEL_MEMPOOL_INPUTS);
+    const CScript& coinbaseScript = m_coinbase_txns[0]->vout[0].scriptPubKey;
+    const ColorIdentifier colorId(coinbaseScript);
+    const CKeyID keyId = coinbaseKey.GetPubKey().GetID();
+    const CScript tpcScript = GetScriptForDestination(keyId);
+    const CScript colorScript = CScript() << colorId.toVector() << OP_COLOR << OP_DUP << OP_HASH160 << ToByteVector(keyId) << OP_EQUALVERIFY << OP_CHECKSIG;
+
+    // Issue 100 tokens, spending coinbases.
+    CMutableTransaction issueTx;
+    issueTx.nFeatures = 1;
+    issueTx.vin.resize(MIN_PARALLEL_MEMPOOL_INPUTS);
+    issueTx.vout.resize(MIN_PARALLEL_MEMPOOL_INPUTS);
+    issueTx.vout[0] = CTxOut(100, colorScript);
+    for (unsigned int i = 0; i < MIN_PARALLEL_MEMPOOL_INPUTS; i++) {
+        issueTx.vin[i].prevout = COutPoint(m_coinbase_txns[i]->GetHashMalFix(), 0);
+        if (i > 0)
+            issueTx.vout[i] = CTxOut(m_coinbase_txns[i]->vout[0].nValue - CENT, tpcScript);
+    }
+    for (unsigned int i = 0; i < MIN_PARALLEL_MEMPOOL_INPUTS; i++)
+        SignInput(issueTx, i, coinbaseKey, coinbaseScript, false);
+    BOOST_CHECK(ToMemPool(issueTx));
+
+    // Spend the tokens together with TPC outputs. The token balance check
+    // depends on the colors the script checks found for the inputs.
+    CMutableTransaction transferTx;
+    transferTx.nFeatures = 1;
+    transferTx.vin.resize(MIN_PARALLEL_MEMPOOL_INPUTS);
+    for (unsigned int i = 0; i < MIN_PARALLEL_MEMPOOL_INPUTS; i++)
+        transferTx.vin[i].prevout = COutPoint(issueTx.GetHashMalFix(), i);
+    transferTx.vout.resize(3);
+    transferTx.vout[0] = CTxOut(60, colorScript);
+    transferTx.vout[1] = CTxOut(40, colorScript);
+    transferTx.vout[2] = CTxOut(issueTx.vout[1].nValue - CENT, tpcScript);
+    auto sign = [&](CMutableTransaction& tx) {
+        SignInput(tx, 0, coinbaseKey, colorScript, true);
+        for (unsigned int i = 1; i < MIN_PARALLEL_MEMPOOL_INPUTS; i++)
+            SignInput(tx, i, coinbaseKey, tpcScript, true);
+    };
+
+    // More tokens out than in is rejected.
+    CMutableTransaction inflateTx(transferTx);
+    inflateTx.vout[1].nValue = 41;
+    sign(inflateTx);
+    BOOST_CHECK(!ToMemPool(inflateTx));
+
+    // So is a bad signature on any one input, with the reason of the failing script.
+    CMutableTransaction badSigTx(transferTx);
+    sign(badSigTx);
+    badSigTx.vin[MIN_PARALLEL_MEMPOOL_INPUTS - 1].scriptSig = badSigTx.vin[1].scriptSig;
+    {
+        LOCK(cs_main);
+        CValidationState state;
+        BOOST_CHECK(!AcceptToMemoryPool(mempool, state, MakeTransactionRef(badSigTx), nullptr, nullptr, true, 0));
+        BOOST_CHECK(state.GetRejectReason().find("mandatory-script-verify-flag-failed") == 0);
+    }
+
+    sign(transferTx);
+    BOOST_CHECK(ToMemPool(transferTx));
+    BOOST_CHECK_EQUAL(mempool.size(), 2U);
+
+    // Both are valid in a block.
+    CBlock block = CreateAndProcessBlock({issueTx, transferTx}, tpcScript);
+    BOOST_CHECK(chainActive.Tip()->GetBlockHash() == block.GetHash());
+    BOOST_CHECK_EQUAL(mempool.size(), 0U);
+}
+
+BOOST_FIXTURE_TEST_CASE(tx_mempool_preverify_batch, TestChainSetup)
+{
+    BOOST_REQUIRE(nScriptCheckThreads > 0);
+    const CScript& coinbaseScript = m_coinbase_txns[0]->vout[0].scriptPubKey;
+    const CScript tpcScript = GetScriptForDestination(coinbaseKey.GetPubKey().GetID());
+    CKey otherKey;
+    otherKey.MakeNewKey(true);
+
+    auto spend = [&](const CTransactionRef& prevTx, const CScript& prevScript, const CKey& key, bool fPushPubkey) {
+        CMutableTransaction tx;
+        tx.nFeatures = 1;
+        tx.vin.resize(1);
+        tx.vin[0].prevout = COutPoint(prevTx->GetHashMalFix(), 0);
+        tx.vout.resize(1);
+        tx.vout[0] = CTxOut(prevTx->vout[0].nValue - CENT, tpcScript);
+        SignInput(tx, 0, key, prevScript, fPushPubkey);
+        return MakeTransactionRef(tx);
+    };
+    const CTransactionRef badTx = spend(m_coinbase_txns[0], coinbaseScript, otherKey, false);
+    const CTransactionRef parentTx = spend(m_coinbase_txns[1], coinbaseScript, coinbaseKey, false);
+    const CTransactionRef childTx = spend(parentTx, tpcScript, coinbaseKey, true);
+
+    // Start with an empty coins cache. The child's input is not available
+    // yet, so only the other two transactions are verified ahead.
+    FlushStateToDisk();
+    std::vector<COutPoint> coins_to_uncache;
+    PreverifyMempoolScripts(mempool, {badTx, parentTx, childTx}, coins_to_uncache);
+    {
+        LOCK(cs_main);
+        BOOST_CHECK(pcoinsTip->HaveCoinInCache(badTx->vin[0].prevout));
+        BOOST_CHECK(pcoinsTip->HaveCoinInCache(parentTx->vin[0].prevout));
+    }
+
+    // The valid signature was verified ahead and cached, the invalid one was not.
+    BOOST_CHECK(SignatureCached(*parentTx, m_coinbase_txns[1]->vout[0]));
+    BOOST_CHECK(!SignatureCached(*badTx, m_coinbase_txns[0]->vout[0]));
+    BOOST_CHECK(!SignatureCached(*childTx, parentTx->vout[0]));
+
+    // Submitting them gives the same results as without verifying them ahead.
+    BOOST_CHECK(!ToMemPool(CMutableTransaction(*badTx)));
+    BOOST_CHECK(ToMemPool(CMutableTransaction(*parentTx)));
+    BOOST_CHECK(ToMemPool(CMutableTransaction(*childTx)));
+    BOOST_CHECK_EQUAL(mempool.size(), 2U);
+
+    // Only the coin of the rejected transaction leaves the cache.
+    {
+        LOCK(cs_main);
+        UncacheUnspentCoins(mempool, coins_to_uncache);
+        BOOST_CHECK(!pcoinsTip->HaveCoinInCache(badTx->vin[0].prevout));
+        BOOST_CHECK(pcoinsTip->HaveCoinInCache(parentTx->vin[0].prevout));
+    }
+}
+
 // Run CheckInputs (using pcoinsTip) on the given transaction, for all script
 // flags.  Test that CheckInputs passes for all flags that don't overlap with
 // the failing_flags argument, but otherwise fails.
@@ -122,7 +246,7 @@ BOOST_FIXTURE_TEST_CASE(tx_mempool_block_doublespend, TestChainSetup)
 static void ValidateCheckInputsForAllFlags(const CTransaction &tx, uint32_t failing_flags, bool add_to_cache)
 {
     PrecomputedTransactionData txdata(tx);
-    TxColoredCoinBalancesMap inColoredCoinBalances;
+    TxColoredCoinBalances inColoredCoinBalances;
     constexpr unsigned int test_flags_list[] = {SCRIPT_VERIFY_NONE,
         SCRIPT_VERIFY_SIGPUSHONLY,
         SCRIPT_VERIFY_DISCOURAGE_UPGRADABLE_NOPS,
@@ -172,7 +296,7 @@ BOOST_FIXTURE_TEST_CASE(checkinputs_test, TestChainSetup)
     CBasicKeyStore keystore;
     keystore.AddKey(coinbaseKey);
     keystore.AddCScript(p2pk_scriptPubKey);
-    TxColoredCoinBalancesMap inColoredCoinBalances;
+    TxColoredCoinBalances inColoredCoinBalances;
 
     // flags to test: SCRIPT_VERIFY_CHECKLOCKTIMEVERIFY, SCRIPT_VERIFY_CHECKSEQUENCE_VERIFY, SCRIPT_VERIFY_NULLDUMMY, uncompressed pubkey thing
 
@@ -193,4 +193,192 @@ BOOST_AUTO_TEST_CASE(processnewblock_signals_ordering)
     BOOST_CHECK(chainActive.Tip()->nHeight != 0);
 }
 
+BOOST_AUTO_TEST_CASE(processnewblockheaders_invalid_proof)
+{
+    std::vector<CBlockHeader> headers;
+    uint256 prev_hash = FederationParams().GenesisBlock().GetHash();
+    for (int height = 1; height <= 10; height++) {
+        headers.push_back(GoodBlock(prev_hash, height)->GetBlockHeader());
+        prev_hash = headers.back().GetHash();
+    }
+
+    // corrupt the proof of one header in the middle of the message
+    std::vector<CBlockHeader> bad_headers(headers);
+    bad_headers[5].proof[0] ^= 0x01;
+
+    CValidationState state;
+    CBlockHeader first_invalid;
+    BOOST_CHECK(!ProcessNewBlockHeaders(bad_headers, state, nullptr, &first_invalid));
+    BOOST_CHECK_EQUAL(state.GetRejectReason(), "bad-proof");
+    BOOST_CHECK_EQUAL(first_invalid.GetHash(), bad_headers[5].GetHash());
+    {
+        LOCK(cs_main);
+        BOOST_CHECK(LookupBlockIndex(headers[4].GetHash()) != nullptr);
+        BOOST_CHECK(LookupBlockIndex(bad_headers[5].GetHash()) == nullptr);
+        BOOST_CHECK(LookupBlockIndex(headers[5].GetHash()) == nullptr);
+    }
+
+    // the valid headers are still accepted afterwards
+    CValidationState state2;
+    BOOST_CHECK(ProcessNewBlockHeaders(headers, state2));
+    {
+        LOCK(cs_main);
+        for (const CBlockHeader& header : headers)
+            BOOST_CHECK(LookupBlockIndex(header.GetHash()) != nullptr);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(block_proof_cache)
+{
+    const std::shared_ptr<const CBlock> pblock = GoodBlock(FederationParams().GenesisBlock().GetHash(), 1);
+    const uint256 hash = pblock->GetHashForSign();
+    const CPubKey aggpubkey = FederationParams().GetLatestAggregatePubkey();
+
+    uint256 entry;
+    blockProofCache.ComputeEntry(entry, hash, pblock->proof, aggpubkey);
+    BOOST_CHECK(!blockProofCache.Get(entry));
+
+    // a valid proof is remembered once verified
+    CValidationState state;
+    BOOST_CHECK(CheckBlockHeader(*pblock, state));
+    BOOST_CHECK(blockProofCache.Get(entry));
+    BOOST_CHECK(CheckBlockProof(hash, pblock->proof, aggpubkey));
+
+    // invalid proofs are not
+    std::vector<unsigned char> badProof(pblock->proof);
+    badProof[0] ^= 0x01;
+    BOOST_CHECK(!CheckBlockProof(hash, badProof, aggpubkey));
+    blockProofCache.ComputeEntry(entry, hash, badProof, aggpubkey);
+    BOOST_CHECK(!blockProofCache.Get(entry));
+
+    // the proof is only valid for the block it signs and the key that signed it
+    BOOST_CHECK(!CheckBlockProof(FederationParams().GenesisBlock().GetHashForSign(), pblock->proof, aggpubkey));
+    CKey key;
+    key.MakeNewKey(true);
+    BOOST_CHECK(!CheckBlockProof(hash, pblock->proof, key.GetPubKey()));
+}
+
+BOOST_AUTO_TEST_CASE(prefetch_block_inputs)
+{
+    // Every coin lives in the base cache, so concurrent reads from it never insert.
+    CCoinsView viewDummy;
+    CCoinsViewCache base(&viewDummy);
+    CCoinsViewCache cache(&base);
+
+    CMutableTransaction funding;
+    funding.vin.resize(1);
+    funding.vin[0].prevout = COutPoint(InsecureRand256(), 0);
+    for (int i = 0; i < 4; i++)
+        funding.vout.emplace_back(1000 + i, CScript() << OP_TRUE);
+    const CTransaction fundingTx(funding);
+    AddCoins(base, fundingTx, 1);
+
+    // Already cached coins are not read again.
+    BOOST_CHECK(!cache.AccessCoin(COutPoint(fundingTx.GetHashMalFix(), 3)).IsSpent());
+
+    CBlock block;
+    CMutableTransaction coinbase;
+    coinbase.vin.resize(1);
+    coinbase.vin[0].prevout.SetNull();
+    coinbase.vout.emplace_back(0, CScript() << OP_TRUE);
+    block.vtx.push_back(MakeTransactionRef(coinbase));
+
+    CMutableTransaction spend;
+    for (uint32_t i = 0; i < 4; i++)
+        spend.vin.emplace_back(COutPoint(fundingTx.GetHashMalFix(), i));
+    // A coin that does not exist anywhere.
+    spend.vin.emplace_back(COutPoint(InsecureRand256(), 0));
+    spend.vout.emplace_back(1000, CScript() << OP_TRUE);
+    const CTransactionRef spendTx = MakeTransactionRef(spend);
+    block.vtx.push_back(spendTx);
+
+    // An output created earlier in the same block is not looked up.
+    CMutableTransaction child;
+    child.vin.emplace_back(COutPoint(spendTx->GetHashMalFix(), 0));
+    child.vout.emplace_back(900, CScript() << OP_TRUE);
+    block.vtx.push_back(MakeTransactionRef(child));
+
+    BOOST_CHECK_EQUAL(cache.GetCacheSize(), 1U);
+    BOOST_CHECK_EQUAL(PrefetchBlockInputs(block, cache, base), 3U);
+    BOOST_CHECK_EQUAL(cache.GetCacheSize(), 4U);
+    for (uint32_t i = 0; i < 4; i++) {
+        const COutPoint outpoint(fundingTx.GetHashMalFix(), i);
+        BOOST_CHECK(cache.HaveCoinInCache(outpoint));
+        BOOST_CHECK(cache.AccessCoin(outpoint).out == fundingTx.vout[i]);
+    }
+    BOOST_CHECK(!cache.HaveCoinInCache(COutPoint(spendTx->GetHashMalFix(), 0)));
+
+    // Prefetched coins are not dirty and can be spent like fetched ones.
+    BOOST_CHECK(cache.SpendCoin(COutPoint(fundingTx.GetHashMalFix(), 0)));
+    BOOST_CHECK(cache.Flush());
+    BOOST_CHECK(!base.HaveCoin(COutPoint(fundingTx.GetHashMalFix(), 0)));
+    BOOST_CHECK(base.HaveCoin(COutPoint(fundingTx.GetHashMalFix(), 1)));
+}
+
+BOOST_AUTO_TEST_CASE(load_block_index)
+{
+    std::vector<std::shared_ptr<const CBlock>> blocks;
+    while (blocks.size() < 50) {
+        blocks.clear();
+        BuildChain(FederationParams().GenesisBlock().GetHash(), 1, 15, 10, 500, blocks);
+    }
+
+    bool ignored;
+    CValidationState state;
+    ProcessNewBlock(std::make_shared<CBlock>(FederationParams().GenesisBlock()), true, &ignored);
+    for (const auto& block : blocks) {
+        ProcessNewBlock(block, true, &ignored);
+    }
+    SyncWithValidationInterfaceQueue();
+    BOOST_REQUIRE(FlushStateToDisk(state, FlushStateMode::ALWAYS));
+
+    LOCK(cs_main);
+    struct Entry {
+        uint256 prev;
+        uint256 skip;
+        int height;
+        unsigned int tx;
+        unsigned int chain_tx;
+        uint32_t status;
+        std::vector<unsigned char> xfield;
+        prevector<CPubKey::SCHNORR_SIGNATURE_SIZE, unsigned char> proof;
+    };
+    std::map<uint256, Entry> before;
+    for (const auto& item : mapBlockIndex) {
+        const CBlockIndex* pindex = item.second;
+        before[item.first] = Entry{pindex->pprev ? pindex->pprev->GetBlockHash() : uint256(),
+                                   pindex->pskip ? pindex->pskip->GetBlockHash() : uint256(),
+                                   pindex->nHeight, pindex->nTx, pindex->nChainTx, pindex->nStatus, pindex->GetXField(), pindex->proof};
+    }
+    const uint256 tip = chainActive.Tip()->GetBlockHash();
+
+    UnloadBlockIndex();
+    BOOST_CHECK(mapBlockIndex.empty());
+    BOOST_CHECK_EQUAL(g_chainstate.blockIndexArena.Size(), 0U);
+    BOOST_REQUIRE(LoadBlockIndex());
+
+    // Every entry is reloaded into the arena with the same links and state.
+    BOOST_CHECK_EQUAL(mapBlockIndex.size(), before.size());
+    BOOST_CHECK_EQUAL(g_chainstate.blockIndexArena.Size(), before.size());
+    for (const auto& item : mapBlockIndex) {
+        const CBlockIndex* pindex = item.second;
+        BOOST_CHECK(g_chainstate.blockIndexArena.Owns(pindex));
+        BOOST_CHECK_EQUAL(pindex->GetBlockHash(), item.first);
+        auto it = before.find(item.first);
+        BOOST_REQUIRE(it != before.end());
+        const Entry& entry = it->second;
+        BOOST_CHECK_EQUAL(pindex->pprev ? pindex->pprev->GetBlockHash() : uint256(), entry.prev);
+        BOOST_CHECK_EQUAL(pindex->pskip ? pindex->pskip->GetBlockHash() : uint256(), entry.skip);
+        BOOST_CHECK_EQUAL(pindex->nHeight, entry.height);
+        BOOST_CHECK_EQUAL(pindex->nTx, entry.tx);
+        BOOST_CHECK_EQUAL(pindex->nChainTx, entry.chain_tx);
+        BOOST_CHECK_EQUAL(pindex->nStatus, entry.status);
+        BOOST_CHECK(pindex->GetXField() == entry.xfield);
+        BOOST_CHECK(pindex->proof == entry.proof);
+    }
+
+    BOOST_REQUIRE(LoadChainTip());
+    BOOST_CHECK_EQUAL(chainActive.Tip()->GetBlockHash(), tip);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
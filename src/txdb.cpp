@@ -14,6 +14,10 @@
 #include <util.h>
 #include <ui_interface.h>
 
+#include <atomic>
+#include <exception>
+#include <system_error>
+#include <thread>
 #include <stdint.h>
 
 #include <boost/thread.hpp>
@@ -53,19 +57,61 @@ struct CoinEntry {
 
 }
 
-CCoinsViewDB::CCoinsViewDB(size_t nCacheSize, bool fMemory, bool fWipe) : db(GetDataDir() / "chainstate", nCacheSize, fMemory, fWipe, true)
+CCoinsViewDB::CCoinsViewDB(size_t nCacheSize, bool fMemory, bool fWipe) : db(GetDataDir() / "chainstate", GetDBTuning("chainstate", nCacheSize), fMemory, fWipe, true)
 {
 }
 
+CCoinsViewDB::~CCoinsViewDB()
+{
+    {
+        WaitableLock lock(cs_flush);
+        m_stop_flush = true;
+    }
+    cv_flush.notify_all();
+    // The thread writes out any pending coins before it returns.
+    if (m_flush_thread.joinable())
+        m_flush_thread.join();
+}
+
+std::shared_ptr<const CCoinsMap> CCoinsViewDB::PendingCoins() const {
+    WaitableLock lock(cs_flush);
+    return m_pending_coins;
+}
+
 bool CCoinsViewDB::GetCoin(const COutPoint &outpoint, Coin &coin) const {
+    std::shared_ptr<const CCoinsMap> pending = PendingCoins();
+    if (pending) {
+        CCoinsMap::const_iterator it = pending->find(outpoint);
+        if (it != pending->end() && (it->second.flags & CCoinsCacheEntry::DIRTY)) {
+            if (it->second.coin.IsSpent())
+                return false;
+            coin = it->second.coin;
+            return true;
+        }
+    }
     return db.Read(CoinEntry(&outpoint), coin);
 }
 
 bool CCoinsViewDB::HaveCoin(const COutPoint &outpoint) const {
+    std::shared_ptr<const CCoinsMap> pending = PendingCoins();
+    if (pending) {
+        CCoinsMap::const_iterator it = pending->find(outpoint);
+        if (it != pending->end() && (it->second.flags & CCoinsCacheEntry::DIRTY))
+            return !it->second.coin.IsSpent();
+    }
     return db.Exists(CoinEntry(&outpoint));
 }
 
 uint256 CCoinsViewDB::GetBestBlock() const {
+    {
+        WaitableLock lock(cs_flush);
+        if (m_pending_coins)
+            return m_pending_block;
+    }
+    return ReadBestBlock();
+}
+
+uint256 CCoinsViewDB::ReadBestBlock() const {
     uint256 hashBestChain;
     if (!db.Read(DB_BEST_BLOCK, hashBestChain))
         return uint256();
@@ -81,6 +127,94 @@ std::vector<uint256> CCoinsViewDB::GetHeadBlocks() const {
 }
 
 bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) {
+    if (!m_flush_thread.joinable())
+        return WriteCoins(mapCoins, hashBlock, true);
+
+    WaitableLock lock(cs_flush);
+    // Only block if the cache filled up again before the last write finished.
+    cv_flush.wait(lock, [this]() { return !m_pending_coins || m_flush_failed; });
+    if (m_flush_failed)
+        return false;
+    // mapCoins still shares the node pool afterwards; CCoinsViewCache::Flush
+    // gives its map a new one before touching it again.
+    m_pending_coins = std::make_shared<CCoinsMap>(std::move(mapCoins));
+    mapCoins.clear();
+    m_pending_block = hashBlock;
+    cv_flush.notify_all();
+    return true;
+}
+
+bool CCoinsViewDB::SyncPendingWrites() const {
+    WaitableLock lock(cs_flush);
+    cv_flush.wait(lock, [this]() { return !m_pending_coins || m_flush_failed; });
+    return !m_flush_failed;
+}
+
+void CCoinsViewDB::AfterPendingWrites(std::function<void()> fn) {
+    {
+        WaitableLock lock(cs_flush);
+        if (m_flush_failed)
+            return;
+        if (m_pending_coins) {
+            m_pending_callbacks.push_back(std::move(fn));
+            return;
+        }
+    }
+    fn();
+}
+
+void CCoinsViewDB::StartBackgroundFlush() {
+    assert(!m_flush_thread.joinable());
+    m_flush_thread = std::thread(&CCoinsViewDB::ThreadFlush, this);
+}
+
+void CCoinsViewDB::ThreadFlush() {
+    RenameThread("tapyrus-coinsdb");
+    while (true) {
+        std::shared_ptr<CCoinsMap> pending;
+        uint256 hashBlock;
+        {
+            WaitableLock lock(cs_flush);
+            cv_flush.wait(lock, [this]() { return m_stop_flush || (m_pending_coins && !m_flush_failed); });
+            if (!m_pending_coins || m_flush_failed)
+                return;
+            pending = m_pending_coins;
+            hashBlock = m_pending_block;
+        }
+        // Readers may look at the pending coins concurrently, so leave them in place.
+        bool fOk = false;
+        try {
+            fOk = WriteCoins(*pending, hashBlock, false);
+        } catch (const std::exception& e) {
+            LogPrintf("%s: %s\n", __func__, e.what());
+        }
+        std::vector<std::function<void()>> callbacks;
+        while (true) {
+            {
+                WaitableLock lock(cs_flush);
+                callbacks.clear();
+                callbacks.swap(m_pending_callbacks);
+                if (!fOk) {
+                    // Keep answering from the pending coins; the next flush reports the failure.
+                    LogPrintf("%s: failed to write to coin database\n", __func__);
+                    m_flush_failed = true;
+                    break;
+                }
+                if (callbacks.empty()) {
+                    m_pending_coins.reset();
+                    m_pending_block.SetNull();
+                    break;
+                }
+            }
+            // Before the pending coins are released, so that they are done when SyncPendingWrites returns.
+            for (const auto& fn : callbacks)
+                fn();
+        }
+        cv_flush.notify_all();
+    }
+}
+
+bool CCoinsViewDB::WriteCoins(CCoinsMap &mapCoins, const uint256 &hashBlock, bool fErase) {
     CDBBatch batch(db);
     size_t count = 0;
     size_t changed = 0;
@@ -88,7 +222,7 @@ bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) {
     int crash_simulate = gArgs.GetArg("-dbcrashratio", 0);
     assert(!hashBlock.IsNull());
 
-    uint256 old_tip = GetBestBlock();
+    uint256 old_tip = ReadBestBlock();
     if (old_tip.IsNull()) {
         // We may be in the middle of replaying.
         std::vector<uint256> old_heads = GetHeadBlocks();
@@ -115,8 +249,12 @@ bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) {
             changed++;
         }
         count++;
-        CCoinsMap::iterator itOld = it++;
-        mapCoins.erase(itOld);
+        if (fErase) {
+            CCoinsMap::iterator itOld = it++;
+            mapCoins.erase(itOld);
+        } else {
+            ++it;
+        }
         if (batch.SizeEstimate() > batch_size) {
             LogPrint(BCLog::COINDB, "Writing partial batch of %.2f MiB\n", batch.SizeEstimate() * (1.0 / 1048576.0));
             db.WriteBatch(batch);
@@ -146,7 +284,7 @@ size_t CCoinsViewDB::EstimateSize() const
     return db.EstimateSize(DB_COIN, (char)(DB_COIN+1));
 }
 
-CBlockTreeDB::CBlockTreeDB(size_t nCacheSize, bool fMemory, bool fWipe) : CDBWrapper(gArgs.IsArgSet("-blocksdir") ? GetDataDir() / "blocks" / "index" : GetBlocksDir() / "index", nCacheSize, fMemory, fWipe) {
+CBlockTreeDB::CBlockTreeDB(size_t nCacheSize, bool fMemory, bool fWipe) : CDBWrapper(gArgs.IsArgSet("-blocksdir") ? GetDataDir() / "blocks" / "index" : GetBlocksDir() / "index", GetDBTuning("blockindex", nCacheSize), fMemory, fWipe) {
 }
 
 bool CBlockTreeDB::ReadBlockFileInfo(int nFile, CBlockFileInfo &info) {
@@ -170,20 +308,57 @@ bool CBlockTreeDB::ReadLastBlockFile(int &nFile) {
 
 CCoinsViewCursor *CCoinsViewDB::Cursor() const
 {
-    CCoinsViewDBCursor *i = new CCoinsViewDBCursor(const_cast<CDBWrapper&>(db).NewIterator(), GetBestBlock());
+    // The cursor reads the database itself, so let pending coins land first.
+    SyncPendingWrites();
+    CCoinsViewDBCursor *i = new CCoinsViewDBCursor(const_cast<CDBWrapper&>(db).NewIterator(), ReadBestBlock());
     /* It seems that there are no "const iterators" for LevelDB.  Since we
        only need read operations on it, use a const-cast to get around
        that restriction.  */
     i->pcursor->Seek(DB_COIN);
     // Cache key of first record
-    if (i->pcursor->Valid()) {
-        CoinEntry entry(&i->keyTmp.second);
-        i->pcursor->GetKey(entry);
-        i->keyTmp.first = entry.key;
+    i->CacheKey();
+    return i;
+}
+
+std::vector<std::unique_ptr<CCoinsViewCursor>> CCoinsViewDB::RangeCursors(int nRanges) const
+{
+    SyncPendingWrites();
+    CDBWrapper& dbw = const_cast<CDBWrapper&>(db);
+    std::shared_ptr<const leveldb::Snapshot> snapshot(dbw.GetSnapshot(), [&dbw](const leveldb::Snapshot* p) { dbw.ReleaseSnapshot(p); });
+
+    // Read the best block from the snapshot too, so that it matches the coins.
+    uint256 hashBestChain;
+    {
+        std::unique_ptr<CDBIterator> pcursor(dbw.NewIterator(snapshot.get()));
+        pcursor->Seek(DB_BEST_BLOCK);
+        char key;
+        if (!pcursor->Valid() || !pcursor->GetKey(key) || key != DB_BEST_BLOCK || !pcursor->GetValue(hashBestChain))
+            hashBestChain.SetNull();
+    }
+
+    // All outputs of a transaction share their txid, so no range splits them.
+    nRanges = std::max(1, std::min(nRanges, 256));
+    std::vector<std::unique_ptr<CCoinsViewCursor>> cursors;
+    cursors.reserve(nRanges);
+    for (int i = 0; i < nRanges; i++) {
+        uint256 hashBegin;
+        *hashBegin.begin() = 256 * i / nRanges;
+        CCoinsViewDBCursor* pcursor = new CCoinsViewDBCursor(dbw.NewIterator(snapshot.get()), hashBestChain, snapshot, 256 * (i + 1) / nRanges);
+        cursors.emplace_back(pcursor);
+        pcursor->pcursor->Seek(std::make_pair(DB_COIN, hashBegin));
+        pcursor->CacheKey();
+    }
+    return cursors;
+}
+
+void CCoinsViewDBCursor::CacheKey()
+{
+    CoinEntry entry(&keyTmp.second);
+    if (!pcursor->Valid() || !pcursor->GetKey(entry) || (entry.key == DB_COIN && *keyTmp.second.hashMalFix.begin() >= nEnd)) {
+        keyTmp.first = 0; // Make sure Valid() and GetKey() return false
     } else {
-        i->keyTmp.first = 0; // Make sure Valid() and GetKey() return false
+        keyTmp.first = entry.key;
     }
-    return i;
 }
 
 bool CCoinsViewDBCursor::GetKey(COutPoint &key) const
@@ -214,12 +389,7 @@ bool CCoinsViewDBCursor::Valid() const
 void CCoinsViewDBCursor::Next()
 {
     pcursor->Next();
-    CoinEntry entry(&keyTmp.second);
-    if (!pcursor->Valid() || !pcursor->GetKey(entry)) {
-        keyTmp.first = 0; // Invalidate cached key after last record so that Valid() and GetKey() return false
-    } else {
-        keyTmp.first = entry.key;
-    }
+    CacheKey();
 }
 
 bool CBlockTreeDB::WriteBatchSync(const std::vector<std::pair<int, const CBlockFileInfo*> >& fileInfo, int nLastFile, const std::vector<const CBlockIndex*>& blockinfo) {
@@ -246,45 +416,134 @@ bool CBlockTreeDB::ReadFlag(const std::string &name, bool &fValue) {
     return true;
 }
 
-bool CBlockTreeDB::LoadBlockIndexGuts(std::function<CBlockIndex*(const uint256&)> insertBlockIndex)
+/**
+ * Call fn(begin, end) for nThreads even parts of [0, count), the calling thread doing the first.
+ * All threads are joined before returning; the first exception thrown by any part is then rethrown.
+ */
+static void ForEachRangeInParallel(size_t count, int nThreads, const std::function<void(size_t, size_t)>& fn)
 {
+    const size_t nParts = std::max<size_t>(1, std::min<size_t>(std::max(nThreads, 1), count));
+    std::vector<std::exception_ptr> errors(nParts);
+    auto run = [&](size_t part) {
+        try {
+            fn(count * part / nParts, count * (part + 1) / nParts);
+        } catch (...) {
+            errors[part] = std::current_exception();
+        }
+    };
+    std::vector<std::thread> threads;
+    threads.reserve(nParts - 1);
+    size_t part = 1;
+    try {
+        for (; part < nParts; part++) {
+            threads.emplace_back(run, part);
+        }
+    } catch (const std::system_error&) {
+        // Out of threads; the parts that did not get one are done here.
+    }
+    run(0);
+    for (; part < nParts; part++) {
+        run(part);
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    for (const std::exception_ptr& error : errors) {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+}
+
+bool CBlockTreeDB::LoadBlockIndexGuts(CBlockIndexArena& arena, int nThreads, std::function<CBlockIndex*(const uint256&, CBlockIndex*)> insertBlockIndex)
+{
+    // Records per batch; bounds the raw records held in memory at once.
+    static const size_t BATCH_SIZE = 1 << 16;
+
     std::unique_ptr<CDBIterator> pcursor(NewIterator());
 
     pcursor->Seek(std::make_pair(DB_BLOCK_INDEX, uint256()));
 
+    // Parent hashes are resolved once every entry is known.
+    std::vector<std::pair<CBlockIndex*, uint256>> vPrev;
+    std::vector<std::vector<unsigned char>> vValues;
+    std::vector<uint256> vHashes;
+    vValues.reserve(BATCH_SIZE);
+
     // Load mapBlockIndex
-    while (pcursor->Valid()) {
+    bool fDone = false;
+    while (!fDone) {
         boost::this_thread::interruption_point();
-        std::pair<char, uint256> key;
-        if (pcursor->GetKey(key) && key.first == DB_BLOCK_INDEX) {
-            CDiskBlockIndex diskindex;
-            if (pcursor->GetValue(diskindex)) {
-                // Construct block index object
-                CBlockIndex* pindexNew = insertBlockIndex(diskindex.GetBlockHash());
-                pindexNew->pprev          = insertBlockIndex(diskindex.hashPrev);
-                pindexNew->nHeight        = diskindex.nHeight;
-                pindexNew->nFile          = diskindex.nFile;
-                pindexNew->nDataPos       = diskindex.nDataPos;
-                pindexNew->nUndoPos       = diskindex.nUndoPos;
-                pindexNew->nFeatures      = diskindex.nFeatures;
-                pindexNew->hashMerkleRoot = diskindex.hashMerkleRoot;
-                pindexNew->hashImMerkleRoot = diskindex.hashImMerkleRoot;
-                pindexNew->nTime          = diskindex.nTime;
-                pindexNew->xfieldType          = diskindex.xfieldType;
-                pindexNew->xfield         = diskindex.xfield;
-                pindexNew->proof          = diskindex.proof;
-                pindexNew->nStatus        = diskindex.nStatus;
-                pindexNew->nTx            = diskindex.nTx;
-
-                // TODO: Check a proof of Signed Blocks in a block header in here
-
-                pcursor->Next();
-            } else {
-                return error("%s: failed to read value", __func__);
+
+        // Read the raw records of one batch.
+        vValues.clear();
+        while (vValues.size() < BATCH_SIZE) {
+            std::pair<char, uint256> key;
+            if (!pcursor->Valid() || !pcursor->GetKey(key) || key.first != DB_BLOCK_INDEX) {
+                fDone = true;
+                break;
             }
-        } else {
+            vValues.emplace_back();
+            pcursor->GetValueBytes(vValues.back());
+            pcursor->Next();
+        }
+        if (vValues.empty()) {
             break;
         }
+
+        // Decode and hash them in parallel, straight into their block index entries.
+        CBlockIndex* pindexBatch = arena.Allocate(vValues.size());
+        vHashes.assign(vValues.size(), uint256());
+        const size_t nPrevOffset = vPrev.size();
+        vPrev.resize(nPrevOffset + vValues.size());
+        std::atomic<bool> fFailed(false);
+        try {
+            ForEachRangeInParallel(vValues.size(), nThreads, [&](size_t begin, size_t end) {
+                for (size_t i = begin; i < end && !fFailed; i++) {
+                    CDiskBlockIndex diskindex;
+                    try {
+                        CSpanReader reader(SER_DISK, CLIENT_VERSION, Span<const unsigned char>(vValues[i].data(), vValues[i].size()));
+                        reader >> diskindex;
+                    } catch (const std::exception&) {
+                        fFailed = true;
+                        break;
+                    }
+                    vHashes[i] = diskindex.GetBlockHash();
+                    vPrev[nPrevOffset + i] = std::make_pair(&pindexBatch[i], diskindex.hashPrev);
+
+                    // Construct block index object
+                    CBlockIndex* pindexNew = &pindexBatch[i];
+                    pindexNew->nHeight        = diskindex.nHeight;
+                    pindexNew->nFile          = diskindex.nFile;
+                    pindexNew->nDataPos       = diskindex.nDataPos;
+                    pindexNew->nUndoPos       = diskindex.nUndoPos;
+                    pindexNew->nFeatures      = diskindex.nFeatures;
+                    pindexNew->hashMerkleRoot = diskindex.hashMerkleRoot;
+                    pindexNew->hashImMerkleRoot = diskindex.hashImMerkleRoot;
+                    pindexNew->nTime          = diskindex.nTime;
+                    pindexNew->xfieldType     = diskindex.xfieldType;
+                    pindexNew->pxfield        = std::move(diskindex.pxfield);
+                    pindexNew->proof          = std::move(diskindex.proof);
+                    pindexNew->nStatus        = diskindex.nStatus;
+                    pindexNew->nTx            = diskindex.nTx;
+
+                    // TODO: Check a proof of Signed Blocks in a block header in here
+                }
+            });
+        } catch (const std::exception& e) {
+            return error("%s: %s", __func__, e.what());
+        }
+        if (fFailed) {
+            return error("%s: failed to read value", __func__);
+        }
+
+        for (size_t i = 0; i < vValues.size(); i++) {
+            insertBlockIndex(vHashes[i], &pindexBatch[i]);
+        }
+    }
+
+    for (const std::pair<CBlockIndex*, uint256>& prev : vPrev) {
+        prev.first->pprev = insertBlockIndex(prev.second, nullptr);
     }
 
     return true;
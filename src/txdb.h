@@ -11,10 +11,13 @@
 #include <dbwrapper.h>
 #include <chain.h>
 #include <primitives/block.h>
+#include <sync.h>
 
+#include <functional>
 #include <map>
 #include <memory>
 #include <string>
+#include <thread>
 #include <utility>
 #include <vector>
 
@@ -28,6 +31,8 @@ static constexpr int MAX_BLOCK_COINSDB_USAGE = 10;
 static const int64_t nDefaultDbCache = 450;
 //! -dbbatchsize default (bytes)
 static const int64_t nDefaultDbBatchSize = 16 << 20;
+//! -dbasyncflush default
+static const bool DEFAULT_DB_ASYNC_FLUSH = true;
 //! max. -dbcache (MiB)
 static const int64_t nMaxDbCache = sizeof(void*) > 4 ? 16384 : 1024;
 //! min. -dbcache (MiB)
@@ -38,6 +43,10 @@ static const int64_t nMaxBlockDBCache = 2;
 // Unlike for the UTXO database, for the txindex scenario the leveldb cache make
 // a meaningful difference: https://github.com/bitcoin/bitcoin/pull/8273#issuecomment-229601991
 static const int64_t nMaxTxIndexCache = 1024;
+//! Max memory allocated to color index DB specific cache, if -colorindex (MiB)
+static const int64_t nMaxColorIndexCache = 256;
+//! Max memory allocated to coin stats index DB specific cache, if -coinstatsindex (MiB)
+static const int64_t nMaxCoinStatsIndexCache = 8;
 //! Max memory allocated to coin DB specific cache (MiB)
 static const int64_t nMaxCoinsDBCache = 8;
 
@@ -48,6 +57,7 @@ protected:
     CDBWrapper db;
 public:
     explicit CCoinsViewDB(size_t nCacheSize, bool fMemory = false, bool fWipe = false);
+    ~CCoinsViewDB();
 
     bool GetCoin(const COutPoint &outpoint, Coin &coin) const override;
     bool HaveCoin(const COutPoint &outpoint) const override;
@@ -55,10 +65,50 @@ public:
     std::vector<uint256> GetHeadBlocks() const override;
     bool BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) override;
     CCoinsViewCursor *Cursor() const override;
+    //! Split on the first byte of the txid, reading all ranges from one snapshot of the database.
+    std::vector<std::unique_ptr<CCoinsViewCursor>> RangeCursors(int nRanges) const override;
 
     //! Attempt to update from an older database format. Returns whether an error occurred.
     bool Upgrade();
     size_t EstimateSize() const override;
+
+    /**
+     * From now on, let BatchWrite hand the coins over to a background thread
+     * and return without waiting for the disk. The thread writes them with the
+     * same partial batches and head block markers as a synchronous write.
+     * Until it is done, GetCoin, HaveCoin and GetBestBlock answer from the
+     * handed over coins. Only one write is in flight at a time: BatchWrite
+     * waits for the previous one to finish first.
+     */
+    void StartBackgroundFlush();
+
+    //! Wait until every coin passed to BatchWrite is on disk. Returns false if writing failed.
+    bool SyncPendingWrites() const;
+
+    /**
+     * Call fn once every coin passed to BatchWrite so far is on disk: at once
+     * if nothing is being written, otherwise from the writing thread before
+     * SyncPendingWrites returns. fn is dropped if writing fails.
+     */
+    void AfterPendingWrites(std::function<void()> fn);
+
+private:
+    uint256 ReadBestBlock() const;
+    //! Write mapCoins to the database, erasing the entries written if fErase is set.
+    bool WriteCoins(CCoinsMap &mapCoins, const uint256 &hashBlock, bool fErase);
+    //! Coins being written by the background thread, or null.
+    std::shared_ptr<const CCoinsMap> PendingCoins() const;
+    void ThreadFlush();
+
+    mutable CWaitableCriticalSection cs_flush;
+    mutable CConditionVariable cv_flush;
+    std::shared_ptr<CCoinsMap> m_pending_coins GUARDED_BY(cs_flush);
+    uint256 m_pending_block GUARDED_BY(cs_flush);
+    //! Called once m_pending_coins are written
+    std::vector<std::function<void()>> m_pending_callbacks GUARDED_BY(cs_flush);
+    bool m_flush_failed GUARDED_BY(cs_flush) = false;
+    bool m_stop_flush GUARDED_BY(cs_flush) = false;
+    std::thread m_flush_thread;
 };
 
 /** Specialization of CCoinsViewCursor to iterate over a CCoinsViewDB */
@@ -75,10 +125,17 @@ public:
     void Next() override;
 
 private:
-    CCoinsViewDBCursor(CDBIterator* pcursorIn, const uint256 &hashBlockIn):
-        CCoinsViewCursor(hashBlockIn), pcursor(pcursorIn) {}
+    CCoinsViewDBCursor(CDBIterator* pcursorIn, const uint256 &hashBlockIn, std::shared_ptr<const leveldb::Snapshot> snapshotIn = nullptr, int nEndIn = 256):
+        CCoinsViewCursor(hashBlockIn), snapshot(std::move(snapshotIn)), pcursor(pcursorIn), nEnd(nEndIn) {}
+    //! Snapshot pcursor reads from, if any. Declared first to outlive pcursor.
+    std::shared_ptr<const leveldb::Snapshot> snapshot;
     std::unique_ptr<CDBIterator> pcursor;
     std::pair<char, COutPoint> keyTmp;
+    //! The cursor ends before the first txid whose first byte is nEnd or more.
+    int nEnd;
+
+    //! Cache the key of the current record, or invalidate the cursor past its last one.
+    void CacheKey();
 
     friend class CCoinsViewDB;
 };
@@ -96,7 +153,14 @@ public:
     void ReadReindexing(bool &fReindexing);
     bool WriteFlag(const std::string &name, bool fValue);
     bool ReadFlag(const std::string &name, bool &fValue);
-    bool LoadBlockIndexGuts(std::function<CBlockIndex*(const uint256&)> insertBlockIndex);
+    /**
+     * Load every block index entry. Records are read in batches. The entries
+     * of a batch are allocated together from arena and decoded, block hash
+     * included, on nThreads threads. insertBlockIndex(hash, pindex) adds each
+     * decoded entry to the block index. Once all are added, it is called with
+     * pindex == nullptr to find, or create, the parent of every entry.
+     */
+    bool LoadBlockIndexGuts(CBlockIndexArena& arena, int nThreads, std::function<CBlockIndex*(const uint256&, CBlockIndex*)> insertBlockIndex);
 };
 
 #endif // BITCOIN_TXDB_H
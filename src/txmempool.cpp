@@ -21,12 +21,25 @@
 
 CTxMemPoolEntry::CTxMemPoolEntry(const CTransactionRef& _tx, const CAmount& _nFee,
                                  int64_t _nTime, unsigned int _entryHeight,
-                                 bool _spendsCoinbase, int64_t _sigOpsCost, LockPoints lp):
+                                 bool _spendsCoinbase, int64_t _sigOpsCost, LockPoints lp,
+                                 const std::vector<ColorIdentifier>& spentColorIds):
     tx(_tx), nFee(_nFee), nTime(_nTime), entryHeight(_entryHeight),
     spendsCoinbase(_spendsCoinbase), sigOpCost(_sigOpsCost), lockPoints(lp)
 {
+    for (const ColorIdentifier& colorId : tx->GetColorIds()) {
+        if (colorId.type != TokenTypes::NONE)
+            colorIds.push_back(colorId);
+    }
+    for (const ColorIdentifier& colorId : spentColorIds) {
+        if (colorId.type != TokenTypes::NONE)
+            colorIds.push_back(colorId);
+    }
+    std::sort(colorIds.begin(), colorIds.end(), ColorIdentifierCompare());
+    colorIds.erase(std::unique(colorIds.begin(), colorIds.end()), colorIds.end());
+    colorIds.shrink_to_fit();
+
     nTxWeight = GetTransactionWeight(*tx);
-    nUsageSize = RecursiveDynamicUsage(tx);
+    nUsageSize = RecursiveDynamicUsage(tx) + memusage::DynamicUsage(colorIds);
 
     nCountWithDescendants = 1;
     nSizeWithDescendants = GetTxSize();
@@ -387,6 +400,11 @@ void CTxMemPool::addUnchecked(const uint256& hash, const CTxMemPoolEntry &entry,
         mapNextTx.insert(std::make_pair(&tx.vin[i].prevout, &tx));
         setParentTransactions.insert(tx.vin[i].prevout.hashMalFix);
     }
+    for (const ColorIdentifier& colorId : newit->GetColorIds()) {
+        setEntries& colorEntries = mapColorTx[colorId];
+        colorEntries.insert(newit);
+        cachedInnerUsage += memusage::IncrementalDynamicUsage(colorEntries);
+    }
     // Don't bother worrying about child transactions of this one.
     // Normal case of a new transaction arriving is that there can't be any
     // children, because such children would be orphans.
@@ -418,6 +436,13 @@ void CTxMemPool::removeUnchecked(txiter it, MemPoolRemovalReason reason)
     const uint256 hash = it->GetTx().GetHashMalFix();
     for (const CTxIn& txin : it->GetTx().vin)
         mapNextTx.erase(txin.prevout);
+    for (const ColorIdentifier& colorId : it->GetColorIds()) {
+        colorTxMap::iterator colorit = mapColorTx.find(colorId);
+        colorit->second.erase(it);
+        cachedInnerUsage -= memusage::IncrementalDynamicUsage(colorit->second);
+        if (colorit->second.empty())
+            mapColorTx.erase(colorit);
+    }
 
     if (vTxHashes.size() > 1) {
         vTxHashes[it->vTxHashesIdx] = std::move(vTxHashes.back());
@@ -589,6 +614,7 @@ void CTxMemPool::_clear()
     mapLinks.clear();
     mapTx.clear();
     mapNextTx.clear();
+    mapColorTx.clear();
     totalTxSize = 0;
     cachedInnerUsage = 0;
     lastRollingFeeUpdate = GetTime();
@@ -625,6 +651,7 @@ void CTxMemPool::check(const CCoinsViewCache *pcoins) const
 
     uint64_t checkTotal = 0;
     uint64_t innerUsage = 0;
+    size_t colorEntriesCheck = 0;
 
     CCoinsViewCache mempoolDuplicate(const_cast<CCoinsViewCache*>(pcoins));
     const int64_t spendheight = GetSpendHeight(mempoolDuplicate);
@@ -665,6 +692,13 @@ void CTxMemPool::check(const CCoinsViewCache *pcoins) const
             i++;
         }
         assert(setParentCheck == GetMemPoolParents(it));
+        // Check that the transaction is indexed under each of its colors.
+        for (const ColorIdentifier& colorId : it->GetColorIds()) {
+            colorTxMap::const_iterator colorit = mapColorTx.find(colorId);
+            assert(colorit != mapColorTx.end());
+            assert(colorit->second.count(it));
+            colorEntriesCheck++;
+        }
         // Verify ancestor state is correct.
         setEntries setAncestors;
         uint64_t nNoLimit = std::numeric_limits<uint64_t>::max();
@@ -728,6 +762,12 @@ void CTxMemPool::check(const CCoinsViewCache *pcoins) const
         assert(it2 != mapTx.end());
         assert(&tx == it->second);
     }
+    for (const auto& entry : mapColorTx) {
+        assert(!entry.second.empty());
+        innerUsage += memusage::DynamicUsage(entry.second);
+        colorEntriesCheck -= entry.second.size();
+    }
+    assert(colorEntriesCheck == 0);
 
     assert(totalTxSize == checkTotal);
     assert(innerUsage == cachedInnerUsage);
@@ -791,6 +831,13 @@ void CTxMemPool::queryHashes(std::vector<uint256>& vtxid)
     }
 }
 
+CTxMemPool::setEntries CTxMemPool::GetColorEntries(const ColorIdentifier& colorId) const
+{
+    AssertLockHeld(cs);
+    colorTxMap::const_iterator it = mapColorTx.find(colorId);
+    return it == mapColorTx.end() ? setEntries() : it->second;
+}
+
 static TxMempoolInfo GetInfo(CTxMemPool::indexed_transaction_set::const_iterator it) {
     return TxMempoolInfo{it->GetSharedTx(), it->GetTime(), CFeeRate(it->GetFee(), it->GetTxSize()), it->GetModifiedFee() - it->GetFee()};
 }
@@ -890,8 +937,7 @@ bool CCoinsViewMemPool::GetCoin(const COutPoint &outpoint, Coin &coin) const {
     CTransactionRef ptx = mempool.get(outpoint.hashMalFix);
     if (ptx) {
         if (outpoint.n < ptx->vout.size()) {
-            ColorIdentifier colorId(GetColorIdFromScript(ptx->vout[outpoint.n].scriptPubKey));
-            coin = Coin(ptx->vout[outpoint.n], MEMPOOL_HEIGHT, false, colorId.type);
+            coin = Coin(ptx->vout[outpoint.n], MEMPOOL_HEIGHT, false, ptx->GetColorId(outpoint.n).type);
             return true;
         } else {
             return false;
@@ -903,7 +949,7 @@ bool CCoinsViewMemPool::GetCoin(const COutPoint &outpoint, Coin &coin) const {
 size_t CTxMemPool::DynamicMemoryUsage() const {
     LOCK(cs);
     // Estimate the overhead of mapTx to be 12 pointers + an allocation, as no exact formula for boost::multi_index_contained is implemented.
-    return memusage::MallocUsage(sizeof(CTxMemPoolEntry) + 12 * sizeof(void*)) * mapTx.size() + memusage::DynamicUsage(mapNextTx) + memusage::DynamicUsage(mapDeltas) + memusage::DynamicUsage(mapLinks) + memusage::DynamicUsage(vTxHashes) + cachedInnerUsage;
+    return memusage::MallocUsage(sizeof(CTxMemPoolEntry) + 12 * sizeof(void*)) * mapTx.size() + memusage::DynamicUsage(mapNextTx) + memusage::DynamicUsage(mapDeltas) + memusage::DynamicUsage(mapLinks) + memusage::DynamicUsage(mapColorTx) + memusage::DynamicUsage(vTxHashes) + cachedInnerUsage;
 }
 
 void CTxMemPool::RemoveStaged(setEntries &stage, bool updateDescendants, MemPoolRemovalReason reason) {
@@ -7,6 +7,8 @@
 #include <validation.h>
 
 #include <arith_uint256.h>
+#include <blockcache.h>
+#include <blockfilemap.h>
 #include <chain.h>
 #include <chainparams.h>
 #include <checkpoints.h>
@@ -15,15 +17,18 @@
 #include <consensus/merkle.h>
 #include <consensus/tx_verify.h>
 #include <consensus/validation.h>
+#include <crypto/common.h>
 #include <cuckoocache.h>
 #include <federationparams.h>
 #include <hash.h>
 #include <index/txindex.h>
+#include <memusage.h>
 #include <policy/fees.h>
 #include <policy/policy.h>
 #include <policy/rbf.h>
 #include <primitives/block.h>
 #include <primitives/transaction.h>
+#include <pubkey.h>
 #include <random.h>
 #include <reverse_iterator.h>
 #include <script/script.h>
@@ -44,6 +49,7 @@
 
 #include <future>
 #include <sstream>
+#include <unordered_set>
 
 #include <boost/algorithm/string/replace.hpp>
 #include <boost/thread.hpp>
@@ -154,6 +160,8 @@ private:
 public:
     CChain chainActive;
     BlockMap mapBlockIndex;
+    //! Owns the mapBlockIndex entries loaded from disk. See DeleteBlockIndex().
+    CBlockIndexArena blockIndexArena;
     std::multimap<CBlockIndex*, CBlockIndex*> mapBlocksUnlinked;
     CBlockIndex *pindexBestInvalid = nullptr;
 
@@ -164,8 +172,10 @@ public:
     /**
      * If a block header hasn't already been seen, call CheckBlockHeader on it, ensure
      * that it doesn't descend from an invalid block, and then add it to mapBlockIndex.
+     * fProofChecked skips the block proof verification, for headers whose proof has
+     * already been verified against the latest aggregate public key.
      */
-    bool AcceptBlockHeader(const CBlockHeader& block, CValidationState& state, CBlockIndex** ppindex) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+    bool AcceptBlockHeader(const CBlockHeader& block, CValidationState& state, CBlockIndex** ppindex, bool fProofChecked = false) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
     bool AcceptBlock(const std::shared_ptr<const CBlock>& pblock, CValidationState& state, CBlockIndex** ppindex, bool fRequested, const CDiskBlockPos* dbp, bool* fNewBlock) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
 
     // Block (dis)connection on a given view:
@@ -195,7 +205,7 @@ private:
 
     CBlockIndex* AddToBlockIndex(const CBlockHeader& block) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
     /** Create a new block index entry for a given block hash */
-    CBlockIndex* InsertBlockIndex(const uint256& hash) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+    CBlockIndex* InsertBlockIndex(const uint256& hash, CBlockIndex* pindexNew = nullptr) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
     /**
      * Make various assertions about the state of the block index.
      *
@@ -229,6 +239,8 @@ bool fPruneMode = false;
 bool fIsBareMultisigStd = DEFAULT_PERMIT_BAREMULTISIG;
 bool fCheckBlockIndex = false;
 bool fCheckpointsEnabled = DEFAULT_CHECKPOINTS_ENABLED;
+bool fBlockFileMmap = DEFAULT_BLOCK_MMAP;
+CBlockCache g_block_cache(DEFAULT_MAX_BLOCK_CACHE_SIZE << 20);
 size_t nCoinCacheUsage = 5000 * 300;
 uint64_t nPruneTarget = 0;
 int64_t nMaxTipAge = DEFAULT_MAX_TIP_AGE;
@@ -239,6 +251,13 @@ bool acceptnonstdtxn = false;
 
 uint256 hashAssumeValid;
 
+/** Free a block index entry, unless it is part of the arena it was loaded into. */
+static void DeleteBlockIndex(CBlockIndex* pindex)
+{
+    if (!g_chainstate.blockIndexArena.Owns(pindex))
+        delete pindex;
+}
+
 CFeeRate minRelayTxFee = CFeeRate(DEFAULT_MIN_RELAY_TX_FEE);
 CAmount maxTxFee = DEFAULT_TRANSACTION_MAXFEE;
 
@@ -310,7 +329,7 @@ enum class FlushStateMode {
 static bool FlushStateToDisk(CValidationState &state, FlushStateMode mode, int nManualPruneHeight=0);
 static void FindFilesToPruneManual(std::set<int>& setFilesToPrune, int nManualPruneHeight);
 static void FindFilesToPrune(std::set<int>& setFilesToPrune, uint64_t nPruneAfterHeight);
-bool CheckInputs(const CTransaction& tx, CValidationState &state, const CCoinsViewCache &inputs, bool fScriptChecks, unsigned int flags, bool cacheSigStore, bool cacheFullScriptStore, PrecomputedTransactionData& txdata, TxColoredCoinBalancesMap& inColoredCoinBalances, std::vector<CScriptCheck> *pvChecks = nullptr);
+bool CheckInputs(const CTransaction& tx, CValidationState &state, const CCoinsViewCache &inputs, bool fScriptChecks, unsigned int flags, bool cacheSigStore, bool cacheFullScriptStore, PrecomputedTransactionData& txdata, TxColoredCoinBalances& inColoredCoinBalances, std::vector<CScriptCheck> *pvChecks = nullptr);
 static FILE* OpenUndoFile(const CDiskBlockPos &pos, bool fReadOnly = false);
 
 bool CheckFinalTx(const CTransaction &tx, int flags)
@@ -437,6 +456,7 @@ bool CheckSequenceLocks(const CTransaction &tx, int flags, LockPoints* lp, bool
 
 // Returns the script flags which should be checked for a given block
 static unsigned int GetBlockScriptFlags(const CBlockIndex* pindex);
+static bool CheckInputsForMempool(const CTransaction& tx, CValidationState& state, const CCoinsViewCache& view, unsigned int flags, bool cacheSigStore, bool cacheFullScriptStore, PrecomputedTransactionData& txdata, TxColoredCoinBalances& inColoredCoinBalances);
 
 static void LimitMempoolSize(CTxMemPool& pool, size_t limit, unsigned long age) {
     int expired = pool.Expire(GetTime() - age);
@@ -556,21 +576,27 @@ static bool CheckInputsFromMempoolAndCache(const CTransaction& tx, CValidationSt
         }
     }
 
-    TxColoredCoinBalancesMap inColoredCoinBalances;
-    return CheckInputs(tx, state, view, true, flags, cacheSigStore, true, txdata, inColoredCoinBalances);
+    TxColoredCoinBalances inColoredCoinBalances;
+    return CheckInputsForMempool(tx, state, view, flags, cacheSigStore, true, txdata, inColoredCoinBalances);
 }
 
 bool CheckColorIdentifierValidity(const CTransaction& tx, CValidationState& state, CCoinsViewCache &inputs)
 {
+    // colors derived from the input coins' scriptPubKeys, computed on first use
+    // and shared by all outputs: hash(scriptpubkey) for TPC coins and the
+    // coin's own colorid for token coins
+    std::vector<ColorIdentifier> coinScriptColorIds;
+
     // when this transaction issues or transfers tokens,
     // verify that the color id is valid.
-    for(auto& txout:tx.vout)
+    for(size_t i = 0; i < tx.vout.size(); i++)
     {
+        const CTxOut& txout = tx.vout[i];
         if(!txout.scriptPubKey.IsColoredScript())
             continue;
 
-        //identify the scriptPubkey type and get colorid from the script
-        ColorIdentifier outColorId(GetColorIdFromScript(txout.scriptPubKey));
+        //colorid parsed from the scriptPubkey when the transaction was created
+        const ColorIdentifier& outColorId = tx.GetColorId(i);
 
         //if the token type is none, OP_COLOR should not be used in the script.
         if (outColorId.type == TokenTypes::NONE)
@@ -580,10 +606,24 @@ bool CheckColorIdentifierValidity(const CTransaction& tx, CValidationState& stat
         if(txout.nValue <= 0)
             return false;
 
+        if(coinScriptColorIds.empty())
+        {
+            coinScriptColorIds.reserve(tx.vin.size());
+            for(const CTxIn& txin:tx.vin)
+            {
+                const Coin& coin = inputs.AccessCoin(txin.prevout);
+                if(coin.type == TokenTypes::NONE)
+                    coinScriptColorIds.emplace_back(coin.out.scriptPubKey);
+                else
+                    coinScriptColorIds.push_back(GetColorIdFromScript(coin.out.scriptPubKey));
+            }
+        }
+
         bool matchFound = false;
-        for(auto txin:tx.vin)
+        for(size_t j = 0; j < tx.vin.size(); j++)
         {
             //match the input coin to the token's colorid
+            const CTxIn& txin = tx.vin[j];
             const Coin& coin = inputs.AccessCoin(txin.prevout);
             ColorIdentifier coinColorId;
 
@@ -593,7 +633,7 @@ bool CheckColorIdentifierValidity(const CTransaction& tx, CValidationState& stat
                 // colorid is hash(coin's scriptpubkey) or prevout
                 case TokenTypes::NONE:
                     if(outColorId.type == TokenTypes::REISSUABLE)
-                        coinColorId = ColorIdentifier(coin.out.scriptPubKey);
+                        coinColorId = coinScriptColorIds[j];
                     else
                         coinColorId = ColorIdentifier(txin.prevout, outColorId.type);
                     break;
@@ -603,7 +643,7 @@ bool CheckColorIdentifierValidity(const CTransaction& tx, CValidationState& stat
                 case TokenTypes::REISSUABLE:
                 case TokenTypes::NON_REISSUABLE:
                 case TokenTypes::NFT:
-                    coinColorId = GetColorIdFromScript(coin.out.scriptPubKey);
+                    coinColorId = coinScriptColorIds[j];
                     break;
 
                 default:
@@ -787,19 +827,21 @@ static bool AcceptToMemoryPoolWorker(CTxMemPool& pool, CValidationState& state,
         pool.ApplyDelta(hash, nModifiedFees);
 
         // Keep track of transactions that spend a coinbase, which we re-scan
-        // during reorgs to ensure COINBASE_MATURITY is still met.
+        // during reorgs to ensure COINBASE_MATURITY is still met, and of the
+        // colors of the coins spent, which the mempool indexes.
         bool fSpendsCoinbase = false;
+        std::vector<ColorIdentifier> spentColorIds;
         for (const CTxIn &txin : tx.vin) {
             const Coin &coin = view.AccessCoin(txin.prevout);
             if (coin.IsCoinBase())
-            {
                 fSpendsCoinbase = true;
-                break;
-            }
+            ColorIdentifier colorId = GetColorIdFromScript(coin.out.scriptPubKey);
+            if (colorId.type != TokenTypes::NONE)
+                spentColorIds.push_back(colorId);
         }
 
         CTxMemPoolEntry entry(ptx, nFees, nAcceptTime, chainActive.Height(),
-                              fSpendsCoinbase, nSigOpsCost, lp);
+                              fSpendsCoinbase, nSigOpsCost, lp, spentColorIds);
         unsigned int nSize = entry.GetTxSize();
 
         // Check that the transaction doesn't have an excessive number of
@@ -983,11 +1025,11 @@ static bool AcceptToMemoryPoolWorker(CTxMemPool& pool, CValidationState& state,
         // Check against previous transactions
         // This is done last to help prevent CPU exhaustion denial-of-service attacks.
         PrecomputedTransactionData txdata(tx);
-        TxColoredCoinBalancesMap inColoredCoinBalances;
-        if (!CheckInputs(tx, state, view, true, scriptVerifyFlags, true, false, txdata, inColoredCoinBalances)) {
+        TxColoredCoinBalances inColoredCoinBalances;
+        if (!CheckInputsForMempool(tx, state, view, scriptVerifyFlags, true, false, txdata, inColoredCoinBalances)) {
 
         #ifdef DEBUG
-            TxColoredCoinBalancesMap tmpColoredCoinBalancesTemp;
+            TxColoredCoinBalances tmpColoredCoinBalancesTemp;
             // SCRIPT_VERIFY_CLEANSTACK requires SCRIPT_VERIFY_WITNESS, so we
             // need to turn both off, and compare against just turning off CLEANSTACK
             // to see if the failure is specifically due to witness validation.
@@ -1026,20 +1068,14 @@ static bool AcceptToMemoryPoolWorker(CTxMemPool& pool, CValidationState& state,
         //verify token balances:
         //for every output eliminate a matching input.
         //verify that all outputs are matched
-        TxColoredCoinBalancesMap outColoredCoinBalances;
-        for (const auto& tx_out : tx.vout) {
-            ColorIdentifier outColorId(GetColorIdFromScript(tx_out.scriptPubKey));
-
+        TxColoredCoinBalances outColoredCoinBalances;
+        for (size_t i = 0; i < tx.vout.size(); i++) {
             //collect token balances from all outputs.
-            auto iter = outColoredCoinBalances.find(outColorId);
-            if(iter == outColoredCoinBalances.end())
-                outColoredCoinBalances.emplace(outColorId, tx_out.nValue);
-            else
-                iter->second += tx_out.nValue;
+            outColoredCoinBalances.Add(tx.GetColorId(i), tx.vout[i].nValue);
         }
         // Tally transaction fees
         CAmount tpcin = 0, tpcout = 0;
-        TxColoredCoinBalancesMap::const_iterator iter = inColoredCoinBalances.find(ColorIdentifier());
+        TxColoredCoinBalances::const_iterator iter = inColoredCoinBalances.find(ColorIdentifier());
         if(iter != inColoredCoinBalances.end())  
             tpcin = iter->second;
 
@@ -1052,7 +1088,7 @@ static bool AcceptToMemoryPoolWorker(CTxMemPool& pool, CValidationState& state,
 
         for(auto& out:outColoredCoinBalances)
         {
-            TxColoredCoinBalancesMap::iterator iter = inColoredCoinBalances.find(out.first);
+            TxColoredCoinBalances::iterator iter = inColoredCoinBalances.find(out.first);
 
             //output does not have a corresponding input.
             if(iter == inColoredCoinBalances.end())
@@ -1215,25 +1251,78 @@ static bool WriteBlockToDisk(const CBlock& block, CDiskBlockPos& pos, const CMes
     return true;
 }
 
+/** Recently read block files, kept mapped while fBlockFileMmap is set. */
+static CBlockFileMapCache g_block_file_maps(MAX_MAPPED_BLOCK_FILES);
+
+/**
+ * Find the block stored at pos in its memory mapped block file. Every block is
+ * preceded by the network magic and its size. On success block points at the
+ * serialized block and the returned mapping keeps it valid. Returns nullptr
+ * when mapping is disabled or unavailable, or when the file does not look as
+ * expected; callers then fall back to reading the file, which reports any
+ * actual error.
+ */
+static std::shared_ptr<const CMappedFile> MapBlockFromDisk(const CDiskBlockPos& pos, const CMessageHeader::MessageStartChars* message_start, Span<const unsigned char>& block)
+{
+    static const size_t BLOCK_HEADER_SIZE = CMessageHeader::MESSAGE_START_SIZE + sizeof(uint32_t);
+    if (!fBlockFileMmap || pos.IsNull() || pos.nPos < BLOCK_HEADER_SIZE) {
+        return nullptr;
+    }
+    const fs::path path = GetBlockPosFilename(pos, "blk");
+    std::shared_ptr<const CMappedFile> file = g_block_file_maps.Get(path, pos.nPos);
+    if (!file) {
+        return nullptr;
+    }
+    const unsigned char* header = file->data() + pos.nPos - BLOCK_HEADER_SIZE;
+    if (message_start && memcmp(header, *message_start, CMessageHeader::MESSAGE_START_SIZE)) {
+        return nullptr;
+    }
+    const uint32_t blk_size = ReadLE32(header + CMessageHeader::MESSAGE_START_SIZE);
+    if (blk_size > MAX_SIZE) {
+        return nullptr;
+    }
+    if (!file->Contains(pos.nPos, blk_size)) {
+        // The block was appended after the file was mapped.
+        file = g_block_file_maps.Get(path, (size_t)pos.nPos + blk_size);
+        if (!file) {
+            return nullptr;
+        }
+    }
+    block = file->GetSpan(pos.nPos, blk_size);
+    return file;
+}
+
 bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos, int nHeight)
 {
     block.SetNull();
 
-    // Open history file to read
-    CAutoFile filein(OpenBlockFile(pos, true), SER_DISK, CLIENT_VERSION);
-    if (filein.IsNull())
-        return error("ReadBlockFromDisk: OpenBlockFile failed for %s", pos.ToString());
-
-    // Read block
-    try {
-        filein >> block;
-    }
-    catch (const std::exception& e) {
-        return error("%s: Deserialize or I/O error - %s at %s", __func__, e.what(), pos.ToString());
+    Span<const unsigned char> block_data;
+    std::shared_ptr<const CMappedFile> mapped = MapBlockFromDisk(pos, nullptr, block_data);
+    if (mapped) {
+        try {
+            CSpanReader reader(SER_DISK, CLIENT_VERSION, block_data);
+            reader >> block;
+        }
+        catch (const std::exception& e) {
+            return error("%s: Deserialize error - %s at %s", __func__, e.what(), pos.ToString());
+        }
+    } else {
+        // Open history file to read
+        CAutoFile filein(OpenBlockFile(pos, true), SER_DISK, CLIENT_VERSION);
+        if (filein.IsNull())
+            return error("ReadBlockFromDisk: OpenBlockFile failed for %s", pos.ToString());
+
+        // Read block
+        try {
+            filein >> block;
+        }
+        catch (const std::exception& e) {
+            return error("%s: Deserialize or I/O error - %s at %s", __func__, e.what(), pos.ToString());
+        }
     }
 
     CValidationState state;
-    if(!CheckBlockHeader(block.GetBlockHeader(), state, nHeight, true))
+    if(!CheckBlockHeader(block, state, nHeight, true))
         return error("%s: ReadBlockFromDisk: %s nHeight = %d", __func__, FormatStateMessage(state), nHeight);
 
     return true;
@@ -1257,8 +1346,33 @@ bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex)
     return true;
 }
 
-bool ReadRawBlockFromDisk(std::vector<uint8_t>& block, const CDiskBlockPos& pos, const CMessageHeader::MessageStartChars& message_start)
+std::shared_ptr<const CBlock> ReadBlockFromDiskCached(const CBlockIndex* pindex, bool fCacheResult)
+{
+    std::shared_ptr<const CBlock> pblock = g_block_cache.Get(pindex->GetBlockHash());
+    if (pblock) {
+        return pblock;
+    }
+    std::shared_ptr<CBlock> pblockRead = std::make_shared<CBlock>();
+    if (!ReadBlockFromDisk(*pblockRead, pindex)) {
+        return nullptr;
+    }
+    pblockRead->MemoizeHashes();
+    if (fCacheResult) {
+        g_block_cache.Insert(pindex->GetBlockHash(), pblockRead);
+    }
+    return pblockRead;
+}
+
+bool ReadRawBlockFromDisk(CRawBlockData& block, const CDiskBlockPos& pos, const CMessageHeader::MessageStartChars& message_start)
 {
+    Span<const unsigned char> block_data;
+    std::shared_ptr<const CMappedFile> mapped = MapBlockFromDisk(pos, &message_start, block_data);
+    if (mapped) {
+        block.data = block_data;
+        block.keep_alive = std::move(mapped);
+        return true;
+    }
+
     CDiskBlockPos hpos = pos;
     hpos.nPos -= 8; // Seek back 8 bytes for meta header
     CAutoFile filein(OpenBlockFile(hpos, true), SER_DISK, CLIENT_VERSION);
@@ -1283,8 +1397,10 @@ bool ReadRawBlockFromDisk(std::vector<uint8_t>& block, const CDiskBlockPos& pos,
                     blk_size, MAX_SIZE);
         }
 
-        block.resize(blk_size); // Zeroing of memory is intentional here
-        filein.read((char*)block.data(), blk_size);
+        std::shared_ptr<std::vector<uint8_t>> buffer = std::make_shared<std::vector<uint8_t>>(blk_size); // Zeroing of memory is intentional here
+        filein.read((char*)buffer->data(), blk_size);
+        block.data = Span<const uint8_t>(buffer->data(), buffer->size());
+        block.keep_alive = std::move(buffer);
     } catch(const std::exception& e) {
         return error("%s: Read from block file failed: %s for %s", __func__, e.what(), pos.ToString());
     }
@@ -1292,7 +1408,7 @@ bool ReadRawBlockFromDisk(std::vector<uint8_t>& block, const CDiskBlockPos& pos,
     return true;
 }
 
-bool ReadRawBlockFromDisk(std::vector<uint8_t>& block, const CBlockIndex* pindex, const CMessageHeader::MessageStartChars& message_start)
+bool ReadRawBlockFromDisk(CRawBlockData& block, const CBlockIndex* pindex, const CMessageHeader::MessageStartChars& message_start)
 {
     CDiskBlockPos block_pos;
     {
@@ -1473,14 +1589,53 @@ void UpdateCoins(const CTransaction& tx, CCoinsViewCache& inputs, CTxUndo &txund
 
 void UpdateCoins(const CTransaction& tx, CCoinsViewCache& inputs, int nHeight)
 {
-    CTxUndo txundo;
-    UpdateCoins(tx, inputs, txundo, nHeight);
+    // mark inputs spent, without keeping them for undo
+    if (!tx.IsCoinBase()) {
+        for (const CTxIn &txin : tx.vin) {
+            bool is_spent = inputs.SpendCoin(txin.prevout);
+            assert(is_spent);
+        }
+    }
+    // add outputs
+    AddCoins(inputs, tx, nHeight);
 }
 
-bool CScriptCheck::operator()() {
+bool CScriptCheck::operator()(CSchnorrBatch* batch) {
     const CScript &scriptSig = ptxTo->vin[nIn].scriptSig;
     const CScriptWitness *witness = &ptxTo->vin[nIn].scriptWitness;
-    return VerifyScript(scriptSig, m_tx_out.scriptPubKey, witness, nFlags, CachingTransactionSignatureChecker(ptxTo, nIn, m_tx_out.nValue, cacheStore, *txdata), colorid, &error);
+    // Start afresh, as the check runs again when its signature batch fails
+    // and a color left over from the first run would count as a second one.
+    colorid = ColorIdentifier();
+    if (!VerifyScript(scriptSig, m_tx_out.scriptPubKey, witness, nFlags, CachingTransactionSignatureChecker(ptxTo, nIn, m_tx_out.nValue, cacheStore, *txdata, batch), colorid, &error))
+        return fCacheOnly;
+    if (pcoloridOut)
+        *pcoloridOut = colorid;
+    return true;
+}
+
+bool RunCheckBatch(std::vector<CScriptCheck>& vChecks)
+{
+    CSchnorrBatch batch;
+    bool fOk = true;
+    for (CScriptCheck& check : vChecks) {
+        if (!check(&batch)) {
+            fOk = false;
+            break;
+        }
+    }
+    if (fOk && batch.Verify())
+        return true;
+
+    // Either one of the queued signatures is invalid, or a script failed while
+    // its signatures were assumed valid. Both are rare in blocks; repeat the
+    // checks one by one to get the exact result.
+    if (!batch.empty())
+        LogPrint(BCLog::BENCH, "%s: batch of %u Schnorr signatures failed, verifying %u scripts individually\n", __func__, batch.size(), vChecks.size());
+    for (CScriptCheck& check : vChecks) {
+        if (!check())
+            return false;
+    }
+    return true;
 }
 
 int GetSpendHeight(const CCoinsViewCache& inputs)
@@ -1494,6 +1649,17 @@ int GetSpendHeight(const CCoinsViewCache& inputs)
 static CuckooCache::cache<uint256, SignatureCacheHasher> scriptExecutionCache;
 static uint256 scriptExecutionCacheNonce(GetRandHash());
 
+/** The key of a transaction's script executions with the given flags in the script execution cache */
+static uint256 GetScriptExecutionCacheEntry(const CTransaction& tx, unsigned int flags)
+{
+    uint256 hashCacheEntry;
+    // We only use the first 19 bytes of nonce to avoid a second SHA
+    // round - giving us 19 + 32 + 4 = 55 bytes (+ 8 + 1 = 64)
+    static_assert(55 - sizeof(flags) - 32 >= 128/8, "Want at least 128 bits of nonce for script execution cache");
+    CSHA256().Write(scriptExecutionCacheNonce.begin(), 55 - sizeof(flags) - 32).Write(tx.GetWitnessHash().begin(), 32).Write((unsigned char*)&flags, sizeof(flags)).Finalize(hashCacheEntry.begin());
+    return hashCacheEntry;
+}
+
 void InitScriptExecutionCache() {
     // nMaxCacheSize is unsigned. If -maxsigcachesize is set to zero,
     // setup_bytes creates the minimum possible cache (2 elements).
@@ -1503,13 +1669,83 @@ void InitScriptExecutionCache() {
             (nElems*sizeof(uint256)) >>20, (nMaxCacheSize*2)>>20, nElems);
 }
 
+namespace {
+/**
+ * Cache of valid block proofs, so that the proof of a block is verified only
+ * once although the block is checked several times: as a header and as a full
+ * block, when it is reconnected after a reorg or reconsiderblock, and when the
+ * signers hand it to combineblocksigs before submitting it.
+ */
+class CBlockProofCache
+{
+private:
+    //! Entries are SHA256(nonce || sign hash || aggregate public key || proof)
+    uint256 nonce;
+    CuckooCache::cache<uint256, SignatureCacheHasher> setValid;
+    CCriticalSection cs_blockproofcache;
+    bool fInitialized = false;
+
+public:
+    //! Enough for about 32000 proofs, far more than the blocks a reorg can touch
+    static const size_t MAX_CACHE_BYTES = 1 << 20;
+
+    void Init(size_t nMaxCacheSize)
+    {
+        LOCK(cs_blockproofcache);
+        GetRandBytes(nonce.begin(), 32);
+        setValid.setup_bytes(std::min(nMaxCacheSize, MAX_CACHE_BYTES));
+        fInitialized = true;
+    }
+
+    void ComputeEntry(uint256& entry, const uint256& hash, const std::vector<unsigned char>& proof, const CPubKey& aggpubkey)
+    {
+        CSHA256().Write(nonce.begin(), 32).Write(hash.begin(), 32).Write(aggpubkey.begin(), aggpubkey.size()).Write(proof.data(), proof.size()).Finalize(entry.begin());
+    }
+
+    bool Get(const uint256& entry)
+    {
+        LOCK(cs_blockproofcache);
+        return fInitialized && setValid.contains(entry, false);
+    }
+
+    void Set(const uint256& entry)
+    {
+        LOCK(cs_blockproofcache);
+        if (fInitialized)
+            setValid.insert(entry);
+    }
+};
+
+static CBlockProofCache blockProofCache;
+} // namespace
+
+void InitBlockProofCache()
+{
+    // Like the signature caches, bounded by -maxsigcachesize.
+    size_t nMaxCacheSize = std::min(std::max((int64_t)0, gArgs.GetArg("-maxsigcachesize", DEFAULT_MAX_SIG_CACHE_SIZE)), MAX_MAX_SIG_CACHE_SIZE) * ((size_t) 1 << 20);
+    blockProofCache.Init(nMaxCacheSize);
+}
+
+bool CheckBlockProof(const uint256& hash, const std::vector<unsigned char>& proof, const CPubKey& aggpubkey, const CParsedPubKey* aggpubkeyParsed)
+{
+    uint256 entry;
+    blockProofCache.ComputeEntry(entry, hash, proof, aggpubkey);
+    if (blockProofCache.Get(entry))
+        return true;
+    if (!(aggpubkeyParsed ? aggpubkeyParsed->Verify_Schnorr(hash, proof) : aggpubkey.Verify_Schnorr(hash, proof)))
+        return false;
+    blockProofCache.Set(entry);
+    return true;
+}
+
 /**
  * Check whether all inputs of this transaction are valid (no double spends, scripts & sigs, amounts)
  * This does not modify the UTXO set.
  *
  * If pvChecks is not nullptr, script checks are pushed onto it instead of being performed inline. Any
  * script checks which are not necessary (eg due to script execution cache hits) are, obviously,
- * not pushed onto pvChecks/run.
+ * not pushed onto pvChecks/run. The colors of the inputs are only known once their scripts ran, so
+ * inColoredCoinBalances is then left for the caller to fill in.
  *
  * Setting cacheSigStore/cacheFullScriptStore to false will remove elements from the corresponding cache
  * which are matched. This is useful for checking blocks where we will likely never need the cache
@@ -1517,7 +1753,7 @@ void InitScriptExecutionCache() {
  *
  * Non-static (and re-declared) in src/test/txvalidationcache_tests.cpp
  */
-bool CheckInputs(const CTransaction& tx, CValidationState &state, const CCoinsViewCache &inputs, bool fScriptChecks, unsigned int flags, bool cacheSigStore, bool cacheFullScriptStore, PrecomputedTransactionData& txdata, TxColoredCoinBalancesMap& inColoredCoinBalances, std::vector<CScriptCheck> *pvChecks)
+bool CheckInputs(const CTransaction& tx, CValidationState &state, const CCoinsViewCache &inputs, bool fScriptChecks, unsigned int flags, bool cacheSigStore, bool cacheFullScriptStore, PrecomputedTransactionData& txdata, TxColoredCoinBalances& inColoredCoinBalances, std::vector<CScriptCheck> *pvChecks)
 {
     if (!tx.IsCoinBase())
     {
@@ -1539,11 +1775,7 @@ bool CheckInputs(const CTransaction& tx, CValidationState &state, const CCoinsVi
             // correct (ie that the transaction hash which is in tx's prevouts
             // properly commits to the scriptPubKey in the inputs view of that
             // transaction).
-            uint256 hashCacheEntry;
-            // We only use the first 19 bytes of nonce to avoid a second SHA
-            // round - giving us 19 + 32 + 4 = 55 bytes (+ 8 + 1 = 64)
-            static_assert(55 - sizeof(flags) - 32 >= 128/8, "Want at least 128 bits of nonce for script execution cache");
-            CSHA256().Write(scriptExecutionCacheNonce.begin(), 55 - sizeof(flags) - 32).Write(tx.GetWitnessHash().begin(), 32).Write((unsigned char*)&flags, sizeof(flags)).Finalize(hashCacheEntry.begin());
+            const uint256 hashCacheEntry = GetScriptExecutionCacheEntry(tx, flags);
             AssertLockHeld(cs_main); //TODO: Remove this requirement by making CuckooCache not require external locks
             if (scriptExecutionCache.contains(hashCacheEntry, !cacheFullScriptStore)) {
                 return true;
@@ -1586,13 +1818,11 @@ bool CheckInputs(const CTransaction& tx, CValidationState &state, const CCoinsVi
                     // super-majority signaling has occurred.
                     return state.DoS(100,false, REJECT_INVALID, strprintf("mandatory-script-verify-flag-failed (%s)", ScriptErrorString(check.GetScriptError())));
                 }
-                ColorIdentifier colorId(check.GetColorIdentifier());
-                //collect token balances from verified input.
-                auto iter = inColoredCoinBalances.find(colorId);
-                if(iter == inColoredCoinBalances.end())
-                    inColoredCoinBalances.emplace(colorId, coin.out.nValue);
-                else
-                    iter->second += coin.out.nValue;
+                if (!pvChecks) {
+                    ColorIdentifier colorId(check.GetColorIdentifier());
+                    //collect token balances from verified input.
+                    inColoredCoinBalances.Add(colorId, coin.out.nValue);
+                }
             }
 
             if (cacheFullScriptStore && !pvChecks) {
@@ -1635,7 +1865,9 @@ bool UndoWriteToDisk(const CBlockUndo& blockundo, CDiskBlockPos& pos, const uint
     return true;
 }
 
-static bool UndoReadFromDisk(CBlockUndo& blockundo, const CBlockIndex *pindex)
+} // namespace
+
+bool UndoReadFromDisk(CBlockUndo& blockundo, const CBlockIndex *pindex)
 {
     CDiskBlockPos pos = pindex->GetUndoPos();
     if (pos.IsNull()) {
@@ -1666,6 +1898,8 @@ static bool UndoReadFromDisk(CBlockUndo& blockundo, const CBlockIndex *pindex)
     return true;
 }
 
+namespace {
+
 /** Abort with a message */
 static bool AbortNode(const std::string& strMessage, const std::string& userMessage="")
 {
@@ -1788,8 +2022,11 @@ void static FlushBlockFile(bool fFinalize = false)
 
     FILE *fileOld = OpenBlockFile(posOld);
     if (fileOld) {
-        if (fFinalize)
+        if (fFinalize) {
             status &= TruncateFile(fileOld, vinfoBlockFile[nLastBlockFile].nSize);
+            // Never touch mapped pages beyond the new end of the file.
+            g_block_file_maps.Erase(GetBlockPosFilename(posOld, "blk"));
+        }
         status &= FileCommit(fileOld);
         fclose(fileOld);
     }
@@ -1835,6 +2072,256 @@ void ThreadScriptCheck() {
     scriptcheckqueue.Thread();
 }
 
+/**
+ * Queue for PreverifyMempoolScripts, which runs without cs_main. On a queue of
+ * its own, it never holds up ConnectBlock waiting for scriptcheckqueue.
+ */
+static CCheckQueue<CScriptCheck> mempoolcheckqueue(128);
+
+void ThreadMempoolScriptCheck() {
+    RenameThread("tapyrus-mempoolch");
+    mempoolcheckqueue.Thread();
+}
+
+/**
+ * CheckInputs for mempool acceptance. The script checks of a transaction with
+ * at least MIN_PARALLEL_MEMPOOL_INPUTS inputs are run on the script check
+ * threads, as ConnectBlock does, instead of all on the calling thread. When
+ * they fail, CheckInputs repeats them inline to give state the exact reason.
+ */
+static bool CheckInputsForMempool(const CTransaction& tx, CValidationState& state, const CCoinsViewCache& view, unsigned int flags, bool cacheSigStore, bool cacheFullScriptStore, PrecomputedTransactionData& txdata, TxColoredCoinBalances& inColoredCoinBalances)
+{
+    AssertLockHeld(cs_main);
+    if (!nScriptCheckThreads || tx.vin.size() < MIN_PARALLEL_MEMPOOL_INPUTS)
+        return CheckInputs(tx, state, view, true, flags, cacheSigStore, cacheFullScriptStore, txdata, inColoredCoinBalances);
+
+    std::vector<CScriptCheck> vChecks;
+    if (!CheckInputs(tx, state, view, true, flags, cacheSigStore, cacheFullScriptStore, txdata, inColoredCoinBalances, &vChecks))
+        return false;
+    if (vChecks.empty())
+        return true; // script execution cache hit
+    assert(vChecks.size() == tx.vin.size());
+
+    // The checks are moved into the queue, so they report the colors of the
+    // spent outputs here.
+    std::vector<ColorIdentifier> vColorIds(vChecks.size());
+    for (size_t i = 0; i < vChecks.size(); i++)
+        vChecks[i].SetColorIdentifierOut(&vColorIds[i]);
+    bool fOk;
+    {
+        CCheckQueueControl<CScriptCheck> control(&scriptcheckqueue);
+        control.Add(vChecks);
+        fOk = control.Wait();
+    }
+    if (!fOk)
+        return CheckInputs(tx, state, view, true, flags, cacheSigStore, false, txdata, inColoredCoinBalances);
+
+    for (size_t i = 0; i < tx.vin.size(); i++) {
+        //collect token balances from verified input.
+        inColoredCoinBalances.Add(vColorIds[i], view.AccessCoin(tx.vin[i].prevout).out.nValue);
+    }
+    if (cacheFullScriptStore) {
+        // As CheckInputs does after running all the scripts inline.
+        scriptExecutionCache.insert(GetScriptExecutionCacheEntry(tx, flags));
+    }
+    return true;
+}
+
+void PreverifyMempoolScripts(const CTxMemPool& pool, const std::vector<CTransactionRef>& txs, std::vector<COutPoint>& coins_to_uncache)
+{
+    if (!nScriptCheckThreads)
+        return;
+
+    // The checks copy the spent outputs, so the scripts can run once the
+    // inputs have been looked up and the locks released. The lookups need
+    // cs_main, as pcoinsTip is not safe to read without it, and pool.cs for
+    // the outputs of mempool transactions; both are taken once for the batch.
+    std::vector<PrecomputedTransactionData> txdata;
+    txdata.reserve(txs.size());
+    std::vector<CScriptCheck> vChecks;
+    {
+        LOCK2(cs_main, pool.cs);
+        CCoinsViewMemPool viewMemPool(pcoinsTip.get(), pool);
+        CCoinsViewCache view(&viewMemPool);
+        const int nSpendHeight = GetSpendHeight(view);
+        std::set<uint256> setSeen;
+        for (const CTransactionRef& ptx : txs) {
+            const CTransaction& tx = *ptx;
+            const uint256 hash = tx.GetHashMalFix();
+            if (!setSeen.insert(hash).second || pool.exists(hash))
+                continue;
+
+            // Do not spend CPU on transactions AcceptToMemoryPool rejects
+            // before verifying their scripts.
+            CValidationState state;
+            std::string reason;
+            if (!CheckTransaction(tx, state) || tx.IsCoinBase() || !IsStandardTx(tx, reason))
+                continue;
+            bool fHaveInputs = true;
+            for (const CTxIn& txin : tx.vin) {
+                if (!pcoinsTip->HaveCoinInCache(txin.prevout))
+                    coins_to_uncache.push_back(txin.prevout);
+                if (!view.HaveCoin(txin.prevout)) {
+                    fHaveInputs = false;
+                    break;
+                }
+            }
+            CAmount nFees = 0;
+            if (!fHaveInputs || !Consensus::CheckTxInputs(tx, state, view, nSpendHeight, nFees) || !AreInputsStandard(tx, view))
+                continue;
+            if (nFees < ::minRelayTxFee.GetFee(GetVirtualTransactionSize(tx)))
+                continue;
+
+            txdata.emplace_back(tx);
+            for (unsigned int i = 0; i < tx.vin.size(); i++) {
+                vChecks.emplace_back(view.AccessCoin(tx.vin[i].prevout).out, tx, i, STANDARD_SCRIPT_VERIFY_FLAGS, true, &txdata.back());
+                vChecks.back().SetCacheOnly();
+            }
+        }
+    }
+    if (vChecks.empty())
+        return;
+
+    CCheckQueueControl<CScriptCheck> control(&mempoolcheckqueue);
+    control.Add(vChecks);
+    control.Wait();
+}
+
+void UncacheUnspentCoins(const CTxMemPool& pool, const std::vector<COutPoint>& coins)
+{
+    AssertLockHeld(cs_main);
+    LOCK(pool.cs);
+    for (const COutPoint& outpoint : coins) {
+        if (!pool.isSpent(outpoint))
+            pcoinsTip->Uncache(outpoint);
+    }
+}
+
+/**
+ * Closure representing the verification of the block proof of one header
+ * against an aggregate public key.
+ */
+class CHeaderProofCheck
+{
+private:
+    const CBlockHeader *pheader;
+    const CPubKey *paggpubkey;
+    const CParsedPubKey *paggpubkeyParsed;
+
+public:
+    CHeaderProofCheck(): pheader(nullptr), paggpubkey(nullptr), paggpubkeyParsed(nullptr) {}
+    CHeaderProofCheck(const CBlockHeader& headerIn, const CPubKey& aggpubkeyIn, const CParsedPubKey& aggpubkeyParsedIn) :
+        pheader(&headerIn), paggpubkey(&aggpubkeyIn), paggpubkeyParsed(&aggpubkeyParsedIn) { }
+
+    bool operator()() {
+        return CheckBlockProof(pheader->GetHashForSign(), pheader->proof, *paggpubkey, paggpubkeyParsed);
+    }
+
+    void swap(CHeaderProofCheck &check) {
+        std::swap(pheader, check.pheader);
+        std::swap(paggpubkey, check.paggpubkey);
+        std::swap(paggpubkeyParsed, check.paggpubkeyParsed);
+    }
+};
+
+static CCheckQueue<CHeaderProofCheck> headerproofcheckqueue(16);
+
+void ThreadHeaderProofCheck() {
+    RenameThread("tapyrus-hdrproof");
+    headerproofcheckqueue.Thread();
+}
+
+/**
+ * Closure representing the read of one coin from the coins database, so that
+ * the inputs of a block can be loaded into pcoinsTip before ConnectBlock.
+ */
+class CCoinPrefetch
+{
+private:
+    const CCoinsView *pview;
+    const COutPoint *poutpoint;
+    Coin *pcoin;
+    char *pfound;
+
+public:
+    CCoinPrefetch(): pview(nullptr), poutpoint(nullptr), pcoin(nullptr), pfound(nullptr) {}
+    CCoinPrefetch(const CCoinsView& viewIn, const COutPoint& outpointIn, Coin& coinIn, char& foundIn) :
+        pview(&viewIn), poutpoint(&outpointIn), pcoin(&coinIn), pfound(&foundIn) { }
+
+    bool operator()() {
+        try {
+            *pfound = pview->GetCoin(*poutpoint, *pcoin);
+        } catch (const std::runtime_error&) {
+            // Leave the coin to ConnectBlock, which reads it again and reports the error.
+            *pfound = false;
+        }
+        return true;
+    }
+
+    void swap(CCoinPrefetch &check) {
+        std::swap(pview, check.pview);
+        std::swap(poutpoint, check.poutpoint);
+        std::swap(pcoin, check.pcoin);
+        std::swap(pfound, check.pfound);
+    }
+};
+
+static CCheckQueue<CCoinPrefetch> coinprefetchqueue(8);
+
+void ThreadCoinPrefetch() {
+    RenameThread("tapyrus-coinload");
+    coinprefetchqueue.Thread();
+}
+
+/**
+ * Read the coins spent by block that are missing from cache out of base on the
+ * coin prefetch threads, and add them to cache. base must be safe to read from
+ * several threads and must be the view that cache falls back to, so that
+ * ConnectBlock finds every input in memory instead of reading the database one
+ * input at a time. Returns the number of coins added to cache.
+ */
+static size_t PrefetchBlockInputs(const CBlock& block, CCoinsViewCache& cache, const CCoinsView& base)
+{
+    if (!nScriptCheckThreads)
+        return 0;
+
+    std::unordered_set<uint256, SaltedTxidHasher> setBlockTxids;
+    setBlockTxids.reserve(block.vtx.size());
+    std::vector<COutPoint> vOutpoints;
+    for (const auto& tx : block.vtx) {
+        if (!tx->IsCoinBase()) {
+            for (const CTxIn& txin : tx->vin) {
+                // Outputs created earlier in this block are not in the database.
+                if (!setBlockTxids.count(txin.prevout.hashMalFix) && !cache.HaveCoinInCache(txin.prevout))
+                    vOutpoints.push_back(txin.prevout);
+            }
+        }
+        setBlockTxids.insert(tx->GetHashMalFix());
+    }
+    if (vOutpoints.size() < 2)
+        return 0;
+
+    std::vector<Coin> vCoins(vOutpoints.size());
+    std::vector<char> vFound(vOutpoints.size(), false);
+    std::vector<CCoinPrefetch> vChecks;
+    vChecks.reserve(vOutpoints.size());
+    for (size_t i = 0; i < vOutpoints.size(); i++)
+        vChecks.emplace_back(base, vOutpoints[i], vCoins[i], vFound[i]);
+
+    CCheckQueueControl<CCoinPrefetch> control(&coinprefetchqueue);
+    control.Add(vChecks);
+    control.Wait();
+
+    size_t nAdded = 0;
+    for (size_t i = 0; i < vOutpoints.size(); i++) {
+        if (vFound[i]) {
+            cache.EmplaceFetchedCoin(vOutpoints[i], std::move(vCoins[i]));
+            nAdded++;
+        }
+    }
+    return nAdded;
+}
+
 
 static unsigned int GetBlockScriptFlags(const CBlockIndex* pindex) {
     AssertLockHeld(cs_main);
@@ -1945,14 +2432,16 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
     std::vector<int> prevheights;
     CAmount nFees = 0;
     int nInputs = 0;
+    int nScriptsCached = 0;
     int64_t nSigOpsCost = 0;
-    blockundo.vtxundo.reserve(block.vtx.size() - 1);
+    if (!fJustCheck)
+        blockundo.vtxundo.reserve(block.vtx.size() - 1);
     std::vector<PrecomputedTransactionData> txdata;
     txdata.reserve(block.vtx.size()); // Required so that pointers to individual PrecomputedTransactionData don't get invalidated
     for (unsigned int i = 0; i < block.vtx.size(); i++)
     {
         const CTransaction &tx = *(block.vtx[i]);
-        TxColoredCoinBalancesMap inColoredCoinBalances;
+        TxColoredCoinBalances inColoredCoinBalances;
 
         nInputs += tx.vin.size();
 
@@ -1991,22 +2480,30 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
             return state.DoS(100, error("ConnectBlock(): too many sigops"),
                              REJECT_INVALID, "bad-blk-sigops");
 
-        txdata.emplace_back(tx);
-        if (!tx.IsCoinBase())
+        if (!tx.IsCoinBase() && fScriptChecks)
         {
             std::vector<CScriptCheck> vChecks;
             bool fCacheResults = fJustCheck; /* Don't cache results if we're actually connecting blocks (still consult the cache, though) */
-            if (!CheckInputs(tx, state, view, fScriptChecks, flags, fCacheResults, fCacheResults, txdata[i], inColoredCoinBalances, nScriptCheckThreads ? &vChecks : nullptr))
-                return error("ConnectBlock(): CheckInputs on %s failed with %s",
-                    tx.GetHashMalFix().ToString(), FormatStateMessage(state));
-            control.Add(vChecks);
+            // CheckInputs returns on a script execution cache hit without using
+            // txdata, so look the entry up here and only precompute for misses.
+            if (scriptExecutionCache.contains(GetScriptExecutionCacheEntry(tx, flags), !fCacheResults)) {
+                nScriptsCached++;
+            } else {
+                txdata.emplace_back(tx);
+                if (!CheckInputs(tx, state, view, fScriptChecks, flags, fCacheResults, fCacheResults, txdata.back(), inColoredCoinBalances, nScriptCheckThreads ? &vChecks : nullptr))
+                    return error("ConnectBlock(): CheckInputs on %s failed with %s",
+                        tx.GetHashMalFix().ToString(), FormatStateMessage(state));
+                control.Add(vChecks);
+            }
         }
 
-        CTxUndo undoDummy;
-        if (i > 0) {
+        // A block that is only checked is never undone.
+        if (i == 0 || fJustCheck) {
+            UpdateCoins(tx, view, pindex->nHeight);
+        } else {
             blockundo.vtxundo.push_back(CTxUndo());
+            UpdateCoins(tx, view, blockundo.vtxundo.back(), pindex->nHeight);
         }
-        UpdateCoins(tx, view, i == 0 ? undoDummy : blockundo.vtxundo.back(), pindex->nHeight);
     }
     int64_t nTime3 = GetTimeMicros(); nTimeConnect += nTime3 - nTime2;
     LogPrint(BCLog::BENCH, "      - Connect %u transactions: %.2fms (%.3fms/tx, %.3fms/txin) [%.2fs (%.2fms/blk)]\n", (unsigned)block.vtx.size(), MILLI * (nTime3 - nTime2), MILLI * (nTime3 - nTime2) / block.vtx.size(), nInputs <= 1 ? 0 : MILLI * (nTime3 - nTime2) / (nInputs-1), nTimeConnect * MICRO, nTimeConnect * MILLI / nBlocksTotal);
@@ -2022,6 +2519,7 @@ bool CChainState::ConnectBlock(const CBlock& block, CValidationState& state, CBl
         return state.DoS(100, error("%s: CheckQueue failed", __func__), REJECT_INVALID, "block-validation-failed");
     int64_t nTime4 = GetTimeMicros(); nTimeVerify += nTime4 - nTime2;
     LogPrint(BCLog::BENCH, "    - Verify %u txins: %.2fms (%.3fms/txin) [%.2fs (%.2fms/blk)]\n", nInputs - 1, MILLI * (nTime4 - nTime2), nInputs <= 1 ? 0 : MILLI * (nTime4 - nTime2) / (nInputs-1), nTimeVerify * MICRO, nTimeVerify * MILLI / nBlocksTotal);
+    LogPrint(BCLog::BENCH, "    - Scripts cached for %d of %u txs\n", nScriptsCached, (unsigned)block.vtx.size() - 1);
 
     if (fJustCheck)
         return true;
@@ -2129,9 +2627,13 @@ bool static FlushStateToDisk(CValidationState &state, FlushStateMode mode, int n
                     return AbortNode(state, "Failed to write to block index database");
                 }
             }
-            // Finally remove any pruned files
-            if (fFlushForPrune)
+            // Finally remove any pruned files, once the chainstate written by
+            // an earlier flush no longer needs them to be replayed.
+            if (fFlushForPrune) {
+                if (!pcoinsdbview->SyncPendingWrites())
+                    return AbortNode(state, "Failed to write to coin database");
                 UnlinkPrunedFiles(setFilesToPrune);
+            }
             nLastWrite = nNow;
         }
         // Flush best chain related state. This can only be done if the blocks / block index write was also done.
@@ -2146,8 +2648,18 @@ bool static FlushStateToDisk(CValidationState &state, FlushStateMode mode, int n
             // Flush the chainstate (which may refer to block index entries).
             if (!pcoinsTip->Flush())
                 return AbortNode(state, "Failed to write to coin database");
+            // Other flushes are written by the coins database in the background,
+            // and only reported once they are on disk: listeners persist the
+            // locator and must not get ahead of the chainstate they replay from.
+            if (mode == FlushStateMode::ALWAYS) {
+                if (!pcoinsdbview->SyncPendingWrites())
+                    return AbortNode(state, "Failed to write to coin database");
+                full_flush_completed = true;
+            } else {
+                const CBlockLocator locator = chainActive.GetLocator();
+                pcoinsdbview->AfterPendingWrites([locator] { GetMainSignals().ChainStateFlushed(locator); });
+            }
             nLastFlush = nNow;
-            full_flush_completed = true;
         }
     }
     if (full_flush_completed) {
@@ -2225,11 +2737,11 @@ bool CChainState::DisconnectTip(CValidationState& state, DisconnectedBlockTransa
 {
     CBlockIndex *pindexDelete = chainActive.Tip();
     assert(pindexDelete);
-    // Read block from disk.
-    std::shared_ptr<CBlock> pblock = std::make_shared<CBlock>();
-    CBlock& block = *pblock;
-    if (!ReadBlockFromDisk(block, pindexDelete))
+    // Read block from disk, unless it was connected recently.
+    std::shared_ptr<const CBlock> pblock = ReadBlockFromDiskCached(pindexDelete, false);
+    if (!pblock)
         return AbortNode(state, "Failed to read block");
+    const CBlock& block = *pblock;
     // Apply the block atomically to the chain state.
     int64_t nStart = GetTimeMicros();
     {
@@ -2268,6 +2780,7 @@ bool CChainState::DisconnectTip(CValidationState& state, DisconnectedBlockTransa
 }
 
 static int64_t nTimeReadFromDisk = 0;
+static int64_t nTimePrefetch = 0;
 static int64_t nTimeConnectTotal = 0;
 static int64_t nTimeFlush = 0;
 static int64_t nTimeChainState = 0;
@@ -2351,10 +2864,9 @@ bool CChainState::ConnectTip(CValidationState& state, CBlockIndex* pindexNew, co
     int64_t nTime1 = GetTimeMicros();
     std::shared_ptr<const CBlock> pthisBlock;
     if (!pblock) {
-        std::shared_ptr<CBlock> pblockNew = std::make_shared<CBlock>();
-        if (!ReadBlockFromDisk(*pblockNew, pindexNew))
+        pthisBlock = ReadBlockFromDiskCached(pindexNew, false);
+        if (!pthisBlock)
             return AbortNode(state, "Failed to read block");
-        pthisBlock = pblockNew;
     } else {
         pthisBlock = pblock;
     }
@@ -2363,6 +2875,12 @@ bool CChainState::ConnectTip(CValidationState& state, CBlockIndex* pindexNew, co
     int64_t nTime2 = GetTimeMicros(); nTimeReadFromDisk += nTime2 - nTime1;
     int64_t nTime3;
     LogPrint(BCLog::BENCH, "  - Load block from disk: %.2fms [%.2fs]\n", (nTime2 - nTime1) * MILLI, nTimeReadFromDisk * MICRO);
+    // Warm pcoinsTip with the block's inputs in parallel. pcoinsTip falls back
+    // to pcoinsdbview (through the error catcher, which adds nothing on success).
+    size_t nPrefetched = PrefetchBlockInputs(blockConnecting, *pcoinsTip, *pcoinsdbview);
+    int64_t nTimePrefetched = GetTimeMicros(); nTimePrefetch += nTimePrefetched - nTime2;
+    LogPrint(BCLog::BENCH, "  - Prefetch %u inputs: %.2fms [%.2fs]\n", (unsigned)nPrefetched, (nTimePrefetched - nTime2) * MILLI, nTimePrefetch * MICRO);
+    nTime2 = nTimePrefetched;
     {
         CCoinsViewCache view(pcoinsTip.get());
         bool rv = ConnectBlock(blockConnecting, state, pindexNew, view);
@@ -2402,6 +2920,8 @@ bool CChainState::ConnectTip(CValidationState& state, CBlockIndex* pindexNew, co
     LogPrint(BCLog::BENCH, "  - Connect postprocess: %.2fms [%.2fs (%.2fms/blk)]\n", (nTime6 - nTime5) * MILLI, nTimePostConnect * MICRO, nTimePostConnect * MILLI / nBlocksTotal);
     LogPrint(BCLog::BENCH, "- Connect block: %.2fms [%.2fs (%.2fms/blk)]\n", (nTime6 - nTime1) * MILLI, nTimeTotal * MICRO, nTimeTotal * MILLI / nBlocksTotal);
 
+    // Recently connected blocks are the ones peers, RPC and REST ask for most.
+    g_block_cache.Insert(pindexNew->GetBlockHash(), pthisBlock);
     connectTrace.BlockConnected(pindexNew, std::move(pthisBlock));
     return true;
 }
@@ -3016,15 +3536,15 @@ static bool CheckBlockHeader(const CBlockHeader& block, CValidationState& state,
     if(!proofSize)
         return state.Invalid(false, REJECT_INVALID, "bad-proof", "No Proof in block");
 
-    CPubKey aggregatePubkey = FederationParams().GetAggPubkeyFromHeight(nHeight);
+    const aggPubkeyAndHeight aggregatePubkey = FederationParams().GetAggPubkeyAndHeightFromHeight(nHeight);
 
-    if(!aggregatePubkey.IsValid())
+    if(!aggregatePubkey.aggpubkeyParsed.IsValid())
         return state.Error("Invalid aggregatePubkey");
 
     const uint256 blockHash = block.GetHashForSign();
 
     //verify signature
-    if(!aggregatePubkey.Verify_Schnorr(blockHash, block.proof))
+    if(!CheckBlockProof(blockHash, block.proof, aggregatePubkey.aggpubkey, &aggregatePubkey.aggpubkeyParsed))
         return state.Invalid(false, REJECT_INVALID, "bad-proof", "Proof verification failed");
 
     return true;
@@ -3219,7 +3739,7 @@ static bool ContextualCheckBlock(const CBlock& block, CValidationState& state, c
     return true;
 }
 
-bool CChainState::AcceptBlockHeader(const CBlockHeader& block, CValidationState& state, CBlockIndex** ppindex)
+bool CChainState::AcceptBlockHeader(const CBlockHeader& block, CValidationState& state, CBlockIndex** ppindex, bool fProofChecked)
 {
     AssertLockHeld(cs_main);
     // Check for duplicate
@@ -3237,7 +3757,7 @@ bool CChainState::AcceptBlockHeader(const CBlockHeader& block, CValidationState&
             return true;
         }
 
-        if (!CheckBlockHeader(block, state))
+        if (!CheckBlockHeader(block, state, -1, !fProofChecked))
             return error("%s: Consensus::CheckBlockHeader: %s, %s", __func__, hash.ToString(), FormatStateMessage(state));
 
         // Get prev block index
@@ -3280,15 +3800,66 @@ bool CChainState::AcceptBlockHeader(const CBlockHeader& block, CValidationState&
     return true;
 }
 
+/**
+ * Verify the block proofs of the new headers in a headers message on the
+ * header proof checking threads, without holding cs_main while doing so.
+ * vProofChecked[i] is set for every header whose proof was verified against
+ * aggpubkey. If any proof is invalid nothing is marked, so that the serial
+ * path in AcceptBlockHeader reports the first invalid header.
+ */
+static void CheckHeaderProofsParallel(const std::vector<CBlockHeader>& headers, std::vector<bool>& vProofChecked, CPubKey& aggpubkey) LOCKS_EXCLUDED(cs_main)
+{
+    vProofChecked.assign(headers.size(), false);
+    if (!nScriptCheckThreads || headers.size() < 2)
+        return;
+
+    std::vector<CHeaderProofCheck> vChecks;
+    std::vector<size_t> vIndices;
+    aggPubkeyAndHeight latest;
+    {
+        LOCK(cs_main);
+        // AcceptBlockHeader checks proofs against the latest aggregate public key.
+        // It is copied once, as the checks run without cs_main.
+        latest = FederationParams().GetAggPubkeyAndHeightFromHeight(-1);
+        aggpubkey = latest.aggpubkey;
+        vChecks.reserve(headers.size());
+        vIndices.reserve(headers.size());
+        for (size_t i = 0; i < headers.size(); i++) {
+            // Known headers are not checked again.
+            if (headers[i].proof.empty() || LookupBlockIndex(headers[i].GetHash()))
+                continue;
+            vChecks.emplace_back(headers[i], latest.aggpubkey, latest.aggpubkeyParsed);
+            vIndices.push_back(i);
+        }
+    }
+    if (vChecks.size() < 2)
+        return;
+
+    CCheckQueueControl<CHeaderProofCheck> control(&headerproofcheckqueue);
+    control.Add(vChecks);
+    if (!control.Wait())
+        return;
+
+    for (size_t i : vIndices)
+        vProofChecked[i] = true;
+}
+
 // Exposed wrapper for AcceptBlockHeader
 bool ProcessNewBlockHeaders(const std::vector<CBlockHeader>& headers, CValidationState& state, const CBlockIndex** ppindex, CBlockHeader *first_invalid)
 {
     if (first_invalid != nullptr) first_invalid->SetNull();
+
+    std::vector<bool> vProofChecked;
+    CPubKey aggpubkey;
+    CheckHeaderProofsParallel(headers, vProofChecked, aggpubkey);
     {
         LOCK(cs_main);
-        for (const CBlockHeader& header : headers) {
+        // A block connected in the meantime may have changed the aggregate public key.
+        const bool fAggPubkeyUnchanged = aggpubkey == FederationParams().GetLatestAggregatePubkey();
+        for (size_t i = 0; i < headers.size(); i++) {
+            const CBlockHeader& header = headers[i];
             CBlockIndex *pindex = nullptr; // Use a temp pindex instead of ppindex to avoid a const_cast
-            if (!g_chainstate.AcceptBlockHeader(header, state, &pindex)) {
+            if (!g_chainstate.AcceptBlockHeader(header, state, &pindex, fAggPubkeyUnchanged && vProofChecked[i])) {
                 if (first_invalid) *first_invalid = header;
                 return false;
             }
@@ -3438,6 +4009,7 @@ bool TestBlockValidity(CValidationState& state, const CBlock& block, CBlockIndex
     indexDummy.nHeight = pindexPrev->nHeight + 1;
     indexDummy.phashBlock = &block_hash;
 
+    int64_t nTimeStart = GetTimeMicros();
     // NOTE: CheckBlockHeader is called by CheckBlock
     if (!ContextualCheckBlockHeader(block, state, pindexPrev, GetAdjustedTime()))
         return error("%s: Consensus::ContextualCheckBlockHeader: %s", __func__, FormatStateMessage(state));
@@ -3445,9 +4017,13 @@ bool TestBlockValidity(CValidationState& state, const CBlock& block, CBlockIndex
         return error("%s: Consensus::CheckBlock: %s", __func__, FormatStateMessage(state));
     if (!ContextualCheckBlock(block, state, pindexPrev))
         return error("%s: Consensus::ContextualCheckBlock: %s", __func__, FormatStateMessage(state));
+    int64_t nTime1 = GetTimeMicros();
     if (!g_chainstate.ConnectBlock(block, state, &indexDummy, viewNew, true))
         return false;
     assert(state.IsValid());
+    int64_t nTime2 = GetTimeMicros();
+    LogPrint(BCLog::BENCH, "TestBlockValidity(): block checks: %.2fms, connect: %.2fms (total %.2fms)\n",
+             MILLI * (nTime1 - nTimeStart), MILLI * (nTime2 - nTime1), MILLI * (nTime2 - nTimeStart));
 
     return true;
 }
@@ -3507,6 +4083,7 @@ void UnlinkPrunedFiles(const std::set<int>& setFilesToPrune)
 {
     for (std::set<int>::iterator it = setFilesToPrune.begin(); it != setFilesToPrune.end(); ++it) {
         CDiskBlockPos pos(*it, 0);
+        g_block_file_maps.Erase(GetBlockPosFilename(pos, "blk"));
         fs::remove(GetBlockPosFilename(pos, "blk"));
         fs::remove(GetBlockPosFilename(pos, "rev"));
         LogPrintf("Prune: %s deleted blk/rev (%05u)\n", __func__, *it);
@@ -3663,7 +4240,7 @@ fs::path GetBlockPosFilename(const CDiskBlockPos &pos, const char *prefix)
     return GetBlocksDir() / strprintf("%s%05u.dat", prefix, pos.nFile);
 }
 
-CBlockIndex * CChainState::InsertBlockIndex(const uint256& hash)
+CBlockIndex * CChainState::InsertBlockIndex(const uint256& hash, CBlockIndex* pindexNew)
 {
     AssertLockHeld(cs_main);
 
@@ -3675,8 +4252,9 @@ CBlockIndex * CChainState::InsertBlockIndex(const uint256& hash)
     if (mi != mapBlockIndex.end())
         return (*mi).second;
 
-    // Create new
-    CBlockIndex* pindexNew = new CBlockIndex();
+    // Create new, unless the caller already has
+    if (!pindexNew)
+        pindexNew = new CBlockIndex();
     mi = mapBlockIndex.insert(std::make_pair(hash, pindexNew)).first;
     pindexNew->phashBlock = &((*mi).first);
 
@@ -3685,22 +4263,28 @@ CBlockIndex * CChainState::InsertBlockIndex(const uint256& hash)
 
 bool CChainState::LoadBlockIndex(CBlockTreeDB& blocktree)
 {
-    if (!blocktree.LoadBlockIndexGuts([this](const uint256& hash) EXCLUSIVE_LOCKS_REQUIRED(cs_main) { return this->InsertBlockIndex(hash); }))
+    // Decode with as many threads as script verification uses.
+    if (!blocktree.LoadBlockIndexGuts(blockIndexArena, nScriptCheckThreads + 1, [this](const uint256& hash, CBlockIndex* pindex) EXCLUSIVE_LOCKS_REQUIRED(cs_main) { return this->InsertBlockIndex(hash, pindex); }))
         return false;
 
     boost::this_thread::interruption_point();
 
-    std::vector<std::pair<int, CBlockIndex*> > vSortedByHeight;
-    vSortedByHeight.reserve(mapBlockIndex.size());
+    // Order the entries by height with a counting sort, so that every entry
+    // is visited after its parent in the single pass below.
+    int nMaxHeight = 0;
     for (const std::pair<const uint256, CBlockIndex*>& item : mapBlockIndex)
+        nMaxHeight = std::max(nMaxHeight, item.second->nHeight);
+    std::vector<size_t> vHeightStart(nMaxHeight + 2, 0);
+    for (const std::pair<const uint256, CBlockIndex*>& item : mapBlockIndex)
+        vHeightStart[item.second->nHeight + 1]++;
+    for (int nHeight = 1; nHeight <= nMaxHeight + 1; nHeight++)
+        vHeightStart[nHeight] += vHeightStart[nHeight - 1];
+    std::vector<CBlockIndex*> vSortedByHeight(mapBlockIndex.size());
+    for (const std::pair<const uint256, CBlockIndex*>& item : mapBlockIndex)
+        vSortedByHeight[vHeightStart[item.second->nHeight]++] = item.second;
+
+    for (CBlockIndex* pindex : vSortedByHeight)
     {
-        CBlockIndex* pindex = item.second;
-        vSortedByHeight.push_back(std::make_pair(pindex->nHeight, pindex));
-    }
-    sort(vSortedByHeight.begin(), vSortedByHeight.end());
-    for (const std::pair<int, CBlockIndex*>& item : vSortedByHeight)
-    {
-        CBlockIndex* pindex = item.second;
         pindex->nTimeMax = (pindex->pprev ? std::max(pindex->pprev->nTimeMax, pindex->nTime) : pindex->nTime);
         // We can link the chain of blocks for which we've received transactions at some point.
         // Pruned nodes may have deleted the block.
@@ -4116,16 +4700,32 @@ void UnloadBlockIndex()
     nLastBlockFile = 0;
     setDirtyBlockIndex.clear();
     setDirtyFileInfo.clear();
+    g_block_file_maps.Clear();
+    g_block_cache.Clear();
 
     for (BlockMap::value_type& entry : mapBlockIndex) {
-        delete entry.second;
+        DeleteBlockIndex(entry.second);
     }
     mapBlockIndex.clear();
+    g_chainstate.blockIndexArena.Clear();
     fHavePruned = false;
 
     g_chainstate.UnloadBlockIndex();
 }
 
+size_t BlockIndexDynamicMemoryUsage()
+{
+    AssertLockHeld(cs_main);
+    size_t usage = memusage::DynamicUsage(mapBlockIndex);
+    for (const BlockMap::value_type& entry : mapBlockIndex) {
+        const CBlockIndex* pindex = entry.second;
+        // Arena entries share one allocation per batch.
+        usage += g_chainstate.blockIndexArena.Owns(pindex) ? sizeof(CBlockIndex) : memusage::MallocUsage(sizeof(CBlockIndex));
+        usage += pindex->DynamicMemoryUsage();
+    }
+    return usage;
+}
+
 bool LoadBlockIndex()
 {
     // Load block index from databases
@@ -4222,6 +4822,7 @@ bool LoadExternalBlockFile(FILE* fileIn, CDiskBlockPos *dbp)
                 std::shared_ptr<CBlock> pblock = std::make_shared<CBlock>();
                 CBlock& block = *pblock;
                 blkdat >> block;
+                block.MemoizeHashes();
                 nRewind = blkdat.GetPos();
 
                 uint256 hash = block.GetHash();
@@ -4656,8 +5257,9 @@ public:
         // block headers
         BlockMap::iterator it1 = mapBlockIndex.begin();
         for (; it1 != mapBlockIndex.end(); it1++)
-            delete (*it1).second;
+            DeleteBlockIndex((*it1).second);
         mapBlockIndex.clear();
+        g_chainstate.blockIndexArena.Clear();
     }
 } instance_of_cmaincleanup;
 
@@ -17,6 +17,7 @@
 #include <protocol.h> // For CMessageHeader::MessageStartChars
 #include <policy/feerate.h>
 #include <script/script_error.h>
+#include <span.h>
 #include <sync.h>
 #include <chainparams.h>
 #include <chain.h>
@@ -33,13 +34,16 @@
 
 #include <atomic>
 
+class CBlockCache;
 class CBlockIndex;
 class CBlockTreeDB;
+class CBlockUndo;
 class CChainParams;
 class CCoinsViewDB;
 class CInv;
 class CConnman;
 class CScriptCheck;
+class CSchnorrBatch;
 class CBlockPolicyEstimator;
 class CTxMemPool;
 class CValidationState;
@@ -78,11 +82,15 @@ static const unsigned int MAX_BLOCKFILE_SIZE = 0x8000000; // 128 MiB
 static const unsigned int BLOCKFILE_CHUNK_SIZE = 0x1000000; // 16 MiB
 /** The pre-allocation chunk size for rev?????.dat files (since 0.8) */
 static const unsigned int UNDOFILE_CHUNK_SIZE = 0x100000; // 1 MiB
+/** Number of blk?????.dat files kept memory mapped for reading blocks */
+static const unsigned int MAX_MAPPED_BLOCK_FILES = 8;
 
 /** Maximum number of script-checking threads allowed */
 static const int MAX_SCRIPTCHECK_THREADS = 16;
 /** -par default (number of script-checking threads, 0 = auto) */
 static const int DEFAULT_SCRIPTCHECK_THREADS = 0;
+/** Minimum number of inputs of a transaction for mempool acceptance to run its script checks on the script check threads */
+static const unsigned int MIN_PARALLEL_MEMPOOL_INPUTS = 4;
 /** Number of blocks that can be requested at any given time from a single peer. */
 static const int MAX_BLOCKS_IN_TRANSIT_PER_PEER = 16;
 /** Timeout in seconds during which a peer must stall block download progress before being disconnected. */
@@ -121,6 +129,12 @@ static const int64_t MAX_FEE_ESTIMATION_TIP_AGE = 3 * 60 * 60;
 static const bool DEFAULT_PERMIT_BAREMULTISIG = true;
 static const bool DEFAULT_CHECKPOINTS_ENABLED = true;
 static const bool DEFAULT_TXINDEX = false;
+static const bool DEFAULT_COLORINDEX = false;
+static const bool DEFAULT_COINSTATSINDEX = false;
+/** Default for -blockmmap. Off, as a read error on a mapped block file kills the process with SIGBUS. */
+static const bool DEFAULT_BLOCK_MMAP = false;
+/** Default for -maxblockcachesize, the memory for recently used blocks in MiB */
+static const unsigned int DEFAULT_MAX_BLOCK_CACHE_SIZE = 32;
 static const unsigned int DEFAULT_BANSCORE_THRESHOLD = 100;
 /** Default for -persistmempool */
 static const bool DEFAULT_PERSIST_MEMPOOL = true;
@@ -164,6 +178,10 @@ extern int nScriptCheckThreads;
 extern bool fIsBareMultisigStd;
 extern bool fCheckBlockIndex;
 extern bool fCheckpointsEnabled;
+/** Whether blocks are read from memory mapped block files (-blockmmap) */
+extern bool fBlockFileMmap;
+/** Recently connected and read blocks, shared by everything that reads blocks by index. */
+extern CBlockCache g_block_cache;
 extern size_t nCoinCacheUsage;
 /** A fee rate smaller than this is considered zero fee (for relaying, mining and transaction creation) */
 extern CFeeRate minRelayTxFee;
@@ -263,8 +281,16 @@ bool LoadBlockIndex() EXCLUSIVE_LOCKS_REQUIRED(cs_main);
 bool LoadChainTip();
 /** Unload database information */
 void UnloadBlockIndex();
+/** Memory used by mapBlockIndex and its entries, in bytes */
+size_t BlockIndexDynamicMemoryUsage() EXCLUSIVE_LOCKS_REQUIRED(cs_main);
 /** Run an instance of the script checking thread */
 void ThreadScriptCheck();
+/** Run an instance of the thread verifying scripts ahead of mempool acceptance */
+void ThreadMempoolScriptCheck();
+/** Run an instance of the header proof checking thread */
+void ThreadHeaderProofCheck();
+/** Run an instance of the thread that reads block inputs from the coins database ahead of ConnectBlock */
+void ThreadCoinPrefetch();
 /** Check whether we are doing an initial block download (synchronizing from disk or network) */
 bool IsInitialBlockDownload();
 /** Retrieve a transaction (from memory pool, or from disk, if possible) */
@@ -307,6 +333,25 @@ bool AcceptToMemoryPool(CTxMemPool& pool, CValidationState &state, const CTransa
                         bool* pfMissingInputs, std::list<CTransactionRef>* plTxnReplaced,
                         bool bypass_limits, const CAmount nAbsurdFee, bool test_accept=false);
 
+/**
+ * Verify the scripts of transactions about to be submitted to
+ * AcceptToMemoryPool together on the mempool script check threads, storing their
+ * signatures in the signature cache so that AcceptToMemoryPool does not verify
+ * them again. cs_main is held while the inputs of the whole batch are looked
+ * up, not while the scripts run. Only transactions that pass the checks
+ * AcceptToMemoryPool makes before the scripts are verified, and nothing is
+ * verified when there are no script check threads. The results are not used
+ * otherwise: AcceptToMemoryPool still validates every transaction in full.
+ *
+ * @param[out] coins_to_uncache  the inputs this loaded into the coins cache,
+ *                               to be passed to UncacheUnspentCoins once the
+ *                               transactions have been submitted
+ */
+void PreverifyMempoolScripts(const CTxMemPool& pool, const std::vector<CTransactionRef>& txs, std::vector<COutPoint>& coins_to_uncache);
+
+/** Remove the coins no mempool transaction spends from the coins cache, as AcceptToMemoryPool does for rejected transactions */
+void UncacheUnspentCoins(const CTxMemPool& pool, const std::vector<COutPoint>& coins) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
+
 /** Convert CValidationState to a human-readable message for logging */
 std::string FormatStateMessage(const CValidationState &state);
 
@@ -357,13 +402,19 @@ private:
     ScriptError error;
     PrecomputedTransactionData *txdata;
     ColorIdentifier colorid;
+    ColorIdentifier *pcoloridOut;
+    bool fCacheOnly;
 
 public:
-    CScriptCheck(): ptxTo(nullptr), nIn(0), nFlags(0), cacheStore(false), error(SCRIPT_ERR_UNKNOWN_ERROR), colorid(ColorIdentifier()) {}
+    CScriptCheck(): ptxTo(nullptr), nIn(0), nFlags(0), cacheStore(false), error(SCRIPT_ERR_UNKNOWN_ERROR), colorid(ColorIdentifier()), pcoloridOut(nullptr), fCacheOnly(false) {}
     CScriptCheck(const CTxOut& outIn, const CTransaction& txToIn, unsigned int nInIn, unsigned int nFlagsIn, bool cacheIn, PrecomputedTransactionData* txdataIn, ColorIdentifier coloridIn = ColorIdentifier()) :
-        m_tx_out(outIn), ptxTo(&txToIn), nIn(nInIn), nFlags(nFlagsIn), cacheStore(cacheIn), error(SCRIPT_ERR_UNKNOWN_ERROR), txdata(txdataIn), colorid(coloridIn) { }
+        m_tx_out(outIn), ptxTo(&txToIn), nIn(nInIn), nFlags(nFlagsIn), cacheStore(cacheIn), error(SCRIPT_ERR_UNKNOWN_ERROR), txdata(txdataIn), colorid(coloridIn), pcoloridOut(nullptr), fCacheOnly(false) { }
 
-    bool operator()();
+    /**
+     * Run the script. If batch is given, Schnorr signatures may be queued in
+     * it instead of being verified (see CachingTransactionSignatureChecker).
+     */
+    bool operator()(CSchnorrBatch* batch = nullptr);
 
     void swap(CScriptCheck &check) {
         std::swap(ptxTo, check.ptxTo);
@@ -374,21 +425,76 @@ public:
         std::swap(error, check.error);
         std::swap(txdata, check.txdata);
         std::swap(colorid, check.colorid);
+        std::swap(pcoloridOut, check.pcoloridOut);
+        std::swap(fCacheOnly, check.fCacheOnly);
     }
 
     ScriptError GetScriptError() const { return error; }
     const ColorIdentifier& GetColorIdentifier() const { return colorid; }
+
+    /**
+     * Have a successful run also write the color of the spent output to
+     * *pcoloridOutIn, for callers that hand the check to the check queue and
+     * no longer own it when it runs.
+     */
+    void SetColorIdentifierOut(ColorIdentifier* pcoloridOutIn) { pcoloridOut = pcoloridOutIn; }
+
+    /**
+     * Run only to store the signatures in the signature cache: report success
+     * whatever the result, so that the check queue goes on with the checks of
+     * the other transactions queued with this one.
+     */
+    void SetCacheOnly() { fCacheOnly = true; }
 };
 
+/**
+ * Run a slice of script checks taken off the check queue, verifying all their
+ * Schnorr signatures as one batch. Falls back to checking every script on its
+ * own when the batch fails. Overrides the generic RunCheckBatch in checkqueue.h.
+ */
+bool RunCheckBatch(std::vector<CScriptCheck>& vChecks);
+
 /** Initializes the script-execution cache */
 void InitScriptExecutionCache();
 
+/** Initializes the cache of verified block proofs */
+void InitBlockProofCache();
+
+/**
+ * Verify a block proof, the Schnorr signature of the aggregate public key on
+ * the block's sign hash. Valid proofs are remembered, so each proof is verified
+ * once. aggpubkeyParsed, if given, must be aggpubkey already parsed.
+ */
+bool CheckBlockProof(const uint256& hash, const std::vector<unsigned char>& proof, const CPubKey& aggpubkey, const CParsedPubKey* aggpubkeyParsed = nullptr);
+
 
 /** Functions for disk access for blocks */
 bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos, int height);
 bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex);
-bool ReadRawBlockFromDisk(std::vector<uint8_t>& block, const CDiskBlockPos& pos, const CMessageHeader::MessageStartChars& message_start);
-bool ReadRawBlockFromDisk(std::vector<uint8_t>& block, const CBlockIndex* pindex, const CMessageHeader::MessageStartChars& message_start);
+/**
+ * Return the block from g_block_cache, or read it from disk. Blocks read from
+ * disk are added to the cache unless fCacheResult is false, which callers
+ * walking through old blocks use so they do not evict the recent ones.
+ * Returns nullptr if the block cannot be read.
+ */
+std::shared_ptr<const CBlock> ReadBlockFromDiskCached(const CBlockIndex* pindex, bool fCacheResult = true);
+/** Read the undo data of a block, i.e. the coins its transactions spent */
+bool UndoReadFromDisk(CBlockUndo& blockundo, const CBlockIndex* pindex);
+
+/**
+ * A block as serialized on disk, which is also its network serialization.
+ * data points into a memory mapped block file, or into a buffer read from it
+ * when mapping is not available; either way it stays valid for as long as
+ * keep_alive is held.
+ */
+struct CRawBlockData {
+    Span<const uint8_t> data;
+    std::shared_ptr<const void> keep_alive;
+};
+
+/** Read a block without deserializing it. Served straight from the mapped block file when possible. */
+bool ReadRawBlockFromDisk(CRawBlockData& block, const CDiskBlockPos& pos, const CMessageHeader::MessageStartChars& message_start);
+bool ReadRawBlockFromDisk(CRawBlockData& block, const CBlockIndex* pindex, const CMessageHeader::MessageStartChars& message_start);
 
 /** Functions for validating blocks and updating the block tree */
 
@@ -1775,8 +1775,11 @@ CBlockIndex* CWallet::ScanForWalletTransactions(CBlockIndex* pindexStart, CBlock
                 WalletLogPrintf("Still rescanning. At block %d. Progress=%f\n", pindex->nHeight, progress_current);
             }
 
-            CBlock block;
-            if (ReadBlockFromDisk(block, pindex)) {
+            // Rescans walk through old blocks, so do not let them evict the
+            // recent ones from the block cache.
+            std::shared_ptr<const CBlock> pblock = ReadBlockFromDiskCached(pindex, false);
+            if (pblock) {
+                const CBlock& block = *pblock;
                 LOCK2(cs_main, cs_wallet);
                 if (pindex && !chainActive.Contains(pindex)) {
                     // Abort scan if current block is no longer active, to prevent
@@ -0,0 +1,95 @@
+#!/usr/bin/env python3
+# Copyright (c) 2020 Chaintope Inc.
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+"""Test gettxoutsetinfo with -coinstatsindex.
+
+- Start a node with a chain but no index. Verify that the new index syncs
+  from the genesis block and agrees with a scan of the UTXO set.
+- Connect, invalidate and reconsider blocks, and restart the node. Verify
+  that the index still agrees with the scan.
+- Verify that use_index=false and a node without the index scan the UTXO set.
+"""
+
+from test_framework.test_framework import BitcoinTestFramework
+from test_framework.util import (
+    assert_equal,
+    wait_until,
+)
+
+# Fields the index maintains; the others are only returned by a scan.
+INDEX_FIELDS = ('height', 'bestblock', 'txouts', 'bogosize', 'total_amount', 'colors')
+
+class CoinStatsIndexTest(BitcoinTestFramework):
+
+    def set_test_params(self):
+        self.num_nodes = 1
+        self.extra_args = [['-coinstatsindex']]
+
+    def index_synced(self):
+        try:
+            self.nodes[0].gettxoutsetinfo()
+            return True
+        except Exception as e:
+            if 'still syncing' not in str(e):
+                raise
+            return False
+
+    def check_index(self):
+        node = self.nodes[0]
+        wait_until(self.index_synced, timeout=30)
+        index = node.gettxoutsetinfo()
+        scan = node.gettxoutsetinfo(False)
+        assert 'transactions' not in index
+        assert 'hash_serialized_2' not in index
+        assert 'hash_serialized_2' in scan
+        for field in INDEX_FIELDS:
+            assert_equal(index[field], scan[field])
+        assert_equal(index['bestblock'], node.getbestblockhash())
+        return index
+
+    def run_test(self):
+        node = self.nodes[0]
+
+        self.log.info("Test that a new index syncs from the genesis block")
+        res = self.check_index()
+        assert_equal(res['height'], 200)
+
+        self.log.info("Test that the index follows connected blocks")
+        node.generate(5, self.signblockprivkey)
+        res = self.check_index()
+        assert_equal(res['height'], 205)
+
+        self.log.info("Test that the index follows invalidated and reconsidered blocks")
+        b201 = node.getblockhash(201)
+        node.invalidateblock(b201)
+        res = self.check_index()
+        assert_equal(res['height'], 200)
+        node.reconsiderblock(b201)
+        res = self.check_index()
+        assert_equal(res['height'], 205)
+
+        self.log.info("Test that the index is at the genesis block for a chain of just the genesis block")
+        b1 = node.getblockhash(1)
+        node.invalidateblock(b1)
+        res = self.check_index()
+        assert_equal(res['height'], 0)
+        assert_equal(res['txouts'], 0)
+        assert_equal(res['bestblock'], node.getblockhash(0))
+        node.reconsiderblock(b1)
+        self.check_index()
+
+        self.log.info("Test that the index is kept across restarts")
+        self.restart_node(0, ['-coinstatsindex'])
+        res = self.check_index()
+        assert_equal(res['height'], 205)
+
+        self.log.info("Test that the UTXO set is scanned without the index")
+        self.restart_node(0, [])
+        scan = node.gettxoutsetinfo()
+        assert 'hash_serialized_2' in scan
+        for field in INDEX_FIELDS:
+            assert_equal(scan[field], res[field])
+
+if __name__ == '__main__':
+    CoinStatsIndexTest().main()
@@ -92,5 +92,16 @@ class ScantxoutsetTest(BitcoinTestFramework):
         assert_equal(self.nodes[0].scantxoutset("start", [ {"desc": "combo(tpubD6NzVbkrYhZ4WaWSyoBvQwbpLkojyoTZPRsgXELWz3Popb3qkjcJyJUGLnL4qHHoQvao8ESaAstxYSnhyswJ76uZPStJRJCTKvosUCJZL5B/1/1/*)", "range": 1499}])['total_amount'], Decimal("12.288"))
         assert_equal(self.nodes[0].scantxoutset("start", [ {"desc": "combo(tpubD6NzVbkrYhZ4WaWSyoBvQwbpLkojyoTZPRsgXELWz3Popb3qkjcJyJUGLnL4qHHoQvao8ESaAstxYSnhyswJ76uZPStJRJCTKvosUCJZL5B/1/1/*)", "range": 1500}])['total_amount'], Decimal("28.672"))
 
+        self.log.info("Test color filters and scan ids.")
+        color = "c1" + "00" * 32
+        assert_equal(self.nodes[0].scantxoutset("start", [ {"desc": "addr(mtfUoUax9L4tzXARpw1oTGxWyoogp52KhJ)", "color": color} ])['unspents'], [])
+        assert_equal(self.nodes[0].scantxoutset("start", [ {"color": color} ])['unspents'], [])
+        assert_equal(self.nodes[0].scantxoutset("start", [ "addr(mtfUoUax9L4tzXARpw1oTGxWyoogp52KhJ)", "addr(mxp7w7j8S1Aq6L8StS2PqVvtt4HGxXEvdy)" ], "myscan")['total_amount'], Decimal("12.288"))
+        assert_raises_rpc_error(-8, "Invalid color identifier", self.nodes[0].scantxoutset, "start", [ {"color": "c1"} ])
+        assert_raises_rpc_error(-8, "Descriptor or color needs to be provided in scan object", self.nodes[0].scantxoutset, "start", [ {"range": 1} ])
+        assert_equal(self.nodes[0].scantxoutset("status"), None)
+        assert_equal(self.nodes[0].scantxoutset("status", None, "myscan"), None)
+        assert_equal(self.nodes[0].scantxoutset("abort"), False)
+
 if __name__ == '__main__':
     ScantxoutsetTest().main()
@@ -84,6 +84,7 @@ BASE_SCRIPTS = [
     'rpc_rawtransaction.py --scheme SCHNORR',
     'wallet_address_types.py',
     'feature_reindex.py',
+    'feature_coinstatsindex.py',
     'feature_serialization.py',
     'feature_serialization.py --scheme SCHNORR',
     'feature_federation_management.py',